@@ -0,0 +1,764 @@
+#include "os-dependencies.h"
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "FakeAudioEndpoints.h"
+#include "FanOutHttpRequestDispatcher.h"
+#include "NdjsonHttpRequestDispatchers.h"
+#include "NotificationReplay.h"
+#include "PayloadEncoding.h"
+#include "PipelineLatency.h"
+#include "RelayClientHttpRequestDispatcher.h"
+#include "ServiceObserver.h"
+#include "SoundDevice.h"
+#include "SoundDeviceCollection.h"
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <ranges>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Poco/String.h>
+#include <spdlog/spdlog.h>
+
+
+// Fleet load simulator: many virtual agents in one process, each one a SoundDeviceCollection on fake endpoints
+// observed by the agent's own ServiceObserver (the very code path of the service), all of them sending into one
+// sink pipeline. Plug/unplug, default switches and volume drags arrive per agent as endpoint callbacks, Poisson
+// processes at rates of real desks; the simulated time runs --time-scale times faster than the real one. The
+// callbacks are processed on the driver threads, as the collection does on the threads of the audio service.
+// With --replay, every agent replays a notification recording of a real agent instead, --replay-speed times
+// faster than recorded, and the recorded snapshots are verified against the agent's collection.
+// Reports the messages and bytes per second reaching the sink and the latency percentiles per stage.
+namespace
+{
+    using SteadyClock = std::chrono::steady_clock;
+
+    constexpr auto EVENT_TIME_HEADER_KEY = "X-Fleet-Simulator-Event-Us";
+    constexpr auto ENTRY_TIME_HEADER_KEY = "X-Fleet-Simulator-Entry-Us";
+
+    // Time the driver started the step being processed on this thread, e.g. posting the whole collection on start
+    thread_local SteadyClock::time_point currentEventTime;
+
+    // Of the event being processed on this thread: an endpoint notification is processed on the thread delivering it,
+    // which calls the observers and with them the dispatchers synchronously
+    SteadyClock::time_point GetCurrentEventTime()
+    {
+        const auto* context = ed::LatencyTrace::GetContext();
+        return context != nullptr ? context->steadyCaptureTime : currentEventTime;
+    }
+
+    int64_t ToMicroseconds(const SteadyClock::time_point& time)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    }
+
+    struct SimulatorSettings
+    {
+        size_t agentCount = 1000;
+        std::chrono::seconds duration{30};
+        size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+        double timeScale = 60.0;
+        std::string sink = "None";
+        std::string path = "FleetSimulator.ndjson";
+        std::string relayHost = "localhost";
+        uint16_t relayPort = 5680;
+        std::string relaySecret;
+        ed::PayloadEncoding encoding = ed::PayloadEncoding::Json;
+        size_t queueCapacity = 100000;
+        uint32_t seed = 42;
+        std::string replayPath;
+        double replaySpeed = 1.0; // 0: as fast as possible
+    };
+
+    // Event rates of one desk, per simulated hour
+    struct DeskRates
+    {
+        static constexpr double VOLUME_DRAGS = 4.0;
+        static constexpr double CAPTURE_VOLUME_CHANGES = 1.0;
+        static constexpr double DEFAULT_SWITCHES = 0.5;
+        static constexpr double HEADSET_PLUGS = 0.5;
+        static constexpr double ALL = VOLUME_DRAGS + CAPTURE_VOLUME_CHANGES + DEFAULT_SWITCHES + HEADSET_PLUGS;
+    };
+
+    // Latency samples of one stage in microseconds; beyond the capacity a uniform reservoir sample is kept
+    class LatencySamples final
+    {
+    public:
+        void Add(int64_t latencyUs, std::mt19937& randomGenerator)
+        {
+            ++count_;
+            maxUs_ = std::max(maxUs_, latencyUs);
+            if (samples_.size() < CAPACITY)
+            {
+                samples_.push_back(latencyUs);
+            }
+            else if (const auto slot = std::uniform_int_distribution<uint64_t>(0, count_ - 1)(randomGenerator); slot < CAPACITY)
+            {
+                samples_[slot] = latencyUs;
+            }
+        }
+
+        [[nodiscard]] std::string Format(const std::string& stage)
+        {
+            if (samples_.empty())
+            {
+                return std::format("{:<12} no samples", stage);
+            }
+            std::ranges::sort(samples_);
+            const auto percentile = [this](double quantile)
+                {
+                    return samples_[std::min(samples_.size() - 1, static_cast<size_t>(quantile * static_cast<double>(samples_.size())))];
+                };
+            return std::format("{:<12} p50 {:>8} us, p90 {:>8} us, p99 {:>8} us, p99.9 {:>8} us, max {:>8} us ({} samples)",
+                               stage, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), maxUs_, count_);
+        }
+
+    private:
+        static constexpr size_t CAPACITY = 1'000'000;
+
+        std::vector<int64_t> samples_;
+        uint64_t count_ = 0;
+        int64_t maxUs_ = 0;
+    };
+
+    struct FleetStatistics
+    {
+        std::atomic<uint64_t> eventCount = 0;
+        std::atomic<uint64_t> enteredCount = 0;
+        std::atomic<uint64_t> deliveredCount = 0;
+        std::atomic<uint64_t> deliveredBytes = 0;
+        std::atomic<size_t> finishedDriverCount = 0;
+
+        std::mutex mutex;
+        LatencySamples observerLatencies;
+        LatencySamples pipelineLatencies;
+        LatencySamples endToEndLatencies;
+        uint64_t checkedSnapshotCount = 0;
+        std::vector<std::string> snapshotDifferences;
+    };
+
+    // First stage behind the observers: stamps every request with the time of its event and of entering the pipeline
+    class ProbeHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+    {
+    public:
+        ProbeHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher, FleetStatistics& statistics)
+            : targetDispatcher_(targetDispatcher)
+            , statistics_(statistics)
+        {
+        }
+
+        void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                            const std::string& urlSuffix, const std::string& payload,
+                            const std::unordered_map<std::string, std::string>& header, const std::string& hint
+        ) override
+        {
+            auto stampedHeader = header;
+            stampedHeader[EVENT_TIME_HEADER_KEY] = std::to_string(ToMicroseconds(GetCurrentEventTime()));
+            stampedHeader[ENTRY_TIME_HEADER_KEY] = std::to_string(ToMicroseconds(SteadyClock::now()));
+            ++statistics_.enteredCount;
+            targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, payload, stampedHeader, hint);
+        }
+
+    private:
+        HttpRequestDispatcherInterface& targetDispatcher_;
+        FleetStatistics& statistics_;
+    };
+
+    // Last stage in front of the sink: records the latencies and the delivered bytes, removes the stamps
+    // and hands the request over to the sink, if there is one
+    class MeasuringHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+    {
+    public:
+        MeasuringHttpRequestDispatcher(std::unique_ptr<HttpRequestDispatcherInterface> sink, FleetStatistics& statistics)
+            : sink_(std::move(sink))
+            , statistics_(statistics)
+        {
+        }
+
+        void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                            const std::string& urlSuffix, const std::string& payload,
+                            const std::unordered_map<std::string, std::string>& header, const std::string& hint
+        ) override
+        {
+            const auto nowUs = ToMicroseconds(SteadyClock::now());
+            auto unstampedHeader = header;
+            const auto eventUs = TakeStamp(unstampedHeader, EVENT_TIME_HEADER_KEY);
+            const auto entryUs = TakeStamp(unstampedHeader, ENTRY_TIME_HEADER_KEY);
+
+            size_t bytes = urlSuffix.size() + payload.size();
+            for (const auto& [key, value] : unstampedHeader)
+            {
+                bytes += key.size() + value.size();
+            }
+            if (eventUs > 0 && entryUs > 0)
+            {
+                std::lock_guard lock(statistics_.mutex);
+                statistics_.observerLatencies.Add(entryUs - eventUs, randomGenerator_);
+                statistics_.pipelineLatencies.Add(nowUs - entryUs, randomGenerator_);
+                statistics_.endToEndLatencies.Add(nowUs - eventUs, randomGenerator_);
+            }
+            ++statistics_.deliveredCount;
+            statistics_.deliveredBytes += bytes;
+
+            if (sink_ != nullptr)
+            {
+                sink_->EnqueueRequest(postOrPut, time, urlSuffix, payload, unstampedHeader, hint);
+            }
+        }
+
+    private:
+        static int64_t TakeStamp(std::unordered_map<std::string, std::string>& header, const std::string& key)
+        {
+            const auto found = header.find(key);
+            if (found == header.end())
+            {
+                return 0;
+            }
+            const auto stamp = std::stoll(found->second);
+            header.erase(found);
+            return stamp;
+        }
+
+    private:
+        const std::unique_ptr<HttpRequestDispatcherInterface> sink_;
+        FleetStatistics& statistics_;
+        std::mt19937 randomGenerator_{1}; // NOLINT(cert-msc51-cpp): reservoir sampling only
+    };
+
+    // One desk: onboard speakers and microphone, often an HDMI monitor, sometimes a USB headset, each one a fake
+    // endpoint under a SoundDeviceCollection of its own; or, given a replay, the desk the notifications were recorded at
+    class VirtualAgent final
+    {
+    public:
+        VirtualAgent(size_t index, HttpRequestDispatcherInterface& dispatcher, std::mt19937& randomGenerator,
+                     const ed::audio::NotificationReplay* replay)
+            : replay_(replay)
+            , hostName_(std::format("SIM-{:06}", index))
+            , operationSystemName_(std::bernoulli_distribution(0.7)(randomGenerator)
+                ? "Windows 11 Enterprise 23H2 Build 22631.4317"
+                : "Windows 10 Pro 22H2 Build 19045.5011")
+            , hasMonitor_(std::bernoulli_distribution(0.6)(randomGenerator))
+            , observer_(collection_, dispatcher, nullptr,
+                        [this] { return hostName_; }, [this] { return operationSystemName_; })
+        {
+            if (replay_ != nullptr)
+            {
+                replay_->AddEndpoints(endpoints_);
+                return;
+            }
+            speakers_ = &endpoints_.Add(SPEAKERS_ENDPOINT, SPEAKERS, "Speakers (Realtek(R) Audio)", SoundDeviceFlowType::Render);
+            microphone_ = &endpoints_.Add(MICROPHONE_ENDPOINT, MICROPHONE, "Microphone Array (Realtek(R) Audio)", SoundDeviceFlowType::Capture);
+            if (hasMonitor_)
+            {
+                monitor_ = &endpoints_.Add(MONITOR_ENDPOINT, MONITOR, "DELL U2723QE (NVIDIA High Definition Audio)", SoundDeviceFlowType::Render);
+            }
+            headsetEarphone_ = &endpoints_.Add(HEADSET_EARPHONE_ENDPOINT, HEADSET, "Headset Earphone (Jabra Evolve2 65)", SoundDeviceFlowType::Render);
+            headsetMicrophone_ = &endpoints_.Add(HEADSET_MICROPHONE_ENDPOINT, HEADSET, "Headset Microphone (Jabra Evolve2 65)", SoundDeviceFlowType::Capture);
+            microphone_->volume = 700;
+            headsetMicrophone_->volume = 700;
+        }
+
+        DISALLOW_COPY_MOVE(VirtualAgent);
+        ~VirtualAgent()
+        {
+            collection_.Unsubscribe(observer_);
+        }
+
+        // Like the service start: the devices present, the observer subscribed, the whole collection posted
+        void Start()
+        {
+            if (replay_ != nullptr)
+            {
+                replay_->LoadInitialState(endpoints_, collection_);
+            }
+            else
+            {
+                speakers_->active = true;
+                microphone_->active = true;
+                if (monitor_ != nullptr)
+                {
+                    monitor_->active = true;
+                }
+                endpoints_.GetDefault(eRender) = speakers_;
+                endpoints_.GetDefault(eCapture) = microphone_;
+                collection_.ResetContent();
+            }
+            collection_.Subscribe(observer_);
+            observer_.PostAndPrintCollection();
+        }
+
+        // Runs the next step of the desk's script; returns the simulated time until the following one
+        std::chrono::microseconds Step(std::mt19937& randomGenerator, FleetStatistics& statistics)
+        {
+            if (replay_ != nullptr)
+            {
+                return ReplayStep(statistics);
+            }
+            if (dragStepsLeft_ > 0)
+            {
+                --dragStepsLeft_;
+                dragVolume_ = static_cast<uint16_t>(std::clamp(dragVolume_ + dragStep_, 0, 1000));
+                SetVolume(*dragEndpoint_, dragVolume_);
+                return DRAG_STEP_INTERVAL;
+            }
+
+            std::uniform_real_distribution<double> activity(0.0, DeskRates::ALL);
+            if (auto pick = activity(randomGenerator); pick < DeskRates::VOLUME_DRAGS)
+            {
+                StartVolumeDrag(randomGenerator);
+            }
+            else if ((pick -= DeskRates::VOLUME_DRAGS) < DeskRates::CAPTURE_VOLUME_CHANGES)
+            {
+                SetVolume(headsetPlugged_ ? *headsetMicrophone_ : *microphone_,
+                          static_cast<uint16_t>(std::uniform_int_distribution(200, 1000)(randomGenerator)));
+            }
+            else if ((pick -= DeskRates::CAPTURE_VOLUME_CHANGES) < DeskRates::DEFAULT_SWITCHES)
+            {
+                SwitchDefaultRender();
+            }
+            else
+            {
+                PlugOrUnplugHeadset(randomGenerator);
+            }
+            return NextActivityDelay(randomGenerator);
+        }
+
+        // Replay only: all the recorded notifications applied
+        [[nodiscard]] bool IsFinished() const
+        {
+            return replay_ != nullptr && replayIndex_ >= replay_->GetSize();
+        }
+
+        // Until the first step
+        [[nodiscard]] std::chrono::microseconds GetStartDelay(std::mt19937& randomGenerator) const
+        {
+            if (replay_ != nullptr)
+            {
+                return replay_->GetSize() > 0 ? replay_->GetTime(0) : std::chrono::microseconds::zero();
+            }
+            return NextActivityDelay(randomGenerator);
+        }
+
+        static std::chrono::microseconds NextActivityDelay(std::mt19937& randomGenerator)
+        {
+            const auto hours = std::exponential_distribution(DeskRates::ALL)(randomGenerator);
+            return std::chrono::microseconds(static_cast<int64_t>(hours * 3600e6));
+        }
+
+    private:
+        std::chrono::microseconds ReplayStep(FleetStatistics& statistics)
+        {
+            if (IsFinished())
+            {
+                return std::chrono::microseconds::zero();
+            }
+            if (auto differences = replay_->Apply(endpoints_, collection_, replayIndex_);
+                replay_->IsSnapshot(replayIndex_))
+            {
+                std::lock_guard lock(statistics.mutex);
+                ++statistics.checkedSnapshotCount;
+                for (auto& difference : differences)
+                {
+                    statistics.snapshotDifferences.push_back(std::format("{}: {}", hostName_, std::move(difference)));
+                }
+            }
+            ++replayIndex_;
+            return IsFinished() ? std::chrono::microseconds::zero()
+                : replay_->GetTime(replayIndex_) - replay_->GetTime(replayIndex_ - 1);
+        }
+
+        void StartVolumeDrag(std::mt19937& randomGenerator)
+        {
+            auto* defaultRender = endpoints_.GetDefault(eRender).load();
+            dragEndpoint_ = defaultRender != nullptr ? defaultRender : speakers_;
+            dragVolume_ = dragEndpoint_->volume;
+            dragStepsLeft_ = std::uniform_int_distribution(5, 25)(randomGenerator);
+            dragStep_ = std::uniform_int_distribution(10, 40)(randomGenerator) * (dragVolume_ > 500 ? -1 : 1);
+        }
+
+        void SwitchDefaultRender()
+        {
+            if (const auto* current = endpoints_.GetDefault(eRender).load(); current != speakers_)
+            {
+                SetDefault(eRender, *speakers_);
+            }
+            else if (monitor_ != nullptr)
+            {
+                SetDefault(eRender, *monitor_);
+            }
+            else if (headsetPlugged_)
+            {
+                SetDefault(eRender, *headsetEarphone_);
+            }
+        }
+
+        void PlugOrUnplugHeadset(std::mt19937& randomGenerator)
+        {
+            if (headsetPlugged_)
+            {
+                SetState(*headsetEarphone_, DEVICE_STATE_UNPLUGGED);
+                SetState(*headsetMicrophone_, DEVICE_STATE_UNPLUGGED);
+                SetDefault(eRender, *speakers_);
+                SetDefault(eCapture, *microphone_);
+            }
+            else
+            {
+                SetState(*headsetEarphone_, DEVICE_STATE_ACTIVE);
+                SetState(*headsetMicrophone_, DEVICE_STATE_ACTIVE);
+                if (std::bernoulli_distribution(0.7)(randomGenerator))
+                {
+                    SetDefault(eRender, *headsetEarphone_);
+                    SetDefault(eCapture, *headsetMicrophone_);
+                }
+            }
+            headsetPlugged_ = !headsetPlugged_;
+        }
+
+        // The endpoint changes, then the audio service calls the collection back
+        void SetVolume(ed::audio::FakeEndpoint& endpoint, uint16_t volume)
+        {
+            endpoint.volume = volume;
+            AUDIO_VOLUME_NOTIFICATION_DATA volumeData{};
+            volumeData.fMasterVolume = static_cast<float>(volume) / 1000.0f;
+            volumeData.nChannels = 1;
+            volumeData.afChannelVolumes[0] = volumeData.fMasterVolume;
+            collection_.OnNotify(&volumeData);
+        }
+
+        void SetDefault(EDataFlow flow, ed::audio::FakeEndpoint& endpoint)
+        {
+            endpoints_.GetDefault(flow) = &endpoint;
+            collection_.OnDefaultDeviceChanged(flow, eConsole, endpoint.id.c_str());
+        }
+
+        void SetState(ed::audio::FakeEndpoint& endpoint, DWORD state)
+        {
+            endpoint.active = state == DEVICE_STATE_ACTIVE;
+            collection_.OnDeviceStateChanged(endpoint.id.c_str(), state);
+        }
+
+    private:
+        static constexpr auto SPEAKERS = "{0.0.0.00000000}.{6A3B1F29-4C8E-4D2A-9E71-0F5B2C8D4A11}";
+        static constexpr auto MICROPHONE = "{0.0.1.00000000}.{B7E2C4D1-3F9A-4E6B-8C05-1D7A9F3E2B22}";
+        static constexpr auto MONITOR = "{0.0.0.00000000}.{2D9F6E83-7A1C-4B5D-A3E8-6C0F4B9D1E33}";
+        static constexpr auto HEADSET = "{0.0.0.00000000}.{E1C8A5B7-9D2F-4A6E-B4C3-8F5D0E7A6C44}";
+        static constexpr auto SPEAKERS_ENDPOINT = L"{0.0.0.00000000}.{6A3B1F29-4C8E-4D2A-9E71-0F5B2C8D4A11}";
+        static constexpr auto MICROPHONE_ENDPOINT = L"{0.0.1.00000000}.{B7E2C4D1-3F9A-4E6B-8C05-1D7A9F3E2B22}";
+        static constexpr auto MONITOR_ENDPOINT = L"{0.0.0.00000000}.{2D9F6E83-7A1C-4B5D-A3E8-6C0F4B9D1E33}";
+        static constexpr auto HEADSET_EARPHONE_ENDPOINT = L"{0.0.0.00000000}.{E1C8A5B7-9D2F-4A6E-B4C3-8F5D0E7A6C44}";
+        static constexpr auto HEADSET_MICROPHONE_ENDPOINT = L"{0.0.1.00000000}.{E1C8A5B7-9D2F-4A6E-B4C3-8F5D0E7A6C44}";
+        static constexpr std::chrono::microseconds DRAG_STEP_INTERVAL{30000};
+
+        const ed::audio::NotificationReplay* const replay_;
+        size_t replayIndex_ = 0;
+
+        const std::string hostName_;
+        const std::string operationSystemName_;
+        const bool hasMonitor_;
+        bool headsetPlugged_ = false;
+
+        ed::audio::FakeEndpoint* dragEndpoint_ = nullptr;
+        uint16_t dragVolume_ = 0;
+        int dragStep_ = 0;
+        int dragStepsLeft_ = 0;
+
+        // The audio service of the desk; the endpoints of the recording, given a replay
+        ed::audio::FakeEndpoints endpoints_;
+        ed::audio::FakeEndpoint* speakers_ = nullptr;
+        ed::audio::FakeEndpoint* microphone_ = nullptr;
+        ed::audio::FakeEndpoint* monitor_ = nullptr; // if the desk has one
+        ed::audio::FakeEndpoint* headsetEarphone_ = nullptr;
+        ed::audio::FakeEndpoint* headsetMicrophone_ = nullptr;
+
+        ed::audio::SoundDeviceCollection collection_{std::make_unique<ed::audio::FakeEndpointProvider>(endpoints_), nullptr};
+        ServiceObserver observer_;
+    };
+
+    // Drives every agentIndex % threadCount == threadIndex agent along the real time line
+    void DriveAgents(std::vector<std::unique_ptr<VirtualAgent>>& agents, size_t threadIndex, const SimulatorSettings& settings,
+                     const SteadyClock::time_point& start, FleetStatistics& statistics)
+    {
+        using Due = std::pair<SteadyClock::time_point, size_t>;
+        std::priority_queue<Due, std::vector<Due>, std::greater<>> schedule;
+        std::mt19937 randomGenerator(settings.seed + static_cast<uint32_t>(threadIndex));
+        const auto end = start + settings.duration;
+        const auto toRealTime = [&settings](const std::chrono::microseconds& simulated)
+            {
+                return std::chrono::duration_cast<SteadyClock::duration>(simulated / settings.timeScale);
+            };
+
+        // the agents start spread over the first tenth of the run
+        std::uniform_int_distribution<int64_t> startOffsetUs(0, std::chrono::duration_cast<std::chrono::microseconds>(settings.duration).count() / 10);
+        for (size_t agentIndex = threadIndex; agentIndex < agents.size(); agentIndex += settings.threadCount)
+        {
+            schedule.emplace(start + std::chrono::microseconds(startOffsetUs(randomGenerator)), agentIndex);
+        }
+        std::vector<bool> started(agents.size());
+
+        while (!schedule.empty() && schedule.top().first < end)
+        {
+            const auto [due, agentIndex] = schedule.top();
+            schedule.pop();
+            std::this_thread::sleep_until(due);
+
+            currentEventTime = SteadyClock::now();
+            ++statistics.eventCount;
+            std::chrono::microseconds delay;
+            if (!started[agentIndex])
+            {
+                started[agentIndex] = true;
+                agents[agentIndex]->Start();
+                delay = agents[agentIndex]->GetStartDelay(randomGenerator);
+            }
+            else
+            {
+                delay = agents[agentIndex]->Step(randomGenerator, statistics);
+            }
+            if (!agents[agentIndex]->IsFinished())
+            {
+                schedule.emplace(due + toRealTime(delay), agentIndex);
+            }
+        }
+        ++statistics.finishedDriverCount;
+    }
+
+    std::unique_ptr<HttpRequestDispatcherInterface> CreateSink(const SimulatorSettings& settings)
+    {
+        if (Poco::icompare(settings.sink, "None") == 0)
+        {
+            return nullptr;
+        }
+        if (Poco::icompare(settings.sink, "Stdout") == 0)
+        {
+            return std::make_unique<NdjsonStreamHttpRequestDispatcher>(std::cout);
+        }
+        if (Poco::icompare(settings.sink, "File") == 0)
+        {
+            return std::make_unique<NdjsonFileHttpRequestDispatcher>(settings.path, std::chrono::milliseconds(1000));
+        }
+        if (Poco::icompare(settings.sink, "Relay") == 0)
+        {
+            return std::make_unique<RelayClientHttpRequestDispatcher>(settings.relayHost, settings.relayPort, settings.relaySecret,
+                                                                      "FLEET-SIMULATOR");
+        }
+        throw std::invalid_argument(std::format(R"(Unknown sink "{}")", settings.sink));
+    }
+
+    SimulatorSettings ParseArguments(int argc, char* argv[])
+    {
+        SimulatorSettings settings;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string argument(argv[i]);
+            const auto separator = argument.find('=');
+            if (!argument.starts_with("--") || separator == std::string::npos)
+            {
+                throw std::invalid_argument(std::format(R"(Invalid argument "{}")", argument));
+            }
+            const auto key = argument.substr(2, separator - 2);
+            const auto value = argument.substr(separator + 1);
+            if (key == "agents")
+            {
+                settings.agentCount = std::stoul(value);
+            }
+            else if (key == "duration-s")
+            {
+                settings.duration = std::chrono::seconds(std::stoul(value));
+            }
+            else if (key == "threads")
+            {
+                settings.threadCount = std::max<size_t>(1, std::stoul(value));
+            }
+            else if (key == "time-scale")
+            {
+                settings.timeScale = std::max(0.001, std::stod(value));
+            }
+            else if (key == "sink")
+            {
+                settings.sink = value;
+            }
+            else if (key == "path")
+            {
+                settings.path = value;
+            }
+            else if (key == "relay-host")
+            {
+                settings.relayHost = value;
+            }
+            else if (key == "relay-port")
+            {
+                settings.relayPort = static_cast<uint16_t>(std::stoul(value));
+            }
+            else if (key == "relay-secret")
+            {
+                settings.relaySecret = value;
+            }
+            else if (key == "encoding")
+            {
+                const auto encoding = ed::ParsePayloadEncoding(value);
+                if (!encoding.has_value())
+                {
+                    throw std::invalid_argument(std::format(R"(Unknown payload encoding "{}")", value));
+                }
+                settings.encoding = *encoding;
+            }
+            else if (key == "queue-capacity")
+            {
+                settings.queueCapacity = std::stoul(value);
+            }
+            else if (key == "seed")
+            {
+                settings.seed = static_cast<uint32_t>(std::stoul(value));
+            }
+            else if (key == "replay")
+            {
+                settings.replayPath = value;
+            }
+            else if (key == "replay-speed")
+            {
+                settings.replaySpeed = Poco::icompare(value, "max") == 0 ? 0.0 : std::max(0.001, std::stod(value));
+            }
+            else
+            {
+                throw std::invalid_argument(std::format(R"(Unknown option "--{}")", key));
+            }
+        }
+        return settings;
+    }
+
+    constexpr auto USAGE =
+        "Usage: FleetSimulator [--agents=1000] [--duration-s=30] [--threads=<cores>] [--time-scale=60]\n"
+        "                      [--sink=None|Stdout|File|Relay] [--path=FleetSimulator.ndjson]\n"
+        "                      [--relay-host=localhost] [--relay-port=5680] [--relay-secret=<relaySecret>]\n"
+        "                      [--encoding=json|cbor|msgpack]\n"
+        "                      [--queue-capacity=100000] [--seed=42]\n"
+        "                      [--replay=<recording>.notifications.bin] [--replay-speed=1|<factor>|max]\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    SimulatorSettings settings;
+    try
+    {
+        settings = ParseArguments(argc, argv);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << ".\n" << USAGE;
+        return 1;
+    }
+    std::unique_ptr<ed::audio::NotificationReplay> replay;
+    if (!settings.replayPath.empty())
+    {
+        try
+        {
+            replay = std::make_unique<ed::audio::NotificationReplay>(ed::audio::ReadNotificationRecording(settings.replayPath));
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << ex.what() << ".\n";
+            return 1;
+        }
+        // the recorded time line replaces the simulated desk one
+        settings.timeScale = settings.replaySpeed > 0.0 ? settings.replaySpeed : std::numeric_limits<double>::infinity();
+    }
+    // the observers log every event; only problems are of interest here
+    spdlog::set_level(spdlog::level::err);
+    // the stage latencies are reported, and the probe takes the event time from the trace context
+    ed::LatencyTrace::SetEnabled(true);
+
+    FleetStatistics statistics;
+    std::chrono::duration<double> elapsed{};
+    {
+        FanOutHttpRequestDispatcher fanOutDispatcher;
+        try
+        {
+            fanOutDispatcher.AddSink(settings.sink, std::make_unique<MeasuringHttpRequestDispatcher>(CreateSink(settings), statistics),
+                                     settings.encoding, settings.queueCapacity);
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << ex.what() << ".\n" << USAGE;
+            return 1;
+        }
+        ProbeHttpRequestDispatcher probeDispatcher(fanOutDispatcher, statistics);
+
+        std::mt19937 randomGenerator(settings.seed);
+        std::vector<std::unique_ptr<VirtualAgent>> agents;
+        agents.reserve(settings.agentCount);
+        for (size_t i = 0; i < settings.agentCount; ++i)
+        {
+            agents.push_back(std::make_unique<VirtualAgent>(i, probeDispatcher, randomGenerator, replay.get()));
+        }
+        if (replay != nullptr)
+        {
+            std::cout << std::format(R"(Replaying "{}": {} notifications over {:.1f} s recorded, per agent.)" "\n",
+                                     settings.replayPath, replay->GetSize(),
+                                     replay->GetSize() > 0 ? static_cast<double>(replay->GetTime(replay->GetSize() - 1).count()) / 1e6 : 0.0);
+        }
+
+        std::cout << std::format("{} agents on {} thread(s) for {} s, simulated time x{}, sink \"{}\" ({}).\n",
+                                 settings.agentCount, settings.threadCount, settings.duration.count(), settings.timeScale,
+                                 settings.sink, ed::GetPayloadEncodingName(settings.encoding));
+
+        const auto start = SteadyClock::now();
+        std::vector<std::jthread> drivers;
+        for (size_t threadIndex = 0; threadIndex < std::min(settings.threadCount, settings.agentCount); ++threadIndex)
+        {
+            drivers.emplace_back([&, threadIndex] { DriveAgents(agents, threadIndex, settings, start, statistics); });
+        }
+        // until the end of the run, or until a replay is over
+        for (auto report = std::chrono::seconds(5);
+             SteadyClock::now() < start + settings.duration && statistics.finishedDriverCount.load() < drivers.size(); )
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (SteadyClock::now() >= start + report)
+            {
+                std::cout << std::format("{:>4} s: {} events, {} messages delivered.\n",
+                                         report.count(), statistics.eventCount.load(), statistics.deliveredCount.load());
+                report += std::chrono::seconds(5);
+            }
+        }
+        drivers.clear();
+        elapsed = std::min<std::chrono::duration<double>>(SteadyClock::now() - start, settings.duration);
+        // the fan-out queue is drained on destruction
+    }
+
+    const auto seconds = elapsed.count();
+    std::cout << std::format(
+        "{} events in {:.1f} s ({:.0f} events/s), {} messages entered the pipeline, {} delivered ({} dropped by the queue).\n"
+        "{:.0f} messages/s, {:.0f} bytes/s, {:.0f} bytes/message on average.\n",
+        statistics.eventCount.load(), seconds, static_cast<double>(statistics.eventCount.load()) / seconds,
+        statistics.enteredCount.load(), statistics.deliveredCount.load(),
+        statistics.enteredCount.load() - statistics.deliveredCount.load(),
+        static_cast<double>(statistics.deliveredCount.load()) / seconds,
+        static_cast<double>(statistics.deliveredBytes.load()) / seconds,
+        statistics.deliveredCount.load() == 0 ? 0.0
+            : static_cast<double>(statistics.deliveredBytes.load()) / static_cast<double>(statistics.deliveredCount.load()));
+    std::cout << statistics.observerLatencies.Format("observer") << "\n"
+        << statistics.pipelineLatencies.Format("pipeline") << "\n"
+        << statistics.endToEndLatencies.Format("end-to-end") << "\n";
+    if (replay != nullptr)
+    {
+        std::cout << std::format("{} recorded snapshots checked, {} differences.\n",
+                                 statistics.checkedSnapshotCount, statistics.snapshotDifferences.size());
+        for (const auto& difference : statistics.snapshotDifferences | std::views::take(10))
+        {
+            std::cout << difference << "\n";
+        }
+        return statistics.snapshotDifferences.empty() ? 0 : 2;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "targetver.h"
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
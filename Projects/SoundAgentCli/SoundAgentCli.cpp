@@ -1,6 +1,6 @@
 #include "stdafx.h"
 
-#include "ApiClient/common/TimeUtil.h"
+#include "TimestampFormatter.h"
 
 #include "public/CoInitRaiiHelper.h"
 #include "public/SoundAgentInterface.h"
@@ -16,19 +16,15 @@
 namespace
 {
     std::ostream& CurrentLocalTimeAsStringShort(std::ostream& os) {
-        const std::string currentTime = ed::TimePointToStringAsLocal(
-            std::chrono::system_clock::now(),
+        thread_local ed::TimestampFormatter formatter(
+            ed::TimestampFormatter::Zone::Local,
             false, // insertTBetweenDateAndTime
             false // addTimeZone
         );
-        if
-        (
-            constexpr int beginOfTimeCountingFromTheEnd = 15;
-            currentTime.size() >= beginOfTimeCountingFromTheEnd
-        )
-        {
-            os << currentTime.substr(currentTime.size() - beginOfTimeCountingFromTheEnd, 12) << " ";
-        }
+        ed::TimestampFormatter::Buffer buffer;
+        // "12:34:56.223" of "2025-05-29 12:34:56.223709"
+        const auto currentTime = formatter.Format(std::chrono::system_clock::now(), buffer);
+        os << currentTime.substr(11, 12) << " ";
         return os;
     }
 }
@@ -0,0 +1,93 @@
+#include "os-dependencies.h"
+
+#include "AgentMetrics.h"
+
+#include "PipelineLatency.h"
+
+#include <psapi.h>
+
+#include <magic_enum/magic_enum.hpp>
+
+
+ed::AgentMetrics::AgentMetrics(SoundDeviceCollectionInterface& collection,
+                               const FanOutHttpRequestDispatcher* fanOutDispatcher, uint16_t port)
+    : collection_(collection)
+{
+    RegisterMetrics(fanOutDispatcher);
+    server_ = std::make_unique<MetricsHttpServer>(registry_, port);
+    collection_.Subscribe(*this);
+}
+
+ed::AgentMetrics::~AgentMetrics()
+{
+    collection_.Unsubscribe(*this);
+}
+
+uint16_t ed::AgentMetrics::GetPort() const
+{
+    return server_->GetPort();
+}
+
+const ed::MetricsRegistry& ed::AgentMetrics::GetRegistry() const
+{
+    return registry_;
+}
+
+void ed::AgentMetrics::OnCollectionChanged(SoundDeviceEventType event, const std::string&)
+{
+    eventCounts_[static_cast<size_t>(event)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ed::AgentMetrics::RegisterMetrics(const FanOutHttpRequestDispatcher* fanOutDispatcher)
+{
+    for (const auto event : magic_enum::enum_values<SoundDeviceEventType>())
+    {
+        registry_.AddCounter("soundagent_events_total", "Device events raised by the collection.",
+                             {{"type", std::string(magic_enum::enum_name(event))}},
+                             [this, event] { return static_cast<double>(eventCounts_[static_cast<size_t>(event)].load(std::memory_order_relaxed)); });
+    }
+    // Not counted from the events: the collection is also rebuilt without notifying, e.g. on a reset
+    registry_.AddGauge("soundagent_devices", "Devices in the collection.", {},
+                       [this] { return static_cast<double>(collection_.GetSize()); });
+
+    for (size_t index = 0; index < PipelineLatency::STAGE_COUNT; ++index)
+    {
+        const auto stage = static_cast<LatencyStage>(index);
+        registry_.AddSummary("soundagent_stage_latency_seconds", "Latency of a notification processing stage since the previous one.",
+                             {{"stage", PipelineLatency::GetStageName(stage)}},
+                             [stage] { return PipelineLatency::GetInstance().GetSnapshot(stage); });
+    }
+
+    if (fanOutDispatcher != nullptr)
+    {
+        const auto sinks = fanOutDispatcher->GetSinkStatistics();
+        for (size_t index = 0; index < sinks.size(); ++index)
+        {
+            const auto sinkStatistic = [fanOutDispatcher, index](auto member)
+            {
+                return [fanOutDispatcher, index, member] { return static_cast<double>(fanOutDispatcher->GetSinkStatistics().at(index).*member); };
+            };
+            const MetricsRegistry::Labels labels{{"sink", sinks[index].name}};
+            using Statistics = FanOutHttpRequestDispatcher::SinkStatistics;
+            registry_.AddGauge("soundagent_sink_queue_size", "Requests waiting in the queue of a sink.", labels,
+                               sinkStatistic(&Statistics::queueSize));
+            registry_.AddCounter("soundagent_sink_dropped_total", "Requests dropped by a full sink queue.", labels,
+                                 sinkStatistic(&Statistics::droppedCount));
+            registry_.AddCounter("soundagent_sink_failures_total", "Deliveries a sink failed on, retried ones included.", labels,
+                                 sinkStatistic(&Statistics::failedCount));
+            registry_.AddCounter("soundagent_sink_retries_total", "Delivery retries of a sink.", labels,
+                                 sinkStatistic(&Statistics::retryCount));
+        }
+    }
+
+    registry_.AddGauge("process_resident_memory_bytes", "Working set of the process.", {}, []
+    {
+        PROCESS_MEMORY_COUNTERS counters{};
+        return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? static_cast<double>(counters.WorkingSetSize) : 0.0;
+    });
+    registry_.AddGauge("process_open_handles", "Handles opened by the process.", {}, []
+    {
+        DWORD handleCount = 0;
+        return GetProcessHandleCount(GetCurrentProcess(), &handleCount) ? static_cast<double>(handleCount) : 0.0;
+    });
+}
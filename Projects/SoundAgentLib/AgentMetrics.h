@@ -0,0 +1,46 @@
+#pragma once
+
+#include "public/SoundAgentInterface.h"
+
+#include "FanOutHttpRequestDispatcher.h"
+#include "MetricsHttpServer.h"
+#include "MetricsRegistry.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+
+namespace ed {
+// The operational metrics of the agent on a loopback HTTP endpoint: the endpoint events by type, the device count,
+// the latency per processing stage, per sink the queue size, drops, failures and retries, and the resident memory
+// and handle count of the process. Counts the events as an observer of the collection; everything else, the device
+// count included, is sampled on a scrape only. Not created at all if the metrics are off.
+class AgentMetrics final : public SoundDeviceObserverInterface {
+public:
+    // fanOutDispatcher: nullptr if there are no sinks to report; its sinks are to be added already
+    AgentMetrics(SoundDeviceCollectionInterface& collection, const FanOutHttpRequestDispatcher* fanOutDispatcher,
+                 uint16_t port);
+
+    DISALLOW_COPY_MOVE(AgentMetrics);
+    ~AgentMetrics() override;
+
+public:
+    [[nodiscard]] uint16_t GetPort() const;
+    [[nodiscard]] const MetricsRegistry& GetRegistry() const;
+
+    void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId) override;
+
+private:
+    void RegisterMetrics(const FanOutHttpRequestDispatcher* fanOutDispatcher);
+
+private:
+    static constexpr size_t EVENT_TYPE_COUNT = static_cast<size_t>(SoundDeviceEventType::DefaultCaptureChanged) + 1;
+
+    SoundDeviceCollectionInterface& collection_;
+    std::array<std::atomic<uint64_t>, EVENT_TYPE_COUNT> eventCounts_{};
+
+    MetricsRegistry registry_;
+    std::unique_ptr<MetricsHttpServer> server_; // last: stops serving before the rest is destroyed
+};
+}
@@ -0,0 +1,38 @@
+#include "os-dependencies.h"
+
+#include "AsyncDefaultLogger.h"
+
+#include <spdlog/spdlog.h>
+
+
+ed::AsyncDefaultLogger::AsyncDefaultLogger(size_t queueSize)
+    : previousLogger_(spdlog::default_logger())
+    , threadPool_(std::make_shared<spdlog::details::thread_pool>(queueSize, 1))
+{
+    const auto& sinks = previousLogger_->sinks();
+    asyncLogger_ = std::make_shared<spdlog::async_logger>(previousLogger_->name(), sinks.begin(), sinks.end(),
+                                                          threadPool_, spdlog::async_overflow_policy::overrun_oldest);
+    asyncLogger_->set_level(previousLogger_->level());
+    asyncLogger_->flush_on(previousLogger_->flush_level());
+    spdlog::set_default_logger(asyncLogger_);
+    spdlog::info("Logging asynchronously, queue size {}.", queueSize);
+}
+
+ed::AsyncDefaultLogger::~AsyncDefaultLogger()
+{
+    spdlog::set_default_logger(previousLogger_);
+    const auto droppedCount = GetDroppedCount();
+    asyncLogger_.reset();
+    // Joins the worker after it wrote the queued messages
+    threadPool_.reset();
+    if (droppedCount > 0)
+    {
+        spdlog::warn("{} log message(s) dropped because the log queue was full.", droppedCount);
+    }
+    previousLogger_->flush();
+}
+
+size_t ed::AsyncDefaultLogger::GetDroppedCount() const
+{
+    return threadPool_->overrun_counter();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <memory>
+
+#include <spdlog/async.h>
+
+
+namespace ed {
+// Replaces the default spdlog logger by an asynchronous one writing to the same sinks from a worker thread,
+// so that the logging threads, e.g. the endpoint callbacks, only format and enqueue. The queue is bounded;
+// when it is full the oldest messages are dropped rather than blocking the caller.
+// The destructor writes the queued messages and restores the previous default logger.
+class AsyncDefaultLogger final {
+public:
+    explicit AsyncDefaultLogger(size_t queueSize);
+    DISALLOW_COPY_MOVE(AsyncDefaultLogger);
+    ~AsyncDefaultLogger();
+
+public:
+    // Messages dropped because the queue was full
+    [[nodiscard]] size_t GetDroppedCount() const;
+
+private:
+    const std::shared_ptr<spdlog::logger> previousLogger_;
+    std::shared_ptr<spdlog::details::thread_pool> threadPool_;
+    std::shared_ptr<spdlog::logger> asyncLogger_;
+};
+}
@@ -0,0 +1,652 @@
+#include "os-dependencies.h"
+
+#include "BinaryLog.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <format>
+#include <stdexcept>
+
+#include <fmt/args.h>
+
+
+namespace
+{
+    constexpr std::string_view MAGIC = "SABL";
+    constexpr uint8_t FORMAT_VERSION = 1;
+
+    // The magic starts with 'S', which is no record type: a new session can follow the previous one
+    enum class FileRecordType : uint8_t
+    {
+        Site = 1, // id, line, file name, format
+        Message, // site id, level, time since the previous message, thread id, argument count, arguments
+        Dropped // thread id, count
+    };
+
+    enum class FileArgumentType : uint8_t
+    {
+        Signed = 0, // zigzag varint
+        Unsigned, // varint
+        Double, // 8 bytes
+        Bool, // byte
+        String, // length prefixed
+        InternedString, // length prefixed, gets the next string id
+        StringReference // string id
+    };
+
+    std::atomic<uint64_t> lastLogId = 0;
+
+    void AppendVarint(std::string& buffer, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    void AppendSignedVarint(std::string& buffer, int64_t value)
+    {
+        AppendVarint(buffer, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void AppendString(std::string& buffer, std::string_view value)
+    {
+        AppendVarint(buffer, value.size());
+        buffer.append(value);
+    }
+
+    template <typename T>
+    T ReadRaw(std::string_view& data)
+    {
+        T value;
+        std::memcpy(&value, data.data(), sizeof(value));
+        data.remove_prefix(sizeof(value));
+        return value;
+    }
+
+    // The data ends inside a record
+    struct TruncatedRecord final : std::exception
+    {
+    };
+
+    class FileReader final
+    {
+    public:
+        explicit FileReader(std::string_view data)
+            : data_(data)
+        {
+        }
+
+        [[nodiscard]] bool AtEnd() const
+        {
+            return position_ == data_.size();
+        }
+
+        [[nodiscard]] bool AtSessionStart() const
+        {
+            return data_.substr(position_).starts_with(MAGIC);
+        }
+
+        void ReadSessionStart()
+        {
+            if (!AtSessionStart() || data_.size() - position_ <= MAGIC.size())
+            {
+                throw std::runtime_error("No binary log");
+            }
+            position_ += MAGIC.size();
+            if (const auto version = ReadByte(); version != FORMAT_VERSION)
+            {
+                throw std::runtime_error(std::format("Binary log of unsupported version {}", version));
+            }
+        }
+
+        uint8_t ReadByte()
+        {
+            if (AtEnd())
+            {
+                throw TruncatedRecord();
+            }
+            return static_cast<uint8_t>(data_[position_++]);
+        }
+
+        uint64_t ReadVarint()
+        {
+            uint64_t value = 0;
+            for (unsigned shift = 0; ; shift += 7)
+            {
+                if (shift > 63)
+                {
+                    throw std::runtime_error("Binary log: invalid number");
+                }
+                const auto byte = ReadByte();
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+        }
+
+        int64_t ReadSignedVarint()
+        {
+            const auto value = ReadVarint();
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        double ReadDouble()
+        {
+            if (data_.size() - position_ < sizeof(double))
+            {
+                throw TruncatedRecord();
+            }
+            auto data = data_.substr(position_);
+            position_ += sizeof(double);
+            return ReadRaw<double>(data);
+        }
+
+        std::string ReadString()
+        {
+            const auto size = ReadVarint();
+            if (size > data_.size() - position_)
+            {
+                throw TruncatedRecord();
+            }
+            std::string value(data_.substr(position_, size));
+            position_ += size;
+            return value;
+        }
+
+    private:
+        const std::string_view data_;
+        size_t position_ = 0;
+    };
+
+    struct DecodedSite
+    {
+        uint64_t line = 0;
+        std::string file;
+        std::string format;
+    };
+
+    std::string FormatTime(int64_t microsecondsSinceEpoch)
+    {
+        const std::chrono::sys_time<std::chrono::microseconds> time{std::chrono::microseconds(microsecondsSinceEpoch)};
+        const auto seconds = std::chrono::floor<std::chrono::seconds>(time);
+        return std::format("{:%F %T}.{:06}", seconds, (time - seconds).count());
+    }
+
+    // A wrong format, e.g. a numeric format of an argument logged as text, keeps the format and the arguments
+    std::string FormatMessage(const std::string& format, const fmt::dynamic_format_arg_store<fmt::format_context>& arguments,
+                              const std::vector<std::string>& argumentTexts)
+    {
+        try
+        {
+            return fmt::vformat(format, arguments);
+        }
+        catch (const fmt::format_error&)
+        {
+            std::string message = format;
+            for (const auto& text : argumentTexts)
+            {
+                message += " | " + text;
+            }
+            return message;
+        }
+    }
+}
+
+// A ring written by its thread only and read by the writer; a record that does not fit is dropped
+class ed::BinaryLog::ThreadBuffer final {
+public:
+    explicit ThreadBuffer(uint32_t threadId)
+        : threadId_(threadId)
+        , data_(std::make_unique<char[]>(BYTES_PER_THREAD))
+    {
+    }
+
+    DISALLOW_COPY_MOVE(ThreadBuffer);
+    ~ThreadBuffer() = default;
+
+public:
+    void Write(std::string_view record)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (BYTES_PER_THREAD - (head - tail_.load(std::memory_order_acquire)) < record.size())
+        {
+            droppedCount_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const auto offset = head % BYTES_PER_THREAD;
+        const auto firstPart = std::min(record.size(), BYTES_PER_THREAD - offset);
+        std::memcpy(data_.get() + offset, record.data(), firstPart);
+        std::memcpy(data_.get(), record.data() + firstPart, record.size() - firstPart);
+        head_.store(head + record.size(), std::memory_order_release);
+    }
+
+    // One reader at a time
+    ThreadRecords Take()
+    {
+        const auto head = head_.load(std::memory_order_acquire);
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        ThreadRecords records{.threadId = threadId_, .data = {}, .droppedCount = droppedCount_.exchange(0, std::memory_order_relaxed)};
+        records.data.resize(head - tail);
+        const auto offset = tail % BYTES_PER_THREAD;
+        const auto firstPart = std::min(records.data.size(), BYTES_PER_THREAD - offset);
+        std::memcpy(records.data.data(), data_.get() + offset, firstPart);
+        std::memcpy(records.data.data() + firstPart, data_.get(), records.data.size() - firstPart);
+        tail_.store(head, std::memory_order_release);
+        return records;
+    }
+
+private:
+    const uint32_t threadId_;
+    const std::unique_ptr<char[]> data_;
+    std::atomic<uint64_t> head_ = 0; // written up to
+    std::atomic<uint64_t> tail_ = 0; // read up to
+    std::atomic<uint64_t> droppedCount_ = 0;
+};
+
+thread_local std::vector<std::pair<uint64_t, ed::BinaryLog::ThreadBuffer*>> ed::BinaryLog::threadBuffers_;
+
+ed::BinaryLog::BinaryLog()
+    : id_(++lastLogId)
+{
+}
+
+ed::BinaryLog::~BinaryLog() = default;
+
+ed::BinaryLog& ed::BinaryLog::GetInstance()
+{
+    static BinaryLog instance;
+    return instance;
+}
+
+void ed::BinaryLog::SetEnabled(bool enabled)
+{
+    isEnabled_.store(enabled, std::memory_order_relaxed);
+}
+
+bool ed::BinaryLog::IsEnabled() const
+{
+    return isEnabled_.load(std::memory_order_relaxed);
+}
+
+std::vector<ed::BinaryLog::ThreadRecords> ed::BinaryLog::TakeRecords()
+{
+    std::lock_guard lock(mutex_);
+    std::vector<ThreadRecords> records;
+    records.reserve(buffers_.size());
+    for (const auto& buffer : buffers_)
+    {
+        if (auto threadRecords = buffer->Take(); !threadRecords.data.empty() || threadRecords.droppedCount > 0)
+        {
+            records.push_back(std::move(threadRecords));
+        }
+    }
+    return records;
+}
+
+void ed::BinaryLog::Commit(std::string_view record)
+{
+    GetThreadBuffer().Write(record);
+}
+
+ed::BinaryLog::ThreadBuffer& ed::BinaryLog::GetThreadBuffer()
+{
+    for (const auto& [logId, buffer] : threadBuffers_)
+    {
+        if (logId == id_)
+        {
+            return *buffer;
+        }
+    }
+    // First record of this thread: the log owns the buffer, so it outlives the thread
+    auto buffer = std::make_shared<ThreadBuffer>(static_cast<uint32_t>(GetCurrentThreadId()));
+    {
+        std::lock_guard lock(mutex_);
+        buffers_.push_back(buffer);
+    }
+    threadBuffers_.emplace_back(id_, buffer.get());
+    return *buffer;
+}
+
+ed::BinaryLog::RecordBuilder::RecordBuilder(spdlog::level::level_enum level, size_t argumentCount, const LogSite& site,
+                                            const char* format)
+{
+    const auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    data_[0] = static_cast<char>(level);
+    data_[1] = static_cast<char>(argumentCount);
+    const auto* sitePointer = &site;
+    std::memcpy(data_.data() + 2, &sitePointer, sizeof(sitePointer));
+    std::memcpy(data_.data() + 2 + sizeof(sitePointer), &format, sizeof(format));
+    std::memcpy(data_.data() + 2 + sizeof(sitePointer) + sizeof(format), &time, sizeof(time));
+    size_ = HEADER_SIZE;
+}
+
+std::string_view ed::BinaryLog::RecordBuilder::GetRecord() const
+{
+    return {data_.data(), size_};
+}
+
+void ed::BinaryLog::RecordBuilder::AppendString(std::string_view value)
+{
+    auto size = std::min(value.size(), MAX_STRING_SIZE);
+    // A cut string ends before a UTF-8 sequence, not inside it
+    while (size < value.size() && size > 0 && (static_cast<uint8_t>(value[size]) & 0xC0) == 0x80)
+    {
+        --size;
+    }
+    data_[size_++] = static_cast<char>(ArgumentType::String);
+    const auto stringSize = static_cast<uint16_t>(size);
+    std::memcpy(data_.data() + size_, &stringSize, sizeof(stringSize));
+    size_ += sizeof(stringSize);
+    std::memcpy(data_.data() + size_, value.data(), size);
+    size_ += size;
+}
+
+ed::BinaryLogWriter::BinaryLogWriter(const std::filesystem::path& pathName, BinaryLog& log,
+                                     std::chrono::milliseconds flushInterval)
+    : log_(log)
+    , file_(pathName, std::ios::binary | std::ios::app)
+{
+    if (!file_)
+    {
+        throw std::runtime_error(std::format(R"(Binary log "{}" can not be opened)", pathName.string()));
+    }
+    file_.write(MAGIC.data(), static_cast<std::streamsize>(MAGIC.size()));
+    file_.put(static_cast<char>(FORMAT_VERSION));
+    file_.flush();
+
+    log_.SetEnabled(true);
+    flusher_ = std::jthread([this, flushInterval](const std::stop_token& stopToken)
+    {
+        std::mutex mutex;
+        std::condition_variable_any stopCondition;
+        std::unique_lock lock(mutex);
+        while (!stopCondition.wait_for(lock, stopToken, flushInterval, [&stopToken] { return stopToken.stop_requested(); }))
+        {
+            Flush();
+        }
+    });
+}
+
+ed::BinaryLogWriter::~BinaryLogWriter()
+{
+    log_.SetEnabled(false);
+    flusher_ = {};
+    Flush();
+}
+
+uint64_t ed::BinaryLogWriter::GetWrittenCount() const
+{
+    return writtenCount_.load(std::memory_order_relaxed);
+}
+
+uint64_t ed::BinaryLogWriter::GetDroppedCount() const
+{
+    return droppedCount_.load(std::memory_order_relaxed);
+}
+
+void ed::BinaryLogWriter::Flush()
+{
+    std::string buffer;
+    for (const auto& threadRecords : log_.TakeRecords())
+    {
+        std::string_view records = threadRecords.data;
+        while (!records.empty())
+        {
+            AppendRecord(buffer, records, threadRecords.threadId);
+        }
+        if (threadRecords.droppedCount > 0)
+        {
+            buffer.push_back(static_cast<char>(FileRecordType::Dropped));
+            AppendVarint(buffer, threadRecords.threadId);
+            AppendVarint(buffer, threadRecords.droppedCount);
+            droppedCount_.fetch_add(threadRecords.droppedCount, std::memory_order_relaxed);
+        }
+    }
+    if (!buffer.empty())
+    {
+        file_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        file_.flush();
+    }
+}
+
+void ed::BinaryLogWriter::AppendRecord(std::string& buffer, std::string_view& records, uint32_t threadId)
+{
+    using ArgumentType = BinaryLog::ArgumentType;
+
+    const auto level = static_cast<uint8_t>(records[0]);
+    const auto argumentCount = static_cast<uint8_t>(records[1]);
+    records.remove_prefix(2);
+    const auto* site = ReadRaw<const LogSite*>(records);
+    const auto* format = ReadRaw<const char*>(records);
+    const auto time = ReadRaw<int64_t>(records);
+
+    auto [siteId, isNewSite] = siteIds_.try_emplace({site, format}, siteIds_.size());
+    if (isNewSite)
+    {
+        buffer.push_back(static_cast<char>(FileRecordType::Site));
+        AppendVarint(buffer, siteId->second);
+        AppendVarint(buffer, static_cast<uint64_t>(site->GetLine()));
+        AppendString(buffer, std::filesystem::path(site->GetFile()).filename().string());
+        AppendString(buffer, format);
+    }
+
+    buffer.push_back(static_cast<char>(FileRecordType::Message));
+    AppendVarint(buffer, siteId->second);
+    buffer.push_back(static_cast<char>(level));
+    AppendSignedVarint(buffer, time - previousTime_);
+    previousTime_ = time;
+    AppendVarint(buffer, threadId);
+    buffer.push_back(static_cast<char>(argumentCount));
+    for (uint8_t argument = 0; argument < argumentCount; ++argument)
+    {
+        const auto type = static_cast<ArgumentType>(records[0]);
+        records.remove_prefix(1);
+        switch (type)
+        {
+        case ArgumentType::Signed:
+            buffer.push_back(static_cast<char>(FileArgumentType::Signed));
+            AppendSignedVarint(buffer, ReadRaw<int64_t>(records));
+            break;
+        case ArgumentType::Unsigned:
+            buffer.push_back(static_cast<char>(FileArgumentType::Unsigned));
+            AppendVarint(buffer, ReadRaw<uint64_t>(records));
+            break;
+        case ArgumentType::Double:
+            buffer.push_back(static_cast<char>(FileArgumentType::Double));
+            buffer.append(records.substr(0, sizeof(double)));
+            records.remove_prefix(sizeof(double));
+            break;
+        case ArgumentType::Bool:
+            buffer.push_back(static_cast<char>(FileArgumentType::Bool));
+            buffer.push_back(records[0]);
+            records.remove_prefix(1);
+            break;
+        case ArgumentType::String:
+        {
+            const auto size = ReadRaw<uint16_t>(records);
+            AppendArgumentString(buffer, records.substr(0, size));
+            records.remove_prefix(size);
+            break;
+        }
+        }
+    }
+    writtenCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ed::BinaryLogWriter::AppendArgumentString(std::string& buffer, std::string_view value)
+{
+    if (const auto found = stringIds_.find(value); found != stringIds_.end())
+    {
+        buffer.push_back(static_cast<char>(FileArgumentType::StringReference));
+        AppendVarint(buffer, found->second);
+        return;
+    }
+    if (stringIds_.size() < MAX_INTERNED_STRINGS)
+    {
+        stringIds_.emplace(value, stringIds_.size());
+        buffer.push_back(static_cast<char>(FileArgumentType::InternedString));
+    }
+    else
+    {
+        buffer.push_back(static_cast<char>(FileArgumentType::String));
+    }
+    AppendString(buffer, value);
+}
+
+std::string ed::DecodeBinaryLog(std::string_view data)
+{
+    FileReader reader(data);
+    reader.ReadSessionStart();
+
+    std::vector<DecodedSite> sites;
+    std::vector<std::string> strings;
+    int64_t time = 0;
+    std::string text;
+    try
+    {
+        while (!reader.AtEnd())
+        {
+            if (reader.AtSessionStart())
+            {
+                reader.ReadSessionStart();
+                sites.clear();
+                strings.clear();
+                time = 0;
+                continue;
+            }
+
+            std::string line;
+            switch (const auto type = reader.ReadByte(); static_cast<FileRecordType>(type))
+            {
+            case FileRecordType::Site:
+            {
+                if (reader.ReadVarint() != sites.size())
+                {
+                    throw std::runtime_error("Binary log: call site out of order");
+                }
+                DecodedSite site;
+                site.line = reader.ReadVarint();
+                site.file = reader.ReadString();
+                site.format = reader.ReadString();
+                sites.push_back(std::move(site));
+                break;
+            }
+            case FileRecordType::Message:
+            {
+                const auto siteId = reader.ReadVarint();
+                if (siteId >= sites.size())
+                {
+                    throw std::runtime_error(std::format("Binary log: unknown call site {}", siteId));
+                }
+                const auto level = reader.ReadByte();
+                if (level >= spdlog::level::n_levels)
+                {
+                    throw std::runtime_error(std::format("Binary log: invalid level {}", level));
+                }
+                time += reader.ReadSignedVarint();
+                const auto threadId = reader.ReadVarint();
+
+                fmt::dynamic_format_arg_store<fmt::format_context> arguments;
+                std::vector<std::string> argumentTexts;
+                for (auto argumentCount = reader.ReadByte(); argumentCount > 0; --argumentCount)
+                {
+                    switch (const auto argumentType = reader.ReadByte(); static_cast<FileArgumentType>(argumentType))
+                    {
+                    case FileArgumentType::Signed:
+                    {
+                        const auto value = reader.ReadSignedVarint();
+                        arguments.push_back(value);
+                        argumentTexts.push_back(std::to_string(value));
+                        break;
+                    }
+                    case FileArgumentType::Unsigned:
+                    {
+                        const auto value = reader.ReadVarint();
+                        arguments.push_back(value);
+                        argumentTexts.push_back(std::to_string(value));
+                        break;
+                    }
+                    case FileArgumentType::Double:
+                    {
+                        const auto value = reader.ReadDouble();
+                        arguments.push_back(value);
+                        argumentTexts.push_back(std::format("{}", value));
+                        break;
+                    }
+                    case FileArgumentType::Bool:
+                    {
+                        const bool value = reader.ReadByte() != 0;
+                        arguments.push_back(value);
+                        argumentTexts.emplace_back(value ? "true" : "false");
+                        break;
+                    }
+                    case FileArgumentType::String:
+                    case FileArgumentType::InternedString:
+                    {
+                        auto value = reader.ReadString();
+                        if (static_cast<FileArgumentType>(argumentType) == FileArgumentType::InternedString)
+                        {
+                            strings.push_back(value);
+                        }
+                        arguments.push_back(value);
+                        argumentTexts.push_back(std::move(value));
+                        break;
+                    }
+                    case FileArgumentType::StringReference:
+                    {
+                        const auto stringId = reader.ReadVarint();
+                        if (stringId >= strings.size())
+                        {
+                            throw std::runtime_error(std::format("Binary log: unknown string {}", stringId));
+                        }
+                        arguments.push_back(strings[stringId]);
+                        argumentTexts.push_back(strings[stringId]);
+                        break;
+                    }
+                    default:
+                        throw std::runtime_error(std::format("Binary log: invalid argument type {}", argumentType));
+                    }
+                }
+
+                const auto levelName = spdlog::level::to_string_view(static_cast<spdlog::level::level_enum>(level));
+                line = std::format("[{}] [{}] [{}] {}\n", FormatTime(time), std::string_view(levelName.data(), levelName.size()),
+                                   threadId, FormatMessage(sites[siteId].format, arguments, argumentTexts));
+                break;
+            }
+            case FileRecordType::Dropped:
+            {
+                const auto threadId = reader.ReadVarint();
+                const auto count = reader.ReadVarint();
+                line = std::format("[{}] [warning] [{}] {} log messages dropped: the buffer of the thread was full.\n",
+                                   FormatTime(time), threadId, count);
+                break;
+            }
+            default:
+                throw std::runtime_error(std::format("Binary log: invalid record type {}", type));
+            }
+            text += line;
+        }
+    }
+    catch (const TruncatedRecord&)
+    {
+        // written up to here
+    }
+    return text;
+}
+
+std::string ed::DecodeBinaryLogFile(const std::filesystem::path& pathName)
+{
+    std::ifstream file(pathName, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error(std::format(R"(Binary log "{}" can not be opened)", pathName.string()));
+    }
+    const std::string data{std::istreambuf_iterator(file), std::istreambuf_iterator<char>()};
+    return DecodeBinaryLog(data);
+}
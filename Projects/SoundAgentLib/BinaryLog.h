@@ -0,0 +1,208 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include "LogFloodGuard.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+#include <spdlog/common.h>
+
+
+namespace ed {
+// Logging with deferred formatting: instead of a text line, the logging thread writes the call site, the time
+// and the raw arguments (numbers as they are, strings up to MAX_STRING_SIZE bytes, anything else formatted)
+// into a ring of its own, and a BinaryLogWriter turns them into a compact file in the background;
+// DecodeBinaryLog makes text of it. While enabled, ED_LOG writes here instead of to spdlog, so its lines are in no spdlog sink.
+// A full ring drops the new records and counts them.
+class BinaryLog final {
+public:
+    static constexpr size_t BYTES_PER_THREAD = 256 * 1024;
+    static constexpr size_t MAX_STRING_SIZE = 256;
+    static constexpr size_t MAX_ARGUMENTS = 16;
+
+    // The records one thread wrote since the previous TakeRecords
+    struct ThreadRecords
+    {
+        uint32_t threadId = 0;
+        std::string data;
+        uint64_t droppedCount = 0;
+    };
+
+public:
+    BinaryLog();
+    DISALLOW_COPY_MOVE(BinaryLog);
+    ~BinaryLog();
+
+    // The one ED_LOG writes into
+    [[nodiscard]] static BinaryLog& GetInstance();
+
+public:
+    void SetEnabled(bool enabled);
+    [[nodiscard]] bool IsEnabled() const;
+
+    // The format must outlive the log, e.g. a string literal, as the site does
+    template <typename... Args>
+    void Write(spdlog::level::level_enum level, const LogSite& site, const char* format, const Args&... arguments);
+
+    [[nodiscard]] std::vector<ThreadRecords> TakeRecords();
+
+private:
+    enum class ArgumentType : uint8_t
+    {
+        Signed = 0,
+        Unsigned,
+        Double,
+        Bool,
+        String
+    };
+
+    // Layout: level, argument count, site, format, microseconds since the epoch, then per argument its type and value
+    class RecordBuilder final {
+    public:
+        static constexpr size_t HEADER_SIZE = 2 + sizeof(const LogSite*) + sizeof(const char*) + sizeof(int64_t);
+        static constexpr size_t MAX_SIZE = HEADER_SIZE + MAX_ARGUMENTS * (1 + sizeof(uint16_t) + MAX_STRING_SIZE);
+
+    public:
+        RecordBuilder(spdlog::level::level_enum level, size_t argumentCount, const LogSite& site, const char* format);
+        DISALLOW_COPY_MOVE(RecordBuilder);
+        ~RecordBuilder() = default;
+
+    public:
+        template <typename T>
+        void Append(const T& argument);
+        [[nodiscard]] std::string_view GetRecord() const;
+
+    private:
+        template <typename T>
+        void AppendValue(ArgumentType type, T value);
+        void AppendString(std::string_view value);
+
+    private:
+        std::array<char, MAX_SIZE> data_; // not initialized: only the appended part is read
+        size_t size_ = 0;
+    };
+
+    class ThreadBuffer;
+    friend class BinaryLogWriter;
+
+    void Commit(std::string_view record);
+    ThreadBuffer& GetThreadBuffer();
+
+    // The buffers of the current thread by log id; in practice the one of the global log
+    static thread_local std::vector<std::pair<uint64_t, ThreadBuffer*>> threadBuffers_;
+
+    const uint64_t id_;
+    std::atomic<bool> isEnabled_ = false;
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_; // of every thread that logged, also the finished ones
+};
+
+// Appends the records of a BinaryLog to a file every flushInterval and on destruction; enables the log meanwhile.
+// File: magic "SABL" and a version byte per writer session, then the call sites and strings on their first use
+// and the messages referring to them; integers as LEB128 varints.
+class BinaryLogWriter final {
+public:
+    static constexpr auto DEFAULT_FLUSH_INTERVAL = std::chrono::milliseconds(100);
+    // Strings repeated in the arguments, e.g. endpoint ids, are written once; later strings are written in full
+    static constexpr size_t MAX_INTERNED_STRINGS = 4096;
+
+public:
+    // Throws std::runtime_error if the file can not be opened
+    explicit BinaryLogWriter(const std::filesystem::path& pathName, BinaryLog& log = BinaryLog::GetInstance(),
+                             std::chrono::milliseconds flushInterval = DEFAULT_FLUSH_INTERVAL);
+    DISALLOW_COPY_MOVE(BinaryLogWriter);
+    ~BinaryLogWriter();
+
+public:
+    // Records written and dropped by full rings, so far
+    [[nodiscard]] uint64_t GetWrittenCount() const;
+    [[nodiscard]] uint64_t GetDroppedCount() const;
+
+private:
+    void Flush();
+    void AppendRecord(std::string& buffer, std::string_view& records, uint32_t threadId);
+    void AppendArgumentString(std::string& buffer, std::string_view value);
+
+private:
+    BinaryLog& log_;
+    std::ofstream file_;
+    std::map<std::pair<const LogSite*, const char*>, uint64_t> siteIds_; // by site and format
+    std::map<std::string, uint64_t, std::less<>> stringIds_; // up to MAX_INTERNED_STRINGS
+    int64_t previousTime_ = 0; // of the previous message, microseconds since the epoch
+    std::atomic<uint64_t> writtenCount_ = 0;
+    std::atomic<uint64_t> droppedCount_ = 0;
+    std::jthread flusher_;
+};
+
+// Text lines "[2026-01-31 12:34:56.789012] [info] [4242] Message"; the time in UTC.
+// Throws std::runtime_error if the data is no binary log; a last record cut off is dropped
+[[nodiscard]] std::string DecodeBinaryLog(std::string_view data);
+[[nodiscard]] std::string DecodeBinaryLogFile(const std::filesystem::path& pathName);
+}
+
+template <typename... Args>
+void ed::BinaryLog::Write(spdlog::level::level_enum level, const LogSite& site, const char* format, const Args&... arguments)
+{
+    static_assert(sizeof...(Args) <= MAX_ARGUMENTS, "Too many arguments for the binary log");
+    RecordBuilder builder(level, sizeof...(Args), site, format);
+    (builder.Append(arguments), ...);
+    Commit(builder.GetRecord());
+}
+
+template <typename T>
+void ed::BinaryLog::RecordBuilder::Append(const T& argument)
+{
+    if constexpr (std::is_same_v<T, char>)
+    {
+        AppendString(std::string_view(&argument, 1));
+    }
+    else if constexpr (std::is_same_v<T, bool>)
+    {
+        AppendValue(ArgumentType::Bool, static_cast<uint8_t>(argument ? 1 : 0));
+    }
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+    {
+        AppendValue(ArgumentType::Signed, static_cast<int64_t>(argument));
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        AppendValue(ArgumentType::Unsigned, static_cast<uint64_t>(argument));
+    }
+    else if constexpr (std::is_floating_point_v<T>)
+    {
+        AppendValue(ArgumentType::Double, static_cast<double>(argument));
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+    {
+        AppendString(argument);
+    }
+    else
+    {
+        AppendString(fmt::format("{}", argument));
+    }
+}
+
+template <typename T>
+void ed::BinaryLog::RecordBuilder::AppendValue(ArgumentType type, T value)
+{
+    data_[size_++] = static_cast<char>(type);
+    std::memcpy(data_.data() + size_, &value, sizeof(value));
+    size_ += sizeof(value);
+}
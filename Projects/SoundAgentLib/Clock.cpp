@@ -0,0 +1,96 @@
+#include "os-dependencies.h"
+
+#include "Clock.h"
+
+#include <algorithm>
+
+
+const ed::ClockInterface& ed::SystemClock::GetInstance()
+{
+    static const SystemClock instance;
+    return instance;
+}
+
+std::chrono::system_clock::time_point ed::SystemClock::SystemNow() const
+{
+    return std::chrono::system_clock::now();
+}
+
+std::chrono::steady_clock::time_point ed::SystemClock::SteadyNow() const
+{
+    return std::chrono::steady_clock::now();
+}
+
+bool ed::SystemClock::WaitUntil(std::condition_variable_any& condition, std::unique_lock<std::mutex>& lock,
+                                const std::stop_token& stopToken, std::chrono::steady_clock::time_point deadline,
+                                const std::function<bool()>& predicate) const
+{
+    return condition.wait_until(lock, stopToken, deadline, predicate);
+}
+
+ed::ManualClock::ManualClock(std::chrono::system_clock::time_point systemStart)
+    : systemStart_(systemStart)
+    , steadyStart_()
+{
+}
+
+void ed::ManualClock::Advance(std::chrono::steady_clock::duration duration)
+{
+    std::lock_guard lock(mutex_);
+    elapsed_ += std::max(duration, std::chrono::steady_clock::duration::zero());
+    // Under the lock: a waiter unregisters under it before its condition may go away
+    for (const auto& waiter : waiters_)
+    {
+        waiter.condition->notify_all();
+    }
+}
+
+std::chrono::steady_clock::duration ed::ManualClock::GetElapsed() const
+{
+    std::lock_guard lock(mutex_);
+    return elapsed_;
+}
+
+bool ed::ManualClock::WaitForWaiters(size_t waiterCount, std::chrono::milliseconds timeout) const
+{
+    std::unique_lock lock(mutex_);
+    return waitersChanged_.wait_for(lock, timeout, [this, waiterCount] { return GetPendingWaiterCount() >= waiterCount; });
+}
+
+size_t ed::ManualClock::GetPendingWaiterCount() const
+{
+    const auto now = steadyStart_ + elapsed_;
+    return static_cast<size_t>(std::ranges::count_if(waiters_, [now](const Waiter& waiter) { return waiter.deadline > now; }));
+}
+
+std::chrono::system_clock::time_point ed::ManualClock::SystemNow() const
+{
+    return systemStart_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(GetElapsed());
+}
+
+std::chrono::steady_clock::time_point ed::ManualClock::SteadyNow() const
+{
+    return steadyStart_ + GetElapsed();
+}
+
+bool ed::ManualClock::WaitUntil(std::condition_variable_any& condition, std::unique_lock<std::mutex>& lock,
+                                const std::stop_token& stopToken, std::chrono::steady_clock::time_point deadline,
+                                const std::function<bool()>& predicate) const
+{
+    std::list<Waiter>::iterator registration;
+    {
+        std::lock_guard clockLock(mutex_);
+        registration = waiters_.insert(waiters_.end(), {&condition, deadline});
+    }
+    waitersChanged_.notify_all();
+    const auto isDue = [this, deadline, &predicate] { return predicate() || SteadyNow() >= deadline; };
+    for (bool isWoken = false; !isWoken && !stopToken.stop_requested(); )
+    {
+        isWoken = condition.wait_for(lock, stopToken, WAKE_UP_INTERVAL, isDue);
+    }
+    {
+        std::lock_guard clockLock(mutex_);
+        waiters_.erase(registration);
+    }
+    return predicate();
+}
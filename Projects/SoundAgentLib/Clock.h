@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <stop_token>
+
+namespace ed {
+// Time source of the time-dependent stages: the timestamps of the messages and the waits of the worker threads.
+// SystemClock reads the real clocks; ManualClock is advanced by hand, so hours of backoff, token bucket refills
+// or batching windows pass in milliseconds, in tests and benchmarks.
+class ClockInterface
+{
+public:
+    [[nodiscard]] virtual std::chrono::system_clock::time_point SystemNow() const = 0;
+    [[nodiscard]] virtual std::chrono::steady_clock::time_point SteadyNow() const = 0;
+
+    // Waits on the condition until the predicate holds, a stop is requested or SteadyNow() reaches the deadline;
+    // returns the predicate. The lock guards what the predicate reads, as with std::condition_variable_any.
+    virtual bool WaitUntil(std::condition_variable_any& condition, std::unique_lock<std::mutex>& lock,
+                           const std::stop_token& stopToken, std::chrono::steady_clock::time_point deadline,
+                           const std::function<bool()>& predicate) const = 0;
+
+    AS_INTERFACE(ClockInterface);
+    DISALLOW_COPY_MOVE(ClockInterface);
+};
+
+class SystemClock final : public ClockInterface
+{
+public:
+    SystemClock() = default;
+    DISALLOW_COPY_MOVE(SystemClock);
+    ~SystemClock() override = default;
+
+    // The one the stages use unless another clock is injected
+    [[nodiscard]] static const ClockInterface& GetInstance();
+
+public:
+    [[nodiscard]] std::chrono::system_clock::time_point SystemNow() const override;
+    [[nodiscard]] std::chrono::steady_clock::time_point SteadyNow() const override;
+    bool WaitUntil(std::condition_variable_any& condition, std::unique_lock<std::mutex>& lock,
+                   const std::stop_token& stopToken, std::chrono::steady_clock::time_point deadline,
+                   const std::function<bool()>& predicate) const override;
+};
+
+// Stands still until advanced; thread safe. Advancing wakes the threads waiting on it, so the waits of
+// the workers end as soon as their deadline passes in the manual time. A test advances in steps, each one
+// after WaitForWaiters: a worker computing its deadline after the step would miss it otherwise.
+class ManualClock final : public ClockInterface
+{
+public:
+    explicit ManualClock(std::chrono::system_clock::time_point systemStart = std::chrono::system_clock::time_point{});
+    DISALLOW_COPY_MOVE(ManualClock);
+    ~ManualClock() override = default;
+
+public:
+    void Advance(std::chrono::steady_clock::duration duration);
+    [[nodiscard]] std::chrono::steady_clock::duration GetElapsed() const;
+    // Waits in real time until at least waiterCount threads wait for a deadline still ahead in the manual time;
+    // false on timeout
+    [[nodiscard]] bool WaitForWaiters(size_t waiterCount, std::chrono::milliseconds timeout) const;
+
+    [[nodiscard]] std::chrono::system_clock::time_point SystemNow() const override;
+    [[nodiscard]] std::chrono::steady_clock::time_point SteadyNow() const override;
+    bool WaitUntil(std::condition_variable_any& condition, std::unique_lock<std::mutex>& lock,
+                   const std::stop_token& stopToken, std::chrono::steady_clock::time_point deadline,
+                   const std::function<bool()>& predicate) const override;
+
+private:
+    struct Waiter
+    {
+        std::condition_variable_any* condition;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    [[nodiscard]] size_t GetPendingWaiterCount() const; // under the mutex
+
+    // Backstop for a notification racing with the check of the deadline; in real time
+    static constexpr auto WAKE_UP_INTERVAL = std::chrono::milliseconds(5);
+
+    const std::chrono::system_clock::time_point systemStart_;
+    const std::chrono::steady_clock::time_point steadyStart_;
+
+    mutable std::mutex mutex_;
+    std::chrono::steady_clock::duration elapsed_{};
+    mutable std::list<Waiter> waiters_;
+    mutable std::condition_variable waitersChanged_;
+};
+}
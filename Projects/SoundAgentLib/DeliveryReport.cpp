@@ -0,0 +1,37 @@
+#include "os-dependencies.h"
+
+#include "DeliveryReport.h"
+
+
+namespace
+{
+    // The innermost scope on this thread
+    thread_local ed::DeliveryReport::Scope* currentScope = nullptr;
+}
+
+ed::DeliveryReport::Scope::Scope(Handler handler)
+    : handler_(std::move(handler))
+    , outerScope_(currentScope)
+{
+    currentScope = this;
+}
+
+ed::DeliveryReport::Scope::~Scope()
+{
+    currentScope = outerScope_;
+}
+
+bool ed::DeliveryReport::Scope::IsTaken() const
+{
+    return taken_;
+}
+
+ed::DeliveryReport::Handler ed::DeliveryReport::Take()
+{
+    if (currentScope == nullptr || currentScope->taken_)
+    {
+        return nullptr;
+    }
+    currentScope->taken_ = true;
+    return std::move(currentScope->handler_);
+}
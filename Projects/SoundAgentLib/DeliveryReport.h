@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <functional>
+#include <string>
+
+
+namespace ed {
+// Outcome of a request at a sink that delivers after EnqueueRequest returned, e.g. from an own writer thread.
+// A dispatcher interested in the outcome calls EnqueueRequest within a Scope; such a sink takes the handler over
+// (Take, on the calling thread, within EnqueueRequest) and calls it once the request is delivered or failed,
+// from any thread, never with a lock of its own held. A sink that does not take it delivers synchronously:
+// returning from EnqueueRequest is the delivery, an exception the failure.
+class DeliveryReport final {
+public:
+    using Handler = std::function<void(bool delivered, const std::string& error)>;
+
+    class Scope final {
+    public:
+        explicit Scope(Handler handler);
+        DISALLOW_COPY_MOVE(Scope);
+        ~Scope();
+
+    public:
+        // The sink took the handler: the outcome is reported later
+        [[nodiscard]] bool IsTaken() const;
+
+    private:
+        Handler handler_;
+        bool taken_ = false;
+        Scope* const outerScope_;
+
+        friend class DeliveryReport;
+    };
+
+public:
+    DeliveryReport() = delete;
+    DISALLOW_COPY_MOVE(DeliveryReport);
+    ~DeliveryReport() = delete;
+
+public:
+    // The handler of the innermost scope on this thread; empty outside of a scope or if already taken
+    [[nodiscard]] static Handler Take();
+};
+}
@@ -0,0 +1,228 @@
+#include "os-dependencies.h"
+
+#include "DeviceDigest.h"
+
+#include "ApiClient/common/TimeUtil.h"
+
+#include <format>
+#include <type_traits>
+
+#include <magic_enum/magic_enum.hpp>
+
+
+namespace
+{
+    constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    // Little endian whatever the byte order of the machine: the agent and the backend hash alike
+    template <typename T>
+    uint64_t HashValue(uint64_t hash, T value)
+    {
+        static_assert(std::is_unsigned_v<T>);
+        std::array<uint8_t, sizeof(T)> bytes{};
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+        return HashBytes(hash, bytes.data(), bytes.size());
+    }
+
+    uint64_t HashString(uint64_t hash, const std::string& value)
+    {
+        // length prefixed: "ab" + "c" differs from "a" + "bc"
+        hash = HashValue(hash, static_cast<uint64_t>(value.size()));
+        return HashBytes(hash, value.data(), value.size());
+    }
+}
+
+ed::audio::DeviceRecord ed::audio::DeviceRecord::FromDevice(const SoundDeviceInterface& device)
+{
+    return {
+        .pnpId = device.GetPnpId(),
+        .name = device.GetName(),
+        .flow = device.GetFlow(),
+        .renderVolume = device.GetCurrentRenderVolume(),
+        .captureVolume = device.GetCurrentCaptureVolume(),
+        .renderIsDefault = device.IsRenderCurrentlyDefault(),
+        .captureIsDefault = device.IsCaptureCurrentlyDefault()
+    };
+}
+
+ed::audio::DeviceRecord ed::audio::DeviceRecord::FromJson(const nlohmann::json& json)
+{
+    return {
+        .pnpId = json.at("pnpId").get<std::string>(),
+        .name = json.at("name").get<std::string>(),
+        .flow = magic_enum::enum_cast<SoundDeviceFlowType>(json.at("flowType").get<std::string>()).value_or(SoundDeviceFlowType::None),
+        .renderVolume = json.at("renderVolume").get<uint16_t>(),
+        .captureVolume = json.at("captureVolume").get<uint16_t>(),
+        .renderIsDefault = json.at("isRenderDefault").get<bool>(),
+        .captureIsDefault = json.at("isCaptureDefault").get<bool>()
+    };
+}
+
+nlohmann::json ed::audio::DeviceRecord::ToJson() const
+{
+    return {
+        {"pnpId", pnpId},
+        {"name", name},
+        {"flowType", magic_enum::enum_name(flow)},
+        {"renderVolume", renderVolume},
+        {"captureVolume", captureVolume},
+        {"isRenderDefault", renderIsDefault},
+        {"isCaptureDefault", captureIsDefault}
+    };
+}
+
+std::unique_ptr<ed::audio::DeviceDigest> ed::audio::DeviceDigest::FromCollection(const SoundDeviceCollectionInterface& collection)
+{
+    auto digest = std::make_unique<DeviceDigest>();
+    for (const auto& deviceSmartPtr : collection.CreateItems())
+    {
+        digest->Put(DeviceRecord::FromDevice(*deviceSmartPtr));
+    }
+    return digest;
+}
+
+void ed::audio::DeviceDigest::Put(const DeviceRecord& record)
+{
+    pnpIdToRecord_[record.pnpId] = record;
+}
+
+void ed::audio::DeviceDigest::Remove(const std::string& pnpId)
+{
+    pnpIdToRecord_.erase(pnpId);
+}
+
+void ed::audio::DeviceDigest::ReplaceBucket(size_t bucket, const std::vector<DeviceRecord>& records)
+{
+    std::erase_if(pnpIdToRecord_, [bucket](const auto& pnpIdAndRecord)
+    {
+        return GetBucket(pnpIdAndRecord.first) == bucket;
+    });
+    for (const auto& record : records)
+    {
+        Put(record);
+    }
+}
+
+size_t ed::audio::DeviceDigest::GetSize() const
+{
+    return pnpIdToRecord_.size();
+}
+
+ed::audio::DeviceDigest::BucketHashes ed::audio::DeviceDigest::GetBucketHashes() const
+{
+    BucketHashes bucketHashes;
+    bucketHashes.fill(FNV_OFFSET_BASIS);
+    // ordered by PnP id, so both sides hash a bucket in the same order
+    for (const auto& [pnpId, record] : pnpIdToRecord_)
+    {
+        auto& bucketHash = bucketHashes[GetBucket(pnpId)];
+        bucketHash = HashValue(bucketHash, HashRecord(record));
+    }
+    return bucketHashes;
+}
+
+uint64_t ed::audio::DeviceDigest::GetRootHash() const
+{
+    return HashBuckets(GetBucketHashes());
+}
+
+std::vector<ed::audio::DeviceRecord> ed::audio::DeviceDigest::GetBucketRecords(size_t bucket) const
+{
+    std::vector<DeviceRecord> records;
+    for (const auto& [pnpId, record] : pnpIdToRecord_)
+    {
+        if (GetBucket(pnpId) == bucket)
+        {
+            records.push_back(record);
+        }
+    }
+    return records;
+}
+
+std::string ed::audio::DeviceDigest::CreateDigestPayload(const std::string& hostName, std::chrono::system_clock::time_point now) const
+{
+    const auto bucketHashes = GetBucketHashes();
+    nlohmann::json buckets = nlohmann::json::array();
+    for (const auto bucketHash : bucketHashes)
+    {
+        buckets.push_back(std::format("{:016x}", bucketHash));
+    }
+    const nlohmann::json payload = {
+        {"hostName", hostName},
+        {"rootHash", std::format("{:016x}", HashBuckets(bucketHashes))},
+        {"bucketHashes", buckets},
+        {"updateDate", TimePointToStringAsUtc(now, true, true)}
+    };
+    return payload.dump();
+}
+
+std::string ed::audio::DeviceDigest::CreateBucketPayload(size_t bucket, const std::string& hostName,
+                                                         std::chrono::system_clock::time_point now) const
+{
+    nlohmann::json devices = nlohmann::json::array();
+    for (const auto& record : GetBucketRecords(bucket))
+    {
+        devices.push_back(record.ToJson());
+    }
+    const nlohmann::json payload = {
+        {"hostName", hostName},
+        {"bucket", bucket},
+        {"devices", devices},
+        {"updateDate", TimePointToStringAsUtc(now, true, true)}
+    };
+    return payload.dump();
+}
+
+size_t ed::audio::DeviceDigest::GetBucket(const std::string& pnpId)
+{
+    return static_cast<size_t>(HashString(FNV_OFFSET_BASIS, pnpId) % BUCKET_COUNT);
+}
+
+uint64_t ed::audio::DeviceDigest::HashRecord(const DeviceRecord& record)
+{
+    auto hash = HashString(FNV_OFFSET_BASIS, record.pnpId);
+    hash = HashString(hash, record.name);
+    hash = HashValue(hash, static_cast<uint8_t>(record.flow));
+    hash = HashValue(hash, record.renderVolume);
+    hash = HashValue(hash, record.captureVolume);
+    hash = HashValue(hash, static_cast<uint8_t>(record.renderIsDefault));
+    return HashValue(hash, static_cast<uint8_t>(record.captureIsDefault));
+}
+
+uint64_t ed::audio::DeviceDigest::HashBuckets(const BucketHashes& bucketHashes)
+{
+    auto hash = FNV_OFFSET_BASIS;
+    for (const auto bucketHash : bucketHashes)
+    {
+        hash = HashValue(hash, bucketHash);
+    }
+    return hash;
+}
+
+std::vector<size_t> ed::audio::DeviceDigest::FindMismatchedBuckets(const BucketHashes& left, const BucketHashes& right)
+{
+    std::vector<size_t> mismatched;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+    {
+        if (left[bucket] != right[bucket])
+        {
+            mismatched.push_back(bucket);
+        }
+    }
+    return mismatched;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "public/SoundAgentInterface.h"
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+
+namespace ed::audio {
+// Canonical device state covered by the digest, the same on the agent and the backend side
+struct DeviceRecord
+{
+    std::string pnpId;
+    std::string name;
+    SoundDeviceFlowType flow = SoundDeviceFlowType::None;
+    uint16_t renderVolume = 0;
+    uint16_t captureVolume = 0;
+    bool renderIsDefault = false;
+    bool captureIsDefault = false;
+
+    [[nodiscard]] static DeviceRecord FromDevice(const SoundDeviceInterface& device);
+    [[nodiscard]] static DeviceRecord FromJson(const nlohmann::json& json);
+    [[nodiscard]] nlohmann::json ToJson() const;
+};
+
+// Two level (Merkle style) digest of a device table: the devices are spread over a few buckets by PnP id,
+// a bucket hash covers the record hashes of its devices, the root hash covers the bucket hashes.
+// The agent publishes the bucket hashes; a backend holding a different table can ask for the mismatched
+// buckets, and only the records of those buckets are sent, each bucket as a whole, so that devices the
+// agent no longer has are removed from the backend, too. The hashes cover a fixed little endian
+// serialization of the records: they are the same on every machine.
+class DeviceDigest final {
+public:
+    static constexpr size_t BUCKET_COUNT = 8;
+    using BucketHashes = std::array<uint64_t, BUCKET_COUNT>;
+
+public:
+    DeviceDigest() = default;
+    DISALLOW_COPY_MOVE(DeviceDigest);
+    ~DeviceDigest() = default;
+
+public:
+    [[nodiscard]] static std::unique_ptr<DeviceDigest> FromCollection(const SoundDeviceCollectionInterface& collection);
+
+    void Put(const DeviceRecord& record);
+    void Remove(const std::string& pnpId);
+    void ReplaceBucket(size_t bucket, const std::vector<DeviceRecord>& records);
+
+    [[nodiscard]] size_t GetSize() const;
+    [[nodiscard]] BucketHashes GetBucketHashes() const;
+    [[nodiscard]] uint64_t GetRootHash() const;
+    [[nodiscard]] std::vector<DeviceRecord> GetBucketRecords(size_t bucket) const;
+
+    [[nodiscard]] std::string CreateDigestPayload(const std::string& hostName, std::chrono::system_clock::time_point now) const;
+    [[nodiscard]] std::string CreateBucketPayload(size_t bucket, const std::string& hostName,
+                                                  std::chrono::system_clock::time_point now) const;
+
+    [[nodiscard]] static size_t GetBucket(const std::string& pnpId);
+    [[nodiscard]] static uint64_t HashRecord(const DeviceRecord& record);
+    [[nodiscard]] static uint64_t HashBuckets(const BucketHashes& bucketHashes);
+    [[nodiscard]] static std::vector<size_t> FindMismatchedBuckets(const BucketHashes& left, const BucketHashes& right);
+
+private:
+    std::map<std::string, DeviceRecord> pnpIdToRecord_;
+};
+}
@@ -0,0 +1,62 @@
+#include "os-dependencies.h"
+
+#include "EncodingHttpRequestDispatcher.h"
+
+#include <Poco/String.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+
+EncodingHttpRequestDispatcher::EncodingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher,
+                                                             ed::PayloadEncoding encoding)
+    : targetDispatcher_(targetDispatcher)
+    , encoding_(encoding)
+{
+}
+
+void EncodingHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                   const std::string& urlSuffix, const std::string& payload,
+                                                   const std::unordered_map<std::string, std::string>& header,
+                                                   const std::string& hint)
+{
+    if (!IsPlainJson(header))
+    {
+        targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, payload, header, hint);
+        return;
+    }
+
+    const auto document = nlohmann::json::parse(payload, nullptr, false);
+    if (document.is_discarded())
+    {
+        if (notEncodedCount_++ == 0)
+        {
+            spdlog::warn(R"(Payload "{}" is no JSON document, sent as is.)", hint);
+        }
+        targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, payload, header, hint);
+        return;
+    }
+
+    auto encodedHeader = header;
+    encodedHeader[ed::CONTENT_TYPE_HEADER_KEY] = ed::GetContentType(encoding_);
+    if (document.is_object() && document.contains(DEVICE_PAYLOAD_KEY))
+    {
+        encodedHeader[ed::SCHEMA_ID_HEADER_KEY] = ed::PAYLOAD_SCHEMA_ID;
+    }
+    targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, ed::EncodeJsonDocument(encoding_, document), encodedHeader, hint);
+}
+
+bool EncodingHttpRequestDispatcher::IsPlainJson(const std::unordered_map<std::string, std::string>& header)
+{
+    if (header.contains(ed::CONTENT_ENCODING_HEADER_KEY))
+    {
+        return false;
+    }
+    const auto foundPair = header.find(ed::CONTENT_TYPE_HEADER_KEY);
+    if (foundPair == header.end())
+    {
+        return false;
+    }
+    // media type without parameters such as "; charset=utf-8"
+    const auto mediaType = Poco::trim(foundPair->second.substr(0, foundPair->second.find(';')));
+    return Poco::icompare(mediaType, std::string(ed::GetContentType(ed::PayloadEncoding::Json))) == 0;
+}
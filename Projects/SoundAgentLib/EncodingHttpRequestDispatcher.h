@@ -0,0 +1,36 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "PayloadEncoding.h"
+
+#include <atomic>
+
+// Decorator re-encoding the JSON payloads to the configured wire encoding.
+// Only plain "application/json" requests (no Content-Encoding) are re-encoded, announced via Content-Type;
+// device payloads (carrying "deviceMessageType") get the X-Schema-Id header in addition.
+// Any other request, and a payload that is no JSON document, is forwarded untouched.
+class EncodingHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    EncodingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher, ed::PayloadEncoding encoding);
+
+    DISALLOW_COPY_MOVE(EncodingHttpRequestDispatcher);
+    ~EncodingHttpRequestDispatcher() override = default;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+private:
+    [[nodiscard]] static bool IsPlainJson(const std::unordered_map<std::string, std::string>& header);
+
+private:
+    static constexpr auto DEVICE_PAYLOAD_KEY = "deviceMessageType";
+
+    HttpRequestDispatcherInterface& targetDispatcher_;
+    const ed::PayloadEncoding encoding_;
+    std::atomic<uint64_t> notEncodedCount_ = 0;
+};
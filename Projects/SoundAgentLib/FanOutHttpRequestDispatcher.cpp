@@ -0,0 +1,92 @@
+#include "os-dependencies.h"
+
+#include "FanOutHttpRequestDispatcher.h"
+
+#include "EncodingHttpRequestDispatcher.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+
+void FanOutHttpRequestDispatcher::AddSink(const std::string& name, std::unique_ptr<HttpRequestDispatcherInterface> sink,
+                                          ed::PayloadEncoding encoding, size_t queueCapacity,
+                                          const std::optional<ed::RetrySettings>& retrySettings)
+{
+    Sink newSink;
+    newSink.name = name;
+    newSink.dispatcher = std::move(sink);
+    if (encoding != ed::PayloadEncoding::Json)
+    {
+        newSink.encodingDispatcher = std::make_unique<EncodingHttpRequestDispatcher>(*newSink.dispatcher, encoding);
+    }
+    auto* target = newSink.encodingDispatcher ? newSink.encodingDispatcher.get() : newSink.dispatcher.get();
+    if (retrySettings.has_value())
+    {
+        newSink.retryingDispatcher = std::make_unique<RetryingHttpRequestDispatcher>(*target, name, *retrySettings);
+        target = newSink.retryingDispatcher.get();
+    }
+    newSink.queue = std::make_unique<QueuedHttpRequestDispatcher>(*target, name, queueCapacity);
+    sinks_.push_back(std::move(newSink));
+
+    spdlog::info(R"(Sink "{}" added: {} payloads, queue capacity {}.)", name, ed::GetPayloadEncodingName(encoding), queueCapacity);
+}
+
+size_t FanOutHttpRequestDispatcher::GetSinkCount() const
+{
+    return sinks_.size();
+}
+
+std::vector<FanOutHttpRequestDispatcher::SinkStatistics> FanOutHttpRequestDispatcher::GetSinkStatistics() const
+{
+    std::vector<SinkStatistics> statistics;
+    statistics.reserve(sinks_.size());
+    for (const auto& sink : sinks_)
+    {
+        statistics.push_back({
+            .name = sink.name,
+            .queueSize = sink.queue->GetSize(),
+            .droppedCount = sink.queue->GetDroppedCount(),
+            .failedCount = sink.queue->GetFailedCount() + (sink.retryingDispatcher ? sink.retryingDispatcher->GetFailedCount() : 0),
+            .retryCount = sink.retryingDispatcher ? sink.retryingDispatcher->GetRetryCount() : 0
+        });
+    }
+    return statistics;
+}
+
+bool FanOutHttpRequestDispatcher::IsAnySinkAvailable() const
+{
+    return std::ranges::any_of(sinks_, [](const Sink& sink)
+    {
+        return !sink.retryingDispatcher || !sink.retryingDispatcher->IsCircuitOpen();
+    });
+}
+
+void FanOutHttpRequestDispatcher::SetSinkRecoveredHandler(const std::function<void(const std::string& sinkName)>& onRecovered)
+{
+    for (const auto& sink : sinks_)
+    {
+        std::function<void()> onSinkRecovered;
+        if (onRecovered)
+        {
+            onSinkRecovered = [onRecovered, name = sink.name] { onRecovered(name); };
+        }
+        // Behind a retrying stage the queue sees no failures; otherwise there is no retrying stage
+        sink.queue->SetRecoveredHandler(onSinkRecovered);
+        if (sink.retryingDispatcher)
+        {
+            sink.retryingDispatcher->SetRecoveredHandler(onSinkRecovered);
+        }
+    }
+}
+
+void FanOutHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                 const std::string& urlSuffix, const std::string& payload,
+                                                 const std::unordered_map<std::string, std::string>& header,
+                                                 const std::string& hint)
+{
+    for (const auto& sink : sinks_)
+    {
+        sink.queue->EnqueueRequest(postOrPut, time, urlSuffix, payload, header, hint);
+    }
+}
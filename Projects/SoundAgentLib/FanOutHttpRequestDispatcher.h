@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "PayloadEncoding.h"
+#include "QueuedHttpRequestDispatcher.h"
+#include "RetryingHttpRequestDispatcher.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Hands every request over to all the sinks. Each sink gets its own bounded queue and worker thread,
+// so a slow or stalled sink (e.g. a broker that is down) does not hold back the others.
+class FanOutHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    struct SinkStatistics
+    {
+        std::string name;
+        size_t queueSize;
+        uint64_t droppedCount;
+        // Requests the sink threw on, retried ones included
+        uint64_t failedCount;
+        uint64_t retryCount;
+    };
+
+    FanOutHttpRequestDispatcher() = default;
+
+    DISALLOW_COPY_MOVE(FanOutHttpRequestDispatcher);
+    ~FanOutHttpRequestDispatcher() override = default;
+
+public:
+    // Sinks are to be added before the first request is enqueued. With retry settings,
+    // requests the sink throws on are retried with backoff behind a circuit breaker of its own.
+    void AddSink(const std::string& name, std::unique_ptr<HttpRequestDispatcherInterface> sink,
+                 ed::PayloadEncoding encoding, size_t queueCapacity,
+                 const std::optional<ed::RetrySettings>& retrySettings = std::nullopt);
+    [[nodiscard]] size_t GetSinkCount() const;
+    // In the order the sinks were added
+    [[nodiscard]] std::vector<SinkStatistics> GetSinkStatistics() const;
+    // False if every sink's circuit is open: none takes requests at the moment
+    [[nodiscard]] bool IsAnySinkAvailable() const;
+    // Called with the sink name once a sink delivers again after failing, e.g. reconnected; from a sink's thread
+    // with its lock held, so it must not enqueue a request. nullptr: none; to be reset before the handler's target goes
+    void SetSinkRecoveredHandler(const std::function<void(const std::string& sinkName)>& onRecovered);
+
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+private:
+    struct Sink
+    {
+        std::string name;
+        // Declaration order: the queue is destroyed (and drained) first, the sink itself last
+        std::unique_ptr<HttpRequestDispatcherInterface> dispatcher;
+        std::unique_ptr<HttpRequestDispatcherInterface> encodingDispatcher;
+        std::unique_ptr<RetryingHttpRequestDispatcher> retryingDispatcher;
+        std::unique_ptr<QueuedHttpRequestDispatcher> queue;
+    };
+
+    std::vector<Sink> sinks_;
+};
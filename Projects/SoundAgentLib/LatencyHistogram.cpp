@@ -0,0 +1,97 @@
+#include "os-dependencies.h"
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+
+uint64_t ed::LatencyHistogram::Snapshot::GetCount() const
+{
+    return count_;
+}
+
+std::chrono::microseconds ed::LatencyHistogram::Snapshot::GetMax() const
+{
+    return std::chrono::microseconds(maxUs_);
+}
+
+std::chrono::microseconds ed::LatencyHistogram::Snapshot::GetMean() const
+{
+    return std::chrono::microseconds(count_ == 0 ? 0 : sumUs_ / count_);
+}
+
+std::chrono::microseconds ed::LatencyHistogram::Snapshot::GetSum() const
+{
+    return std::chrono::microseconds(sumUs_);
+}
+
+std::chrono::microseconds ed::LatencyHistogram::Snapshot::GetPercentile(double percentile) const
+{
+    if (count_ == 0)
+    {
+        return std::chrono::microseconds(0);
+    }
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(count_))));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < counts_.size(); ++index)
+    {
+        seen += counts_[index];
+        if (seen >= rank)
+        {
+            // The bucket bound may exceed the largest value actually recorded
+            return std::chrono::microseconds(std::min(GetBucketValue(index), maxUs_));
+        }
+    }
+    return std::chrono::microseconds(maxUs_);
+}
+
+void ed::LatencyHistogram::Record(std::chrono::steady_clock::duration latency)
+{
+    const auto valueUs = static_cast<uint64_t>(std::clamp<std::chrono::microseconds>(
+        std::chrono::duration_cast<std::chrono::microseconds>(latency), std::chrono::microseconds(0), MAX_VALUE).count());
+
+    counts_[GetBucketIndex(valueUs)].fetch_add(1, std::memory_order_relaxed);
+    sumUs_.fetch_add(valueUs, std::memory_order_relaxed);
+    for (auto maxUs = maxUs_.load(std::memory_order_relaxed);
+         valueUs > maxUs && !maxUs_.compare_exchange_weak(maxUs, valueUs, std::memory_order_relaxed); )
+    {
+    }
+}
+
+ed::LatencyHistogram::Snapshot ed::LatencyHistogram::GetSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.counts_.reserve(counts_.size());
+    for (const auto& count : counts_)
+    {
+        snapshot.counts_.push_back(count.load(std::memory_order_relaxed));
+        snapshot.count_ += snapshot.counts_.back();
+    }
+    snapshot.sumUs_ = sumUs_.load(std::memory_order_relaxed);
+    snapshot.maxUs_ = maxUs_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+size_t ed::LatencyHistogram::GetBucketIndex(uint64_t valueUs)
+{
+    if (valueUs < 2 * SUB_BUCKET_COUNT)
+    {
+        return static_cast<size_t>(valueUs);
+    }
+    // Keeps the SUB_BUCKET_BITS + 1 leading bits of the value
+    const auto shift = static_cast<unsigned>(std::bit_width(valueUs)) - SUB_BUCKET_BITS - 1;
+    return static_cast<size_t>(shift * SUB_BUCKET_COUNT + (valueUs >> shift));
+}
+
+uint64_t ed::LatencyHistogram::GetBucketValue(size_t index)
+{
+    if (index < 2 * SUB_BUCKET_COUNT)
+    {
+        return index;
+    }
+    const auto shift = index / SUB_BUCKET_COUNT - 1;
+    const auto subBucket = index - shift * SUB_BUCKET_COUNT;
+    return ((subBucket + 1) << shift) - 1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+
+namespace ed {
+// HDR style latency histogram in microseconds: linear below 64 us, above that 32 sub-buckets per power of two,
+// i.e. a value is reported within about 3% up to MAX_VALUE (larger values are counted as MAX_VALUE).
+// Record is lock free (relaxed atomic increments), so it may be called from any thread.
+class LatencyHistogram final {
+public:
+    static constexpr auto MAX_VALUE = std::chrono::microseconds((1LL << 36) - 1); // about 19 hours
+
+    class Snapshot final {
+    public:
+        [[nodiscard]] uint64_t GetCount() const;
+        [[nodiscard]] std::chrono::microseconds GetMax() const;
+        [[nodiscard]] std::chrono::microseconds GetMean() const;
+        [[nodiscard]] std::chrono::microseconds GetSum() const;
+        // percentile in [0, 100]; zero for an empty histogram
+        [[nodiscard]] std::chrono::microseconds GetPercentile(double percentile) const;
+
+    private:
+        friend class LatencyHistogram;
+
+        std::vector<uint64_t> counts_;
+        uint64_t count_ = 0;
+        uint64_t sumUs_ = 0;
+        uint64_t maxUs_ = 0;
+    };
+
+public:
+    LatencyHistogram() = default;
+    DISALLOW_COPY_MOVE(LatencyHistogram);
+    ~LatencyHistogram() = default;
+
+public:
+    void Record(std::chrono::steady_clock::duration latency);
+    // Not atomic as a whole: a concurrent Record may be seen in some of the counts only
+    [[nodiscard]] Snapshot GetSnapshot() const;
+
+private:
+    static constexpr unsigned SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = 1024; // GetBucketIndex(MAX_VALUE) + 1
+
+    [[nodiscard]] static size_t GetBucketIndex(uint64_t valueUs);
+    // The largest value counted in the bucket
+    [[nodiscard]] static uint64_t GetBucketValue(size_t index);
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+    std::atomic<uint64_t> sumUs_ = 0;
+    std::atomic<uint64_t> maxUs_ = 0;
+};
+}
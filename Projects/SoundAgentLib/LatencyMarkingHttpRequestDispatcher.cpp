@@ -0,0 +1,23 @@
+#include "os-dependencies.h"
+
+#include "LatencyMarkingHttpRequestDispatcher.h"
+
+#include "PipelineLatency.h"
+#include "TraceSpans.h"
+
+
+LatencyMarkingHttpRequestDispatcher::LatencyMarkingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher)
+    : targetDispatcher_(targetDispatcher)
+{
+}
+
+void LatencyMarkingHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                         const std::string& urlSuffix, const std::string& payload,
+                                                         const std::unordered_map<std::string, std::string>& header,
+                                                         const std::string& hint)
+{
+    ed::LatencyTrace::Mark(ed::LatencyStage::PayloadBuilt);
+    TRACE_SPAN("EnqueueRequest");
+    targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, payload, header, hint);
+    ed::LatencyTrace::Mark(ed::LatencyStage::Enqueued);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+// Outermost decorator: marks the PayloadBuilt and Enqueued latency stages of the notification
+// being processed on the calling thread, if any (see ed::LatencyTrace).
+class LatencyMarkingHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    explicit LatencyMarkingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher);
+
+    DISALLOW_COPY_MOVE(LatencyMarkingHttpRequestDispatcher);
+    ~LatencyMarkingHttpRequestDispatcher() override = default;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+private:
+    HttpRequestDispatcherInterface& targetDispatcher_;
+};
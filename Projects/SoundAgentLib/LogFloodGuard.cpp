@@ -0,0 +1,100 @@
+#include "os-dependencies.h"
+
+#include "LogFloodGuard.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#include <spdlog/spdlog.h>
+
+
+void ed::LogFloodGuard::SetLimit(double messagesPerSecond, double burst)
+{
+    Clock::rep interval = 0;
+    if (messagesPerSecond > 0.0)
+    {
+        interval = std::max<Clock::rep>(
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / messagesPerSecond)).count(), 1);
+    }
+    burstDuration_.store(static_cast<Clock::rep>(static_cast<double>(interval) * std::max(burst, 1.0)), std::memory_order_relaxed);
+    interval_.store(interval, std::memory_order_relaxed);
+}
+
+bool ed::LogFloodGuard::IsLimited() const
+{
+    return interval_.load(std::memory_order_relaxed) != 0;
+}
+
+uint64_t ed::LogFloodGuard::ReportSuppressed()
+{
+    std::vector<LogSite*> sites;
+    {
+        std::lock_guard lock(mutex_);
+        sites = sites_;
+    }
+
+    uint64_t total = 0;
+    for (auto* site : sites)
+    {
+        if (const auto count = site->suppressedCount_.exchange(0, std::memory_order_relaxed); count > 0)
+        {
+            spdlog::warn("Suppressed {} similar messages of {}:{}.", count,
+                         std::filesystem::path(site->file_).filename().string(), site->line_);
+            total += count;
+        }
+    }
+    return total;
+}
+
+void ed::LogFloodGuard::Register(LogSite& site)
+{
+    std::lock_guard lock(mutex_);
+    sites_.push_back(&site);
+}
+
+bool ed::LogSite::TryAcquire(LogFloodGuard& guard, Clock::time_point now)
+{
+    const auto interval = guard.interval_.load(std::memory_order_relaxed);
+    if (interval == 0)
+    {
+        return true;
+    }
+    const auto burstDuration = guard.burstDuration_.load(std::memory_order_relaxed);
+    const auto nowCount = now.time_since_epoch().count();
+
+    auto fullAt = fullAt_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        const auto nextFullAt = std::max(fullAt, nowCount) + interval;
+        if (nextFullAt - nowCount > burstDuration)
+        {
+            break;
+        }
+        if (fullAt_.compare_exchange_weak(fullAt, nextFullAt, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+
+    suppressedCount_.fetch_add(1, std::memory_order_relaxed);
+    if (!isRegistered_.load(std::memory_order_relaxed) && !isRegistered_.exchange(true, std::memory_order_relaxed))
+    {
+        guard.Register(*this);
+    }
+    return false;
+}
+
+uint64_t ed::LogSite::GetSuppressedCount() const
+{
+    return suppressedCount_.load(std::memory_order_relaxed);
+}
+
+const char* ed::LogSite::GetFile() const
+{
+    return file_;
+}
+
+int ed::LogSite::GetLine() const
+{
+    return line_;
+}
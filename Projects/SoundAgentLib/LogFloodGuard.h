@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+namespace ed {
+class LogSite;
+
+// The rate limit of the log call sites, see ED_LOG: every site may write `burst` messages at once
+// and then messagesPerSecond on average; the messages above that are suppressed and counted per site.
+// ReportSuppressed writes one summary line per site with suppressed messages.
+// Unlimited until a limit is set.
+class LogFloodGuard final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+public:
+    LogFloodGuard() = default;
+    DISALLOW_COPY_MOVE(LogFloodGuard);
+    ~LogFloodGuard() = default;
+
+    // The one ED_LOG uses
+    [[nodiscard]] static LogFloodGuard& GetInstance();
+
+public:
+    // 0 messages per second: unlimited
+    void SetLimit(double messagesPerSecond, double burst);
+    [[nodiscard]] bool IsLimited() const;
+
+    // Logs "Suppressed N similar messages" per site and resets the counts; the total suppressed since the last report
+    uint64_t ReportSuppressed();
+
+private:
+    friend class LogSite;
+
+    void Register(LogSite& site);
+
+    std::atomic<Clock::rep> interval_ = 0; // between two messages of a site at the sustained rate; 0: unlimited
+    std::atomic<Clock::rep> burstDuration_ = 0; // burst * interval_
+    std::mutex mutex_;
+    std::vector<LogSite*> sites_; // the ones that suppressed a message ever
+};
+
+// The token bucket of one log call site, as a generic cell rate algorithm: a single atomic time point
+// the bucket is full again at, so a message that passes costs a clock read and a compare-exchange.
+// Constant initialized, so a static one per call site has no initialization guard.
+class LogSite final {
+public:
+    using Clock = LogFloodGuard::Clock;
+
+public:
+    constexpr LogSite(const char* file, int line) noexcept
+        : file_(file)
+        , line_(line)
+    {
+    }
+    DISALLOW_COPY_MOVE(LogSite);
+    ~LogSite() = default;
+
+public:
+    // Inline, as the unlimited case must stay a single relaxed load
+    [[nodiscard]] bool TryAcquire(LogFloodGuard& guard);
+    // False if the message is suppressed; it is counted then
+    [[nodiscard]] bool TryAcquire(LogFloodGuard& guard, Clock::time_point now);
+
+    [[nodiscard]] uint64_t GetSuppressedCount() const;
+    [[nodiscard]] const char* GetFile() const;
+    [[nodiscard]] int GetLine() const;
+
+private:
+    friend class LogFloodGuard;
+
+    const char* const file_;
+    const int line_;
+    std::atomic<Clock::rep> fullAt_ = 0; // the "theoretical arrival time": the bucket is full from then on
+    std::atomic<uint64_t> suppressedCount_ = 0; // since the last report
+    std::atomic<bool> isRegistered_ = false;
+};
+}
+
+inline ed::LogFloodGuard& ed::LogFloodGuard::GetInstance()
+{
+    static LogFloodGuard instance;
+    return instance;
+}
+
+inline bool ed::LogSite::TryAcquire(LogFloodGuard& guard)
+{
+    return guard.interval_.load(std::memory_order_relaxed) == 0 || TryAcquire(guard, Clock::now());
+}
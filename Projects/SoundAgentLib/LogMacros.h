@@ -0,0 +1,51 @@
+#pragma once
+
+#include "BinaryLog.h"
+#include "LogFloodGuard.h"
+
+#include <spdlog/spdlog.h>
+
+// Logging with the default spdlog logger, gated by the level: the arguments, e.g. the string conversions,
+// are evaluated only if the level is enabled at run time, and a level below SPDLOG_ACTIVE_LEVEL
+// (a preprocessor definition, info by default) is compiled out altogether.
+// Each call site is rate limited by the LogFloodGuard, if it has a limit set, and writes to the BinaryLog
+// instead of spdlog while that is enabled; the format must be a string literal then, and the line reaches none
+// of the spdlog sinks, e.g. neither the text log file nor the LogRing of the log shipping.
+#define ED_LOG(level, ...) \
+    do { if (spdlog::should_log(level)) { \
+        static constinit ed::LogSite edLogSite(__FILE__, __LINE__); \
+        if (edLogSite.TryAcquire(ed::LogFloodGuard::GetInstance())) { \
+            if (auto& edBinaryLog = ed::BinaryLog::GetInstance(); edBinaryLog.IsEnabled()) { edBinaryLog.Write(level, edLogSite, __VA_ARGS__); } \
+            else { spdlog::log(level, __VA_ARGS__); } \
+        } \
+    } } while (false)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define ED_LOG_TRACE(...) ED_LOG(spdlog::level::trace, __VA_ARGS__)
+#else
+#define ED_LOG_TRACE(...) static_cast<void>(0)
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define ED_LOG_DEBUG(...) ED_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+#define ED_LOG_DEBUG(...) static_cast<void>(0)
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define ED_LOG_INFO(...) ED_LOG(spdlog::level::info, __VA_ARGS__)
+#else
+#define ED_LOG_INFO(...) static_cast<void>(0)
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define ED_LOG_WARN(...) ED_LOG(spdlog::level::warn, __VA_ARGS__)
+#else
+#define ED_LOG_WARN(...) static_cast<void>(0)
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define ED_LOG_ERROR(...) ED_LOG(spdlog::level::err, __VA_ARGS__)
+#else
+#define ED_LOG_ERROR(...) static_cast<void>(0)
+#endif
@@ -0,0 +1,200 @@
+#include "os-dependencies.h"
+
+#include "LogRing.h"
+#include "TimestampFormatter.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+
+#include <fmt/format.h>
+#include <spdlog/details/log_msg.h>
+
+
+namespace
+{
+    // The state of a record in the two lowest bits of its stamp, the position of its latest writer above
+    enum RecordState : uint64_t
+    {
+        Empty = 0,
+        Writing = 1, // by the writer of the position
+        Ready = 2,
+        Reading = 3 // part of an acquired chunk
+    };
+
+    constexpr uint64_t MakeStamp(uint64_t position, RecordState state)
+    {
+        return position << 2 | state;
+    }
+
+    constexpr uint64_t GetPosition(uint64_t stamp)
+    {
+        return stamp >> 2;
+    }
+
+    constexpr RecordState GetState(uint64_t stamp)
+    {
+        return static_cast<RecordState>(stamp & 3);
+    }
+
+    void StoreMax(std::atomic<uint64_t>& value, uint64_t candidate)
+    {
+        auto current = value.load(std::memory_order_relaxed);
+        while (current < candidate && !value.compare_exchange_weak(current, candidate, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+std::string_view ed::LogRing::Record::GetText() const
+{
+    return {text_, size_};
+}
+
+ed::LogRing::LogRing(size_t capacity)
+    : capacity_(std::bit_ceil(std::max<size_t>(capacity, 1)))
+    , records_(std::make_unique<Record[]>(capacity_))
+{
+}
+
+bool ed::LogRing::Write(std::string_view text)
+{
+    const auto position = head_.fetch_add(1, std::memory_order_relaxed);
+    auto& record = records_[position & (capacity_ - 1)];
+    auto stamp = record.stamp_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (GetPosition(stamp) > position)
+        {
+            // lapped by a faster writer: the reader skips the position
+            droppedCount_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (const auto state = GetState(stamp); state == Writing || state == Reading)
+        {
+            // a slow writer of a previous round or the reader: tell the reader not to wait for this position
+            StoreMax(record.skippedPosition_, position + 1);
+            droppedCount_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (record.stamp_.compare_exchange_weak(stamp, MakeStamp(position, Writing), std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    if (GetState(stamp) == Ready)
+    {
+        droppedCount_.fetch_add(1, std::memory_order_relaxed); // the oldest, overwritten before it was read
+    }
+
+    auto size = std::min(text.size(), MAX_TEXT_SIZE);
+    // A cut line ends before a UTF-8 sequence, not inside it
+    while (size < text.size() && size > 0 && (static_cast<uint8_t>(text[size]) & 0xC0) == 0x80)
+    {
+        --size;
+    }
+    std::memcpy(record.text_, text.data(), size);
+    record.size_ = static_cast<uint32_t>(size);
+    record.stamp_.store(MakeStamp(position, Ready), std::memory_order_release);
+    return true;
+}
+
+std::span<const ed::LogRing::Record> ed::LogRing::AcquireChunk(size_t maxRecords)
+{
+    const auto head = head_.load(std::memory_order_relaxed);
+    // Older positions are overwritten or will be
+    tail_ = std::max(tail_, head > capacity_ ? head - capacity_ : 0);
+
+    // Skip the positions that will never be written
+    for (; tail_ < head; ++tail_)
+    {
+        auto& record = records_[tail_ & (capacity_ - 1)];
+        auto stamp = record.stamp_.load(std::memory_order_acquire);
+        if (GetPosition(stamp) == tail_ && GetState(stamp) == Ready)
+        {
+            break;
+        }
+        // Wait for a writer to finish even if it is a previous round's one: its line is counted as dropped below
+        if (GetPosition(stamp) <= tail_
+            && (GetState(stamp) == Writing || record.skippedPosition_.load(std::memory_order_acquire) <= tail_))
+        {
+            return {}; // still being written
+        }
+        // A line of a previous round its writer finished after the reader had passed it: never read
+        if (GetState(stamp) == Ready && GetPosition(stamp) < tail_
+            && record.stamp_.compare_exchange_strong(stamp, MakeStamp(GetPosition(stamp), Empty), std::memory_order_relaxed))
+        {
+            droppedCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    const auto first = tail_ & (capacity_ - 1);
+    const auto available = std::min({maxRecords, static_cast<size_t>(head - tail_), capacity_ - first});
+    size_t count = 0;
+    for (; count < available; ++count)
+    {
+        auto expected = MakeStamp(tail_ + count, Ready);
+        if (!records_[first + count].stamp_.compare_exchange_strong(expected, MakeStamp(tail_ + count, Reading), std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+    return {records_.get() + first, count};
+}
+
+void ed::LogRing::ReleaseChunk(std::span<const Record> chunk)
+{
+    const auto first = static_cast<size_t>(chunk.data() - records_.get());
+    for (size_t index = first; index < first + chunk.size(); ++index)
+    {
+        auto& stamp = records_[index].stamp_;
+        stamp.store(MakeStamp(GetPosition(stamp.load(std::memory_order_relaxed)), Empty), std::memory_order_release);
+    }
+    tail_ += chunk.size();
+}
+
+size_t ed::LogRing::GetCapacity() const
+{
+    return capacity_;
+}
+
+uint64_t ed::LogRing::GetDroppedCount() const
+{
+    return droppedCount_.load(std::memory_order_relaxed);
+}
+
+ed::LogRingSink::LogRingSink(LogRing& ring)
+    : ring_(ring)
+{
+}
+
+void ed::LogRingSink::log(const spdlog::details::log_msg& message)
+{
+    if (!should_log(message.level))
+    {
+        return;
+    }
+    thread_local TimestampFormatter formatter(TimestampFormatter::Zone::Utc, false, false);
+    TimestampFormatter::Buffer timeBuffer;
+    const auto time = formatter.Format(message.time, timeBuffer);
+    const auto levelName = spdlog::level::to_string_view(message.level);
+    char line[LogRing::MAX_TEXT_SIZE + 4]; // room for a character more, to cut a long line at a character
+    const auto result = fmt::format_to_n(line, std::size(line), "[{}] [{}] {}",
+                                         fmt::string_view(time.data(), time.size()), fmt::string_view(levelName.data(), levelName.size()),
+                                         fmt::string_view(message.payload.data(), message.payload.size()));
+    ring_.Write(std::string_view(line, static_cast<size_t>(result.out - line)));
+}
+
+void ed::LogRingSink::flush()
+{
+}
+
+void ed::LogRingSink::set_pattern(const std::string&)
+{
+}
+
+void ed::LogRingSink::set_formatter(std::unique_ptr<spdlog::formatter>)
+{
+}
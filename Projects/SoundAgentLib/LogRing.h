@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include <spdlog/sinks/sink.h>
+
+
+namespace ed {
+// In-memory log of the latest formatted UTF-8 lines, a fixed number of fixed size records: any thread writes
+// without locking, one reader drains. A full ring overwrites the oldest unread lines; a line that would
+// overwrite one the reader holds, or that a faster writer lapped, is dropped. Both are counted.
+// The reader gets the lines in chunks without copying: the records of a chunk stay untouched until released.
+class LogRing final {
+public:
+    static constexpr size_t RECORD_SIZE = 256;
+
+    class Record final {
+    public:
+        Record() = default;
+        DISALLOW_COPY_MOVE(Record);
+        ~Record() = default;
+
+    public:
+        [[nodiscard]] std::string_view GetText() const;
+
+    private:
+        friend class LogRing;
+
+        std::atomic<uint64_t> stamp_ = 0; // position << 2 | state
+        std::atomic<uint64_t> skippedPosition_ = 0; // the latest position whose writer gave up on this record, plus one
+        uint32_t size_ = 0;
+        char text_[RECORD_SIZE - 2 * sizeof(std::atomic<uint64_t>) - sizeof(uint32_t)]{};
+    };
+
+    static constexpr size_t MAX_TEXT_SIZE = sizeof(Record::text_);
+
+public:
+    // The capacity is rounded up to a power of two
+    explicit LogRing(size_t capacity);
+    DISALLOW_COPY_MOVE(LogRing);
+    ~LogRing() = default;
+
+public:
+    // Longer lines are cut at MAX_TEXT_SIZE bytes; false if the line is dropped
+    bool Write(std::string_view text);
+
+    // Reader only: the next unread lines in order, at most maxRecords; empty if there are none. Each chunk
+    // must be released before the next one is acquired
+    [[nodiscard]] std::span<const Record> AcquireChunk(size_t maxRecords = SIZE_MAX);
+    void ReleaseChunk(std::span<const Record> chunk);
+
+    [[nodiscard]] size_t GetCapacity() const;
+    // Lines overwritten before they were read, and lines never written
+    [[nodiscard]] uint64_t GetDroppedCount() const;
+
+private:
+    const size_t capacity_;
+    const std::unique_ptr<Record[]> records_;
+    alignas(64) std::atomic<uint64_t> head_ = 0; // the next position to write
+    alignas(64) uint64_t tail_ = 0; // the next position to read; the reader's only
+    std::atomic<uint64_t> droppedCount_ = 0;
+};
+
+// Writes the lines of a logger into a LogRing, "[time] [level] message" without a line end
+class LogRingSink final : public spdlog::sinks::sink {
+public:
+    explicit LogRingSink(LogRing& ring);
+    DISALLOW_COPY_MOVE(LogRingSink);
+    ~LogRingSink() override = default;
+
+public:
+    void log(const spdlog::details::log_msg& message) override;
+    void flush() override;
+    // The format is fixed
+    void set_pattern(const std::string& pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override;
+
+private:
+    LogRing& ring_;
+};
+}
@@ -0,0 +1,309 @@
+#include "os-dependencies.h"
+
+#include "LogShipper.h"
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+#include <Poco/DeflatingStream.h>
+#include <spdlog/spdlog.h>
+
+
+namespace
+{
+    std::string Compress(const std::string& text)
+    {
+        std::ostringstream compressed;
+        {
+            Poco::DeflatingOutputStream deflater(compressed, Poco::DeflatingStreamBuf::STREAM_GZIP);
+            deflater << text;
+            deflater.close();
+        }
+        return std::move(compressed).str();
+    }
+
+    // A batch bigger than a second's budget waits until it is covered
+    double GetBandwidthCapacity(const ed::LogShippingSettings& settings)
+    {
+        return std::max(settings.bytesPerSecond, static_cast<double>(settings.maxBatchBytes));
+    }
+}
+
+LogShipper::LogShipper(ed::LogRing& ring, HttpRequestDispatcherInterface& targetDispatcher, const ed::LogShippingSettings& settings,
+                       std::string hostName, std::function<bool()> isTransportAvailable, const ed::ClockInterface& clock)
+    : ring_(ring)
+    , targetDispatcher_(targetDispatcher)
+    , settings_(settings)
+    , hostName_(std::move(hostName))
+    , isTransportAvailable_(std::move(isTransportAvailable))
+    , clock_(clock)
+    , bandwidth_(settings.bytesPerSecond > 0.0
+                     ? std::optional<ed::TokenBucket>(std::in_place, settings.bytesPerSecond, GetBandwidthCapacity(settings), clock.SteadyNow())
+                     : std::nullopt)
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+}
+
+LogShipper::~LogShipper()
+{
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+    Drain();
+    if (lineCount_ > 0)
+    {
+        CloseBatch();
+    }
+    Send();
+    if (pending_.has_value())
+    {
+        Spool(*pending_);
+        pending_.reset();
+    }
+}
+
+uint64_t LogShipper::GetShippedBatchCount() const
+{
+    return shippedBatchCount_.load();
+}
+
+uint64_t LogShipper::GetShippedLineCount() const
+{
+    return shippedLineCount_.load();
+}
+
+uint64_t LogShipper::GetShippedBytes() const
+{
+    return shippedBytes_.load();
+}
+
+uint64_t LogShipper::GetDroppedBatchCount() const
+{
+    return droppedBatchCount_.load();
+}
+
+void LogShipper::Run(const std::stop_token& stopToken)
+{
+    LoadSpool();
+    std::unique_lock lock(mutex_);
+    while (!stopToken.stop_requested())
+    {
+        clock_.WaitUntil(condition_, lock, stopToken, clock_.SteadyNow() + DRAIN_INTERVAL, [] { return false; });
+        Drain();
+        if (lineCount_ > 0 && clock_.SteadyNow() - batchStart_ >= settings_.maxBatchDelay)
+        {
+            CloseBatch();
+        }
+        Send();
+    }
+}
+
+void LogShipper::Drain()
+{
+    for (auto chunk = ring_.AcquireChunk(DRAIN_CHUNK_SIZE); !chunk.empty(); chunk = ring_.AcquireChunk(DRAIN_CHUNK_SIZE))
+    {
+        if (lineCount_ == 0)
+        {
+            batchStart_ = clock_.SteadyNow();
+        }
+        for (const auto& record : chunk)
+        {
+            lines_.append(record.GetText()).push_back('\n');
+        }
+        lineCount_ += chunk.size();
+        ring_.ReleaseChunk(chunk);
+
+        if (lines_.size() >= settings_.maxBatchBytes)
+        {
+            CloseBatch();
+        }
+    }
+}
+
+void LogShipper::CloseBatch()
+{
+    Batch batch{.payload = Compress(lines_), .lineCount = lineCount_};
+    lines_.clear();
+    lineCount_ = 0;
+
+    // The previous one, if still unsent: to the spool, behind the batches spooled before
+    Send();
+    if (pending_.has_value())
+    {
+        Spool(*pending_);
+        pending_.reset();
+    }
+    if (spoolFiles_.empty())
+    {
+        pending_ = std::move(batch);
+    }
+    else
+    {
+        Spool(batch);
+    }
+}
+
+void LogShipper::Send()
+{
+    for (;;)
+    {
+        const bool isSpooled = !spoolFiles_.empty();
+        if (!isSpooled && !pending_.has_value())
+        {
+            return;
+        }
+        if (isTransportAvailable_ && !isTransportAvailable_())
+        {
+            return;
+        }
+
+        std::string spooledPayload;
+        if (isSpooled)
+        {
+            std::ifstream file(spoolFiles_.front(), std::ios::binary);
+            spooledPayload.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            if (!file.eof() && !file)
+            {
+                spdlog::warn(R"(Spooled log batch "{}" can not be read; dropped.)", spoolFiles_.front().string());
+                std::error_code errorCode;
+                std::filesystem::remove(spoolFiles_.front(), errorCode);
+                spoolFiles_.pop_front();
+                ++droppedBatchCount_;
+                continue;
+            }
+        }
+        const auto& payload = isSpooled ? spooledPayload : pending_->payload;
+        if (bandwidth_.has_value()
+            && !bandwidth_->TryConsume(clock_.SteadyNow(), std::min(static_cast<double>(payload.size()), GetBandwidthCapacity(settings_))))
+        {
+            return;
+        }
+        if (!TrySend(payload, isSpooled ? "Spooled log batch" : std::format("Log batch of {} line(s)", pending_->lineCount)))
+        {
+            return;
+        }
+
+        ++shippedBatchCount_;
+        shippedBytes_ += payload.size();
+        if (isSpooled)
+        {
+            spoolBytes_ -= std::min<uintmax_t>(spoolBytes_, payload.size());
+            std::error_code errorCode;
+            std::filesystem::remove(spoolFiles_.front(), errorCode);
+            spoolFiles_.pop_front();
+        }
+        else
+        {
+            shippedLineCount_ += pending_->lineCount;
+            pending_.reset();
+        }
+    }
+}
+
+bool LogShipper::TrySend(const std::string& payload, const std::string& hint)
+{
+    try
+    {
+        targetDispatcher_.EnqueueRequest(false, clock_.SystemNow(), LOG_BATCH_URL_SUFFIX, payload,
+                                         {{"Content-Type", "text/plain; charset=utf-8"}, {"Content-Encoding", "gzip"},
+                                          {HOST_NAME_HEADER_KEY, hostName_}},
+                                         hint);
+    }
+    catch (const std::exception& ex)
+    {
+        // Once per outage: the warning is a log line to ship as well
+        if (!isFailing_)
+        {
+            spdlog::warn("Log batches can not be shipped, spooled meanwhile: {}.", ex.what());
+            isFailing_ = true;
+        }
+        return false;
+    }
+    if (isFailing_)
+    {
+        spdlog::info("Log shipping resumed.");
+        isFailing_ = false;
+    }
+    return true;
+}
+
+void LogShipper::Spool(const Batch& batch)
+{
+    if (settings_.spoolDirectory.empty() || batch.payload.size() > settings_.maxSpoolBytes)
+    {
+        ++droppedBatchCount_;
+        return;
+    }
+    // Full: the oldest batches make room
+    while (!spoolFiles_.empty() && spoolBytes_ + batch.payload.size() > settings_.maxSpoolBytes)
+    {
+        std::error_code errorCode;
+        const auto size = std::filesystem::file_size(spoolFiles_.front(), errorCode);
+        spoolBytes_ -= errorCode ? uintmax_t{0} : std::min(spoolBytes_, size);
+        std::filesystem::remove(spoolFiles_.front(), errorCode);
+        spoolFiles_.pop_front();
+        ++droppedBatchCount_;
+    }
+
+    auto pathName = settings_.spoolDirectory / std::format("{:020}{}", nextSpoolNumber_++, SPOOL_FILE_EXTENSION);
+    std::ofstream file(pathName, std::ios::binary | std::ios::trunc);
+    file.write(batch.payload.data(), static_cast<std::streamsize>(batch.payload.size()));
+    file.close();
+    if (!file)
+    {
+        spdlog::warn(R"(Log batch can not be spooled to "{}"; dropped.)", pathName.string());
+        std::error_code errorCode;
+        std::filesystem::remove(pathName, errorCode);
+        ++droppedBatchCount_;
+        return;
+    }
+    spoolFiles_.push_back(std::move(pathName));
+    spoolBytes_ += batch.payload.size();
+}
+
+void LogShipper::LoadSpool()
+{
+    if (settings_.spoolDirectory.empty())
+    {
+        return;
+    }
+    std::error_code errorCode;
+    std::filesystem::create_directories(settings_.spoolDirectory, errorCode);
+    if (errorCode)
+    {
+        spdlog::warn(R"(Log spool directory "{}" can not be created: {}.)", settings_.spoolDirectory.string(), errorCode.message());
+        return;
+    }
+
+    // Left by a previous run; the numbered names give the order
+    std::vector<std::pair<uint64_t, std::filesystem::path>> files;
+    for (const auto& entry : std::filesystem::directory_iterator(settings_.spoolDirectory, errorCode))
+    {
+        const auto fileName = entry.path().filename().string();
+        uint64_t number = 0;
+        if (entry.is_regular_file(errorCode) && fileName.ends_with(SPOOL_FILE_EXTENSION)
+            && std::from_chars(fileName.data(), fileName.data() + fileName.size(), number).ec == std::errc{})
+        {
+            files.emplace_back(number, entry.path());
+            spoolBytes_ += entry.file_size(errorCode);
+        }
+    }
+    std::ranges::sort(files);
+    for (auto& [number, pathName] : files)
+    {
+        spoolFiles_.push_back(std::move(pathName));
+        nextSpoolNumber_ = number + 1;
+    }
+    if (!spoolFiles_.empty())
+    {
+        spdlog::info("{} spooled log batch(es) of {} bytes to ship.", spoolFiles_.size(), spoolBytes_);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "Clock.h"
+#include "LogRing.h"
+#include "RateLimiter.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+
+namespace ed {
+struct LogShippingSettings
+{
+    // Of the text lines in a batch, before compression
+    size_t maxBatchBytes = 256 * 1024;
+    // A batch is closed at the latest this long after its first line
+    std::chrono::milliseconds maxBatchDelay{10000};
+    // Compressed bytes sent per second on average, 0: unlimited. A batch waits until the budget covers it
+    double bytesPerSecond = 8 * 1024;
+    // Batches the transport does not take are kept here, also across restarts; empty: they are dropped
+    std::filesystem::path spoolDirectory;
+    uintmax_t maxSpoolBytes = 64 * 1024 * 1024;
+};
+}
+
+// Remote log shipping: drains the lines of a LogRing, collects them into batches closed by size or age and
+// sends every batch gzip compressed as one PUT request to the target dispatcher, e.g. the background queue of
+// the rate limiter, within a bandwidth budget. A batch still unsent when the next one closes, as the transport is
+// unavailable, the target throws or the budget is used up, goes to a local spool; the spooled batches are
+// sent first, oldest first. On destruction the lines still in the ring are shipped or spooled.
+class LogShipper final
+{
+public:
+    // isTransportAvailable: checked before every batch; none: the transport is taken as available until it throws
+    LogShipper(ed::LogRing& ring, HttpRequestDispatcherInterface& targetDispatcher, const ed::LogShippingSettings& settings,
+               std::string hostName, std::function<bool()> isTransportAvailable = {},
+               const ed::ClockInterface& clock = ed::SystemClock::GetInstance());
+
+    DISALLOW_COPY_MOVE(LogShipper);
+    ~LogShipper();
+
+public:
+    [[nodiscard]] uint64_t GetShippedBatchCount() const;
+    // Of the batches not spooled before; the spool files keep no line count
+    [[nodiscard]] uint64_t GetShippedLineCount() const;
+    [[nodiscard]] uint64_t GetShippedBytes() const;
+    // Batches dropped because the spool was full or there is none
+    [[nodiscard]] uint64_t GetDroppedBatchCount() const;
+
+    static constexpr auto LOG_BATCH_URL_SUFFIX = "/logs/batch";
+    static constexpr auto HOST_NAME_HEADER_KEY = "X-Host-Name";
+    static constexpr auto SPOOL_FILE_EXTENSION = ".log.gz";
+
+private:
+    struct Batch
+    {
+        std::string payload; // compressed
+        size_t lineCount = 0;
+    };
+
+    void Run(const std::stop_token& stopToken);
+    void Drain();
+    void CloseBatch();
+    void Send();
+    // false if the target threw
+    bool TrySend(const std::string& payload, const std::string& hint);
+    void Spool(const Batch& batch);
+    void LoadSpool();
+
+private:
+    static constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(100);
+    // Records leased from the ring at a time, so that the writers rarely meet a leased one
+    static constexpr size_t DRAIN_CHUNK_SIZE = 64;
+
+    ed::LogRing& ring_;
+    HttpRequestDispatcherInterface& targetDispatcher_;
+    const ed::LogShippingSettings settings_;
+    const std::string hostName_;
+    const std::function<bool()> isTransportAvailable_;
+    const ed::ClockInterface& clock_;
+
+    // The worker's, or the destructor's after the worker stopped
+    std::string lines_;
+    size_t lineCount_ = 0;
+    std::chrono::steady_clock::time_point batchStart_;
+    std::optional<Batch> pending_; // closed, not sent yet, not spooled
+    std::deque<std::filesystem::path> spoolFiles_; // oldest first
+    uintmax_t spoolBytes_ = 0;
+    uint64_t nextSpoolNumber_ = 0;
+    std::optional<ed::TokenBucket> bandwidth_;
+    bool isFailing_ = false; // the target threw on the latest batch
+
+    std::atomic<uint64_t> shippedBatchCount_ = 0;
+    std::atomic<uint64_t> shippedLineCount_ = 0;
+    std::atomic<uint64_t> shippedBytes_ = 0;
+    std::atomic<uint64_t> droppedBatchCount_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable_any condition_;
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
@@ -0,0 +1,85 @@
+#include "os-dependencies.h"
+
+#include "MetricsHttpServer.h"
+
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPRequestHandlerFactory.h>
+#include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/HTTPServerParams.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/SocketAddress.h>
+
+#include <spdlog/spdlog.h>
+
+
+namespace
+{
+    class MetricsRequestHandler final : public Poco::Net::HTTPRequestHandler
+    {
+    public:
+        explicit MetricsRequestHandler(const ed::MetricsRegistry& registry)
+            : registry_(registry)
+        {
+        }
+
+        void handleRequest(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response) override
+        {
+            if (request.getMethod() != Poco::Net::HTTPRequest::HTTP_GET
+                || request.getURI().substr(0, request.getURI().find('?')) != MetricsHttpServer::METRICS_PATH)
+            {
+                response.setStatusAndReason(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+                response.setContentLength(0);
+                response.send();
+                return;
+            }
+            const auto text = registry_.Render();
+            response.setStatusAndReason(Poco::Net::HTTPResponse::HTTP_OK);
+            response.setContentType(ed::MetricsRegistry::CONTENT_TYPE);
+            response.sendBuffer(text.data(), text.size());
+        }
+
+    private:
+        const ed::MetricsRegistry& registry_;
+    };
+
+    class MetricsRequestHandlerFactory final : public Poco::Net::HTTPRequestHandlerFactory
+    {
+    public:
+        explicit MetricsRequestHandlerFactory(const ed::MetricsRegistry& registry)
+            : registry_(registry)
+        {
+        }
+
+        Poco::Net::HTTPRequestHandler* createRequestHandler(const Poco::Net::HTTPServerRequest&) override
+        {
+            return new MetricsRequestHandler(registry_); // NOLINT(cppcoreguidelines-owning-memory): deleted by the server
+        }
+
+    private:
+        const ed::MetricsRegistry& registry_;
+    };
+}
+
+MetricsHttpServer::MetricsHttpServer(const ed::MetricsRegistry& registry, uint16_t port)
+{
+    auto* params = new Poco::Net::HTTPServerParams; // NOLINT(cppcoreguidelines-owning-memory): reference counted
+    params->setMaxThreads(1);
+    params->setMaxQueued(16);
+    server_ = std::make_unique<Poco::Net::HTTPServer>(new MetricsRequestHandlerFactory(registry), // NOLINT(cppcoreguidelines-owning-memory)
+                                                      Poco::Net::ServerSocket(Poco::Net::SocketAddress("127.0.0.1", port)),
+                                                      params);
+    server_->start();
+    spdlog::info("Metrics served on http://127.0.0.1:{}{}.", GetPort(), METRICS_PATH);
+}
+
+MetricsHttpServer::~MetricsHttpServer()
+{
+    server_->stopAll(true);
+}
+
+uint16_t MetricsHttpServer::GetPort() const
+{
+    return server_->port();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "MetricsRegistry.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace Poco::Net
+{
+    class HTTPServer;
+}
+
+// Serves the metrics of the registry for scraping: GET /metrics on the loopback interface only,
+// so the endpoint is not reachable from the network. One request is handled at a time.
+class MetricsHttpServer final
+{
+public:
+    // Port 0: any free port, see GetPort
+    MetricsHttpServer(const ed::MetricsRegistry& registry, uint16_t port);
+
+    DISALLOW_COPY_MOVE(MetricsHttpServer);
+    ~MetricsHttpServer();
+
+public:
+    [[nodiscard]] uint16_t GetPort() const;
+
+    static constexpr auto METRICS_PATH = "/metrics";
+
+private:
+    std::unique_ptr<Poco::Net::HTTPServer> server_;
+};
@@ -0,0 +1,119 @@
+#include "os-dependencies.h"
+
+#include "MetricsRegistry.h"
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <stdexcept>
+
+
+namespace
+{
+    std::string EscapeLabelValue(const std::string& value)
+    {
+        std::string escaped;
+        escaped.reserve(value.size());
+        for (const auto character : value)
+        {
+            switch (character)
+            {
+            case '\\':
+                escaped += R"(\\)";
+                break;
+            case '"':
+                escaped += R"(\")";
+                break;
+            case '\n':
+                escaped += R"(\n)";
+                break;
+            default:
+                escaped += character;
+            }
+        }
+        return escaped;
+    }
+
+    // {a="1",b="2"}; empty without labels
+    std::string FormatLabels(const ed::MetricsRegistry::Labels& labels, const std::string& quantile = "")
+    {
+        std::string formatted;
+        for (const auto& [name, value] : labels)
+        {
+            formatted += std::format(R"({}{}="{}")", formatted.empty() ? "" : ",", name, EscapeLabelValue(value));
+        }
+        if (!quantile.empty())
+        {
+            formatted += std::format(R"({}quantile="{}")", formatted.empty() ? "" : ",", quantile);
+        }
+        return formatted.empty() ? formatted : "{" + formatted + "}";
+    }
+
+    std::string FormatSeconds(std::chrono::microseconds duration)
+    {
+        return std::format("{:.6f}", static_cast<double>(duration.count()) / 1e6);
+    }
+}
+
+void ed::MetricsRegistry::AddCounter(const std::string& name, const std::string& help, Labels labels, std::function<double()> sample)
+{
+    Add(name, help, Type::Counter, {std::move(labels), std::move(sample), nullptr});
+}
+
+void ed::MetricsRegistry::AddGauge(const std::string& name, const std::string& help, Labels labels, std::function<double()> sample)
+{
+    Add(name, help, Type::Gauge, {std::move(labels), std::move(sample), nullptr});
+}
+
+void ed::MetricsRegistry::AddSummary(const std::string& name, const std::string& help, Labels labels,
+                                     std::function<LatencyHistogram::Snapshot()> sample)
+{
+    Add(name, help, Type::Summary, {std::move(labels), nullptr, std::move(sample)});
+}
+
+void ed::MetricsRegistry::Add(const std::string& name, const std::string& help, Type type, Series series)
+{
+    std::lock_guard lock(mutex_);
+    auto family = std::ranges::find(families_, name, &Family::name);
+    if (family == families_.end())
+    {
+        families_.push_back({name, help, type, {}});
+        family = std::prev(families_.end());
+    }
+    else if (family->type != type)
+    {
+        throw std::invalid_argument(std::format(R"(Metric "{}" is registered with another type)", name));
+    }
+    family->series.push_back(std::move(series));
+}
+
+std::string ed::MetricsRegistry::Render() const
+{
+    static constexpr std::array TYPE_NAMES = {"counter", "gauge", "summary"};
+    static constexpr std::array<std::pair<double, const char*>, 4> QUANTILES = {{{50.0, "0.5"}, {90.0, "0.9"}, {99.0, "0.99"}, {99.9, "0.999"}}};
+
+    std::lock_guard lock(mutex_);
+    std::string text;
+    for (const auto& family : families_)
+    {
+        text += std::format("# HELP {} {}\n# TYPE {} {}\n", family.name, family.help, family.name,
+                            TYPE_NAMES[static_cast<size_t>(family.type)]);
+        for (const auto& series : family.series)
+        {
+            if (family.type != Type::Summary)
+            {
+                text += std::format("{}{} {}\n", family.name, FormatLabels(series.labels), series.sample());
+                continue;
+            }
+            const auto snapshot = series.sampleSummary();
+            for (const auto& [percentile, quantile] : QUANTILES)
+            {
+                text += std::format("{}{} {}\n", family.name, FormatLabels(series.labels, quantile),
+                                    FormatSeconds(snapshot.GetPercentile(percentile)));
+            }
+            text += std::format("{}_sum{} {}\n", family.name, FormatLabels(series.labels), FormatSeconds(snapshot.GetSum()));
+            text += std::format("{}_count{} {}\n", family.name, FormatLabels(series.labels), snapshot.GetCount());
+        }
+    }
+    return text;
+}
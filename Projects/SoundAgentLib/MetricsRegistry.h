@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include "LatencyHistogram.h"
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace ed {
+// Metrics rendered in the Prometheus text exposition format. The values are sampled by the registered
+// functions on rendering only, so a metric costs nothing between two scrapes beyond what its source counts anyway.
+// Thread safe; the sample functions are called by the rendering thread.
+class MetricsRegistry final {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+public:
+    MetricsRegistry() = default;
+    DISALLOW_COPY_MOVE(MetricsRegistry);
+    ~MetricsRegistry() = default;
+
+public:
+    // Series of the same name share the help text of the first one and must have the same type
+    void AddCounter(const std::string& name, const std::string& help, Labels labels, std::function<double()> sample);
+    void AddGauge(const std::string& name, const std::string& help, Labels labels, std::function<double()> sample);
+    // A latency histogram as a summary in seconds: the 0.5, 0.9, 0.99 and 0.999 quantiles, sum and count
+    void AddSummary(const std::string& name, const std::string& help, Labels labels,
+                    std::function<LatencyHistogram::Snapshot()> sample);
+
+    [[nodiscard]] std::string Render() const;
+
+    static constexpr auto CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+private:
+    enum class Type : uint8_t
+    {
+        Counter = 0,
+        Gauge,
+        Summary
+    };
+
+    struct Series
+    {
+        Labels labels;
+        std::function<double()> sample;
+        std::function<LatencyHistogram::Snapshot()> sampleSummary;
+    };
+
+    struct Family
+    {
+        std::string name;
+        std::string help;
+        Type type;
+        std::vector<Series> series;
+    };
+
+    void Add(const std::string& name, const std::string& help, Type type, Series series);
+
+    mutable std::mutex mutex_;
+    std::vector<Family> families_; // in registration order
+};
+}
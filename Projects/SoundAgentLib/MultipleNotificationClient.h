@@ -21,7 +21,17 @@ private:
 
 public:
     MultipleNotificationClient()
+        : MultipleNotificationClient(true)
     {
+    }
+
+    // Without the device enumerator nothing notifies, e.g. if the endpoints are fakes
+    explicit MultipleNotificationClient(bool withEnumerator)
+    {
+        if (!withEnumerator)
+        {
+            return;
+        }
         const auto hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumerator_));
         assert(SUCCEEDED(hr));
 
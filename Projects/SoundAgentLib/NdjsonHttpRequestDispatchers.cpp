@@ -0,0 +1,218 @@
+#include "os-dependencies.h"
+
+#include "NdjsonHttpRequestDispatchers.h"
+
+#include "ApiClient/common/TimeUtil.h"
+
+#include <algorithm>
+#include <format>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+
+namespace
+{
+    HANDLE OpenForAppend(const std::filesystem::path& pathName)
+    {
+        const auto file = CreateFileW(pathName.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr,
+                                      OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error(std::format(R"(NDJSON file "{}" can not be opened, error {})", pathName.string(), GetLastError()));
+        }
+        return file;
+    }
+
+    std::string CreateReservedBuffer(size_t capacity)
+    {
+        std::string buffer;
+        buffer.reserve(capacity);
+        return buffer;
+    }
+}
+
+std::string ed::FormatRequestAsNdjsonLine(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                          const std::string& urlSuffix, const std::string& payload,
+                                          const std::unordered_map<std::string, std::string>& header,
+                                          const std::string& hint)
+{
+    nlohmann::json payloadValue;
+    if (nlohmann::json::accept(payload))
+    {
+        payloadValue = nlohmann::json::parse(payload);
+    }
+    else
+    {
+        payloadValue = nlohmann::json::binary(std::vector<uint8_t>(payload.begin(), payload.end()));
+    }
+
+    const nlohmann::json line = {
+        {"time", TimePointToStringAsUtc(time, true, true)},
+        {"method", postOrPut ? "POST" : "PUT"},
+        {"urlSuffix", urlSuffix},
+        {"hint", hint},
+        {"header", header},
+        {"payload", payloadValue}
+    };
+    return line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + '\n';
+}
+
+NdjsonFileHttpRequestDispatcher::NdjsonFileHttpRequestDispatcher(std::filesystem::path pathName,
+                                                                 std::chrono::milliseconds syncInterval,
+                                                                 size_t chunkSize)
+    : pathName_(std::move(pathName))
+    , syncInterval_(syncInterval)
+    , chunkSize_(chunkSize)
+    , file_(OpenForAppend(pathName_))
+    , buffer_(CreateReservedBuffer(chunkSize_ * 2))
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+}
+
+NdjsonFileHttpRequestDispatcher::~NdjsonFileHttpRequestDispatcher()
+{
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+    CloseHandle(file_);
+}
+
+void NdjsonFileHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                     const std::string& urlSuffix, const std::string& payload,
+                                                     const std::unordered_map<std::string, std::string>& header,
+                                                     const std::string& hint)
+{
+    const auto line = ed::FormatRequestAsNdjsonLine(postOrPut, time, urlSuffix, payload, header, hint);
+    auto onDelivered = ed::DeliveryReport::Take();
+    bool accepted;
+    bool chunkComplete;
+    {
+        std::lock_guard lock(mutex_);
+        if (buffer_.size() + line.size() > MAX_BUFFER_SIZE)
+        {
+            if (++droppedCount_ % 1000 == 1)
+            {
+                spdlog::warn(R"(NDJSON file "{}" is not written fast enough; {} line(s) dropped so far.)", pathName_.string(), droppedCount_);
+            }
+            accepted = false;
+            chunkComplete = false;
+        }
+        else
+        {
+            accepted = true;
+            buffer_ += line;
+            if (onDelivered)
+            {
+                bufferDeliveryHandlers_.push_back(std::move(onDelivered));
+            }
+            chunkComplete = buffer_.size() >= chunkSize_;
+        }
+    }
+    if (!accepted)
+    {
+        if (onDelivered)
+        {
+            onDelivered(false, "NDJSON file buffer full");
+        }
+        return;
+    }
+    if (chunkComplete)
+    {
+        condition_.notify_one();
+    }
+}
+
+void NdjsonFileHttpRequestDispatcher::Run(const std::stop_token& stopToken)
+{
+    auto nextSync = std::chrono::steady_clock::now() + syncInterval_;
+    std::string chunk;
+    chunk.reserve(chunkSize_ * 2);
+    std::vector<ed::DeliveryReport::Handler> chunkDeliveryHandlers;
+    for (;;)
+    {
+        {
+            std::unique_lock lock(mutex_);
+            condition_.wait_until(lock, stopToken, nextSync, [this] { return buffer_.size() >= chunkSize_; });
+            chunk.swap(buffer_);
+            chunkDeliveryHandlers.swap(bufferDeliveryHandlers_);
+        }
+        // The lines collected meanwhile go to the other buffer: write without holding the lock
+        Write(chunk, chunkDeliveryHandlers);
+        chunk.clear();
+
+        if (stopToken.stop_requested())
+        {
+            break;
+        }
+        if (const auto now = std::chrono::steady_clock::now(); now >= nextSync)
+        {
+            Sync();
+            nextSync = now + syncInterval_;
+        }
+    }
+
+    // Enqueueing is over at this point: the rest and the final flush
+    {
+        std::lock_guard lock(mutex_);
+        chunk.swap(buffer_);
+        chunkDeliveryHandlers.swap(bufferDeliveryHandlers_);
+    }
+    Write(chunk, chunkDeliveryHandlers);
+    Sync();
+}
+
+void NdjsonFileHttpRequestDispatcher::Write(const std::string& chunk, std::vector<ed::DeliveryReport::Handler>& deliveryHandlers)
+{
+    std::string error;
+    size_t offset = 0;
+    while (offset < chunk.size())
+    {
+        DWORD written = 0;
+        const auto toWrite = static_cast<DWORD>(std::min<size_t>(chunk.size() - offset, MAXDWORD));
+        if (!WriteFile(file_, chunk.data() + offset, toWrite, &written, nullptr))
+        {
+            error = std::format("write failed, error {}", GetLastError());
+            spdlog::error(R"(NDJSON file "{}" {}; {} byte(s) lost.)", pathName_.string(), error, chunk.size() - offset);
+            break;
+        }
+        offset += written;
+    }
+    syncPending_ = syncPending_ || offset > 0;
+
+    // The lines of a failed chunk are reported failed as a whole, even if a part got written
+    for (const auto& onDelivered : deliveryHandlers)
+    {
+        onDelivered(error.empty(), error);
+    }
+    deliveryHandlers.clear();
+}
+
+void NdjsonFileHttpRequestDispatcher::Sync()
+{
+    if (syncPending_ && !FlushFileBuffers(file_))
+    {
+        spdlog::warn(R"(NDJSON file "{}" flush failed, error {}.)", pathName_.string(), GetLastError());
+    }
+    syncPending_ = false;
+}
+
+NdjsonStreamHttpRequestDispatcher::NdjsonStreamHttpRequestDispatcher(std::ostream& stream)
+    : stream_(stream)
+{
+}
+
+void NdjsonStreamHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                       const std::string& urlSuffix, const std::string& payload,
+                                                       const std::unordered_map<std::string, std::string>& header,
+                                                       const std::string& hint)
+{
+    stream_ << ed::FormatRequestAsNdjsonLine(postOrPut, time, urlSuffix, payload, header, hint) << std::flush;
+    if (!stream_)
+    {
+        stream_.clear();
+        throw std::runtime_error("NDJSON stream write failed");
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "DeliveryReport.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ed {
+// One request as a single line JSON object (newline delimited JSON): time, method, urlSuffix, hint, header and payload.
+// A JSON payload is embedded as a JSON value; any other one (e.g. CBOR) as a binary value.
+[[nodiscard]] std::string FormatRequestAsNdjsonLine(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                    const std::string& urlSuffix, const std::string& payload,
+                                                    const std::unordered_map<std::string, std::string>& header,
+                                                    const std::string& hint);
+}
+
+// Appends the requests as NDJSON lines to a local (audit) file. Lines are collected in memory and written
+// by an own worker in large sequential chunks; the file is flushed to the disk once per sync interval.
+// The outcome of every line is reported through an ed::DeliveryReport once its chunk is written.
+class NdjsonFileHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    NdjsonFileHttpRequestDispatcher(std::filesystem::path pathName, std::chrono::milliseconds syncInterval,
+                                    size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    DISALLOW_COPY_MOVE(NdjsonFileHttpRequestDispatcher);
+    ~NdjsonFileHttpRequestDispatcher() override;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+private:
+    void Run(const std::stop_token& stopToken);
+    // Reports the outcome to the handlers of the chunk's lines and clears them
+    void Write(const std::string& chunk, std::vector<ed::DeliveryReport::Handler>& deliveryHandlers);
+    void Sync();
+
+private:
+    static constexpr size_t MAX_BUFFER_SIZE = 16 * 1024 * 1024;
+
+    const std::filesystem::path pathName_;
+    const std::chrono::milliseconds syncInterval_;
+    const size_t chunkSize_;
+    const HANDLE file_;
+    bool syncPending_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable_any condition_;
+    std::string buffer_;
+    std::vector<ed::DeliveryReport::Handler> bufferDeliveryHandlers_;
+    uint64_t droppedCount_ = 0;
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
+
+// Writes the requests as NDJSON lines to a stream, e.g. std::cout for a console run. Throws if the stream fails.
+class NdjsonStreamHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    explicit NdjsonStreamHttpRequestDispatcher(std::ostream& stream);
+
+    DISALLOW_COPY_MOVE(NdjsonStreamHttpRequestDispatcher);
+    ~NdjsonStreamHttpRequestDispatcher() override = default;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+private:
+    std::ostream& stream_;
+};
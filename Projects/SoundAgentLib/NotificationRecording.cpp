@@ -0,0 +1,364 @@
+#include "os-dependencies.h"
+
+#include "NotificationRecording.h"
+
+#include <format>
+#include <stdexcept>
+
+
+namespace
+{
+    constexpr std::string_view MAGIC = "SANR";
+    constexpr uint8_t FORMAT_VERSION = 2;
+
+    void AppendVarint(std::string& buffer, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<char>(value));
+    }
+
+    void AppendString(std::string& buffer, const std::string& value)
+    {
+        AppendVarint(buffer, value.size());
+        buffer.append(value);
+    }
+
+    void AppendDevice(std::string& buffer, const ed::audio::SoundDevice& device)
+    {
+        AppendString(buffer, device.GetPnpId());
+        AppendString(buffer, device.GetName());
+        buffer.push_back(static_cast<char>(device.GetFlow()));
+        AppendVarint(buffer, device.GetCurrentRenderVolume());
+        AppendVarint(buffer, device.GetCurrentCaptureVolume());
+        buffer.push_back(static_cast<char>((device.IsRenderCurrentlyDefault() ? 1 : 0) | (device.IsCaptureCurrentlyDefault() ? 2 : 0)));
+    }
+
+    void AppendEndpoints(std::string& buffer, const std::vector<ed::audio::RecordedEndpoint>& endpoints)
+    {
+        AppendVarint(buffer, endpoints.size());
+        for (const auto& [endpointId, device] : endpoints)
+        {
+            AppendString(buffer, endpointId);
+            AppendDevice(buffer, device);
+        }
+    }
+
+    // The data ends inside a record
+    struct TruncatedRecord final : std::exception
+    {
+    };
+
+    class RecordReader final
+    {
+    public:
+        explicit RecordReader(std::string_view data)
+            : data_(data)
+        {
+        }
+
+        [[nodiscard]] bool AtEnd() const
+        {
+            return position_ == data_.size();
+        }
+
+        uint8_t ReadByte()
+        {
+            if (AtEnd())
+            {
+                throw TruncatedRecord();
+            }
+            return static_cast<uint8_t>(data_[position_++]);
+        }
+
+        uint64_t ReadVarint()
+        {
+            uint64_t value = 0;
+            for (unsigned shift = 0; ; shift += 7)
+            {
+                if (shift > 63)
+                {
+                    throw std::runtime_error("Notification recording: invalid number");
+                }
+                const auto byte = ReadByte();
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+        }
+
+        uint16_t ReadVolume()
+        {
+            const auto value = ReadVarint();
+            if (value > 1000)
+            {
+                throw std::runtime_error(std::format("Notification recording: invalid volume {}", value));
+            }
+            return static_cast<uint16_t>(value);
+        }
+
+        std::string ReadString()
+        {
+            const auto size = ReadVarint();
+            if (size > data_.size() - position_)
+            {
+                throw TruncatedRecord();
+            }
+            std::string value(data_.substr(position_, size));
+            position_ += size;
+            return value;
+        }
+
+        ed::audio::SoundDevice ReadDevice()
+        {
+            auto pnpId = ReadString();
+            auto name = ReadString();
+            const auto flow = ReadByte();
+            if (flow > static_cast<uint8_t>(SoundDeviceFlowType::RenderAndCapture))
+            {
+                throw std::runtime_error(std::format("Notification recording: invalid flow {}", flow));
+            }
+            const auto renderVolume = ReadVolume();
+            const auto captureVolume = ReadVolume();
+            const auto defaults = ReadByte();
+            return {std::move(pnpId), std::move(name), static_cast<SoundDeviceFlowType>(flow), renderVolume, captureVolume,
+                    (defaults & 1) != 0, (defaults & 2) != 0};
+        }
+
+        std::vector<ed::audio::RecordedEndpoint> ReadEndpoints()
+        {
+            std::vector<ed::audio::RecordedEndpoint> endpoints;
+            for (auto count = ReadVarint(); count > 0; --count)
+            {
+                auto endpointId = ReadString();
+                endpoints.push_back({std::move(endpointId), ReadDevice()});
+            }
+            return endpoints;
+        }
+
+        ed::audio::RecordedNotification ReadRecord(std::chrono::microseconds previousTime)
+        {
+            using ed::audio::NotificationType;
+
+            ed::audio::RecordedNotification notification;
+            const auto type = ReadByte();
+            if (type > static_cast<uint8_t>(NotificationType::VolumeChanged))
+            {
+                throw std::runtime_error(std::format("Notification recording: invalid record type {}", type));
+            }
+            notification.type = static_cast<NotificationType>(type);
+            notification.time = previousTime + std::chrono::microseconds(ReadVarint());
+
+            switch (notification.type)
+            {
+            case NotificationType::Snapshot:
+                for (auto count = ReadVarint(); count > 0; --count)
+                {
+                    notification.devices.push_back(ReadDevice());
+                }
+                notification.listRecreated = ReadByte() != 0;
+                if (notification.listRecreated)
+                {
+                    notification.endpoints = ReadEndpoints();
+                    notification.defaultRenderEndpointId = ReadString();
+                    notification.defaultCaptureEndpointId = ReadString();
+                }
+                break;
+            case NotificationType::DeviceAdded:
+                notification.endpointId = ReadString();
+                if (ReadByte() != 0)
+                {
+                    notification.devices.push_back(ReadDevice());
+                }
+                notification.endpoints = ReadEndpoints();
+                break;
+            case NotificationType::DeviceRemoved:
+                notification.endpointId = ReadString();
+                notification.pnpId = ReadString();
+                if (ReadByte() != 0)
+                {
+                    notification.devices.push_back(ReadDevice());
+                }
+                notification.endpoints = ReadEndpoints();
+                break;
+            case NotificationType::DeviceStateChanged:
+                notification.endpointId = ReadString();
+                notification.state = static_cast<uint32_t>(ReadVarint());
+                break;
+            case NotificationType::DefaultDeviceChanged:
+                notification.endpointId = ReadString();
+                notification.flow = ReadByte();
+                notification.role = ReadByte();
+                notification.pnpId = ReadString();
+                notification.endpoints = ReadEndpoints();
+                break;
+            case NotificationType::VolumeChanged:
+                notification.masterVolume = ReadVolume();
+                notification.muted = ReadByte() != 0;
+                for (auto count = ReadVarint(); count > 0; --count)
+                {
+                    ed::audio::VolumeChange change;
+                    change.pnpId = ReadString();
+                    change.renderOrCapture = ReadByte() != 0;
+                    change.volume = ReadVolume();
+                    notification.volumeChanges.push_back(std::move(change));
+                }
+                break;
+            }
+            return notification;
+        }
+
+    private:
+        std::string_view data_;
+        size_t position_ = 0;
+    };
+}
+
+void ed::audio::AppendNotificationRecordingHeader(std::string& buffer)
+{
+    buffer.append(MAGIC);
+    buffer.push_back(static_cast<char>(FORMAT_VERSION));
+}
+
+void ed::audio::AppendNotificationRecord(std::string& buffer, const RecordedNotification& notification,
+                                         std::chrono::microseconds previousTime)
+{
+    buffer.push_back(static_cast<char>(notification.type));
+    AppendVarint(buffer, static_cast<uint64_t>(std::max(notification.time - previousTime, std::chrono::microseconds::zero()).count()));
+
+    switch (notification.type)
+    {
+    case NotificationType::Snapshot:
+        AppendVarint(buffer, notification.devices.size());
+        for (const auto& device : notification.devices)
+        {
+            AppendDevice(buffer, device);
+        }
+        buffer.push_back(notification.listRecreated ? 1 : 0);
+        if (notification.listRecreated)
+        {
+            AppendEndpoints(buffer, notification.endpoints);
+            AppendString(buffer, notification.defaultRenderEndpointId);
+            AppendString(buffer, notification.defaultCaptureEndpointId);
+        }
+        break;
+    case NotificationType::DeviceAdded:
+        AppendString(buffer, notification.endpointId);
+        buffer.push_back(notification.devices.empty() ? 0 : 1);
+        if (!notification.devices.empty())
+        {
+            AppendDevice(buffer, notification.devices.front());
+        }
+        AppendEndpoints(buffer, notification.endpoints);
+        break;
+    case NotificationType::DeviceRemoved:
+        AppendString(buffer, notification.endpointId);
+        AppendString(buffer, notification.pnpId);
+        buffer.push_back(notification.devices.empty() ? 0 : 1);
+        if (!notification.devices.empty())
+        {
+            AppendDevice(buffer, notification.devices.front());
+        }
+        AppendEndpoints(buffer, notification.endpoints);
+        break;
+    case NotificationType::DeviceStateChanged:
+        AppendString(buffer, notification.endpointId);
+        AppendVarint(buffer, notification.state);
+        break;
+    case NotificationType::DefaultDeviceChanged:
+        AppendString(buffer, notification.endpointId);
+        buffer.push_back(static_cast<char>(notification.flow));
+        buffer.push_back(static_cast<char>(notification.role));
+        AppendString(buffer, notification.pnpId);
+        AppendEndpoints(buffer, notification.endpoints);
+        break;
+    case NotificationType::VolumeChanged:
+        AppendVarint(buffer, notification.masterVolume);
+        buffer.push_back(notification.muted ? 1 : 0);
+        AppendVarint(buffer, notification.volumeChanges.size());
+        for (const auto& change : notification.volumeChanges)
+        {
+            AppendString(buffer, change.pnpId);
+            buffer.push_back(change.renderOrCapture ? 1 : 0);
+            AppendVarint(buffer, change.volume);
+        }
+        break;
+    }
+}
+
+std::vector<ed::audio::RecordedNotification> ed::audio::ParseNotificationRecording(std::string_view data)
+{
+    if (!data.starts_with(MAGIC) || data.size() <= MAGIC.size())
+    {
+        throw std::runtime_error("No notification recording");
+    }
+    if (const auto version = static_cast<uint8_t>(data[MAGIC.size()]); version != FORMAT_VERSION)
+    {
+        throw std::runtime_error(std::format("Notification recording of unsupported version {}", version));
+    }
+
+    std::vector<RecordedNotification> notifications;
+    RecordReader reader(data.substr(MAGIC.size() + 1));
+    try
+    {
+        while (!reader.AtEnd())
+        {
+            notifications.push_back(reader.ReadRecord(notifications.empty() ? std::chrono::microseconds::zero() : notifications.back().time));
+        }
+    }
+    catch (const TruncatedRecord&)
+    {
+        // written up to here
+    }
+    return notifications;
+}
+
+std::vector<ed::audio::RecordedNotification> ed::audio::ReadNotificationRecording(const std::filesystem::path& pathName)
+{
+    std::ifstream file(pathName, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error(std::format(R"(Notification recording "{}" can not be opened)", pathName.string()));
+    }
+    const std::string data{std::istreambuf_iterator(file), std::istreambuf_iterator<char>()};
+    return ParseNotificationRecording(data);
+}
+
+ed::audio::NotificationRecorder::NotificationRecorder(const std::filesystem::path& pathName, const ClockInterface& clock)
+    : clock_(clock)
+    , start_(clock_.SteadyNow())
+    , file_(pathName, std::ios::binary | std::ios::trunc)
+{
+    if (!file_)
+    {
+        throw std::runtime_error(std::format(R"(Notification recording "{}" can not be created)", pathName.string()));
+    }
+    AppendNotificationRecordingHeader(buffer_);
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    file_.flush();
+}
+
+void ed::audio::NotificationRecorder::Record(RecordedNotification notification)
+{
+    const auto now = std::chrono::duration_cast<std::chrono::microseconds>(clock_.SteadyNow() - start_);
+
+    std::lock_guard lock(mutex_);
+    notification.time = std::max(now, previousTime_);
+    buffer_.clear();
+    AppendNotificationRecord(buffer_, notification, previousTime_);
+    previousTime_ = notification.time;
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    file_.flush();
+    ++recordCount_;
+}
+
+uint64_t ed::audio::NotificationRecorder::GetRecordCount() const
+{
+    std::lock_guard lock(mutex_);
+    return recordCount_;
+}
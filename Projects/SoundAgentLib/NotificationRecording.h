@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Clock.h"
+#include "SoundDevice.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ed::audio {
+// Endpoint notification as SoundDeviceCollection received it (the raw callback arguments), the endpoints
+// as the audio service reported them and what the collection resolved it to (devices, PnP ids, volumes),
+// so that a stream recorded on one machine can be replayed on any other one, see SoundAgentLibStress/NotificationReplay.h.
+enum class NotificationType : uint8_t
+{
+    Snapshot = 0, // the whole collection: after (re)creating the device list and at the end of the recording
+    DeviceAdded,
+    DeviceRemoved,
+    DeviceStateChanged, // followed by the DeviceAdded or DeviceRemoved it is processed as
+    DefaultDeviceChanged,
+    VolumeChanged
+};
+
+struct VolumeChange
+{
+    std::string pnpId;
+    bool renderOrCapture = true;
+    uint16_t volume = 0; // 0 to 1000
+};
+
+// An endpoint as the audio service reported it: a device of the endpoint's flow, not merged
+struct RecordedEndpoint
+{
+    std::string endpointId;
+    SoundDevice device;
+};
+
+struct RecordedNotification
+{
+    NotificationType type = NotificationType::Snapshot;
+    std::chrono::microseconds time{}; // monotonic, since the recording started
+
+    // Raw callback arguments
+    std::string endpointId;
+    uint8_t flow = 0; // EDataFlow
+    uint8_t role = 0; // ERole
+    uint32_t state = 0; // DEVICE_STATE_XXX
+    uint16_t masterVolume = 0; // 0 to 1000
+    bool muted = false;
+
+    // Reported by the audio service
+    std::vector<RecordedEndpoint> endpoints; // the endpoint of an addition, removal or default change, if resolved;
+                                             // the active endpoints of a snapshot with the list recreated
+    bool listRecreated = false; // snapshot after (re)creating the device list, not at the end of the recording
+    std::string defaultRenderEndpointId; // of a snapshot with the list recreated, empty if none
+    std::string defaultCaptureEndpointId;
+
+    // Resolved by the collection
+    std::string pnpId; // removed device; default device after the change, empty if none
+    std::vector<SoundDevice> devices; // added device; part left of a merged device after a removal; all devices of a snapshot
+    std::vector<VolumeChange> volumeChanges;
+};
+
+// Binary format: magic "SANR" and a version byte, then per record the type byte, the time since the previous
+// record and the fields of the type; integers as LEB128 varints, strings length prefixed.
+void AppendNotificationRecordingHeader(std::string& buffer);
+void AppendNotificationRecord(std::string& buffer, const RecordedNotification& notification,
+                              std::chrono::microseconds previousTime);
+// Throws std::runtime_error if the data is no recording; a last record cut off (process killed while writing) is dropped
+[[nodiscard]] std::vector<RecordedNotification> ParseNotificationRecording(std::string_view data);
+[[nodiscard]] std::vector<RecordedNotification> ReadNotificationRecording(const std::filesystem::path& pathName);
+
+// Appends the notifications to a recording file, each one written through, so that a crash loses nothing.
+// Thread safe: the endpoint notifications arrive on different threads.
+class NotificationRecorder final
+{
+public:
+    // Throws std::runtime_error if the file can not be created
+    explicit NotificationRecorder(const std::filesystem::path& pathName,
+                                  const ClockInterface& clock = SystemClock::GetInstance());
+
+    DISALLOW_COPY_MOVE(NotificationRecorder);
+    ~NotificationRecorder() = default;
+
+public:
+    // The time of the notification is set here
+    void Record(RecordedNotification notification);
+    [[nodiscard]] uint64_t GetRecordCount() const;
+
+private:
+    const ClockInterface& clock_;
+    const std::chrono::steady_clock::time_point start_;
+
+    mutable std::mutex mutex_;
+    std::ofstream file_;
+    std::string buffer_;
+    std::chrono::microseconds previousTime_{};
+    uint64_t recordCount_ = 0;
+};
+}
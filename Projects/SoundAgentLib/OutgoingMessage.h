@@ -0,0 +1,19 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+
+namespace ed {
+// A request of HttpRequestDispatcherInterface::EnqueueRequest held for a later delivery
+struct OutgoingMessage
+{
+    bool postOrPut;
+    std::chrono::system_clock::time_point time;
+    std::string urlSuffix;
+    std::string payload;
+    std::unordered_map<std::string, std::string> header;
+    std::string hint;
+};
+}
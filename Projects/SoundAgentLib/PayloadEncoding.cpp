@@ -0,0 +1,92 @@
+#include "os-dependencies.h"
+
+#include "PayloadEncoding.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include <nlohmann/json.hpp>
+
+
+std::optional<ed::PayloadEncoding> ed::ParsePayloadEncoding(std::string_view name)
+{
+    for (const auto encoding : {PayloadEncoding::Json, PayloadEncoding::Cbor, PayloadEncoding::MessagePack})
+    {
+        if (std::ranges::equal(name, GetPayloadEncodingName(encoding),
+                               [](unsigned char left, unsigned char right) { return std::tolower(left) == std::tolower(right); }))
+        {
+            return encoding;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string_view ed::GetPayloadEncodingName(PayloadEncoding encoding)
+{
+    switch (encoding)
+    {
+    case PayloadEncoding::Cbor:
+        return "CBOR";
+    case PayloadEncoding::MessagePack:
+        return "MessagePack";
+    case PayloadEncoding::Json:
+    default:  // NOLINT(clang-diagnostic-covered-switch-default)
+        return "JSON";
+    }
+}
+
+std::string_view ed::GetContentType(PayloadEncoding encoding)
+{
+    switch (encoding)
+    {
+    case PayloadEncoding::Cbor:
+        return "application/cbor";
+    case PayloadEncoding::MessagePack:
+        return "application/msgpack";
+    case PayloadEncoding::Json:
+    default:  // NOLINT(clang-diagnostic-covered-switch-default)
+        return "application/json";
+    }
+}
+
+std::string ed::EncodeJsonPayload(PayloadEncoding encoding, const std::string& jsonText)
+{
+    if (encoding == PayloadEncoding::Json)
+    {
+        return jsonText;
+    }
+    return EncodeJsonDocument(encoding, nlohmann::json::parse(jsonText));
+}
+
+std::string ed::EncodeJsonDocument(PayloadEncoding encoding, const nlohmann::json& document)
+{
+    std::string encodedPayload;
+    switch (encoding)
+    {
+    case PayloadEncoding::Cbor:
+        nlohmann::json::to_cbor(document, encodedPayload);
+        break;
+    case PayloadEncoding::MessagePack:
+        nlohmann::json::to_msgpack(document, encodedPayload);
+        break;
+    case PayloadEncoding::Json:
+    default:  // NOLINT(clang-diagnostic-covered-switch-default)
+        encodedPayload = document.dump();
+        break;
+    }
+    return encodedPayload;
+}
+
+std::string ed::DecodeToJsonPayload(PayloadEncoding encoding, const std::string& encodedPayload)
+{
+    switch (encoding)
+    {
+    case PayloadEncoding::Cbor:
+        return nlohmann::json::from_cbor(encodedPayload).dump();
+    case PayloadEncoding::MessagePack:
+        return nlohmann::json::from_msgpack(encodedPayload).dump();
+    case PayloadEncoding::Json:
+    default:  // NOLINT(clang-diagnostic-covered-switch-default)
+        return encodedPayload;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json_fwd.hpp>
+
+namespace ed {
+// Wire encodings of the request payloads. The request builders produce JSON text;
+// the binary encodings carry the very same document (fixed schema, see PAYLOAD_SCHEMA_ID) in CBOR or MessagePack.
+enum class PayloadEncoding : uint8_t
+{
+    Json = 0,
+    Cbor,
+    MessagePack
+};
+
+constexpr auto PAYLOAD_SCHEMA_ID = "sound-agent-device/1";
+constexpr auto CONTENT_TYPE_HEADER_KEY = "Content-Type";
+constexpr auto SCHEMA_ID_HEADER_KEY = "X-Schema-Id";
+constexpr auto CONTENT_ENCODING_HEADER_KEY = "Content-Encoding";
+
+[[nodiscard]] std::optional<PayloadEncoding> ParsePayloadEncoding(std::string_view name);
+[[nodiscard]] std::string_view GetPayloadEncodingName(PayloadEncoding encoding);
+[[nodiscard]] std::string_view GetContentType(PayloadEncoding encoding);
+
+// Throws nlohmann::json::exception if jsonText is not a valid JSON document
+[[nodiscard]] std::string EncodeJsonPayload(PayloadEncoding encoding, const std::string& jsonText);
+// Same for an already parsed document
+[[nodiscard]] std::string EncodeJsonDocument(PayloadEncoding encoding, const nlohmann::json& document);
+// Back to JSON text; throws nlohmann::json::exception on malformed input
+[[nodiscard]] std::string DecodeToJsonPayload(PayloadEncoding encoding, const std::string& encodedPayload);
+}
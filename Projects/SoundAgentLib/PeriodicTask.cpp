@@ -0,0 +1,71 @@
+#include "os-dependencies.h"
+
+#include "PeriodicTask.h"
+
+#include <spdlog/spdlog.h>
+
+
+ed::PeriodicTask::PeriodicTask(std::string name, std::chrono::steady_clock::duration interval, std::function<void()> task,
+                               OnStop onStop, const ClockInterface& clock)
+    : name_(std::move(name))
+    , interval_(interval)
+    , task_(std::move(task))
+    , onStop_(onStop)
+    , clock_(clock)
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+}
+
+ed::PeriodicTask::~PeriodicTask()
+{
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+void ed::PeriodicTask::Run(const std::stop_token& stopToken)
+{
+    std::unique_lock lock(mutex_);
+    // Scheduled from the previous due time: the runs do not drift by the time the task takes
+    auto dueTime = clock_.SteadyNow() + interval_;
+    for (;;)
+    {
+        clock_.WaitUntil(condition_, lock, stopToken, dueTime, [] { return false; });
+        if (stopToken.stop_requested())
+        {
+            break;
+        }
+        if (clock_.SteadyNow() < dueTime)
+        {
+            continue;
+        }
+        lock.unlock();
+        RunTask();
+        lock.lock();
+        dueTime += interval_;
+        if (const auto now = clock_.SteadyNow(); dueTime <= now)
+        {
+            dueTime = now + interval_; // the task took longer than the interval: skip the missed runs
+        }
+    }
+
+    if (onStop_ == OnStop::Run)
+    {
+        lock.unlock();
+        RunTask();
+    }
+}
+
+void ed::PeriodicTask::RunTask() const
+{
+    try
+    {
+        task_();
+    }
+    catch (const std::exception& ex)
+    {
+        spdlog::error(R"(Periodic task "{}" failed: {}.)", name_, ex.what());
+    }
+}
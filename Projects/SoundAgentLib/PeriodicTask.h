@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include "Clock.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ed {
+// Runs a task on an own thread every interval, the first time one interval after the construction, until destroyed.
+// With OnStop::Run the task runs once more when stopping, e.g. to write out what was collected since the last run.
+// An exception of the task is logged; the next run takes place as scheduled.
+class PeriodicTask final
+{
+public:
+    enum class OnStop : uint8_t
+    {
+        Skip,
+        Run
+    };
+
+public:
+    PeriodicTask(std::string name, std::chrono::steady_clock::duration interval, std::function<void()> task,
+                 OnStop onStop = OnStop::Skip, const ClockInterface& clock = SystemClock::GetInstance());
+    DISALLOW_COPY_MOVE(PeriodicTask);
+    ~PeriodicTask();
+
+private:
+    void Run(const std::stop_token& stopToken);
+    void RunTask() const;
+
+private:
+    const std::string name_;
+    const std::chrono::steady_clock::duration interval_;
+    const std::function<void()> task_;
+    const OnStop onStop_;
+    const ClockInterface& clock_;
+
+    std::mutex mutex_;
+    std::condition_variable_any condition_;
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
+}
@@ -0,0 +1,131 @@
+#include "os-dependencies.h"
+
+#include "PipelineLatency.h"
+
+#include <format>
+#include <random>
+
+
+namespace
+{
+    std::atomic<bool> isEnabled = false;
+
+    // Time of the last mark of the notification processed on this thread; empty outside of a LatencyTrace::Scope
+    thread_local std::optional<std::chrono::steady_clock::time_point> lastMark;
+    // Context of the notification processed on this thread; empty outside of a LatencyTrace::Scope
+    thread_local std::optional<ed::TraceContext> context;
+
+    ed::TraceContext CreateTraceContext(std::chrono::steady_clock::time_point steadyCaptureTime)
+    {
+        thread_local std::mt19937_64 randomGenerator(std::random_device{}());
+        const auto traceIdHigh = randomGenerator();
+        const auto traceIdLow = randomGenerator();
+        const auto spanId = randomGenerator();
+        return {
+            .traceParent = std::format("00-{:016x}{:016x}-{:016x}-01", traceIdHigh, traceIdLow, spanId),
+            .steadyCaptureTime = steadyCaptureTime,
+            .systemCaptureTime = std::chrono::system_clock::now()
+        };
+    }
+}
+
+ed::PipelineLatency& ed::PipelineLatency::GetInstance()
+{
+    static PipelineLatency instance;
+    return instance;
+}
+
+void ed::PipelineLatency::Record(LatencyStage stage, std::chrono::steady_clock::duration latency)
+{
+    histograms_[static_cast<size_t>(stage)].Record(latency);
+}
+
+ed::LatencyHistogram::Snapshot ed::PipelineLatency::GetSnapshot(LatencyStage stage) const
+{
+    return histograms_[static_cast<size_t>(stage)].GetSnapshot();
+}
+
+std::string ed::PipelineLatency::FormatSummary() const
+{
+    std::string summary;
+    for (size_t index = 0; index < STAGE_COUNT; ++index)
+    {
+        const auto stage = static_cast<LatencyStage>(index);
+        const auto snapshot = GetSnapshot(stage);
+        if (snapshot.GetCount() == 0)
+        {
+            continue;
+        }
+        summary += std::format("{}{}: n={} p50={}us p99={}us max={}us", summary.empty() ? "" : ", ",
+                               GetStageName(stage), snapshot.GetCount(), snapshot.GetPercentile(50.0).count(),
+                               snapshot.GetPercentile(99.0).count(), snapshot.GetMax().count());
+    }
+    return summary.empty() ? "no samples" : summary;
+}
+
+const char* ed::PipelineLatency::GetStageName(LatencyStage stage)
+{
+    switch (stage)
+    {
+    case LatencyStage::StateUpdated:
+        return "stateUpdated";
+    case LatencyStage::ObserverInvoked:
+        return "observerInvoked";
+    case LatencyStage::PayloadBuilt:
+        return "payloadBuilt";
+    case LatencyStage::Enqueued:
+        return "enqueued";
+    case LatencyStage::Delivered:
+        return "delivered";
+    }
+    return "unknown";
+}
+
+ed::LatencyTrace::Scope::Scope()
+    : isOpen_(isEnabled.load(std::memory_order_relaxed))
+    , outerLastMark_(isOpen_ ? lastMark : std::nullopt)
+    , outerContext_(isOpen_ ? context : std::nullopt)
+{
+    if (!isOpen_)
+    {
+        return;
+    }
+    lastMark = std::chrono::steady_clock::now();
+    context = CreateTraceContext(*lastMark);
+}
+
+ed::LatencyTrace::Scope::~Scope()
+{
+    if (!isOpen_)
+    {
+        return;
+    }
+    lastMark = outerLastMark_;
+    context = outerContext_;
+}
+
+void ed::LatencyTrace::SetEnabled(bool enabled)
+{
+    isEnabled = enabled;
+}
+
+bool ed::LatencyTrace::IsEnabled()
+{
+    return isEnabled.load(std::memory_order_relaxed);
+}
+
+void ed::LatencyTrace::Mark(LatencyStage stage)
+{
+    if (!lastMark.has_value())
+    {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    PipelineLatency::GetInstance().Record(stage, now - *lastMark);
+    lastMark = now;
+}
+
+const ed::TraceContext* ed::LatencyTrace::GetContext()
+{
+    return context.has_value() ? &*context : nullptr;
+}
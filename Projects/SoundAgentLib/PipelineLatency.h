@@ -0,0 +1,90 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+
+
+namespace ed {
+// Stages of an endpoint notification on its way to the broker, each one measured from the previous one
+enum class LatencyStage : uint8_t
+{
+    StateUpdated = 0,   // the collection callback entered -> the collection state updated, observers about to be notified
+    ObserverInvoked,    // -> the observer called
+    PayloadBuilt,       // -> the request with its payload handed to the dispatchers
+    Enqueued,           // -> EnqueueRequest returned
+    Delivered           // taken from a sink queue -> delivered by the sink, retries included; the wait in the queue is not
+};
+
+// Per stage latency histograms of the process, queried e.g. by a periodic log line
+class PipelineLatency final {
+public:
+    static constexpr size_t STAGE_COUNT = static_cast<size_t>(LatencyStage::Delivered) + 1;
+
+public:
+    PipelineLatency() = default;
+    DISALLOW_COPY_MOVE(PipelineLatency);
+    ~PipelineLatency() = default;
+
+    // The one the pipeline stages record into
+    [[nodiscard]] static PipelineLatency& GetInstance();
+
+public:
+    void Record(LatencyStage stage, std::chrono::steady_clock::duration latency);
+    [[nodiscard]] LatencyHistogram::Snapshot GetSnapshot(LatencyStage stage) const;
+    // One line: count, p50, p99 and max per stage with samples
+    [[nodiscard]] std::string FormatSummary() const;
+
+    [[nodiscard]] static const char* GetStageName(LatencyStage stage);
+
+private:
+    std::array<LatencyHistogram, STAGE_COUNT> histograms_;
+};
+
+// Correlation data of an endpoint notification, sent along with its messages as headers so that
+// the latency from the capture to any point downstream can be computed
+struct TraceContext
+{
+    std::string traceParent; // W3C trace context: 00-<32 hex digits trace id>-<16 hex digits span id>-01
+    std::chrono::steady_clock::time_point steadyCaptureTime;
+    std::chrono::system_clock::time_point systemCaptureTime;
+};
+
+// Carries the time and the trace context of the endpoint notification through the synchronous part of its processing:
+// the collection opens a scope on entering the callback, the stages on the same thread call Mark.
+// Outside of a scope Mark does nothing and there is no context, e.g. for the initial collection posted on start.
+// Off by default: a scope then costs nothing and opens no context.
+class LatencyTrace final {
+public:
+    class Scope final {
+    public:
+        Scope();
+        DISALLOW_COPY_MOVE(Scope);
+        ~Scope();
+
+    private:
+        const bool isOpen_;
+        const std::optional<std::chrono::steady_clock::time_point> outerLastMark_;
+        const std::optional<TraceContext> outerContext_;
+    };
+
+public:
+    LatencyTrace() = delete;
+    DISALLOW_COPY_MOVE(LatencyTrace);
+    ~LatencyTrace() = delete;
+
+public:
+    // For the scopes opened afterwards
+    static void SetEnabled(bool enabled);
+    [[nodiscard]] static bool IsEnabled();
+
+    // Records the time since the scope was opened or the previous mark
+    static void Mark(LatencyStage stage);
+    // Of the innermost scope on this thread; nullptr outside of a scope
+    [[nodiscard]] static const TraceContext* GetContext();
+};
+}
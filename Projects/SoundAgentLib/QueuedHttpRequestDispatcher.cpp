@@ -0,0 +1,147 @@
+#include "os-dependencies.h"
+
+#include "QueuedHttpRequestDispatcher.h"
+
+#include "DeliveryReport.h"
+#include "PipelineLatency.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+
+QueuedHttpRequestDispatcher::QueuedHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher,
+                                                         std::string name, size_t capacity)
+    : targetDispatcher_(targetDispatcher)
+    , name_(std::move(name))
+    , capacity_(std::max<size_t>(capacity, 1))
+    , deliveryOutcomes_(std::make_shared<DeliveryOutcomes>())
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+}
+
+QueuedHttpRequestDispatcher::~QueuedHttpRequestDispatcher()
+{
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+void QueuedHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                 const std::string& urlSuffix, const std::string& payload,
+                                                 const std::unordered_map<std::string, std::string>& header,
+                                                 const std::string& hint)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (queue_.size() >= capacity_)
+        {
+            queue_.pop_front();
+            if (++droppedCount_ % DROPPED_WARNING_INTERVAL == 1)
+            {
+                spdlog::warn(R"(Queue of sink "{}" is full; {} request(s) dropped so far.)", name_, droppedCount_);
+            }
+        }
+        queue_.push_back({postOrPut, time, urlSuffix, payload, header, hint});
+    }
+    condition_.notify_one();
+}
+
+uint64_t QueuedHttpRequestDispatcher::GetDroppedCount() const
+{
+    std::lock_guard lock(mutex_);
+    return droppedCount_;
+}
+
+size_t QueuedHttpRequestDispatcher::GetSize() const
+{
+    std::lock_guard lock(mutex_);
+    return queue_.size();
+}
+
+uint64_t QueuedHttpRequestDispatcher::GetFailedCount() const
+{
+    return deliveryOutcomes_->failedCount.load();
+}
+
+void QueuedHttpRequestDispatcher::SetRecoveredHandler(std::function<void()> onRecovered)
+{
+    std::lock_guard lock(deliveryOutcomes_->mutex);
+    deliveryOutcomes_->onRecovered = std::move(onRecovered);
+}
+
+void QueuedHttpRequestDispatcher::Run(const std::stop_token& stopToken)
+{
+    std::unique_lock lock(mutex_);
+    while (!stopToken.stop_requested())
+    {
+        if (!condition_.wait(lock, stopToken, [this] { return !queue_.empty(); }))
+        {
+            break;
+        }
+        const auto request = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        Forward(request);
+        lock.lock();
+    }
+
+    // Deliver what is left: the target dispatcher is still alive at this point
+    if (!queue_.empty())
+    {
+        spdlog::info(R"(Sink "{}" stopping; forwarding {} pending request(s).)", name_, queue_.size());
+    }
+    for (const auto& request : queue_)
+    {
+        Forward(request);
+    }
+    queue_.clear();
+}
+
+void QueuedHttpRequestDispatcher::Forward(const ed::OutgoingMessage& request) const
+{
+    const auto forwardTime = ed::LatencyTrace::IsEnabled()
+                                 ? std::optional(std::chrono::steady_clock::now())
+                                 : std::nullopt;
+    // Taken by a sink delivering later, unless a retrying stage in between counts the failures itself
+    const ed::DeliveryReport::Scope deliveryReport([deliveryOutcomes = deliveryOutcomes_, forwardTime](bool delivered, const std::string&)
+        {
+            deliveryOutcomes->Report(delivered, forwardTime);
+        });
+    bool delivered = true;
+    try
+    {
+        targetDispatcher_.EnqueueRequest(request.postOrPut, request.time, request.urlSuffix, request.payload,
+                                         request.header, request.hint);
+    }
+    catch (const std::exception& ex)
+    {
+        delivered = false;
+        spdlog::error(R"(Sink "{}" failed to take over a request: {}.)", name_, ex.what());
+    }
+    if (!deliveryReport.IsTaken())
+    {
+        deliveryOutcomes_->Report(delivered, forwardTime);
+    }
+}
+
+void QueuedHttpRequestDispatcher::DeliveryOutcomes::Report(bool delivered,
+                                                           const std::optional<std::chrono::steady_clock::time_point>& forwardTime)
+{
+    if (!delivered)
+    {
+        ++failedCount;
+    }
+    else if (forwardTime.has_value())
+    {
+        ed::PipelineLatency::GetInstance().Record(ed::LatencyStage::Delivered, std::chrono::steady_clock::now() - *forwardTime);
+    }
+    std::lock_guard lock(mutex);
+    if (delivered && isFailing && onRecovered)
+    {
+        onRecovered();
+    }
+    isFailing = !delivered;
+}
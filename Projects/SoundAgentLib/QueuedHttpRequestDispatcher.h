@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "OutgoingMessage.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// Decorator decoupling the caller from the target dispatcher: requests are put into a bounded queue
+// and forwarded by an own worker thread. If the target is slower than the producer, the oldest requests are dropped.
+class QueuedHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    QueuedHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher, std::string name, size_t capacity);
+
+    DISALLOW_COPY_MOVE(QueuedHttpRequestDispatcher);
+    ~QueuedHttpRequestDispatcher() override;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+    [[nodiscard]] uint64_t GetDroppedCount() const;
+    [[nodiscard]] size_t GetSize() const;
+    // Requests the target threw on or reported failed through an ed::DeliveryReport
+    [[nodiscard]] uint64_t GetFailedCount() const;
+    // Called once the target delivers again after failing, e.g. reconnected; from the worker or a thread of the
+    // target, with a lock held, so it must not call back into this dispatcher. nullptr: none
+    void SetRecoveredHandler(std::function<void()> onRecovered);
+
+private:
+    // Shared with the delivery reports: a sink may report after the queue is gone
+    struct DeliveryOutcomes
+    {
+        std::atomic<uint64_t> failedCount = 0;
+        std::mutex mutex;
+        bool isFailing = false;
+        std::function<void()> onRecovered;
+
+        // forwardTime: when the request was handed to the target, if the latency is traced
+        void Report(bool delivered, const std::optional<std::chrono::steady_clock::time_point>& forwardTime);
+    };
+
+    void Run(const std::stop_token& stopToken);
+    void Forward(const ed::OutgoingMessage& request) const;
+
+private:
+    static constexpr uint64_t DROPPED_WARNING_INTERVAL = 1000;
+
+    HttpRequestDispatcherInterface& targetDispatcher_;
+    const std::string name_;
+    const size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any condition_;
+    std::deque<ed::OutgoingMessage> queue_;
+    uint64_t droppedCount_ = 0;
+    const std::shared_ptr<DeliveryOutcomes> deliveryOutcomes_;
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
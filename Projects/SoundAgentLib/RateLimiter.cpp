@@ -0,0 +1,118 @@
+#include "os-dependencies.h"
+
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+ed::TokenBucket::TokenBucket(double tokensPerSecond, double capacity, Clock::time_point now)
+    : tokensPerSecond_(std::max(tokensPerSecond, 0.0))
+    , capacity_(std::max(capacity, 0.0))
+    , available_(std::max(capacity, 0.0))
+    , lastRefill_(now)
+{
+}
+
+void ed::TokenBucket::Refill(Clock::time_point now)
+{
+    if (now <= lastRefill_)
+    {
+        return;
+    }
+    const std::chrono::duration<double> elapsed = now - lastRefill_;
+    available_ = std::min(capacity_, available_ + elapsed.count() * tokensPerSecond_);
+    lastRefill_ = now;
+}
+
+bool ed::TokenBucket::TryConsume(Clock::time_point now, double tokens)
+{
+    Refill(now);
+    if (available_ < tokens)
+    {
+        return false;
+    }
+    available_ -= tokens;
+    return true;
+}
+
+ed::TokenBucket::Clock::duration ed::TokenBucket::TimeUntilAvailable(Clock::time_point now, double tokens)
+{
+    Refill(now);
+    if (available_ >= tokens)
+    {
+        return Clock::duration::zero();
+    }
+    if (tokensPerSecond_ <= 0.0 || tokens > capacity_)
+    {
+        return Clock::duration::max();
+    }
+    const std::chrono::duration<double> missing((tokens - available_) / tokensPerSecond_);
+    return std::chrono::ceil<Clock::duration>(missing);
+}
+
+double ed::TokenBucket::GetAvailable(Clock::time_point now)
+{
+    Refill(now);
+    return available_;
+}
+
+namespace
+{
+    double ReservedPart(const ed::RateLimitSettings& settings)
+    {
+        return static_cast<double>(std::min(settings.lifecycleSharePercent, ed::RateLimitSettings::MAX_LIFECYCLE_SHARE_PERCENT)) / 100.0;
+    }
+
+    // A bucket with a capacity below one message would block forever: keep at least one token, if the bucket is used at all
+    double ReservedCapacity(const ed::RateLimitSettings& settings)
+    {
+        const auto part = ReservedPart(settings);
+        return part > 0.0 ? std::max(std::ceil(std::max(settings.burst, 1.0) * part), 1.0) : 0.0;
+    }
+
+    double SharedCapacity(const ed::RateLimitSettings& settings)
+    {
+        const auto part = 1.0 - ReservedPart(settings);
+        return part > 0.0 ? std::max(std::floor(std::max(settings.burst, 1.0) * part), 1.0) : 0.0;
+    }
+}
+
+ed::PriorityRateLimiter::PriorityRateLimiter(const RateLimitSettings& settings, Clock::time_point now)
+    : unlimited_(settings.messagesPerSecond <= 0.0)
+    , reserved_(settings.messagesPerSecond * ReservedPart(settings), ReservedCapacity(settings), now)
+    , shared_(settings.messagesPerSecond * (1.0 - ReservedPart(settings)), SharedCapacity(settings), now)
+{
+}
+
+bool ed::PriorityRateLimiter::IsUnlimited() const noexcept
+{
+    return unlimited_;
+}
+
+bool ed::PriorityRateLimiter::TryAcquire(RatePriority priority, Clock::time_point now)
+{
+    if (unlimited_)
+    {
+        return true;
+    }
+    if (priority == RatePriority::Lifecycle && reserved_.TryConsume(now))
+    {
+        return true;
+    }
+    return shared_.TryConsume(now);
+}
+
+ed::PriorityRateLimiter::Clock::duration ed::PriorityRateLimiter::TimeUntilAvailable(RatePriority priority, Clock::time_point now)
+{
+    if (unlimited_)
+    {
+        return Clock::duration::zero();
+    }
+    const auto sharedWait = shared_.TimeUntilAvailable(now);
+    if (priority == RatePriority::Lifecycle)
+    {
+        return std::min(reserved_.TimeUntilAvailable(now), sharedWait);
+    }
+    return sharedWait;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace ed {
+// Classic token bucket: refills continuously at tokensPerSecond up to capacity.
+// Not thread-safe; time is always passed in, so the bucket can be driven by a simulated clock.
+class TokenBucket final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(double tokensPerSecond, double capacity, Clock::time_point now);
+
+    [[nodiscard]] bool TryConsume(Clock::time_point now, double tokens = 1.0);
+    // Clock::duration::max() if the tokens will never become available (zero rate or capacity too small)
+    [[nodiscard]] Clock::duration TimeUntilAvailable(Clock::time_point now, double tokens = 1.0);
+    [[nodiscard]] double GetAvailable(Clock::time_point now);
+
+private:
+    void Refill(Clock::time_point now);
+
+private:
+    double tokensPerSecond_;
+    double capacity_;
+    double available_;
+    Clock::time_point lastRefill_;
+};
+
+enum class RatePriority : uint8_t
+{
+    Lifecycle = 0, // device discovered / confirmed / detached
+    Low // volume changes and other chatty events
+};
+
+struct RateLimitSettings
+{
+    double messagesPerSecond = 0.0; // 0: unlimited
+    double burst = 0.0;
+    unsigned lifecycleSharePercent = 50; // part of the rate reserved for lifecycle events only
+
+    // Higher shares are clamped: the other messages keep a part of the rate, else they would wait forever
+    static constexpr unsigned MAX_LIFECYCLE_SHARE_PERCENT = 90;
+};
+
+// Two buckets: a reserved one usable by lifecycle events only and a shared one usable by everybody.
+// Lifecycle events take from the reserved bucket first and fall back to the shared one,
+// so a volume drag can never starve a device (dis)appearance.
+class PriorityRateLimiter final {
+public:
+    using Clock = TokenBucket::Clock;
+
+    PriorityRateLimiter(const RateLimitSettings& settings, Clock::time_point now);
+
+    [[nodiscard]] bool IsUnlimited() const noexcept;
+    [[nodiscard]] bool TryAcquire(RatePriority priority, Clock::time_point now);
+    [[nodiscard]] Clock::duration TimeUntilAvailable(RatePriority priority, Clock::time_point now);
+
+private:
+    bool unlimited_;
+    TokenBucket reserved_;
+    TokenBucket shared_;
+};
+}
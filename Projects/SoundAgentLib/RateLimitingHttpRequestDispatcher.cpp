@@ -0,0 +1,178 @@
+#include "os-dependencies.h"
+
+#include "RateLimitingHttpRequestDispatcher.h"
+
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+
+RateLimitingHttpRequestDispatcher::RateLimitingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher,
+                                                                     const ed::RateLimitSettings& settings,
+                                                                     std::chrono::milliseconds startupDelay,
+                                                                     const ed::ClockInterface& clock)
+    : targetDispatcher_(targetDispatcher)
+    , clock_(clock)
+    , releaseNotBefore_(clock_.SteadyNow() + startupDelay)
+    , limiter_(settings, releaseNotBefore_)
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+}
+
+RateLimitingHttpRequestDispatcher::~RateLimitingHttpRequestDispatcher()
+{
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+HttpRequestDispatcherInterface& RateLimitingHttpRequestDispatcher::GetBackgroundDispatcher()
+{
+    return backgroundDispatcher_;
+}
+
+void RateLimitingHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                       const std::string& urlSuffix, const std::string& payload,
+                                                       const std::unordered_map<std::string, std::string>& header,
+                                                       const std::string& hint)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (postOrPut)
+        {
+            lifecycleQueue_.push_back({postOrPut, time, urlSuffix, payload, header, hint});
+        }
+        else
+        {
+            if (lowPriorityQueue_.size() >= MAX_LOW_PRIORITY_QUEUE_SIZE)
+            {
+                lowPriorityQueue_.pop_front();
+                if (++droppedLowPriorityCount_ % MAX_LOW_PRIORITY_QUEUE_SIZE == 1)
+                {
+                    spdlog::warn("Rate limiter queue is full; {} low priority request(s) dropped so far.", droppedLowPriorityCount_);
+                }
+            }
+            lowPriorityQueue_.push_back({postOrPut, time, urlSuffix, payload, header, hint});
+        }
+        ++enqueuedCount_;
+    }
+    condition_.notify_one();
+}
+
+void RateLimitingHttpRequestDispatcher::Run(const std::stop_token& stopToken)
+{
+    std::unique_lock lock(mutex_);
+    while (!stopToken.stop_requested())
+    {
+        if (lifecycleQueue_.empty() && lowPriorityQueue_.empty() && backgroundQueue_.empty())
+        {
+            condition_.wait(lock, stopToken, [this]
+            {
+                return !lifecycleQueue_.empty() || !lowPriorityQueue_.empty() || !backgroundQueue_.empty();
+            });
+            continue;
+        }
+
+        const auto now = clock_.SteadyNow();
+        if (now < releaseNotBefore_)
+        {
+            clock_.WaitUntil(condition_, lock, stopToken, releaseNotBefore_, [] { return false; });
+            continue;
+        }
+
+        std::deque<ed::OutgoingMessage>* queueToServe = nullptr;
+        if (!lifecycleQueue_.empty() && limiter_.TryAcquire(ed::RatePriority::Lifecycle, now))
+        {
+            queueToServe = &lifecycleQueue_;
+        }
+        else if (!lowPriorityQueue_.empty() && limiter_.TryAcquire(ed::RatePriority::Low, now))
+        {
+            queueToServe = &lowPriorityQueue_;
+        }
+        else if (lifecycleQueue_.empty() && lowPriorityQueue_.empty() && !backgroundQueue_.empty()
+            && limiter_.TryAcquire(ed::RatePriority::Low, now))
+        {
+            queueToServe = &backgroundQueue_;
+        }
+
+        if (queueToServe != nullptr)
+        {
+            const auto request = std::move(queueToServe->front());
+            queueToServe->pop_front();
+            lock.unlock();
+            Forward(request);
+            lock.lock();
+            continue;
+        }
+
+        auto wait = ed::TokenBucket::Clock::duration::max();
+        if (!lifecycleQueue_.empty())
+        {
+            wait = std::min(wait, limiter_.TimeUntilAvailable(ed::RatePriority::Lifecycle, now));
+        }
+        if (!lowPriorityQueue_.empty() || !backgroundQueue_.empty())
+        {
+            wait = std::min(wait, limiter_.TimeUntilAvailable(ed::RatePriority::Low, now));
+        }
+        // A new request may be served by another bucket earlier: wake up on enqueueing, too
+        const auto seenCount = enqueuedCount_;
+        const auto newRequestArrived = [this, seenCount] { return enqueuedCount_ != seenCount; };
+        if (wait == ed::TokenBucket::Clock::duration::max())
+        {
+            // Only requests no bucket will ever serve are waiting (e.g. a zero burst with a zero rate)
+            condition_.wait(lock, stopToken, newRequestArrived);
+            continue;
+        }
+        clock_.WaitUntil(condition_, lock, stopToken, now + wait, newRequestArrived);
+    }
+
+    // Deliver what is left without limitation: the target dispatcher is still alive at this point
+    if (const auto leftCount = lifecycleQueue_.size() + lowPriorityQueue_.size() + backgroundQueue_.size(); leftCount > 0)
+    {
+        spdlog::info("Rate limiter stopping; forwarding {} pending request(s).", leftCount);
+    }
+    for (auto* queue : {&lifecycleQueue_, &lowPriorityQueue_, &backgroundQueue_})
+    {
+        for (const auto& request : *queue)
+        {
+            Forward(request);
+        }
+        queue->clear();
+    }
+}
+
+void RateLimitingHttpRequestDispatcher::Forward(const ed::OutgoingMessage& request) const
+{
+    try
+    {
+        targetDispatcher_.EnqueueRequest(request.postOrPut, request.time, request.urlSuffix, request.payload,
+                                         request.header, request.hint);
+    }
+    catch (const std::exception& ex)
+    {
+        spdlog::error("Forwarding of a rate limited request failed: {}.", ex.what());
+    }
+}
+
+RateLimitingHttpRequestDispatcher::BackgroundDispatcher::BackgroundDispatcher(RateLimitingHttpRequestDispatcher& owner)
+    : owner_(owner)
+{
+}
+
+void RateLimitingHttpRequestDispatcher::BackgroundDispatcher::EnqueueRequest(
+    bool postOrPut, const std::chrono::system_clock::time_point& time, const std::string& urlSuffix,
+    const std::string& payload, const std::unordered_map<std::string, std::string>& header, const std::string& hint)
+{
+    {
+        std::lock_guard lock(owner_.mutex_);
+        if (owner_.backgroundQueue_.size() >= MAX_BACKGROUND_QUEUE_SIZE)
+        {
+            throw std::runtime_error("Rate limiter background queue is full");
+        }
+        owner_.backgroundQueue_.push_back({postOrPut, time, urlSuffix, payload, header, hint});
+        ++owner_.enqueuedCount_;
+    }
+    owner_.condition_.notify_one();
+}
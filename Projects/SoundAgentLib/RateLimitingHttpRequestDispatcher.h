@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "Clock.h"
+#include "OutgoingMessage.h"
+#include "RateLimiter.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Decorator that holds all requests back until the startup delay (jitter) elapsed
+// and then forwards them to the target dispatcher not faster than the token buckets allow.
+// POST requests (device lifecycle) are prioritized over PUT requests (volume changes); the requests of the
+// background dispatcher, e.g. log batches, come last and wait in a short queue of their own.
+class RateLimitingHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    RateLimitingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher,
+                                      const ed::RateLimitSettings& settings,
+                                      std::chrono::milliseconds startupDelay,
+                                      const ed::ClockInterface& clock = ed::SystemClock::GetInstance());
+
+    DISALLOW_COPY_MOVE(RateLimitingHttpRequestDispatcher);
+    ~RateLimitingHttpRequestDispatcher() override;
+
+public:
+    // Waiting PUT requests; the oldest one is dropped for a new one beyond
+    static constexpr size_t MAX_LOW_PRIORITY_QUEUE_SIZE = 1000;
+    // Waiting background requests; beyond, the background dispatcher refuses new ones
+    static constexpr size_t MAX_BACKGROUND_QUEUE_SIZE = 4;
+
+public:
+    // Forwards from the low priority budget once no other request waits. Throws instead of dropping a request
+    // when its queue is full: the caller keeps it, e.g. the log shipper spools the batch.
+    [[nodiscard]] HttpRequestDispatcherInterface& GetBackgroundDispatcher();
+
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+private:
+    class BackgroundDispatcher final : public HttpRequestDispatcherInterface
+    {
+    public:
+        explicit BackgroundDispatcher(RateLimitingHttpRequestDispatcher& owner);
+
+        DISALLOW_COPY_MOVE(BackgroundDispatcher);
+        ~BackgroundDispatcher() override = default;
+
+    public:
+        void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                            const std::string& urlSuffix, const std::string& payload,
+                            const std::unordered_map<std::string, std::string>& header,
+                            const std::string& hint) override;
+
+    private:
+        RateLimitingHttpRequestDispatcher& owner_;
+    };
+
+    void Run(const std::stop_token& stopToken);
+    void Forward(const ed::OutgoingMessage& request) const;
+
+private:
+    HttpRequestDispatcherInterface& targetDispatcher_;
+    const ed::ClockInterface& clock_;
+    ed::TokenBucket::Clock::time_point releaseNotBefore_;
+
+    std::mutex mutex_;
+    std::condition_variable_any condition_;
+    ed::PriorityRateLimiter limiter_;
+    std::deque<ed::OutgoingMessage> lifecycleQueue_;
+    std::deque<ed::OutgoingMessage> lowPriorityQueue_;
+    std::deque<ed::OutgoingMessage> backgroundQueue_;
+    size_t droppedLowPriorityCount_ = 0;
+    uint64_t enqueuedCount_ = 0;
+    BackgroundDispatcher backgroundDispatcher_{*this};
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
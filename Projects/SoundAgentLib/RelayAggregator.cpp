@@ -0,0 +1,261 @@
+#include "os-dependencies.h"
+
+#include "RelayAggregator.h"
+
+#include <format>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <Poco/DeflatingStream.h>
+#include <Poco/DigestEngine.h>
+#include <Poco/HMACEngine.h>
+#include <Poco/InflatingStream.h>
+#include <Poco/SHA2Engine.h>
+
+
+namespace
+{
+    // JSON payloads as a string; others, e.g. the gzip compressed log batches, as bytes: a string would not keep them
+    nlohmann::json PayloadToJson(const std::string& payload)
+    {
+        if (nlohmann::json::accept(payload))
+        {
+            return payload;
+        }
+        return nlohmann::json::binary(std::vector<uint8_t>(payload.begin(), payload.end()));
+    }
+
+    // Parsed from text, bytes are an object: {"bytes": [...], "subtype": null}
+    std::string PayloadFromJson(const nlohmann::json& json)
+    {
+        if (json.is_string())
+        {
+            return json.get<std::string>();
+        }
+        const auto bytes = json.is_binary() ? static_cast<const std::vector<uint8_t>&>(json.get_binary())
+                                            : json.at("bytes").get<std::vector<uint8_t>>();
+        return {bytes.begin(), bytes.end()};
+    }
+
+    nlohmann::json MessageToJson(const ed::RelayMessage& relayMessage)
+    {
+        return {
+            {"hostName", relayMessage.hostName},
+            {"deviceId", relayMessage.deviceId},
+            {"epoch", relayMessage.epoch},
+            {"sequence", relayMessage.sequence},
+            {"timeUs", std::chrono::duration_cast<std::chrono::microseconds>(relayMessage.message.time.time_since_epoch()).count()},
+            {"method", relayMessage.message.postOrPut ? "POST" : "PUT"},
+            {"urlSuffix", relayMessage.message.urlSuffix},
+            {"header", relayMessage.message.header},
+            {"hint", relayMessage.message.hint},
+            {"payload", PayloadToJson(relayMessage.message.payload)}
+        };
+    }
+
+    ed::RelayMessage MessageFromJson(const nlohmann::json& json)
+    {
+        return {
+            .hostName = json.at("hostName").get<std::string>(),
+            .deviceId = json.at("deviceId").get<std::string>(),
+            .epoch = json.at("epoch").get<uint64_t>(),
+            .sequence = json.at("sequence").get<uint64_t>(),
+            .message = {
+                .postOrPut = json.at("method").get<std::string>() == "POST",
+                .time = std::chrono::system_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(json.at("timeUs").get<int64_t>()))),
+                .urlSuffix = json.at("urlSuffix").get<std::string>(),
+                .payload = PayloadFromJson(json.at("payload")),
+                .header = json.at("header").get<std::unordered_map<std::string, std::string>>(),
+                .hint = json.at("hint").get<std::string>()
+            }
+        };
+    }
+}
+
+std::string ed::RelayMessage::ToNdjsonLine() const
+{
+    return MessageToJson(*this).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + '\n';
+}
+
+std::optional<ed::RelayMessage> ed::RelayMessage::FromNdjsonLine(const std::string& line)
+{
+    const auto json = nlohmann::json::parse(line, nullptr, false);
+    if (!json.is_object())
+    {
+        return std::nullopt;
+    }
+    try
+    {
+        return MessageFromJson(json);
+    }
+    catch (const nlohmann::json::exception&)
+    {
+        return std::nullopt;
+    }
+}
+
+std::string ed::RelayHandshake::CreateChallenge()
+{
+    std::random_device randomDevice;
+    std::string challenge;
+    for (int i = 0; i < 4; ++i)
+    {
+        challenge += std::format("{:08x}", randomDevice());
+    }
+    return challenge;
+}
+
+std::string ed::RelayHandshake::CreateResponse(const std::string& secret, const std::string& challenge)
+{
+    Poco::HMACEngine<Poco::SHA2Engine256> hmac(secret);
+    hmac.update(challenge);
+    return Poco::DigestEngine::digestToHex(hmac.digest());
+}
+
+bool ed::RelayHandshake::IsResponseValid(const std::string& secret, const std::string& challenge, const std::string& response)
+{
+    // in constant time: the comparison does not tell how many characters match
+    const auto expected = CreateResponse(secret, challenge);
+    if (response.size() != expected.size())
+    {
+        return false;
+    }
+    unsigned char difference = 0;
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        difference |= static_cast<unsigned char>(expected[i] ^ response[i]);
+    }
+    return difference == 0;
+}
+
+ed::RelayAggregator::RelayAggregator(const RelaySettings& settings)
+    : settings_(settings)
+{
+}
+
+bool ed::RelayAggregator::Accept(RelayMessage message, Clock::time_point now)
+{
+    auto key = message.hostName;
+    key += '\n';
+    key += message.deviceId;
+    key += '\n';
+    key += std::to_string(message.epoch);
+    if (const auto [foundPair, inserted] = keyToDedupEntry_.try_emplace(std::move(key), DedupEntry{message.sequence, now});
+        !inserted)
+    {
+        auto& entry = foundPair->second;
+        entry.lastSeen = now;
+        if (message.sequence <= entry.lastSequence)
+        {
+            ++duplicateCount_;
+            return false;
+        }
+        entry.lastSequence = message.sequence;
+    }
+
+    if (openBatch_.empty())
+    {
+        openBatchStart_ = now;
+    }
+    openBatchBytes_ += message.message.payload.size() + message.message.urlSuffix.size() + message.hostName.size() + message.deviceId.size();
+    openBatch_.push_back(std::move(message));
+    ++acceptedCount_;
+    if (openBatch_.size() >= settings_.maxBatchCount || openBatchBytes_ >= settings_.maxBatchBytes)
+    {
+        CloseOpenBatch();
+    }
+    return true;
+}
+
+std::vector<ed::RelayAggregator::Batch> ed::RelayAggregator::TakeBatches(Clock::time_point now, bool flushAll)
+{
+    if (!openBatch_.empty() && (flushAll || now - openBatchStart_ >= settings_.maxBatchDelay))
+    {
+        CloseOpenBatch();
+    }
+    PruneDedupEntries(now);
+    return std::exchange(closedBatches_, {});
+}
+
+uint64_t ed::RelayAggregator::GetAcceptedCount() const
+{
+    return acceptedCount_;
+}
+
+uint64_t ed::RelayAggregator::GetDuplicateCount() const
+{
+    return duplicateCount_;
+}
+
+size_t ed::RelayAggregator::GetPendingCount() const
+{
+    auto pendingCount = openBatch_.size();
+    for (const auto& batch : closedBatches_)
+    {
+        pendingCount += batch.size();
+    }
+    return pendingCount;
+}
+
+size_t ed::RelayAggregator::GetDedupKeyCount() const
+{
+    return keyToDedupEntry_.size();
+}
+
+void ed::RelayAggregator::CloseOpenBatch()
+{
+    closedBatches_.push_back(std::exchange(openBatch_, {}));
+    openBatchBytes_ = 0;
+}
+
+void ed::RelayAggregator::PruneDedupEntries(Clock::time_point now)
+{
+    // a full scan, so not more often than four times per window
+    if (now - lastPrune_ < settings_.dedupWindow / 4)
+    {
+        return;
+    }
+    lastPrune_ = now;
+    std::erase_if(keyToDedupEntry_, [this, now](const auto& keyAndEntry)
+    {
+        return now - keyAndEntry.second.lastSeen >= settings_.dedupWindow;
+    });
+}
+
+std::string ed::RelayAggregator::CreateBatchPayload(const Batch& batch, const std::string& relayHostName)
+{
+    nlohmann::json messages = nlohmann::json::array();
+    for (const auto& relayMessage : batch)
+    {
+        messages.push_back(MessageToJson(relayMessage));
+    }
+    const nlohmann::json document = {
+        {"relayHostName", relayHostName},
+        {"messages", messages}
+    };
+
+    std::ostringstream compressed;
+    {
+        Poco::DeflatingOutputStream deflater(compressed, Poco::DeflatingStreamBuf::STREAM_GZIP);
+        deflater << document.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+        deflater.close();
+    }
+    return std::move(compressed).str();
+}
+
+ed::RelayAggregator::Batch ed::RelayAggregator::ParseBatchPayload(const std::string& compressedPayload)
+{
+    std::istringstream compressed(compressedPayload);
+    Poco::InflatingInputStream inflater(compressed, Poco::InflatingStreamBuf::STREAM_GZIP);
+    const auto document = nlohmann::json::parse(inflater);
+
+    Batch batch;
+    for (const auto& message : document.at("messages"))
+    {
+        batch.push_back(MessageFromJson(message));
+    }
+    return batch;
+}
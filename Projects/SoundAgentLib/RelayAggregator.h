@@ -0,0 +1,113 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include "OutgoingMessage.h"
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace ed {
+// A request of an agent on its way through a relay, stamped by the agent with its host name,
+// the device the request is about (empty if none), a random epoch per agent process and
+// a sequence number increasing within the epoch: the clock of the agent does not matter
+struct RelayMessage
+{
+    std::string hostName;
+    std::string deviceId;
+    uint64_t epoch = 0;
+    uint64_t sequence = 0;
+    OutgoingMessage message;
+
+    [[nodiscard]] std::string ToNdjsonLine() const;
+    // std::nullopt: not a relay message
+    [[nodiscard]] static std::optional<RelayMessage> FromNdjsonLine(const std::string& line);
+};
+
+struct RelaySettings
+{
+    size_t maxBatchCount = 500;
+    size_t maxBatchBytes = 256 * 1024;
+    // A batch is closed at the latest this long after its first message
+    std::chrono::milliseconds maxBatchDelay{200};
+    // Sequence numbers of a (host, device, epoch) not seen for this long are forgotten
+    std::chrono::milliseconds dedupWindow{600000};
+    // An agent connection not authenticated within this time is closed
+    std::chrono::milliseconds handshakeTimeout{10000};
+    // Connections beyond this many pending authentications are refused on accepting
+    size_t maxPendingHandshakes = 256;
+};
+
+// Authentication of an agent connection: the relay sends a random challenge line, the agent answers with a line
+// of the HMAC-SHA256 of the challenge keyed with the shared secret, the relay confirms a valid one with a line
+// ACCEPTED and disconnects otherwise. The secret itself is never sent.
+class RelayHandshake final {
+public:
+    RelayHandshake() = delete;
+    DISALLOW_COPY_MOVE(RelayHandshake);
+    ~RelayHandshake() = delete;
+
+public:
+    static constexpr size_t MAX_LINE_SIZE = 128;
+    static constexpr auto ACCEPTED = "ok";
+
+    [[nodiscard]] static std::string CreateChallenge();
+    [[nodiscard]] static std::string CreateResponse(const std::string& secret, const std::string& challenge);
+    [[nodiscard]] static bool IsResponseValid(const std::string& secret, const std::string& challenge, const std::string& response);
+};
+
+// Fan-in of many agents: drops duplicates by (host, device, epoch, sequence), e.g. re-sent after a reconnect,
+// and collects the rest into batches closed by count, size or age. Not thread safe; time is passed in explicitly.
+class RelayAggregator final {
+public:
+    using Clock = std::chrono::system_clock;
+    using Batch = std::vector<RelayMessage>;
+
+public:
+    explicit RelayAggregator(const RelaySettings& settings);
+    DISALLOW_COPY_MOVE(RelayAggregator);
+    ~RelayAggregator() = default;
+
+public:
+    // false: a duplicate, dropped
+    bool Accept(RelayMessage message, Clock::time_point now);
+    // Closed batches; flushAll: the open batch, too
+    [[nodiscard]] std::vector<Batch> TakeBatches(Clock::time_point now, bool flushAll = false);
+
+    [[nodiscard]] uint64_t GetAcceptedCount() const;
+    [[nodiscard]] uint64_t GetDuplicateCount() const;
+    [[nodiscard]] size_t GetPendingCount() const;
+    [[nodiscard]] size_t GetDedupKeyCount() const;
+
+    // One gzip compressed JSON document: {"relayHostName": ..., "messages": [...]}
+    [[nodiscard]] static std::string CreateBatchPayload(const Batch& batch, const std::string& relayHostName);
+    [[nodiscard]] static Batch ParseBatchPayload(const std::string& compressedPayload);
+
+private:
+    struct DedupEntry
+    {
+        uint64_t lastSequence;
+        Clock::time_point lastSeen;
+    };
+
+    void CloseOpenBatch();
+    void PruneDedupEntries(Clock::time_point now);
+
+private:
+    const RelaySettings settings_;
+
+    std::unordered_map<std::string, DedupEntry> keyToDedupEntry_;
+    Clock::time_point lastPrune_;
+
+    Batch openBatch_;
+    size_t openBatchBytes_ = 0;
+    Clock::time_point openBatchStart_;
+    std::vector<Batch> closedBatches_;
+
+    uint64_t acceptedCount_ = 0;
+    uint64_t duplicateCount_ = 0;
+};
+}
@@ -0,0 +1,210 @@
+#include "os-dependencies.h"
+
+#include "RelayClientHttpRequestDispatcher.h"
+
+#include "RelayAggregator.h"
+
+#include <format>
+#include <random>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+#include <Poco/Net/NetException.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/StreamSocket.h>
+#include <spdlog/spdlog.h>
+
+
+namespace
+{
+    std::string CheckSecret(std::string secret)
+    {
+        if (secret.empty())
+        {
+            throw std::invalid_argument("Relay secret must not be empty");
+        }
+        return secret;
+    }
+
+    uint64_t CreateEpoch()
+    {
+        std::random_device randomDevice;
+        return (static_cast<uint64_t>(randomDevice()) << 32) | randomDevice();
+    }
+
+    // A handshake line, without the newline
+    std::string ReceiveLine(Poco::Net::StreamSocket& socket)
+    {
+        std::string line;
+        for (;;)
+        {
+            char c;
+            if (socket.receiveBytes(&c, 1) <= 0)
+            {
+                throw Poco::Net::ConnectionResetException("relay closed the connection");
+            }
+            if (c == '\n')
+            {
+                return line;
+            }
+            if (line.size() >= ed::RelayHandshake::MAX_LINE_SIZE)
+            {
+                throw Poco::ProtocolException("relay handshake line too long");
+            }
+            line += c;
+        }
+    }
+}
+
+RelayClientHttpRequestDispatcher::RelayClientHttpRequestDispatcher(std::string relayHost, uint16_t relayPort,
+                                                                   std::string secret, std::string hostName)
+    : relayHost_(std::move(relayHost))
+    , relayPort_(relayPort)
+    , secret_(CheckSecret(std::move(secret)))
+    , hostName_(std::move(hostName))
+    , epoch_(CreateEpoch())
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+}
+
+RelayClientHttpRequestDispatcher::~RelayClientHttpRequestDispatcher()
+{
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+}
+
+void RelayClientHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                      const std::string& urlSuffix, const std::string& payload,
+                                                      const std::unordered_map<std::string, std::string>& header,
+                                                      const std::string& hint)
+{
+    ed::RelayMessage relayMessage{
+        .hostName = hostName_,
+        .epoch = epoch_,
+        .message = {postOrPut, time, urlSuffix, payload, header, hint}
+    };
+    if (const auto json = nlohmann::json::parse(payload, nullptr, false);
+        json.is_object() && json.contains("pnpId") && json["pnpId"].is_string())
+    {
+        relayMessage.deviceId = json["pnpId"].get<std::string>();
+    }
+    auto onDelivered = ed::DeliveryReport::Take();
+
+    ed::DeliveryReport::Handler onDropped;
+    {
+        std::lock_guard lock(mutex_);
+        relayMessage.sequence = nextSequence_++;
+        queue_.push_back({relayMessage.ToNdjsonLine(), std::move(onDelivered)});
+        if (queue_.size() > MAX_QUEUE_SIZE)
+        {
+            onDropped = std::move(queue_.front().onDelivered);
+            queue_.pop_front();
+            if (++droppedCount_ % 1000 == 1)
+            {
+                spdlog::warn(R"(Relay "{}:{}" is not written fast enough; {} line(s) dropped so far.)", relayHost_, relayPort_, droppedCount_);
+            }
+        }
+    }
+    condition_.notify_one();
+    if (onDropped)
+    {
+        onDropped(false, "relay queue full");
+    }
+}
+
+void RelayClientHttpRequestDispatcher::Run(const std::stop_token& stopToken)
+{
+    for (;;)
+    {
+        QueuedLine queuedLine;
+        {
+            std::unique_lock lock(mutex_);
+            // Once stopped, the lines still queued are sent before leaving
+            condition_.wait(lock, stopToken, [this] { return !queue_.empty(); });
+            if (queue_.empty())
+            {
+                break;
+            }
+            queuedLine = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        // Written without holding the lock: enqueueing goes on meanwhile
+        const auto error = Deliver(queuedLine.line);
+        if (queuedLine.onDelivered)
+        {
+            queuedLine.onDelivered(error.empty(), error);
+        }
+    }
+}
+
+std::string RelayClientHttpRequestDispatcher::Deliver(const std::string& line)
+{
+    if (socket_ == nullptr && std::chrono::steady_clock::now() < reconnectNotBefore_)
+    {
+        return std::format(R"(relay "{}:{}" can not be reached)", relayHost_, relayPort_);
+    }
+    try
+    {
+        SendLine(line);
+        return {};
+    }
+    catch (const Poco::Exception& ex)
+    {
+        spdlog::info(R"(Relay "{}:{}" write failed: {}. Reconnecting...)", relayHost_, relayPort_, ex.displayText());
+        socket_.reset();
+    }
+    try
+    {
+        SendLine(line);
+        return {};
+    }
+    catch (const Poco::Exception& ex)
+    {
+        socket_.reset();
+        reconnectNotBefore_ = std::chrono::steady_clock::now() + RECONNECT_DELAY;
+        spdlog::warn(R"(Relay "{}:{}" can not be reached: {}. Reconnecting in {} s at the earliest.)", relayHost_, relayPort_,
+                     ex.displayText(), RECONNECT_DELAY.count());
+        return std::format(R"(relay "{}:{}" can not be reached: {})", relayHost_, relayPort_, ex.displayText());
+    }
+}
+
+void RelayClientHttpRequestDispatcher::SendLine(const std::string& line)
+{
+    if (socket_ == nullptr)
+    {
+        Connect();
+    }
+
+    for (size_t sent = 0; sent < line.size(); )
+    {
+        const auto sentNow = socket_->sendBytes(line.data() + sent, static_cast<int>(line.size() - sent));
+        if (sentNow <= 0)
+        {
+            throw Poco::Net::ConnectionResetException("relay closed the connection");
+        }
+        sent += static_cast<size_t>(sentNow);
+    }
+}
+
+void RelayClientHttpRequestDispatcher::Connect()
+{
+    const Poco::Timespan timeout(std::chrono::duration_cast<std::chrono::microseconds>(CONNECT_TIMEOUT).count());
+    auto socket = std::make_unique<Poco::Net::StreamSocket>();
+    socket->connect(Poco::Net::SocketAddress(relayHost_, relayPort_), timeout);
+    socket->setReceiveTimeout(timeout);
+
+    const auto challenge = ReceiveLine(*socket);
+    const auto response = ed::RelayHandshake::CreateResponse(secret_, challenge) + '\n';
+    socket->sendBytes(response.data(), static_cast<int>(response.size()));
+    if (ReceiveLine(*socket) != ed::RelayHandshake::ACCEPTED)
+    {
+        throw Poco::Net::ConnectionRefusedException("relay rejected the secret");
+    }
+
+    socket_ = std::move(socket);
+    spdlog::info(R"(Connected to relay "{}:{}".)", relayHost_, relayPort_);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "DeliveryReport.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Poco::Net
+{
+    class StreamSocket;
+}
+
+// Sink of an agent behind a relay: every request is stamped with the host name, the device PnP id,
+// the epoch of this sink and a sequence number and queued as an NDJSON line; an own worker writes
+// the lines to the relay over one TCP connection, authenticated with the shared secret (ed::RelayHandshake).
+// A line whose write fails is re-sent once over a new connection with the same sequence number,
+// so that the relay can drop it if the first write got through. The outcome of every line is reported
+// through an ed::DeliveryReport; once the relay could not be reached, lines fail without a connection
+// attempt for a reconnect delay. If the queue is full, the oldest line is dropped and reported failed.
+class RelayClientHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    // Throws std::invalid_argument if the secret is empty
+    RelayClientHttpRequestDispatcher(std::string relayHost, uint16_t relayPort, std::string secret, std::string hostName);
+
+    DISALLOW_COPY_MOVE(RelayClientHttpRequestDispatcher);
+    ~RelayClientHttpRequestDispatcher() override;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+    static constexpr size_t MAX_QUEUE_SIZE = 10000;
+
+private:
+    struct QueuedLine
+    {
+        std::string line;
+        ed::DeliveryReport::Handler onDelivered;
+    };
+
+    void Run(const std::stop_token& stopToken);
+    // Sends the line, re-sent once over a new connection; returns the error, empty if sent
+    std::string Deliver(const std::string& line);
+    // Called on the worker thread only
+    void SendLine(const std::string& line);
+    void Connect();
+
+private:
+    static constexpr std::chrono::seconds CONNECT_TIMEOUT{5};
+    static constexpr std::chrono::seconds RECONNECT_DELAY{5};
+
+    const std::string relayHost_;
+    const uint16_t relayPort_;
+    const std::string secret_;
+    const std::string hostName_;
+    // Random per sink instance: the relay tells the sequence numbers of a restarted agent from the old ones,
+    // whatever its clock did meanwhile
+    const uint64_t epoch_;
+
+    // Used by the worker only
+    std::unique_ptr<Poco::Net::StreamSocket> socket_;
+    std::chrono::steady_clock::time_point reconnectNotBefore_{};
+
+    std::mutex mutex_;
+    std::condition_variable_any condition_;
+    std::deque<QueuedLine> queue_;
+    uint64_t nextSequence_ = 1;
+    uint64_t droppedCount_ = 0;
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
@@ -0,0 +1,316 @@
+#include "os-dependencies.h"
+
+#include "RelayServer.h"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+#include <Poco/Exception.h>
+#include <Poco/NObserver.h>
+#include <Poco/Net/NetException.h>
+#include <Poco/Net/StreamSocket.h>
+#include <spdlog/spdlog.h>
+
+
+namespace
+{
+    std::string CheckSecret(std::string secret)
+    {
+        if (secret.empty())
+        {
+            throw std::invalid_argument("Relay secret must not be empty");
+        }
+        return secret;
+    }
+}
+
+// Authenticates one agent and reads its NDJSON lines; deletes itself when the agent disconnects,
+// fails the authentication or the reactor stops
+class RelayServer::Connection final
+{
+public:
+    // Throws Poco::Exception if the challenge can not be sent
+    Connection(const Poco::Net::StreamSocket& socket, Poco::Net::SocketReactor& reactor, RelayServer& server)
+        : socket_(socket)
+        , peer_(socket_.peerAddress().toString())
+        , reactor_(reactor)
+        , server_(server)
+        , challenge_(ed::RelayHandshake::CreateChallenge())
+    {
+        Send(challenge_ + '\n');
+        reactor_.addEventHandler(socket_, Poco::NObserver<Connection, Poco::Net::ReadableNotification>(*this, &Connection::OnReadable));
+        reactor_.addEventHandler(socket_, Poco::NObserver<Connection, Poco::Net::ShutdownNotification>(*this, &Connection::OnShutdown));
+        server_.AddPendingHandshake(this, socket_, peer_);
+    }
+
+    DISALLOW_COPY_MOVE(Connection);
+
+    ~Connection()
+    {
+        server_.RemovePendingHandshake(this);
+        reactor_.removeEventHandler(socket_, Poco::NObserver<Connection, Poco::Net::ReadableNotification>(*this, &Connection::OnReadable));
+        reactor_.removeEventHandler(socket_, Poco::NObserver<Connection, Poco::Net::ShutdownNotification>(*this, &Connection::OnShutdown));
+    }
+
+private:
+    void OnReadable(const Poco::AutoPtr<Poco::Net::ReadableNotification>&)
+    {
+        char chunk[16384];
+        int received = 0;
+        try
+        {
+            received = socket_.receiveBytes(chunk, sizeof(chunk));
+        }
+        catch (const Poco::Exception& ex)
+        {
+            spdlog::info(R"(Relay connection "{}" failed: {}.)", peer_, ex.displayText());
+        }
+        if (received <= 0)
+        {
+            delete this;
+            return;
+        }
+
+        buffer_.append(chunk, static_cast<size_t>(received));
+        std::vector<ed::RelayMessage> messages;
+        size_t lineStart = 0;
+        for (auto lineEnd = buffer_.find('\n'); lineEnd != std::string::npos; lineEnd = buffer_.find('\n', lineStart))
+        {
+            if (!authenticated_)
+            {
+                if (!Authenticate(buffer_.substr(lineStart, lineEnd - lineStart)))
+                {
+                    delete this;
+                    return;
+                }
+            }
+            else if (auto message = ed::RelayMessage::FromNdjsonLine(buffer_.substr(lineStart, lineEnd - lineStart)))
+            {
+                messages.push_back(std::move(*message));
+            }
+            else
+            {
+                spdlog::warn(R"(Relay connection "{}" sent an invalid line; ignored.)", peer_);
+            }
+            lineStart = lineEnd + 1;
+        }
+        buffer_.erase(0, lineStart);
+        if (const auto maxLineSize = authenticated_ ? MAX_LINE_SIZE : ed::RelayHandshake::MAX_LINE_SIZE;
+            buffer_.size() > maxLineSize)
+        {
+            spdlog::warn(R"(Relay connection "{}" sent a line longer than {} bytes; disconnected.)", peer_, maxLineSize);
+            delete this;
+            return;
+        }
+        if (!messages.empty())
+        {
+            server_.Accept(std::move(messages));
+        }
+    }
+
+    void OnShutdown(const Poco::AutoPtr<Poco::Net::ShutdownNotification>&)
+    {
+        delete this;
+    }
+
+    // false: the connection is to be closed
+    bool Authenticate(const std::string& response)
+    {
+        if (!ed::RelayHandshake::IsResponseValid(server_.secret_, challenge_, response))
+        {
+            spdlog::warn(R"(Relay connection "{}" failed the authentication; disconnected.)", peer_);
+            return false;
+        }
+        try
+        {
+            Send(std::string(ed::RelayHandshake::ACCEPTED) + '\n');
+        }
+        catch (const Poco::Exception& ex)
+        {
+            spdlog::info(R"(Relay connection "{}" failed: {}.)", peer_, ex.displayText());
+            return false;
+        }
+        authenticated_ = true;
+        server_.RemovePendingHandshake(this);
+        return true;
+    }
+
+    // A handshake line: short enough not to block the reactor thread
+    void Send(const std::string& line)
+    {
+        if (socket_.sendBytes(line.data(), static_cast<int>(line.size())) != static_cast<int>(line.size()))
+        {
+            throw Poco::Net::ConnectionResetException("handshake line not sent");
+        }
+    }
+
+private:
+    static constexpr size_t MAX_LINE_SIZE = 4 * 1024 * 1024;
+
+    Poco::Net::StreamSocket socket_;
+    const std::string peer_;
+    Poco::Net::SocketReactor& reactor_;
+    RelayServer& server_;
+    const std::string challenge_;
+    bool authenticated_ = false;
+    std::string buffer_;
+};
+
+RelayServer::RelayServer(HttpRequestDispatcherInterface& targetDispatcher, const Poco::Net::SocketAddress& listenAddress,
+                         std::string secret, const ed::RelaySettings& settings, std::string relayHostName,
+                         const ed::ClockInterface& clock)
+    : targetDispatcher_(targetDispatcher)
+    , clock_(clock)
+    , secret_(CheckSecret(std::move(secret)))
+    , relayHostName_(std::move(relayHostName))
+    , flushInterval_(std::clamp<std::chrono::milliseconds>(settings.maxBatchDelay / 4, std::chrono::milliseconds(10), std::chrono::milliseconds(1000)))
+    , handshakeTimeout_(settings.handshakeTimeout)
+    , maxPendingHandshakes_(settings.maxPendingHandshakes)
+    , aggregator_(settings)
+    , serverSocket_(listenAddress)
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+    reactor_.addEventHandler(serverSocket_, Poco::NObserver<RelayServer, Poco::Net::ReadableNotification>(*this, &RelayServer::OnAcceptable));
+    reactorThread_ = std::thread([this] { reactor_.run(); });
+    spdlog::info("Relay listening on {}: batches of up to {} messages / {} bytes, closed after {} ms at the latest.",
+                 serverSocket_.address().toString(), settings.maxBatchCount, settings.maxBatchBytes, settings.maxBatchDelay.count());
+}
+
+RelayServer::~RelayServer()
+{
+    reactor_.stop(); // the connections get the shutdown notification and delete themselves
+    if (reactorThread_.joinable())
+    {
+        reactorThread_.join();
+    }
+    reactor_.removeEventHandler(serverSocket_, Poco::NObserver<RelayServer, Poco::Net::ReadableNotification>(*this, &RelayServer::OnAcceptable));
+
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+    spdlog::info("Relay stopped: {} message(s) accepted, {} duplicate(s) dropped.", GetAcceptedCount(), GetDuplicateCount());
+}
+
+uint16_t RelayServer::GetPort() const
+{
+    return serverSocket_.address().port();
+}
+
+uint64_t RelayServer::GetAcceptedCount() const
+{
+    std::lock_guard lock(mutex_);
+    return aggregator_.GetAcceptedCount();
+}
+
+uint64_t RelayServer::GetDuplicateCount() const
+{
+    std::lock_guard lock(mutex_);
+    return aggregator_.GetDuplicateCount();
+}
+
+void RelayServer::OnAcceptable(const Poco::AutoPtr<Poco::Net::ReadableNotification>&)
+{
+    try
+    {
+        const auto socket = serverSocket_.acceptConnection();
+        {
+            std::lock_guard lock(mutex_);
+            if (pendingHandshakes_.size() >= maxPendingHandshakes_)
+            {
+                ++refusedCount_; // closed on leaving
+                return;
+            }
+        }
+        new Connection(socket, reactor_, *this); // NOLINT(cppcoreguidelines-owning-memory): deletes itself
+    }
+    catch (const Poco::Exception& ex)
+    {
+        spdlog::warn("Relay connection can not be accepted: {}.", ex.displayText());
+    }
+}
+
+void RelayServer::Accept(std::vector<ed::RelayMessage> messages)
+{
+    const auto now = clock_.SystemNow();
+    std::lock_guard lock(mutex_);
+    for (auto& message : messages)
+    {
+        aggregator_.Accept(std::move(message), now);
+    }
+}
+
+void RelayServer::AddPendingHandshake(const Connection* connection, const Poco::Net::StreamSocket& socket, const std::string& peer)
+{
+    std::lock_guard lock(mutex_);
+    pendingHandshakes_.emplace(connection, PendingHandshake{socket, peer, clock_.SteadyNow() + handshakeTimeout_});
+}
+
+void RelayServer::RemovePendingHandshake(const Connection* connection)
+{
+    std::lock_guard lock(mutex_);
+    pendingHandshakes_.erase(connection);
+}
+
+void RelayServer::Run(const std::stop_token& stopToken)
+{
+    std::unique_lock lock(mutex_);
+    while (!stopToken.stop_requested())
+    {
+        clock_.WaitUntil(condition_, lock, stopToken, clock_.SteadyNow() + flushInterval_, [] { return false; });
+        SweepPendingHandshakes();
+        const auto batches = aggregator_.TakeBatches(clock_.SystemNow(), stopToken.stop_requested());
+        lock.unlock();
+        for (const auto& batch : batches)
+        {
+            Forward(batch);
+        }
+        lock.lock();
+    }
+}
+
+void RelayServer::SweepPendingHandshakes()
+{
+    if (refusedCount_ > 0)
+    {
+        spdlog::warn("Relay refused {} connection(s): {} authentications pending.", refusedCount_, maxPendingHandshakes_);
+        refusedCount_ = 0;
+    }
+    const auto now = clock_.SteadyNow();
+    for (auto handshake = pendingHandshakes_.begin(); handshake != pendingHandshakes_.end();)
+    {
+        auto& [socket, peer, deadline] = handshake->second;
+        if (now < deadline)
+        {
+            ++handshake;
+            continue;
+        }
+        spdlog::warn(R"(Relay connection "{}" did not authenticate within {} ms; disconnected.)", peer, handshakeTimeout_.count());
+        try
+        {
+            socket.shutdown();
+        }
+        catch (const Poco::Exception& ex)
+        {
+            spdlog::info(R"(Relay connection "{}" can not be shut down: {}.)", peer, ex.displayText());
+        }
+        handshake = pendingHandshakes_.erase(handshake);
+    }
+}
+
+void RelayServer::Forward(const ed::RelayAggregator::Batch& batch) const
+{
+    try
+    {
+        targetDispatcher_.EnqueueRequest(true, clock_.SystemNow(), RELAY_BATCH_URL_SUFFIX,
+                                         ed::RelayAggregator::CreateBatchPayload(batch, relayHostName_),
+                                         {{"Content-Type", "application/json"}, {"Content-Encoding", "gzip"}},
+                                         std::format("Relay batch of {} message(s)", batch.size()));
+    }
+    catch (const std::exception& ex)
+    {
+        spdlog::warn("Relay batch of {} message(s) can not be forwarded: {}.", batch.size(), ex.what());
+    }
+}
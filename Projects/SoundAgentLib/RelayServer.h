@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "Clock.h"
+#include "RelayAggregator.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <Poco/AutoPtr.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/SocketNotification.h>
+#include <Poco/Net/SocketReactor.h>
+#include <Poco/Net/StreamSocket.h>
+
+// Relay mode: accepts the NDJSON lines of many RelayClientHttpRequestDispatcher agents on one TCP address,
+// all connections served by one reactor thread, deduplicates and batches them (RelayAggregator) and
+// forwards every batch gzip compressed as one request to the target dispatcher, e.g. the sink fan-out.
+// An agent is only read from after it proved to know the shared secret (ed::RelayHandshake); the worker closes
+// the connections not authenticated in time, whether the reactor is idle or not.
+class RelayServer final
+{
+public:
+    // Throws std::invalid_argument if the secret is empty
+    RelayServer(HttpRequestDispatcherInterface& targetDispatcher, const Poco::Net::SocketAddress& listenAddress,
+                std::string secret, const ed::RelaySettings& settings, std::string relayHostName,
+                const ed::ClockInterface& clock = ed::SystemClock::GetInstance());
+
+    DISALLOW_COPY_MOVE(RelayServer);
+    ~RelayServer();
+
+public:
+    [[nodiscard]] uint16_t GetPort() const;
+    [[nodiscard]] uint64_t GetAcceptedCount() const;
+    [[nodiscard]] uint64_t GetDuplicateCount() const;
+
+    static constexpr auto RELAY_BATCH_URL_SUFFIX = "/relay/batch";
+
+private:
+    class Connection;
+
+    void OnAcceptable(const Poco::AutoPtr<Poco::Net::ReadableNotification>& notification);
+    // Called by the connections on the reactor thread
+    void Accept(std::vector<ed::RelayMessage> messages);
+    void AddPendingHandshake(const Connection* connection, const Poco::Net::StreamSocket& socket, const std::string& peer);
+    void RemovePendingHandshake(const Connection* connection);
+
+    void Run(const std::stop_token& stopToken);
+    // Under mutex_: shuts the sockets of the expired handshakes down, the reactor then deletes their connections
+    void SweepPendingHandshakes();
+    void Forward(const ed::RelayAggregator::Batch& batch) const;
+
+private:
+    HttpRequestDispatcherInterface& targetDispatcher_;
+    const ed::ClockInterface& clock_;
+    const std::string secret_;
+    const std::string relayHostName_;
+    const std::chrono::milliseconds flushInterval_;
+    const std::chrono::milliseconds handshakeTimeout_;
+    const size_t maxPendingHandshakes_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any condition_;
+    ed::RelayAggregator aggregator_;
+    // Of the connections until their authentication, their deadline or their deletion
+    struct PendingHandshake
+    {
+        Poco::Net::StreamSocket socket; // a handle of the connection's one
+        std::string peer;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::map<const Connection*, PendingHandshake> pendingHandshakes_;
+    uint64_t refusedCount_ = 0; // since the last sweep
+
+    Poco::Net::ServerSocket serverSocket_;
+    Poco::Net::SocketReactor reactor_;
+    std::thread reactorThread_;
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
@@ -0,0 +1,255 @@
+#include "os-dependencies.h"
+
+#include "RetryScheduler.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+
+std::chrono::milliseconds ed::GetBackoffDelay(const BackoffSettings& settings, unsigned retry, std::mt19937& randomGenerator)
+{
+    // initialDelay * 2^(retry-1), capped without overflowing
+    auto ceiling = settings.initialDelay;
+    for (unsigned i = 1; i < retry && ceiling < settings.maxDelay; ++i)
+    {
+        ceiling *= 2;
+    }
+    ceiling = std::min(ceiling, settings.maxDelay);
+    return std::chrono::milliseconds(
+        std::uniform_int_distribution<std::chrono::milliseconds::rep>(0, ceiling.count())(randomGenerator));
+}
+
+ed::CircuitBreaker::CircuitBreaker(const CircuitBreakerSettings& settings)
+    : settings_(settings)
+{
+}
+
+bool ed::CircuitBreaker::AllowRequest(Clock::time_point now)
+{
+    switch (state_)
+    {
+    case State::Closed:
+        return true;
+    case State::Open:
+        if (now < reopenTime_)
+        {
+            return false;
+        }
+        state_ = State::HalfOpen;
+        return true; // the trial request
+    case State::HalfOpen:
+        return false; // the trial request is not decided yet
+    }
+    return false;
+}
+
+void ed::CircuitBreaker::OnSuccess()
+{
+    state_ = State::Closed;
+    consecutiveFailures_ = 0;
+}
+
+void ed::CircuitBreaker::OnFailure(Clock::time_point now)
+{
+    ++consecutiveFailures_;
+    if (state_ == State::HalfOpen
+        || (settings_.failureThreshold > 0 && consecutiveFailures_ >= settings_.failureThreshold))
+    {
+        state_ = State::Open;
+        reopenTime_ = now + settings_.openDuration;
+    }
+}
+
+ed::CircuitBreaker::State ed::CircuitBreaker::GetState() const
+{
+    return state_;
+}
+
+ed::CircuitBreaker::Clock::time_point ed::CircuitBreaker::GetReopenTime() const
+{
+    return reopenTime_;
+}
+
+ed::RetryScheduler::RetryScheduler(std::string name, SendFunction send, const RetrySettings& settings,
+                                   Clock::time_point start, uint32_t randomSeed)
+    : name_(std::move(name))
+    , send_(std::move(send))
+    , backoffSettings_(settings.backoff)
+    , circuitBreaker_(settings.circuitBreaker)
+    , timerWheel_(TICK_DURATION, SLOT_COUNT, start)
+    , randomGenerator_(randomSeed)
+{
+}
+
+void ed::RetryScheduler::Submit(OutgoingMessage message, Clock::time_point now)
+{
+    Deliver({std::move(message), 0}, now);
+}
+
+void ed::RetryScheduler::Advance(Clock::time_point now)
+{
+    for (const auto timerId : timerWheel_.Advance(now))
+    {
+        const auto foundPair = timerIdToWaiting_.find(timerId);
+        if (foundPair == timerIdToWaiting_.end())
+        {
+            continue;
+        }
+        auto pending = std::move(foundPair->second->pending);
+        waiting_.erase(foundPair->second);
+        timerIdToWaiting_.erase(foundPair);
+        Deliver(std::move(pending), now);
+    }
+}
+
+void ed::RetryScheduler::OnDeliveryResult(DeliveryId deliveryId, bool delivered, const std::string& error, Clock::time_point now)
+{
+    auto node = inFlight_.extract(deliveryId);
+    if (node.empty())
+    {
+        return;
+    }
+    if (delivered)
+    {
+        OnDelivered();
+        return;
+    }
+    OnFailed(std::move(node.mapped()), error, now);
+}
+
+void ed::RetryScheduler::Deliver(Pending pending, Clock::time_point now)
+{
+    if (!circuitBreaker_.AllowRequest(now))
+    {
+        // Held back without counting an attempt; spread over the first tick after reopening
+        Schedule(std::move(pending), std::max(circuitBreaker_.GetReopenTime(), now + TICK_DURATION));
+        return;
+    }
+
+    ++pending.attempts;
+    ++attemptCount_;
+    if (pending.attempts > 1)
+    {
+        ++retryCount_;
+    }
+    std::string error;
+    try
+    {
+        const auto deliveryId = ++lastDeliveryId_;
+        if (send_(pending.message, deliveryId))
+        {
+            OnDelivered();
+        }
+        else
+        {
+            inFlight_.emplace(deliveryId, std::move(pending));
+        }
+        return;
+    }
+    catch (const std::exception& ex)
+    {
+        error = ex.what();
+    }
+    OnFailed(std::move(pending), error, now);
+}
+
+void ed::RetryScheduler::OnDelivered()
+{
+    const auto stateBefore = circuitBreaker_.GetState();
+    circuitBreaker_.OnSuccess();
+    ++deliveredCount_;
+    if (isFailing_)
+    {
+        isFailing_ = false;
+        ++recoveryCount_;
+    }
+    if (stateBefore != CircuitBreaker::State::Closed)
+    {
+        spdlog::info(R"(Sink "{}" recovered; circuit closed.)", name_);
+    }
+}
+
+void ed::RetryScheduler::OnFailed(Pending pending, const std::string& error, Clock::time_point now)
+{
+    ++failedCount_;
+    isFailing_ = true;
+    const auto stateBefore = circuitBreaker_.GetState();
+    circuitBreaker_.OnFailure(now);
+    if (circuitBreaker_.GetState() == CircuitBreaker::State::Open && stateBefore == CircuitBreaker::State::Closed)
+    {
+        spdlog::warn(R"(Sink "{}" failing ({}); circuit open, {} message(s) pending.)", name_, error, waiting_.size() + 1);
+    }
+
+    if (pending.attempts >= backoffSettings_.maxAttempts)
+    {
+        ++droppedCount_;
+        spdlog::warn(R"(Sink "{}": message "{}" dropped after {} attempt(s).)", name_, pending.message.hint, pending.attempts);
+        return;
+    }
+    const auto delay = GetBackoffDelay(backoffSettings_, pending.attempts, randomGenerator_);
+    Schedule(std::move(pending), now + delay);
+}
+
+void ed::RetryScheduler::Schedule(Pending pending, Clock::time_point due)
+{
+    if (waiting_.size() >= MAX_PENDING_COUNT)
+    {
+        const auto oldestTimerId = waiting_.front().timerId;
+        timerWheel_.Cancel(oldestTimerId);
+        timerIdToWaiting_.erase(oldestTimerId);
+        waiting_.pop_front();
+        if (++droppedCount_ % MAX_PENDING_COUNT == 1)
+        {
+            spdlog::warn(R"(Sink "{}": too many messages waiting for a retry; {} dropped so far.)", name_, droppedCount_);
+        }
+    }
+    const auto timerId = timerWheel_.Schedule(due);
+    waiting_.push_back({std::move(pending), timerId});
+    timerIdToWaiting_.emplace(timerId, std::prev(waiting_.end()));
+}
+
+size_t ed::RetryScheduler::GetPendingCount() const
+{
+    return waiting_.size();
+}
+
+size_t ed::RetryScheduler::GetInFlightCount() const
+{
+    return inFlight_.size();
+}
+
+uint64_t ed::RetryScheduler::GetDeliveredCount() const
+{
+    return deliveredCount_;
+}
+
+uint64_t ed::RetryScheduler::GetDroppedCount() const
+{
+    return droppedCount_;
+}
+
+uint64_t ed::RetryScheduler::GetAttemptCount() const
+{
+    return attemptCount_;
+}
+
+uint64_t ed::RetryScheduler::GetFailedCount() const
+{
+    return failedCount_;
+}
+
+uint64_t ed::RetryScheduler::GetRecoveryCount() const
+{
+    return recoveryCount_;
+}
+
+uint64_t ed::RetryScheduler::GetRetryCount() const
+{
+    return retryCount_;
+}
+
+ed::CircuitBreaker::State ed::RetryScheduler::GetCircuitState() const
+{
+    return circuitBreaker_.GetState();
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "OutgoingMessage.h"
+#include "TimerWheel.h"
+
+#include <functional>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+
+namespace ed {
+struct BackoffSettings
+{
+    std::chrono::milliseconds initialDelay{1000};
+    std::chrono::milliseconds maxDelay{300000};
+    // Delivery attempts per message including the first one; 1: no retry
+    unsigned maxAttempts = 1;
+};
+
+struct CircuitBreakerSettings
+{
+    // Consecutive failures that open the circuit; 0: never opens
+    unsigned failureThreshold = 5;
+    std::chrono::milliseconds openDuration{60000};
+};
+
+struct RetrySettings
+{
+    BackoffSettings backoff;
+    CircuitBreakerSettings circuitBreaker;
+};
+
+// Capped exponential backoff with full jitter: the n-th retry waits a random time
+// in [0, min(maxDelay, initialDelay * 2^(n-1))], so that many agents do not retry in lockstep.
+[[nodiscard]] std::chrono::milliseconds GetBackoffDelay(const BackoffSettings& settings, unsigned retry, std::mt19937& randomGenerator);
+
+// Closed: requests pass. Open: requests are held back for the open duration.
+// Half open: one trial request decides whether the circuit closes or opens again.
+class CircuitBreaker final {
+public:
+    using Clock = TimerWheel::Clock;
+
+    enum class State : uint8_t
+    {
+        Closed = 0,
+        Open,
+        HalfOpen
+    };
+
+public:
+    explicit CircuitBreaker(const CircuitBreakerSettings& settings);
+    DISALLOW_COPY_MOVE(CircuitBreaker);
+    ~CircuitBreaker() = default;
+
+public:
+    [[nodiscard]] bool AllowRequest(Clock::time_point now);
+    void OnSuccess();
+    void OnFailure(Clock::time_point now);
+
+    [[nodiscard]] State GetState() const;
+    [[nodiscard]] Clock::time_point GetReopenTime() const;
+
+private:
+    const CircuitBreakerSettings settings_;
+    State state_ = State::Closed;
+    unsigned consecutiveFailures_ = 0;
+    Clock::time_point reopenTime_;
+};
+
+// Delivers messages through the send function and re-schedules failed ones on a timer wheel with backoff,
+// guarded by a circuit breaker. The send function throws on failure; it returns true if the message is delivered
+// or false if the outcome is reported later through OnDeliveryResult, e.g. by a sink writing from an own thread.
+// Submit, Advance and OnDeliveryResult are O(1) per message. Not thread safe; time is passed in explicitly.
+class RetryScheduler final {
+public:
+    using Clock = TimerWheel::Clock;
+    using DeliveryId = uint64_t;
+    using SendFunction = std::function<bool(const OutgoingMessage&, DeliveryId)>;
+
+public:
+    RetryScheduler(std::string name, SendFunction send, const RetrySettings& settings, Clock::time_point start,
+                   uint32_t randomSeed = std::random_device{}());
+    DISALLOW_COPY_MOVE(RetryScheduler);
+    ~RetryScheduler() = default;
+
+public:
+    void Submit(OutgoingMessage message, Clock::time_point now);
+    void Advance(Clock::time_point now);
+    // The outcome of a send that returned false; not to be called from within the send function
+    void OnDeliveryResult(DeliveryId deliveryId, bool delivered, const std::string& error, Clock::time_point now);
+
+    // Waiting for a retry
+    [[nodiscard]] size_t GetPendingCount() const;
+    // Sent, the outcome not reported yet
+    [[nodiscard]] size_t GetInFlightCount() const;
+    [[nodiscard]] uint64_t GetDeliveredCount() const;
+    [[nodiscard]] uint64_t GetDroppedCount() const;
+    [[nodiscard]] uint64_t GetAttemptCount() const;
+    [[nodiscard]] uint64_t GetFailedCount() const;
+    // Deliveries following a failure, e.g. after the target reconnected
+    [[nodiscard]] uint64_t GetRecoveryCount() const;
+    // Attempts after the first one of a message
+    [[nodiscard]] uint64_t GetRetryCount() const;
+    [[nodiscard]] CircuitBreaker::State GetCircuitState() const;
+
+    static constexpr auto TICK_DURATION = std::chrono::milliseconds(100);
+    static constexpr size_t SLOT_COUNT = 512;
+    static constexpr size_t MAX_PENDING_COUNT = 10000;
+
+private:
+    struct Pending
+    {
+        OutgoingMessage message;
+        unsigned attempts;
+    };
+
+    struct Waiting
+    {
+        Pending pending;
+        TimerWheel::TimerId timerId;
+    };
+
+    void Deliver(Pending pending, Clock::time_point now);
+    void OnDelivered();
+    void OnFailed(Pending pending, const std::string& error, Clock::time_point now);
+    void Schedule(Pending pending, Clock::time_point due);
+
+private:
+    const std::string name_;
+    const SendFunction send_;
+    const BackoffSettings backoffSettings_;
+    CircuitBreaker circuitBreaker_;
+    TimerWheel timerWheel_;
+    std::mt19937 randomGenerator_;
+    // In the order of scheduling: the first one is the longest waiting, dropped on overflow
+    std::list<Waiting> waiting_;
+    std::unordered_map<TimerWheel::TimerId, std::list<Waiting>::iterator> timerIdToWaiting_;
+    std::unordered_map<DeliveryId, Pending> inFlight_;
+    DeliveryId lastDeliveryId_ = 0;
+    uint64_t deliveredCount_ = 0;
+    uint64_t droppedCount_ = 0;
+    uint64_t attemptCount_ = 0;
+    uint64_t failedCount_ = 0;
+    uint64_t recoveryCount_ = 0;
+    uint64_t retryCount_ = 0;
+    bool isFailing_ = false;
+};
+}
@@ -0,0 +1,114 @@
+#include "os-dependencies.h"
+
+#include "RetryingHttpRequestDispatcher.h"
+
+#include "DeliveryReport.h"
+
+#include <spdlog/spdlog.h>
+
+
+RetryingHttpRequestDispatcher::RetryingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher,
+                                                             const std::string& name,
+                                                             const ed::RetrySettings& settings,
+                                                             const ed::ClockInterface& clock)
+    : targetDispatcher_(targetDispatcher)
+    , clock_(clock)
+    , deliveryResults_(std::make_shared<DeliveryResults>())
+    , scheduler_(name,
+                 [this](const ed::OutgoingMessage& message, ed::RetryScheduler::DeliveryId deliveryId) { return Send(message, deliveryId); },
+                 settings, clock_.SteadyNow())
+    , worker_([this](const std::stop_token& stopToken) { Run(stopToken); })
+{
+}
+
+RetryingHttpRequestDispatcher::~RetryingHttpRequestDispatcher()
+{
+    worker_.request_stop();
+    if (worker_.joinable())
+    {
+        worker_.join();
+    }
+    if (const auto pendingCount = scheduler_.GetPendingCount() + scheduler_.GetInFlightCount(); pendingCount > 0)
+    {
+        spdlog::warn("Retrying dispatcher stopping; {} request(s) waiting for a retry or a delivery report are lost.", pendingCount);
+    }
+}
+
+void RetryingHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                   const std::string& urlSuffix, const std::string& payload,
+                                                   const std::unordered_map<std::string, std::string>& header,
+                                                   const std::string& hint)
+{
+    std::lock_guard lock(mutex_);
+    const auto recoveryCountBefore = scheduler_.GetRecoveryCount();
+    scheduler_.Submit({postOrPut, time, urlSuffix, payload, header, hint}, clock_.SteadyNow());
+    NotifyIfRecovered(recoveryCountBefore);
+}
+
+uint64_t RetryingHttpRequestDispatcher::GetFailedCount() const
+{
+    std::lock_guard lock(mutex_);
+    return scheduler_.GetFailedCount();
+}
+
+uint64_t RetryingHttpRequestDispatcher::GetRetryCount() const
+{
+    std::lock_guard lock(mutex_);
+    return scheduler_.GetRetryCount();
+}
+
+bool RetryingHttpRequestDispatcher::IsCircuitOpen() const
+{
+    std::lock_guard lock(mutex_);
+    return scheduler_.GetCircuitState() == ed::CircuitBreaker::State::Open;
+}
+
+void RetryingHttpRequestDispatcher::SetRecoveredHandler(std::function<void()> onRecovered)
+{
+    std::lock_guard lock(mutex_);
+    onRecovered_ = std::move(onRecovered);
+}
+
+void RetryingHttpRequestDispatcher::Run(const std::stop_token& stopToken)
+{
+    std::unique_lock lock(mutex_);
+    while (!stopToken.stop_requested())
+    {
+        clock_.WaitUntil(condition_, lock, stopToken, clock_.SteadyNow() + ed::RetryScheduler::TICK_DURATION, [] { return false; });
+        const auto now = clock_.SteadyNow();
+        const auto recoveryCountBefore = scheduler_.GetRecoveryCount();
+
+        std::vector<DeliveryResult> deliveryResults;
+        {
+            std::lock_guard deliveryResultsLock(deliveryResults_->mutex);
+            deliveryResults.swap(deliveryResults_->results);
+        }
+        for (const auto& [deliveryId, delivered, error] : deliveryResults)
+        {
+            scheduler_.OnDeliveryResult(deliveryId, delivered, error, now);
+        }
+        scheduler_.Advance(now);
+        NotifyIfRecovered(recoveryCountBefore);
+    }
+}
+
+bool RetryingHttpRequestDispatcher::Send(const ed::OutgoingMessage& message, ed::RetryScheduler::DeliveryId deliveryId)
+{
+    // Taken over by a target delivering later; the outcome is passed to the scheduler on the next tick
+    const ed::DeliveryReport::Scope deliveryReport([deliveryResults = deliveryResults_, deliveryId](bool delivered, const std::string& error)
+        {
+            std::lock_guard deliveryResultsLock(deliveryResults->mutex);
+            deliveryResults->results.push_back({deliveryId, delivered, error});
+        });
+    targetDispatcher_.EnqueueRequest(message.postOrPut, message.time, message.urlSuffix, message.payload,
+                                     message.header, message.hint);
+    return !deliveryReport.IsTaken();
+}
+
+void RetryingHttpRequestDispatcher::NotifyIfRecovered(uint64_t recoveryCountBefore) const
+{
+    if (scheduler_.GetRecoveryCount() != recoveryCountBefore && onRecovered_)
+    {
+        onRecovered_();
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "Clock.h"
+#include "RetryScheduler.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Decorator delivering to the target dispatcher and, if the delivery fails, retrying with backoff
+// from an own timer thread. A circuit breaker holds the requests back while the target keeps failing.
+// A failure is an exception of the target or, for a target delivering later, a failed ed::DeliveryReport.
+class RetryingHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    RetryingHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher, const std::string& name,
+                                  const ed::RetrySettings& settings,
+                                  const ed::ClockInterface& clock = ed::SystemClock::GetInstance());
+
+    DISALLOW_COPY_MOVE(RetryingHttpRequestDispatcher);
+    ~RetryingHttpRequestDispatcher() override;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+    // Failed delivery attempts, retries included
+    [[nodiscard]] uint64_t GetFailedCount() const;
+    [[nodiscard]] uint64_t GetRetryCount() const;
+    // The target keeps failing: requests are held back
+    [[nodiscard]] bool IsCircuitOpen() const;
+    // Called once the target delivers again after failing, e.g. reconnected; with the lock held, so it must not
+    // call back into this dispatcher. nullptr: none
+    void SetRecoveredHandler(std::function<void()> onRecovered);
+
+private:
+    struct DeliveryResult
+    {
+        ed::RetryScheduler::DeliveryId deliveryId;
+        bool delivered;
+        std::string error;
+    };
+
+    // Reported by the target from its threads, possibly from within EnqueueRequest or after this dispatcher is gone
+    struct DeliveryResults
+    {
+        std::mutex mutex;
+        std::vector<DeliveryResult> results;
+    };
+
+    void Run(const std::stop_token& stopToken);
+    // Called with the lock held; false if the target reports the outcome later
+    bool Send(const ed::OutgoingMessage& message, ed::RetryScheduler::DeliveryId deliveryId);
+    // Called with the lock held
+    void NotifyIfRecovered(uint64_t recoveryCountBefore) const;
+
+private:
+    HttpRequestDispatcherInterface& targetDispatcher_;
+    const ed::ClockInterface& clock_;
+    const std::shared_ptr<DeliveryResults> deliveryResults_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any condition_;
+    ed::RetryScheduler scheduler_;
+    std::function<void()> onRecovered_;
+
+    std::jthread worker_; // last: starts after all the other members are initialized
+};
@@ -0,0 +1,224 @@
+#include "os-dependencies.h"
+
+#include "SentDeviceStateCache.h"
+
+#include "ApiClient/common/TimeUtil.h"
+
+#include <fstream>
+
+#include <magic_enum/magic_enum.hpp>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+
+ed::audio::SentDeviceStateCache::SentDeviceStateCache(std::filesystem::path storagePathName,
+                                                      std::chrono::system_clock::duration checkpointInterval)
+    : storagePathName_(std::move(storagePathName))
+    , checkpointInterval_(checkpointInterval)
+{
+}
+
+uint8_t ed::audio::SentDeviceStateCache::Compare(const SentState& sent, const SoundDeviceInterface& device)
+{
+    uint8_t changedFields = NoField;
+    if (sent.name != device.GetName())
+    {
+        changedFields |= NameField;
+    }
+    if (sent.flow != device.GetFlow())
+    {
+        changedFields |= FlowField;
+    }
+    if (sent.renderVolume != device.GetCurrentRenderVolume())
+    {
+        changedFields |= RenderVolumeField;
+    }
+    if (sent.captureVolume != device.GetCurrentCaptureVolume())
+    {
+        changedFields |= CaptureVolumeField;
+    }
+    if (sent.renderIsDefault != device.IsRenderCurrentlyDefault())
+    {
+        changedFields |= RenderDefaultField;
+    }
+    if (sent.captureIsDefault != device.IsCaptureCurrentlyDefault())
+    {
+        changedFields |= CaptureDefaultField;
+    }
+    return changedFields;
+}
+
+ed::audio::SentDeviceStateCache::Decision ed::audio::SentDeviceStateCache::Classify(
+    const SoundDeviceInterface& device, std::chrono::system_clock::time_point now) const
+{
+    std::lock_guard lock(mutex_);
+    const auto foundPair = pnpIdToSentState_.find(device.GetPnpId());
+    if (foundPair == pnpIdToSentState_.end())
+    {
+        return {SendKind::Full, NoField};
+    }
+    const auto& sent = foundPair->second;
+    if (now - sent.lastFullSend >= checkpointInterval_)
+    {
+        return {SendKind::Full, Compare(sent, device)};
+    }
+    const auto changedFields = Compare(sent, device);
+    return {changedFields == NoField ? SendKind::Nothing : SendKind::Delta, changedFields};
+}
+
+void ed::audio::SentDeviceStateCache::MarkSent(const SoundDeviceInterface& device, bool fullRecord,
+                                               std::chrono::system_clock::time_point now)
+{
+    std::lock_guard lock(mutex_);
+    auto& sent = pnpIdToSentState_[device.GetPnpId()];
+    sent.name = device.GetName();
+    sent.flow = device.GetFlow();
+    sent.renderVolume = device.GetCurrentRenderVolume();
+    sent.captureVolume = device.GetCurrentCaptureVolume();
+    sent.renderIsDefault = device.IsRenderCurrentlyDefault();
+    sent.captureIsDefault = device.IsCaptureCurrentlyDefault();
+    if (fullRecord)
+    {
+        sent.lastFullSend = now;
+    }
+    modified_ = true;
+}
+
+void ed::audio::SentDeviceStateCache::MarkVolumeSent(const std::string& pnpId, bool renderOrCapture, uint16_t volume)
+{
+    std::lock_guard lock(mutex_);
+    const auto foundPair = pnpIdToSentState_.find(pnpId);
+    if (foundPair == pnpIdToSentState_.end())
+    {
+        return; // the next device message is a full one anyway
+    }
+    (renderOrCapture ? foundPair->second.renderVolume : foundPair->second.captureVolume) = volume;
+    modified_ = true;
+}
+
+std::string ed::audio::SentDeviceStateCache::CreateDeltaPayload(const SoundDeviceInterface& device, uint8_t changedFields,
+                                                                SoundDeviceEventType messageType, const std::string& hostName,
+                                                                std::chrono::system_clock::time_point now)
+{
+    nlohmann::json changed = nlohmann::json::object();
+    if ((changedFields & NameField) != 0)
+    {
+        changed["name"] = device.GetName();
+    }
+    if ((changedFields & FlowField) != 0)
+    {
+        changed["flowType"] = magic_enum::enum_name(device.GetFlow());
+    }
+    if ((changedFields & RenderVolumeField) != 0)
+    {
+        changed["renderVolume"] = device.GetCurrentRenderVolume();
+    }
+    if ((changedFields & CaptureVolumeField) != 0)
+    {
+        changed["captureVolume"] = device.GetCurrentCaptureVolume();
+    }
+    if ((changedFields & RenderDefaultField) != 0)
+    {
+        changed["isRenderDefault"] = device.IsRenderCurrentlyDefault();
+    }
+    if ((changedFields & CaptureDefaultField) != 0)
+    {
+        changed["isCaptureDefault"] = device.IsCaptureCurrentlyDefault();
+    }
+
+    const nlohmann::json payload = {
+        {"pnpId", device.GetPnpId()},
+        {"hostName", hostName},
+        {"deviceMessageType", magic_enum::enum_name(messageType)},
+        {"changed", changed},
+        {"updateDate", TimePointToStringAsUtc(now, true, true)}
+    };
+    return payload.dump();
+}
+
+bool ed::audio::SentDeviceStateCache::Load()
+{
+    std::lock_guard lock(mutex_);
+    pnpIdToSentState_.clear();
+    modified_ = false;
+
+    std::ifstream stream(storagePathName_);
+    if (!stream)
+    {
+        spdlog::info(R"(No sent device state found in "{}"; all devices are sent as full records.)", storagePathName_.string());
+        return false;
+    }
+    try
+    {
+        for (const auto json = nlohmann::json::parse(stream);
+             const auto& device : json.at("devices"))
+        {
+            SentState sent;
+            sent.name = device.at("name").get<std::string>();
+            sent.flow = magic_enum::enum_cast<SoundDeviceFlowType>(device.at("flowType").get<std::string>())
+                .value_or(SoundDeviceFlowType::None);
+            sent.renderVolume = device.at("renderVolume").get<uint16_t>();
+            sent.captureVolume = device.at("captureVolume").get<uint16_t>();
+            sent.renderIsDefault = device.at("isRenderDefault").get<bool>();
+            sent.captureIsDefault = device.at("isCaptureDefault").get<bool>();
+            sent.lastFullSend = std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(device.at("lastFullSendMs").get<int64_t>()));
+            pnpIdToSentState_[device.at("pnpId").get<std::string>()] = sent;
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        spdlog::warn(R"(Sent device state in "{}" can not be read: {}. Starting with full records.)", storagePathName_.string(), ex.what());
+        pnpIdToSentState_.clear();
+        return false;
+    }
+    spdlog::info(R"(Sent state of {} device(s) loaded from "{}".)", pnpIdToSentState_.size(), storagePathName_.string());
+    return true;
+}
+
+bool ed::audio::SentDeviceStateCache::SaveIfModified()
+{
+    std::lock_guard lock(mutex_);
+    if (!modified_)
+    {
+        return true;
+    }
+
+    nlohmann::json devices = nlohmann::json::array();
+    for (const auto& [pnpId, sent] : pnpIdToSentState_)
+    {
+        devices.push_back({
+            {"pnpId", pnpId},
+            {"name", sent.name},
+            {"flowType", magic_enum::enum_name(sent.flow)},
+            {"renderVolume", sent.renderVolume},
+            {"captureVolume", sent.captureVolume},
+            {"isRenderDefault", sent.renderIsDefault},
+            {"isCaptureDefault", sent.captureIsDefault},
+            {"lastFullSendMs", std::chrono::duration_cast<std::chrono::milliseconds>(sent.lastFullSend.time_since_epoch()).count()}
+        });
+    }
+
+    // Write aside and replace, so that a crash never leaves a truncated file behind
+    auto temporaryPathName = storagePathName_;
+    temporaryPathName += ".tmp";
+    try
+    {
+        {
+            std::ofstream stream(temporaryPathName, std::ios::trunc);
+            stream << nlohmann::json{{"devices", devices}}.dump();
+            if (!stream)
+            {
+                throw std::runtime_error("write failed");
+            }
+        }
+        std::filesystem::rename(temporaryPathName, storagePathName_);
+    }
+    catch (const std::exception& ex)
+    {
+        spdlog::warn(R"(Sent device state can not be saved to "{}": {}.)", storagePathName_.string(), ex.what());
+        return false;
+    }
+    modified_ = false;
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "public/SoundAgentInterface.h"
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+
+
+namespace ed::audio {
+// Remembers per device the state last handed over to the request dispatcher and persists it,
+// so that unchanged devices are not re-sent and changed ones are sent as field level deltas.
+// A full record is sent at least once per checkpoint interval.
+class SentDeviceStateCache final {
+public:
+    enum ChangedFields : uint8_t
+    {
+        NoField = 0,
+        NameField = 1 << 0,
+        FlowField = 1 << 1,
+        RenderVolumeField = 1 << 2,
+        CaptureVolumeField = 1 << 3,
+        RenderDefaultField = 1 << 4,
+        CaptureDefaultField = 1 << 5
+    };
+
+    enum class SendKind : uint8_t
+    {
+        Nothing,
+        Delta,
+        Full
+    };
+
+    struct Decision
+    {
+        SendKind kind;
+        uint8_t changedFields;
+    };
+
+public:
+    SentDeviceStateCache(std::filesystem::path storagePathName, std::chrono::system_clock::duration checkpointInterval);
+    DISALLOW_COPY_MOVE(SentDeviceStateCache);
+    ~SentDeviceStateCache() = default;
+
+public:
+    [[nodiscard]] Decision Classify(const SoundDeviceInterface& device, std::chrono::system_clock::time_point now) const;
+    void MarkSent(const SoundDeviceInterface& device, bool fullRecord, std::chrono::system_clock::time_point now);
+    void MarkVolumeSent(const std::string& pnpId, bool renderOrCapture, uint16_t volume);
+
+    [[nodiscard]] static std::string CreateDeltaPayload(const SoundDeviceInterface& device, uint8_t changedFields,
+                                                        SoundDeviceEventType messageType, const std::string& hostName,
+                                                        std::chrono::system_clock::time_point now);
+
+    bool Load();
+    bool SaveIfModified();
+
+private:
+    struct SentState
+    {
+        std::string name;
+        SoundDeviceFlowType flow = SoundDeviceFlowType::None;
+        uint16_t renderVolume = 0;
+        uint16_t captureVolume = 0;
+        bool renderIsDefault = false;
+        bool captureIsDefault = false;
+        std::chrono::system_clock::time_point lastFullSend;
+    };
+
+    [[nodiscard]] static uint8_t Compare(const SentState& sent, const SoundDeviceInterface& device);
+
+private:
+    const std::filesystem::path storagePathName_;
+    const std::chrono::system_clock::duration checkpointInterval_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, SentState> pnpIdToSentState_;
+    bool modified_ = false;
+};
+}
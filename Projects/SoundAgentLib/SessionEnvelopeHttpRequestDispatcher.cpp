@@ -0,0 +1,89 @@
+#include "os-dependencies.h"
+
+#include "SessionEnvelopeHttpRequestDispatcher.h"
+
+#include "ApiClient/common/TimeUtil.h"
+
+#include <format>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+
+SessionEnvelopeHttpRequestDispatcher::SessionEnvelopeHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher,
+                                                                           std::chrono::system_clock::duration helloInterval)
+    : targetDispatcher_(targetDispatcher)
+    , helloInterval_(helloInterval)
+    , randomGenerator_(std::random_device{}())
+{
+}
+
+void SessionEnvelopeHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                          const std::string& urlSuffix, const std::string& payload,
+                                                          const std::unordered_map<std::string, std::string>& header,
+                                                          const std::string& hint)
+{
+    auto json = nlohmann::json::parse(payload, nullptr, false);
+    if (!json.is_object() || (!json.contains(HOST_NAME_FIELD) && !json.contains(OPERATION_SYSTEM_NAME_FIELD)))
+    {
+        targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, payload, header, hint);
+        return;
+    }
+
+    const auto hostName = json.value(HOST_NAME_FIELD, std::string());
+    const auto operationSystemName = json.value(OPERATION_SYSTEM_NAME_FIELD, std::string());
+    json.erase(HOST_NAME_FIELD);
+    json.erase(OPERATION_SYSTEM_NAME_FIELD);
+
+    // Under the lock: the hello precedes the messages of its session
+    std::lock_guard lock(mutex_);
+    if (hostName != hostName_ || operationSystemName != operationSystemName_)
+    {
+        if (!hostName_.empty() || !operationSystemName_.empty())
+        {
+            spdlog::info(R"(Host metadata changed to "{}", "{}": new session.)", hostName, operationSystemName);
+        }
+        hostName_ = hostName;
+        operationSystemName_ = operationSystemName;
+        helloRequired_ = true;
+    }
+    if (helloRequired_)
+    {
+        sessionId_ = std::format("{:016x}", randomGenerator_());
+        SendHello(time);
+    }
+    else if (time - lastHelloTime_ >= helloInterval_)
+    {
+        SendHello(time);
+    }
+
+    json[SESSION_ID_FIELD] = sessionId_;
+    targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, json.dump(), header, hint);
+}
+
+void SessionEnvelopeHttpRequestDispatcher::RenewSession()
+{
+    std::lock_guard lock(mutex_);
+    helloRequired_ = true;
+}
+
+std::string SessionEnvelopeHttpRequestDispatcher::GetSessionId() const
+{
+    std::lock_guard lock(mutex_);
+    return sessionId_;
+}
+
+void SessionEnvelopeHttpRequestDispatcher::SendHello(const std::chrono::system_clock::time_point& time)
+{
+    const nlohmann::json hello = {
+        {SESSION_ID_FIELD, sessionId_},
+        {HOST_NAME_FIELD, hostName_},
+        {OPERATION_SYSTEM_NAME_FIELD, operationSystemName_},
+        {"updateDate", ed::TimePointToStringAsUtc(time, true, true)}
+    };
+    targetDispatcher_.EnqueueRequest(true, time, SESSION_HELLO_URL_SUFFIX, hello.dump(),
+                                     {{"Content-Type", "application/json"}}, "SessionHello");
+    lastHelloTime_ = time;
+    helloRequired_ = false;
+    spdlog::info(R"(Session hello sent, session id "{}".)", sessionId_);
+}
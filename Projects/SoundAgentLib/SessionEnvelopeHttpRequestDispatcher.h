@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include <mutex>
+#include <random>
+#include <string>
+
+// Decorator sending the host metadata once per session instead of in every message: a session hello
+// carries the host name and the operation system name together with a compact session id, the following
+// messages carry the session id only. A new session (and hello) starts if the metadata change or on RenewSession,
+// e.g. after a reconnect; the hello is repeated once per hello interval, so that a backend that lost it recovers.
+class SessionEnvelopeHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    SessionEnvelopeHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher,
+                                         std::chrono::system_clock::duration helloInterval);
+
+    DISALLOW_COPY_MOVE(SessionEnvelopeHttpRequestDispatcher);
+    ~SessionEnvelopeHttpRequestDispatcher() override = default;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+    void RenewSession();
+    [[nodiscard]] std::string GetSessionId() const;
+
+    static constexpr auto SESSION_HELLO_URL_SUFFIX = "/session";
+    static constexpr auto SESSION_ID_FIELD = "sessionId";
+    static constexpr auto HOST_NAME_FIELD = "hostName";
+    static constexpr auto OPERATION_SYSTEM_NAME_FIELD = "operationSystemName";
+
+private:
+    // Called with the lock held
+    void SendHello(const std::chrono::system_clock::time_point& time);
+
+private:
+    HttpRequestDispatcherInterface& targetDispatcher_;
+    const std::chrono::system_clock::duration helloInterval_;
+
+    mutable std::mutex mutex_;
+    std::mt19937_64 randomGenerator_;
+    std::string sessionId_;
+    std::string hostName_;
+    std::string operationSystemName_;
+    std::chrono::system_clock::time_point lastHelloTime_;
+    bool helloRequired_ = true;
+};
@@ -7,12 +7,17 @@ extern "C" const CLSID CLSID_StdGlobalInterfaceTable;
 
 #include "SoundDeviceCollection.h"
 
+#include "LogMacros.h"
+#include "PipelineLatency.h"
 #include "SoundDevice.h"
+#include "TraceSpans.h"
+#include "Utf16Transcoding.h"
 #include "Utilities.h"
 
 #include "ApiClient/common/StringUtils.h"
 
 #include <iostream>
+#include <cmath>
 #include <cstddef>
 #include <mmdeviceapi.h>
 #include <endpointvolume.h>
@@ -43,16 +48,40 @@ namespace {
             return SoundDeviceFlowType::None;
         }
     }
+
+    bool HasFlow(const ed::audio::SoundDevice& device, const EDataFlow flow)
+    {
+        return device.GetFlow() == SoundDeviceFlowType::RenderAndCapture || device.GetFlow() == ConvertFromLowLevelFlow(flow);
+    }
+}
+
+
+ed::audio::SoundDeviceCollection::SoundDeviceCollection(std::unique_ptr<NotificationRecorder> recorder)
+    : recorder_(std::move(recorder))
+{
 }
 
+ed::audio::SoundDeviceCollection::SoundDeviceCollection(std::unique_ptr<AudioEndpointProviderInterface> endpointProvider,
+                                                         std::unique_ptr<NotificationRecorder> recorder)
+    : MultipleNotificationClient(endpointProvider == nullptr)
+    , recorder_(std::move(recorder))
+    , endpointProvider_(std::move(endpointProvider))
+{
+}
 
 ed::audio::SoundDeviceCollection::~SoundDeviceCollection()
 {
+    std::lock_guard lock(mutex_);
+    if (recorder_ != nullptr)
+    {
+        recorder_->Record(CreateSnapshot());
+    }
     UnregisterAllEndpointsVolumes();
 }
 
 void ed::audio::SoundDeviceCollection::ResetContent()
 {
+    std::lock_guard lock(mutex_);
     RecreateActiveDeviceList();
 }
 
@@ -66,11 +95,13 @@ void ed::audio::SoundDeviceCollection::DeactivateAndStopLoop()
 
 size_t ed::audio::SoundDeviceCollection::GetSize() const
 {
+    std::lock_guard lock(mutex_);
     return pnpToDeviceMap_.size();
 }
 
 std::unique_ptr<SoundDeviceInterface> ed::audio::SoundDeviceCollection::CreateItem(size_t deviceNumber) const
 {
+    std::lock_guard lock(mutex_);
     if (deviceNumber >= pnpToDeviceMap_.size())
     {
         throw std::runtime_error("Device number is too big");
@@ -86,9 +117,22 @@ std::unique_ptr<SoundDeviceInterface> ed::audio::SoundDeviceCollection::CreateIt
     throw std::runtime_error("Device number not found");
 }
 
+std::vector<std::unique_ptr<SoundDeviceInterface>> ed::audio::SoundDeviceCollection::CreateItems() const
+{
+    std::lock_guard lock(mutex_);
+    std::vector<std::unique_ptr<SoundDeviceInterface>> devices;
+    devices.reserve(pnpToDeviceMap_.size());
+    for (const auto & recordVal : pnpToDeviceMap_ | std::views::values)
+    {
+        devices.push_back(std::make_unique<SoundDevice>(recordVal));
+    }
+    return devices;
+}
+
 std::unique_ptr<SoundDeviceInterface> ed::audio::SoundDeviceCollection::CreateItem(
     const std::string & devicePnpId) const
 {
+    std::lock_guard lock(mutex_);
     if (!pnpToDeviceMap_.contains(devicePnpId))
     {
         return nullptr;
@@ -98,21 +142,25 @@ std::unique_ptr<SoundDeviceInterface> ed::audio::SoundDeviceCollection::CreateIt
 
 std::optional<std::string> ed::audio::SoundDeviceCollection::GetDefaultRenderDevicePnpId() const
 {
+    std::lock_guard lock(mutex_);
     return defaultRenderDevicePnpId_;
 }
 
 std::optional<std::string> ed::audio::SoundDeviceCollection::GetDefaultCaptureDevicePnpId() const
 {
+    std::lock_guard lock(mutex_);
     return defaultCaptureDevicePnpId_;
 }
 
 void ed::audio::SoundDeviceCollection::Subscribe(SoundDeviceObserverInterface & observer)
 {
+    std::lock_guard lock(mutex_);
     observers_.insert(&observer);
 }
 
 void ed::audio::SoundDeviceCollection::Unsubscribe(SoundDeviceObserverInterface & observer)
 {
+    std::lock_guard lock(mutex_);
     observers_.erase(&observer);
 }
 
@@ -156,17 +204,19 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
     EndPointVolumeSmartPtr & outVolumeEndpoint
 )
 {
+    TRACE_SPAN("TryCreateDeviceAndGetVolumeEndpoint");
     const auto deviceIdOpt = GetDeviceId(deviceEndpointSmartPtr);
     if (!deviceIdOpt.has_value()) {
-        spdlog::warn("Failed to get device ID from IMMDevice.");
+        ED_LOG_WARN("Failed to get device ID from IMMDevice.");
         return false;
     }
     deviceId = deviceIdOpt.value();
-    auto deviceIdAscii = WString2StringTruncate(deviceId);
+    const Utf8Text deviceIdText(deviceId);
+    const auto deviceIdUtf8 = deviceIdText.View();
 
 
     HRESULT hr;
-    spdlog::info(R"(Id of the current device is "{}".)", deviceIdAscii);
+    ED_LOG_INFO(R"(Id of the current device is "{}".)", deviceIdUtf8);
     // Get flow direction via IMMEndpoint
     auto flow = SoundDeviceFlowType::None;
     {
@@ -182,7 +232,7 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
             return false;
         }
         flow = ConvertFromLowLevelFlow(lowLevelFlow);
-        spdlog::info(R"(The end point device "{}", has a data flow "{}".)", deviceIdAscii,
+        ED_LOG_INFO(R"(The end point device "{}", has a data flow "{}".)", deviceIdUtf8,
                      magic_enum::enum_name(flow));
     }
     // Read device PnP Class id property
@@ -206,15 +256,15 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
             if (propVarForName.vt == VT_LPWSTR)
             {
                 name = Utf16ToUtf8(propVarForName.pwszVal);
-                spdlog::info(R"(The end point device "{}" got a name "{}".)",
-                             deviceIdAscii, name);
+                ED_LOG_INFO(R"(The end point device "{}" got a name "{}".)",
+                             deviceIdUtf8, name);
             }
             else
             {
                 name = "UnknownDeviceName";
-                spdlog::warn(
+                ED_LOG_WARN(
                     R"(The end point device "{}" has no friendly name not of expected type VT_LPWSTR. Assigning "{}".)",
-                    deviceIdAscii, name);
+                    deviceIdUtf8, name);
             }
             // ReSharper disable once CppFunctionResultShouldBeUsed
             PropVariantClear(&propVarForName);
@@ -231,8 +281,8 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
             if (propVarForFormFactor.vt == VT_UI4)
             {
                 formFactorEnum = static_cast<EndpointFormFactor>(propVarForFormFactor.ulVal);
-                spdlog::info(R"(The end point device "{}" form factor is "{}")",
-                    deviceIdAscii, magic_enum::enum_name(formFactorEnum));
+                ED_LOG_INFO(R"(The end point device "{}" form factor is "{}")",
+                    deviceIdUtf8, magic_enum::enum_name(formFactorEnum));
             }
             // ReSharper disable once CppFunctionResultShouldBeUsed
             PropVariantClear(&propVarForFormFactor);
@@ -256,23 +306,25 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
                 );
                 if (len >= 2)
                 {
-                    pnpId = WString2StringTruncate(buff);
-                    if (pnpId[0] == '{')
+                    char guidText[std::size(buff)];
+                    std::string_view guid(guidText, TruncateUtf16(std::wstring_view(buff, len - 1), guidText));
+                    if (guid[0] == '{')
                     {
-                        pnpId = pnpId.substr(1, pnpId.length() - 2);
+                        guid = guid.substr(1, guid.length() - 2);
                     }
+                    pnpId = guid;
                 }
                 if (constexpr auto noPlugAndPlayGuid = "00000000-0000-0000-FFFF-FFFFFFFFFFFF"
                     ; pnpId == noPlugAndPlayGuid)
                 {
-                    pnpId = DeviceIdToPnpIdForm(deviceIdAscii);
+                    pnpId = DeviceIdToPnpIdForm(std::string(deviceIdUtf8));
 
-                    spdlog::info(R"(The end point device "{}" has got no-plug-and-play-id {}. Assigning a simplified device id "{}" .)",
-                                 deviceIdAscii, noPlugAndPlayGuid, pnpId);
+                    ED_LOG_INFO(R"(The end point device "{}" has got no-plug-and-play-id {}. Assigning a simplified device id "{}" .)",
+                                 deviceIdUtf8, noPlugAndPlayGuid, pnpId);
                 }
             }
-            spdlog::info(R"(The end point device "{}", got a PnP id "{}".)",
-                deviceIdAscii, pnpId);
+            ED_LOG_INFO(R"(The end point device "{}", got a PnP id "{}".)",
+                deviceIdUtf8, pnpId);
 
             // ReSharper disable once CppFunctionResultShouldBeUsed
             PropVariantClear(&propVarForGuid);
@@ -283,8 +335,8 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
     // check special case: exclude render end point devices with form factor Headset
     if (formFactorEnum == EndpointFormFactor::Headset && flow == SoundDeviceFlowType::Render)
     {
-        spdlog::info(R"(We exclude the render end point device "{}" with name "{}", while its form factor is Headset.)",
-            deviceIdAscii, name);
+        ED_LOG_INFO(R"(We exclude the render end point device "{}" with name "{}", while its form factor is Headset.)",
+            deviceIdUtf8, name);
         return false;
     }
 
@@ -306,7 +358,7 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
     }
     // Check mute and possibly correct volume
     if (outVolumeEndpoint == nullptr) {
-        spdlog::warn(R"(The end point device "{}" has no volume property.)", deviceIdAscii);
+        ED_LOG_WARN(R"(The end point device "{}" has no volume property.)", deviceIdUtf8);
         return false;
     }
     BOOL mute;
@@ -321,7 +373,7 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
             return false;
         }
         volume = static_cast<uint16_t>(lround(currVolume * 1000.0f));
-        spdlog::info(R"(The end point device "{}" has a volume "{}".)", deviceIdAscii, volume);
+        ED_LOG_INFO(R"(The end point device "{}" has a volume "{}".)", deviceIdUtf8, volume);
     }
     uint16_t renderVolume = 0;
     uint16_t captureVolume = 0;
@@ -346,6 +398,11 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceAndGetVolumeEndpoint(
 std::pair<std::optional<std::wstring>, std::optional<std::wstring>>
 ed::audio::SoundDeviceCollection::TryGetRenderAndCaptureDefaultDeviceIds() const
 {
+    if (endpointProvider_ != nullptr)
+    {
+        return {endpointProvider_->GetDefaultDeviceId(eRender), endpointProvider_->GetDefaultDeviceId(eCapture)};
+    }
+
     IMMDevice* devicePtr;
 
     CComPtr<IMMDevice> renderDeviceSmartPtr;
@@ -367,7 +424,7 @@ ed::audio::SoundDeviceCollection::TryGetRenderAndCaptureDefaultDeviceIds() const
         }
         else
         {
-            spdlog::warn("Failed to get default render audio endpoint.");
+            ED_LOG_WARN("Failed to get default render audio endpoint.");
         }
     }
 
@@ -383,7 +440,7 @@ ed::audio::SoundDeviceCollection::TryGetRenderAndCaptureDefaultDeviceIds() const
     }
     else
     {
-        spdlog::warn("Failed to get default capture audio endpoint.");
+        ED_LOG_WARN("Failed to get default capture audio endpoint.");
     }
 
     return {GetDeviceId(renderDeviceSmartPtr), GetDeviceId(captureDeviceSmartPtr)};
@@ -395,8 +452,8 @@ void ed::audio::SoundDeviceCollection::UnregisterAllEndpointsVolumes()
     {
         // ReSharper disable once CppFunctionResultShouldBeUsed
         endpointVolume->UnregisterControlChangeNotify(this);
-        spdlog::info(R"(The next end point device "{}" unregistered for notifications.)",
-            WString2StringTruncate(deviceId));
+        ED_LOG_INFO(R"(The next end point device "{}" unregistered for notifications.)",
+            Utf8Text(deviceId).View());
     }
 }
 
@@ -420,14 +477,11 @@ void ed::audio::SoundDeviceCollection::UnregisterAndRemoveEndpointsVolumes(const
         ; foundPair != devIdToEndpointVolumes_.end()
     )
     {
-        auto audioEndpointVolume = foundPair->second;
         // ReSharper disable once CppFunctionResultShouldBeUsed
-        audioEndpointVolume->UnregisterControlChangeNotify(this);
-        spdlog::info(R"(The end point device "{}" unregistered for notifications before removal.)",
-            WString2StringTruncate(deviceId));
+        foundPair->second->UnregisterControlChangeNotify(this);
+        ED_LOG_INFO(R"(The end point device "{}" unregistered for notifications before removal.)",
+            Utf8Text(deviceId).View());
 
-        //        const auto ii = CountRef(static_cast<IAudioEndpointVolume*>(audioEndpointVolume));
-        audioEndpointVolume.Detach();
         devIdToEndpointVolumes_.erase(foundPair);
     }
 }
@@ -444,11 +498,11 @@ ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExisting
         auto flow = device.GetFlow();
         uint16_t renderVolume = device.GetCurrentRenderVolume();
         uint16_t captureVolume = device.GetCurrentCaptureVolume();
-        bool captureIsDefault = device.IsCaptureCurrentlyDefault();
-        bool renderIsDefault = device.IsRenderCurrentlyDefault();
-
 
         const auto & foundDev = foundPair->second;
+        // An endpoint added again, e.g. on a state change after the addition, keeps the roles of the device
+        const bool captureIsDefault = device.IsCaptureCurrentlyDefault() || foundDev.IsCaptureCurrentlyDefault();
+        const bool renderIsDefault = device.IsRenderCurrentlyDefault() || foundDev.IsRenderCurrentlyDefault();
         if (foundDev.GetFlow() != device.GetFlow())
         {
 
@@ -456,11 +510,9 @@ ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExisting
             {
             case SoundDeviceFlowType::Capture:
                 renderVolume = foundDev.GetCurrentRenderVolume();
-                renderIsDefault = foundDev.IsRenderCurrentlyDefault();
                 break;
             case SoundDeviceFlowType::Render:
                 captureVolume = foundDev.GetCurrentCaptureVolume();
-                captureIsDefault = foundDev.IsCaptureCurrentlyDefault();
             case SoundDeviceFlowType::None:
             case SoundDeviceFlowType::RenderAndCapture:
             default:  // NOLINT(clang-diagnostic-covered-switch-default)
@@ -484,6 +536,21 @@ ed::audio::SoundDevice ed::audio::SoundDeviceCollection::MergeDeviceWithExisting
 // ReSharper disable once CppPassValueParameterByConstReference
 void ed::audio::SoundDeviceCollection::ProcessActiveDeviceList(const ProcessDeviceFunctionT& processDeviceFunc)
 {
+    TRACE_SPAN("ProcessActiveDeviceList");
+    if (endpointProvider_ != nullptr)
+    {
+        for (const auto& deviceId : endpointProvider_->GetActiveDeviceIds())
+        {
+            SoundDevice device;
+            if (EndPointVolumeSmartPtr endPointVolumeSmartPtr;
+                endpointProvider_->TryCreateDevice(deviceId, device, endPointVolumeSmartPtr))
+            {
+                processDeviceFunc(this, deviceId, device, endPointVolumeSmartPtr);
+            }
+        }
+        return;
+    }
+
     HRESULT hr;
     CComPtr<IMMDeviceCollection> deviceCollectionSmartPtr;
     if (GetEnumeratorOrNull() != nullptr)
@@ -494,10 +561,10 @@ void ed::audio::SoundDeviceCollection::ProcessActiveDeviceList(const ProcessDevi
             &deviceCollection);
         if (FAILED(hr))
         {
-            spdlog::warn("EnumAudioEndpoints failed");
+            ED_LOG_WARN("EnumAudioEndpoints failed");
             return;
         }
-        spdlog::info("Audio devices enumerated.");
+        ED_LOG_INFO("Audio devices enumerated.");
         deviceCollectionSmartPtr.Attach(deviceCollection);
     }
     UINT count = 0;
@@ -516,7 +583,7 @@ void ed::audio::SoundDeviceCollection::ProcessActiveDeviceList(const ProcessDevi
                 hr = deviceCollectionSmartPtr->Item(i, &pEndpointDevice);
                 if (FAILED(hr))
                 {
-                    spdlog::warn("Collection::Item failed.");
+                    ED_LOG_WARN("Collection::Item failed.");
                     continue;
                 }
                 endpointDeviceSmartPtr.Attach(pEndpointDevice);
@@ -528,25 +595,33 @@ void ed::audio::SoundDeviceCollection::ProcessActiveDeviceList(const ProcessDevi
             continue;
         }
         processDeviceFunc(this, deviceId, device, endPointVolumeSmartPtr);
-        spdlog::info(R"(End point {} with plug-and-play id {} processed.)", i, device.GetPnpId());
+        ED_LOG_INFO(R"(End point {} with plug-and-play id {} processed.)", i, device.GetPnpId());
     }
 }
 
 
 void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
 {
-    spdlog::info("Recreating audio device info list..");
+    TRACE_SPAN("RecreateActiveDeviceList");
+    ED_LOG_INFO("Recreating audio device info list..");
     pnpToDeviceMap_.clear();
+    defaultRenderDevicePnpId_ = std::nullopt;
+    defaultCaptureDevicePnpId_ = std::nullopt;
 
     UnregisterAllEndpointsVolumes();
     devIdToEndpointVolumes_.clear();
 
     auto [renderDefaultDeviceId, captureDefaultDeviceId] = TryGetRenderAndCaptureDefaultDeviceIds();
+    std::vector<RecordedEndpoint> activeEndpoints;
 
     // ReSharper disable once CppPassValueParameterByConstReference
-    auto setActiveAndRegisterDeviceClosure = [renderDefaultDeviceId, captureDefaultDeviceId, this](ed::audio::SoundDeviceCollection* self, const std::wstring& deviceId, const SoundDevice& device, EndPointVolumeSmartPtr endpointVolume)
+    auto setActiveAndRegisterDeviceClosure = [renderDefaultDeviceId, captureDefaultDeviceId, &activeEndpoints, this](ed::audio::SoundDeviceCollection* self, const std::wstring& deviceId, const SoundDevice& device, EndPointVolumeSmartPtr endpointVolume)
         {
             RegisterDevice(self, deviceId, device, endpointVolume);  // NOLINT(performance-unnecessary-value-param)
+            if (recorder_ != nullptr)
+            {
+                activeEndpoints.push_back({Utf16ToUtf8(deviceId.c_str()), device});
+            }
 
             const auto pnpId = device.GetPnpId();
             const auto foundPair = self->pnpToDeviceMap_.find(pnpId);
@@ -563,9 +638,9 @@ void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
                 {
                     foundDevicePtr->SetRenderCurrentlyDefault(true);
                     defaultRenderDevicePnpId_ = pnpId;
-                    spdlog::info(
+                    ED_LOG_INFO(
                         R"(Device "{}", PnPId "{}", name "{}" detected as Render-Default and set respectively.)"
-                        , WString2StringTruncate(deviceId)
+                        , Utf8Text(deviceId).View()
                         , pnpId
                         , foundDevicePtr->GetName()
                     );
@@ -579,9 +654,9 @@ void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
                 {
                     foundDevicePtr->SetCaptureCurrentlyDefault(true);
                     defaultCaptureDevicePnpId_ = pnpId;
-                    spdlog::info(
+                    ED_LOG_INFO(
                         R"(Device "{}", PnPId "{}", name "{}" detected as Capture-Default and set respectively.)"
-                        , WString2StringTruncate(deviceId)
+                        , Utf8Text(deviceId).View()
                         , pnpId
                         , foundDevicePtr->GetName()
                     );
@@ -589,11 +664,21 @@ void ed::audio::SoundDeviceCollection::RecreateActiveDeviceList()
             }
         };
     ProcessActiveDeviceList(setActiveAndRegisterDeviceClosure);
+
+    if (recorder_ != nullptr)
+    {
+        auto snapshot = CreateSnapshot();
+        snapshot.listRecreated = true;
+        snapshot.endpoints = std::move(activeEndpoints);
+        snapshot.defaultRenderEndpointId = renderDefaultDeviceId.has_value() ? Utf16ToUtf8(renderDefaultDeviceId->c_str()) : std::string();
+        snapshot.defaultCaptureEndpointId = captureDefaultDeviceId.has_value() ? Utf16ToUtf8(captureDefaultDeviceId->c_str()) : std::string();
+        recorder_->Record(std::move(snapshot));
+    }
 }
 
 void ed::audio::SoundDeviceCollection::RefreshVolumes()
 {
-    spdlog::info("Refreshing volumes of audio devices..");
+    ED_LOG_INFO("Refreshing volumes of audio devices..");
     ProcessActiveDeviceList(&SoundDeviceCollection::UpdateDeviceVolume);
 }
 
@@ -604,19 +689,21 @@ void ed::audio::SoundDeviceCollection::RegisterDevice(ed::audio::SoundDeviceColl
 {
     if (endpointVolume != nullptr)
     {
+        // An endpoint added again must not leave its previous registration behind
+        self->UnregisterAndRemoveEndpointsVolumes(deviceId);
         // ReSharper disable once CppFunctionResultShouldBeUsed
         endpointVolume->RegisterControlChangeNotify(self);
         self->devIdToEndpointVolumes_[deviceId] = endpointVolume;
-        spdlog::info(R"(The end point device "{}" registered for notifications.)",
-            WString2StringTruncate(deviceId));
+        ED_LOG_INFO(R"(The end point device "{}" registered for notifications.)",
+            Utf8Text(deviceId).View());
     }
 
     const auto possiblyMergedDevice = self->MergeDeviceWithExistingOneBasedOnPnpIdAndFlow(device);
 
     self->pnpToDeviceMap_[device.GetPnpId()] = possiblyMergedDevice;
 
-    spdlog::info(R"(Device "{}", PnPId "{}", name "{}", flow {} merged and added to the list.)"
-        , WString2StringTruncate(deviceId)
+    ED_LOG_INFO(R"(Device "{}", PnPId "{}", name "{}", flow {} merged and added to the list.)"
+        , Utf8Text(deviceId).View()
         , possiblyMergedDevice.GetPnpId()
         , possiblyMergedDevice.GetName()
         , magic_enum::enum_name(possiblyMergedDevice.GetFlow())
@@ -650,6 +737,8 @@ void ed::audio::SoundDeviceCollection::UpdateDeviceVolume(SoundDeviceCollection*
 
 void ed::audio::SoundDeviceCollection::NotifyObservers(SoundDeviceEventType action, const std::string & devicePNpId) const
 {
+    LatencyTrace::Mark(LatencyStage::StateUpdated);
+    TRACE_SPAN("NotifyObservers");
     for (auto * observer : observers_)
     {
         observer->OnCollectionChanged(action, devicePNpId);
@@ -658,11 +747,15 @@ void ed::audio::SoundDeviceCollection::NotifyObservers(SoundDeviceEventType acti
 
 HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
 {
+    const LatencyTrace::Scope latencyTrace;
+    std::lock_guard lock(mutex_);
     const HRESULT onDeviceAdded = MultipleNotificationClient::OnDeviceAdded(deviceId);
     if (onDeviceAdded == S_OK)
     {
-        spdlog::info(R"(Device added: id "{}".)", WString2StringTruncate(deviceId));
+        ED_LOG_INFO(R"(Device added: id "{}".)", Utf8Text(deviceId).View());
 
+        RecordedNotification notification{.type = NotificationType::DeviceAdded,
+                                          .endpointId = recorder_ != nullptr ? Utf16ToUtf8(deviceId) : std::string()};
         SoundDevice device;
         if
         (
@@ -673,12 +766,17 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
             RegisterDevice(this, deviceId, device, endPointVolumeSmartPtr);
 
             const auto pnpId = device.GetPnpId();
+            notification.devices.push_back(pnpToDeviceMap_.at(pnpId));
+            if (recorder_ != nullptr)
+            {
+                notification.endpoints.push_back({notification.endpointId, device});
+            }
             NotifyObservers(SoundDeviceEventType::Discovered, pnpId);
             if (device.IsRenderCurrentlyDefault())
             {
                 NotifyObservers(SoundDeviceEventType::DefaultRenderChanged, pnpId);
-                spdlog::info(R"(Device "{}", PnPId "{}", name "{}" was already Render-Default. Observers notified.)"
-                    , WString2StringTruncate(deviceId)
+                ED_LOG_INFO(R"(Device "{}", PnPId "{}", name "{}" was already Render-Default. Observers notified.)"
+                    , Utf8Text(deviceId).View()
                     , pnpId
                     , device.GetName()
                 );
@@ -687,15 +785,19 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceAdded(LPCWSTR deviceId)
             if (device.IsCaptureCurrentlyDefault())
             {
                 NotifyObservers(SoundDeviceEventType::DefaultCaptureChanged, pnpId);
-                spdlog::info(R"(Device "{}", PnPId "{}", name "{}" was already Capture-Default. Observers notified.)"
-                    , WString2StringTruncate(deviceId)
+                ED_LOG_INFO(R"(Device "{}", PnPId "{}", name "{}" was already Capture-Default. Observers notified.)"
+                    , Utf8Text(deviceId).View()
                     , pnpId
                     , device.GetName()
                 );
             }
 
         }
-        spdlog::info(R"(Device adding finished: id "{}".)", WString2StringTruncate(deviceId));
+        if (recorder_ != nullptr)
+        {
+            recorder_->Record(std::move(notification));
+        }
+        ED_LOG_INFO(R"(Device adding finished: id "{}".)", Utf8Text(deviceId).View());
     }
     return onDeviceAdded;
 }
@@ -778,39 +880,66 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceRemoved(LPCWSTR deviceId)
 {
     using magic_enum::iostream_operators::operator<<; // out-of-the-box stream operators for enums
 
+    const LatencyTrace::Scope latencyTrace;
+
+    std::lock_guard lock(mutex_);
     const HRESULT hr = MultipleNotificationClient::OnDeviceRemoved(deviceId);
     if (hr == S_OK)
     {
-        spdlog::info(R"(Device to remove: id "{}".)", WString2StringTruncate(deviceId));
+        ED_LOG_INFO(R"(Device to remove: id "{}".)", Utf8Text(deviceId).View());
 
+        RecordedNotification notification{.type = NotificationType::DeviceRemoved,
+                                          .endpointId = recorder_ != nullptr ? Utf16ToUtf8(deviceId) : std::string()};
         SoundDevice removedDeviceToUnmerge;
         if
         (   EndPointVolumeSmartPtr volumeEndpointSmartPtr;
             TryCreateDeviceOnId(deviceId, removedDeviceToUnmerge, volumeEndpointSmartPtr)
         )
         {
-            spdlog::info(R"(Device to remove, more info: name "{}", flow: {}, plug-and-play id: {}.)",
+            ED_LOG_INFO(R"(Device to remove, more info: name "{}", flow: {}, plug-and-play id: {}.)",
                          removedDeviceToUnmerge.GetName(), magic_enum::enum_name(removedDeviceToUnmerge.GetFlow()),
                          removedDeviceToUnmerge.GetPnpId());
+            if (recorder_ != nullptr)
+            {
+                notification.endpoints.push_back({notification.endpointId, removedDeviceToUnmerge});
+            }
 
             if (SoundDevice possiblyUnmergedDevice; 
                 CheckRemovalAndUnmergeDeviceFromExistingOneBasedOnPnpIdAndFlow(removedDeviceToUnmerge, possiblyUnmergedDevice))
             {
-                if (possiblyUnmergedDevice.GetFlow() == SoundDeviceFlowType::None)
+                const auto remainingFlow = possiblyUnmergedDevice.GetFlow();
+                if (remainingFlow == SoundDeviceFlowType::None)
                 {
                     pnpToDeviceMap_.erase(possiblyUnmergedDevice.GetPnpId());
                 }
                 else
                 {
-                    spdlog::info(R"(Removed device unmerged: name "{}", flow: {}.)", possiblyUnmergedDevice.GetName(), magic_enum::enum_name(possiblyUnmergedDevice.GetFlow()));
+                    ED_LOG_INFO(R"(Removed device unmerged: name "{}", flow: {}.)", possiblyUnmergedDevice.GetName(), magic_enum::enum_name(remainingFlow));
 
                     pnpToDeviceMap_[possiblyUnmergedDevice.GetPnpId()] = possiblyUnmergedDevice;
+                    notification.devices.push_back(possiblyUnmergedDevice);
+                }
+                // The role stays unassigned until the default change notification that follows the removal
+                if (defaultRenderDevicePnpId_ == possiblyUnmergedDevice.GetPnpId()
+                    && remainingFlow != SoundDeviceFlowType::Render && remainingFlow != SoundDeviceFlowType::RenderAndCapture)
+                {
+                    defaultRenderDevicePnpId_ = std::nullopt;
+                }
+                if (defaultCaptureDevicePnpId_ == possiblyUnmergedDevice.GetPnpId()
+                    && remainingFlow != SoundDeviceFlowType::Capture && remainingFlow != SoundDeviceFlowType::RenderAndCapture)
+                {
+                    defaultCaptureDevicePnpId_ = std::nullopt;
                 }
                 UnregisterAndRemoveEndpointsVolumes(deviceId);
                 NotifyObservers(SoundDeviceEventType::Detached, removedDeviceToUnmerge.GetPnpId());
+                notification.pnpId = removedDeviceToUnmerge.GetPnpId();
             }
         }
-        spdlog::info(R"(Device removal finished: id "{}".)", WString2StringTruncate(deviceId));
+        if (recorder_ != nullptr)
+        {
+            recorder_->Record(std::move(notification));
+        }
+        ED_LOG_INFO(R"(Device removal finished: id "{}".)", Utf8Text(deviceId).View());
     }
     return hr;
 }
@@ -820,6 +949,11 @@ bool ed::audio::SoundDeviceCollection::TryCreateDeviceOnId(
     SoundDevice& device,
     EndPointVolumeSmartPtr& outVolumeEndpoint
 ) const {
+    if (endpointProvider_ != nullptr)
+    {
+        return endpointProvider_->TryCreateDevice(deviceId, device, outVolumeEndpoint);
+    }
+
     CComPtr<IMMDevice> deviceSmartPtr;
     // Retrieve the device using the device ID
     if (GetEnumeratorOrNull() != nullptr)
@@ -865,9 +999,17 @@ ed::audio::SoundDeviceCollection::GetDevicePnPIdsWithChangedVolume(
 
 HRESULT ed::audio::SoundDeviceCollection::OnDeviceStateChanged(LPCWSTR deviceId, DWORD dwNewState)
 {
+    const LatencyTrace::Scope latencyTrace;
+    std::lock_guard lock(mutex_);
     HRESULT hr = MultipleNotificationClient::OnDeviceStateChanged(deviceId, dwNewState);
     assert(SUCCEEDED(hr));
 
+    if (recorder_ != nullptr)
+    {
+        recorder_->Record({.type = NotificationType::DeviceStateChanged, .endpointId = Utf16ToUtf8(deviceId),
+                           .state = dwNewState});
+    }
+
     switch (dwNewState)
     {
     case DEVICE_STATE_ACTIVE:
@@ -886,6 +1028,8 @@ HRESULT ed::audio::SoundDeviceCollection::OnDeviceStateChanged(LPCWSTR deviceId,
 
 HRESULT ed::audio::SoundDeviceCollection::OnNotify(PAUDIO_VOLUME_NOTIFICATION_DATA pNotify)
 {
+    const LatencyTrace::Scope latencyTrace;
+    std::lock_guard lock(mutex_);
     const HRESULT hResult = MultipleNotificationClient::OnNotify(pNotify);
     const auto copy = pnpToDeviceMap_;
 
@@ -905,19 +1049,62 @@ HRESULT ed::audio::SoundDeviceCollection::OnNotify(PAUDIO_VOLUME_NOTIFICATION_DA
         NotifyObservers(SoundDeviceEventType::VolumeCaptureChanged, currPnPId);
     }
 
+    if (recorder_ != nullptr)
+    {
+        RecordedNotification notification{.type = NotificationType::VolumeChanged};
+        if (pNotify != nullptr)
+        {
+            notification.masterVolume = static_cast<uint16_t>(std::lround(pNotify->fMasterVolume * 1000.0f));
+            notification.muted = pNotify->bMuted != FALSE;
+        }
+        for (const auto& currPnPId : diffRender)
+        {
+            notification.volumeChanges.push_back({currPnPId, true, pnpToDeviceMap_.at(currPnPId).GetCurrentRenderVolume()});
+        }
+        for (const auto& currPnPId : diffCapture)
+        {
+            notification.volumeChanges.push_back({currPnPId, false, pnpToDeviceMap_.at(currPnPId).GetCurrentCaptureVolume()});
+        }
+        recorder_->Record(std::move(notification));
+    }
+
     return hResult;
 }
 
 HRESULT ed::audio::SoundDeviceCollection::OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR defaultDeviceId)
 {
+    const LatencyTrace::Scope latencyTrace;
+    std::lock_guard lock(mutex_);
     const HRESULT hr = MultipleNotificationClient::OnDefaultDeviceChanged(flow, role, defaultDeviceId);
     assert(SUCCEEDED(hr));
 
-    if (role != eConsole)
+    if (role == eConsole)
+    {
+        ProcessDefaultDeviceChange(flow, defaultDeviceId);
+    }
+
+    if (recorder_ != nullptr)
     {
-        return hr;
+        const auto& defaultPnpId = flow == eRender ? defaultRenderDevicePnpId_ : defaultCaptureDevicePnpId_;
+        RecordedNotification notification{.type = NotificationType::DefaultDeviceChanged,
+                                          .endpointId = defaultDeviceId != nullptr ? Utf16ToUtf8(defaultDeviceId) : std::string(),
+                                          .flow = static_cast<uint8_t>(flow), .role = static_cast<uint8_t>(role),
+                                          .pnpId = defaultPnpId.value_or("")};
+        // Resolved again for the recording only: a replay needs the endpoint even if the collection ignored the change
+        if (SoundDevice device; defaultDeviceId != nullptr)
+        {
+            if (EndPointVolumeSmartPtr endPointVolumeSmartPtr; TryCreateDeviceOnId(defaultDeviceId, device, endPointVolumeSmartPtr))
+            {
+                notification.endpoints.push_back({notification.endpointId, device});
+            }
+        }
+        recorder_->Record(std::move(notification));
     }
+    return hr;
+}
 
+void ed::audio::SoundDeviceCollection::ProcessDefaultDeviceChange(EDataFlow flow, LPCWSTR defaultDeviceId)
+{
     // clear previous default device
     if (flow == eRender && defaultRenderDevicePnpId_.has_value())
     {
@@ -947,15 +1134,15 @@ HRESULT ed::audio::SoundDeviceCollection::OnDefaultDeviceChanged(EDataFlow flow,
         {
             defaultRenderDevicePnpId_ = std::nullopt;
             NotifyObservers(SoundDeviceEventType::DefaultRenderChanged, "");
-            spdlog::info("Render-Default device removed.");
+            ED_LOG_INFO("Render-Default device removed.");
         }
         else if (flow == eCapture)
         {
             defaultCaptureDevicePnpId_ = std::nullopt;
             NotifyObservers(SoundDeviceEventType::DefaultCaptureChanged, "");
-            spdlog::info("Capture-Default device removed.");
+            ED_LOG_INFO("Capture-Default device removed.");
         }
-        return hr;
+        return;
     }
 
     // got new default device 
@@ -969,14 +1156,14 @@ HRESULT ed::audio::SoundDeviceCollection::OnDefaultDeviceChanged(EDataFlow flow,
         const auto foundPair = pnpToDeviceMap_.find(pnpId);
 
         if (SoundDevice* foundDevicePtr = foundPair != pnpToDeviceMap_.end() ? &(foundPair->second) : nullptr
-            ; foundDevicePtr != nullptr)
+            ; foundDevicePtr != nullptr && HasFlow(*foundDevicePtr, flow))
         {
             if (flow == eRender)
             {
                 foundDevicePtr->SetRenderCurrentlyDefault(true);
                 SetDefaultRenderDeviceAndNotifyObservers(pnpId);
-                spdlog::info(R"(Device "{}", PnPId "{}", name "{}" set as Render-Default according to Default-Change-Event. Observers notified.)"
-                    , WString2StringTruncate(defaultDeviceId)
+                ED_LOG_INFO(R"(Device "{}", PnPId "{}", name "{}" set as Render-Default according to Default-Change-Event. Observers notified.)"
+                    , Utf8Text(defaultDeviceId).View()
                     , pnpId
                     , foundDevicePtr->GetName()
                 );
@@ -985,30 +1172,27 @@ HRESULT ed::audio::SoundDeviceCollection::OnDefaultDeviceChanged(EDataFlow flow,
             {
                 foundDevicePtr->SetCaptureCurrentlyDefault(true);
                 SetDefaultCaptureDeviceAndNotifyObservers(pnpId);
-                spdlog::info(R"(Device "{}", PnPId "{}", name "{}" set as Capture-Default according to Default-Change-Event. Observers notified.)"
-                    , WString2StringTruncate(defaultDeviceId)
+                ED_LOG_INFO(R"(Device "{}", PnPId "{}", name "{}" set as Capture-Default according to Default-Change-Event. Observers notified.)"
+                    , Utf8Text(defaultDeviceId).View()
                     , pnpId
                     , foundDevicePtr->GetName()
                 );
             }
+            return;
         }
     }
-    else
-    {
-        if (flow == eRender)
-        {
-            defaultRenderDevicePnpId_ = std::nullopt;
-            NotifyObservers(SoundDeviceEventType::DefaultRenderChanged, "");
 
-        }
-        else if (flow == eCapture)
-        {
-            defaultCaptureDevicePnpId_ = std::nullopt;
-            NotifyObservers(SoundDeviceEventType::DefaultCaptureChanged, "");
-        }
+    // the new default endpoint is not in the collection
+    if (flow == eRender)
+    {
+        defaultRenderDevicePnpId_ = std::nullopt;
+        NotifyObservers(SoundDeviceEventType::DefaultRenderChanged, "");
+    }
+    else if (flow == eCapture)
+    {
+        defaultCaptureDevicePnpId_ = std::nullopt;
+        NotifyObservers(SoundDeviceEventType::DefaultCaptureChanged, "");
     }
-
-    return hr;
 }
 
 void ed::audio::SoundDeviceCollection::SetDefaultRenderDeviceAndNotifyObservers(const std::string& pnpId)
@@ -1030,3 +1214,13 @@ void ed::audio::SoundDeviceCollection::SetDefaultCaptureDeviceAndNotifyObservers
         NotifyObservers(SoundDeviceEventType::DefaultRenderChanged, pnpId);
     }
 }
+
+ed::audio::RecordedNotification ed::audio::SoundDeviceCollection::CreateSnapshot() const
+{
+    RecordedNotification notification{.type = NotificationType::Snapshot};
+    for (const auto& device : pnpToDeviceMap_ | std::views::values)
+    {
+        notification.devices.push_back(device);
+    }
+    return notification;
+}
@@ -5,18 +5,37 @@
 #include <map>
 #include <atlbase.h>
 #include <functional>
+#include <mutex>
+#include <vector>
 
 #include "public/SoundAgentInterface.h"
 
 #include "SoundDevice.h"
 
 #include "MultipleNotificationClient.h"
+#include "NotificationRecording.h"
 
 
 namespace ed::audio {
 using EndPointVolumeSmartPtr = CComPtr<IAudioEndpointVolume>;
 
+// Resolves the endpoint ids in place of the MMDevice API, e.g. to drive the collection with fake endpoints,
+// see SoundAgentLibStress/FakeAudioEndpoints.h. A collection with a provider gets no notifications of the real endpoints.
+class AudioEndpointProviderInterface
+{
+public:
+    [[nodiscard]] virtual bool TryCreateDevice(const std::wstring& deviceId, SoundDevice& device,
+                                               EndPointVolumeSmartPtr& outVolumeEndpoint) const = 0;
+    [[nodiscard]] virtual std::vector<std::wstring> GetActiveDeviceIds() const = 0;
+    [[nodiscard]] virtual std::optional<std::wstring> GetDefaultDeviceId(EDataFlow flow) const = 0;
+
+    AS_INTERFACE(AudioEndpointProviderInterface);
+    DISALLOW_COPY_MOVE(AudioEndpointProviderInterface);
+};
+
 
+// Thread safe: the endpoint notifications arrive on threads of the audio service. The observers are notified
+// under the collection lock; they may call back into the collection, but must not wait for another thread that does.
 class SoundDeviceCollection final : public SoundDeviceCollectionInterface, protected MultipleNotificationClient {
 protected:
     using TPnPIdToDeviceMap = std::map<std::string, SoundDevice>;
@@ -29,10 +48,15 @@ public:
 
 public:
     SoundDeviceCollection() = default;
+    // Records the endpoint notifications and what they resolved to, for a replay, see SoundAgentLibStress/NotificationReplay.h
+    explicit SoundDeviceCollection(std::unique_ptr<NotificationRecorder> recorder);
+    SoundDeviceCollection(std::unique_ptr<AudioEndpointProviderInterface> endpointProvider,
+                          std::unique_ptr<NotificationRecorder> recorder);
 
     [[nodiscard]] size_t GetSize() const override;
     [[nodiscard]] std::unique_ptr<SoundDeviceInterface> CreateItem(size_t deviceNumber) const override;
     [[nodiscard]] std::unique_ptr<SoundDeviceInterface> CreateItem(const std::string& devicePnpId) const override;
+    [[nodiscard]] std::vector<std::unique_ptr<SoundDeviceInterface>> CreateItems() const override;
 
     [[nodiscard]] std::optional<std::string> GetDefaultRenderDevicePnpId() const override;
     [[nodiscard]] std::optional<std::string> GetDefaultCaptureDevicePnpId() const override;
@@ -50,6 +74,9 @@ public:
 private:
     void SetDefaultRenderDeviceAndNotifyObservers(const std::string& pnpId);
     void SetDefaultCaptureDeviceAndNotifyObservers(const std::string& pnpId);
+    void ProcessDefaultDeviceChange(EDataFlow flow, LPCWSTR defaultDeviceId);
+
+    [[nodiscard]] RecordedNotification CreateSnapshot() const;
 
     void ProcessActiveDeviceList(const ProcessDeviceFunctionT& processDeviceFunc);
     [[nodiscard]] std::pair<std::optional<std::wstring>, std::optional<std::wstring>> TryGetRenderAndCaptureDefaultDeviceIds() const;
@@ -99,5 +126,11 @@ private:
 
     std::optional<std::string> defaultRenderDevicePnpId_;
     std::optional<std::string> defaultCaptureDevicePnpId_;
+
+    std::unique_ptr<NotificationRecorder> recorder_;
+    std::unique_ptr<AudioEndpointProviderInterface> endpointProvider_;
+
+    // Recursive: the observers call back, and a state change is processed as an addition or a removal
+    mutable std::recursive_mutex mutex_;
 };
 }
@@ -0,0 +1,85 @@
+#include "os-dependencies.h"
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+
+ed::TimerWheel::TimerWheel(Clock::duration tickDuration, size_t slotCount, Clock::time_point start)
+    : tickDuration_(std::max(tickDuration, Clock::duration(1)))
+    , start_(start)
+    , slots_(std::max<size_t>(slotCount, 1))
+{
+}
+
+ed::TimerWheel::TimerId ed::TimerWheel::Schedule(Clock::time_point due)
+{
+    // Tick k is processed once now >= start + k * tickDuration
+    const auto sinceStart = std::max(due - start_, Clock::duration::zero());
+    auto tick = static_cast<uint64_t>((sinceStart + tickDuration_ - Clock::duration(1)) / tickDuration_);
+    tick = std::max(tick, processedTicks_ + 1);
+
+    auto& slot = slots_[tick % slots_.size()];
+    const auto timerId = ++lastTimerId_;
+    slot.push_back({timerId, (tick - processedTicks_ - 1) / slots_.size()});
+    timers_.emplace(timerId, std::make_pair(&slot, std::prev(slot.end())));
+    return timerId;
+}
+
+bool ed::TimerWheel::Cancel(TimerId timerId)
+{
+    const auto foundPair = timers_.find(timerId);
+    if (foundPair == timers_.end())
+    {
+        return false;
+    }
+    const auto& [slot, iterator] = foundPair->second;
+    slot->erase(iterator);
+    timers_.erase(foundPair);
+    return true;
+}
+
+std::vector<ed::TimerWheel::TimerId> ed::TimerWheel::Advance(Clock::time_point now)
+{
+    std::vector<TimerId> expired;
+    if (now < start_)
+    {
+        return expired;
+    }
+    const auto targetTick = static_cast<uint64_t>((now - start_) / tickDuration_);
+    if (timers_.empty())
+    {
+        processedTicks_ = std::max(processedTicks_, targetTick);
+        return expired;
+    }
+
+    while (processedTicks_ < targetTick && !timers_.empty())
+    {
+        ++processedTicks_;
+        auto& slot = slots_[processedTicks_ % slots_.size()];
+        for (auto it = slot.begin(); it != slot.end();)
+        {
+            if (it->rounds > 0)
+            {
+                --it->rounds;
+                ++it;
+                continue;
+            }
+            expired.push_back(it->timerId);
+            timers_.erase(it->timerId);
+            it = slot.erase(it);
+        }
+    }
+    processedTicks_ = std::max(processedTicks_, targetTick);
+    return expired;
+}
+
+size_t ed::TimerWheel::GetSize() const
+{
+    return timers_.size();
+}
+
+ed::TimerWheel::Clock::duration ed::TimerWheel::GetTickDuration() const
+{
+    return tickDuration_;
+}
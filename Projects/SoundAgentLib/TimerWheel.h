@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+
+namespace ed {
+// Hashed timer wheel: slotCount buckets of one tick each. A timer more than one revolution ahead
+// carries the number of remaining rounds. Schedule and Cancel are O(1); Advance costs the elapsed ticks plus the expired timers.
+// Time is passed in explicitly, so a virtual clock can drive it.
+class TimerWheel final {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+
+public:
+    TimerWheel(Clock::duration tickDuration, size_t slotCount, Clock::time_point start);
+    DISALLOW_COPY_MOVE(TimerWheel);
+    ~TimerWheel() = default;
+
+public:
+    // Fires on the first tick at or after due
+    TimerId Schedule(Clock::time_point due);
+    bool Cancel(TimerId timerId);
+    // Processes all the ticks up to now; returns the expired timers, earlier ticks first
+    std::vector<TimerId> Advance(Clock::time_point now);
+
+    [[nodiscard]] size_t GetSize() const;
+    [[nodiscard]] Clock::duration GetTickDuration() const;
+
+private:
+    struct Timer
+    {
+        TimerId timerId;
+        uint64_t rounds;
+    };
+    using Slot = std::list<Timer>;
+
+    const Clock::duration tickDuration_;
+    const Clock::time_point start_;
+    uint64_t processedTicks_ = 0;
+    TimerId lastTimerId_ = 0;
+    std::vector<Slot> slots_;
+    std::unordered_map<TimerId, std::pair<Slot*, Slot::iterator>> timers_;
+};
+}
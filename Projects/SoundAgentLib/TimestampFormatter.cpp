@@ -0,0 +1,84 @@
+#include "os-dependencies.h"
+
+#include "TimestampFormatter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+    // Zero padded, the last digit at end - 1
+    void WriteDigits(char* end, int64_t value, size_t count)
+    {
+        for (size_t digit = 0; digit < count; ++digit)
+        {
+            *--end = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+    }
+}
+
+ed::TimestampFormatter::TimestampFormatter(Zone zone, bool insertTBetweenDateAndTime, bool addTimeZone)
+    : zone_(zone == Zone::Local ? std::chrono::current_zone() : nullptr)
+    , dateTimeDelimiter_(insertTBetweenDateAndTime ? 'T' : ' ')
+    , addTimeZone_(addTimeZone)
+{
+}
+
+std::string_view ed::TimestampFormatter::Format(std::chrono::system_clock::time_point time, Buffer& buffer)
+{
+    const auto microseconds = std::chrono::floor<std::chrono::microseconds>(time);
+    const auto second = std::chrono::floor<std::chrono::seconds>(microseconds);
+    if (second != renderedSecond_)
+    {
+        RenderSecond(second);
+    }
+
+    auto* position = std::copy(dateTime_.begin(), dateTime_.end(), buffer.data());
+    *position++ = '.';
+    position += 6;
+    WriteDigits(position, (microseconds - second).count(), 6);
+    position = std::copy_n(zoneText_.begin(), zoneTextSize_, position);
+    return {buffer.data(), static_cast<size_t>(position - buffer.data())};
+}
+
+void ed::TimestampFormatter::RenderSecond(std::chrono::sys_seconds second)
+{
+    std::chrono::seconds sinceEpoch = second.time_since_epoch();
+    if (zone_ != nullptr)
+    {
+        // The offset may change from one second to the next, at a daylight saving time switch
+        const auto offset = zone_->get_info(second).offset;
+        sinceEpoch += offset;
+        if (addTimeZone_)
+        {
+            const auto offsetMinutes = std::chrono::duration_cast<std::chrono::minutes>(offset).count();
+            zoneText_[0] = offsetMinutes < 0 ? '-' : '+';
+            WriteDigits(zoneText_.data() + 3, std::abs(offsetMinutes) / 60, 2);
+            WriteDigits(zoneText_.data() + 5, std::abs(offsetMinutes) % 60, 2);
+            zoneTextSize_ = 5;
+        }
+    }
+    else if (addTimeZone_)
+    {
+        zoneText_[0] = 'Z';
+        zoneTextSize_ = 1;
+    }
+
+    const auto days = std::chrono::floor<std::chrono::days>(std::chrono::sys_seconds(sinceEpoch));
+    const std::chrono::year_month_day date(days);
+    const std::chrono::hh_mm_ss timeOfDay(std::chrono::sys_seconds(sinceEpoch) - days);
+
+    auto* text = dateTime_.data();
+    std::memcpy(text, "0000-00-00 00:00:00", DATE_TIME_SIZE);
+    WriteDigits(text + 4, static_cast<int>(date.year()), 4);
+    WriteDigits(text + 7, static_cast<unsigned>(date.month()), 2);
+    WriteDigits(text + 10, static_cast<unsigned>(date.day()), 2);
+    text[10] = dateTimeDelimiter_;
+    WriteDigits(text + 13, timeOfDay.hours().count(), 2);
+    WriteDigits(text + 16, timeOfDay.minutes().count(), 2);
+    WriteDigits(text + 19, timeOfDay.seconds().count(), 2);
+    renderedSecond_ = second;
+}
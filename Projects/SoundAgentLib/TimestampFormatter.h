@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+
+namespace ed {
+// The text of TimePointToStringAsUtc / TimePointToStringAsLocal, "2025-05-29 12:34:56.223709" optionally with
+// a T between date and time and the zone ("Z" or "+0200"), without allocating: the zone is looked up once,
+// the date and time are rendered once per second, and only the microseconds are written per call.
+// Not thread safe: one per thread, e.g. thread_local. Years 0 to 9999.
+class TimestampFormatter final {
+public:
+    enum class Zone : uint8_t
+    {
+        Utc = 0,
+        Local
+    };
+
+    static constexpr size_t MAX_SIZE = 32;
+    using Buffer = std::array<char, MAX_SIZE>;
+
+public:
+    TimestampFormatter(Zone zone, bool insertTBetweenDateAndTime, bool addTimeZone);
+    DISALLOW_COPY_MOVE(TimestampFormatter);
+    ~TimestampFormatter() = default;
+
+public:
+    // A view into the buffer
+    [[nodiscard]] std::string_view Format(std::chrono::system_clock::time_point time, Buffer& buffer);
+
+private:
+    void RenderSecond(std::chrono::sys_seconds second);
+
+private:
+    static constexpr size_t DATE_TIME_SIZE = 19; // "2025-05-29 12:34:56"
+
+    const std::chrono::time_zone* const zone_; // nullptr: UTC
+    const char dateTimeDelimiter_;
+    const bool addTimeZone_;
+
+    std::chrono::sys_seconds renderedSecond_ = std::chrono::sys_seconds::min();
+    std::array<char, DATE_TIME_SIZE> dateTime_{};
+    std::array<char, 5> zoneText_{}; // "Z" or "+0200"
+    size_t zoneTextSize_ = 0;
+};
+}
@@ -0,0 +1,34 @@
+#include "os-dependencies.h"
+
+#include "TraceContextHttpRequestDispatcher.h"
+
+#include "PipelineLatency.h"
+
+
+TraceContextHttpRequestDispatcher::TraceContextHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher)
+    : targetDispatcher_(targetDispatcher)
+{
+}
+
+void TraceContextHttpRequestDispatcher::EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                                       const std::string& urlSuffix, const std::string& payload,
+                                                       const std::unordered_map<std::string, std::string>& header,
+                                                       const std::string& hint)
+{
+    const auto* context = ed::LatencyTrace::GetContext();
+    if (context == nullptr)
+    {
+        targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, payload, header, hint);
+        return;
+    }
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    auto tracedHeader = header;
+    tracedHeader[TRACE_PARENT_HEADER_KEY] = context->traceParent;
+    tracedHeader[CAPTURE_TIME_HEADER_KEY] = std::to_string(
+        duration_cast<microseconds>(context->systemCaptureTime.time_since_epoch()).count());
+    tracedHeader[CAPTURE_MONOTONIC_TIME_HEADER_KEY] = std::to_string(
+        duration_cast<microseconds>(context->steadyCaptureTime.time_since_epoch()).count());
+    targetDispatcher_.EnqueueRequest(postOrPut, time, urlSuffix, payload, tracedHeader, hint);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+// Adds the trace context of the notification being processed on the calling thread, if any (see ed::LatencyTrace),
+// to the request headers: the W3C traceparent and the capture times in microseconds.
+// Must be passed the request before any queueing, on the thread of the notification.
+class TraceContextHttpRequestDispatcher final : public HttpRequestDispatcherInterface
+{
+public:
+    static constexpr auto TRACE_PARENT_HEADER_KEY = "traceparent";
+    // Since the Unix epoch
+    static constexpr auto CAPTURE_TIME_HEADER_KEY = "X-Capture-Time-Us";
+    // Of the monotonic clock of the agent; comparable between the messages of one agent run only
+    static constexpr auto CAPTURE_MONOTONIC_TIME_HEADER_KEY = "X-Capture-Monotonic-Us";
+
+public:
+    explicit TraceContextHttpRequestDispatcher(HttpRequestDispatcherInterface& targetDispatcher);
+
+    DISALLOW_COPY_MOVE(TraceContextHttpRequestDispatcher);
+    ~TraceContextHttpRequestDispatcher() override = default;
+
+public:
+    void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                        const std::string& urlSuffix, const std::string& payload,
+                        const std::unordered_map<std::string, std::string>& header,
+                        const std::string& hint) override;
+
+private:
+    HttpRequestDispatcherInterface& targetDispatcher_;
+};
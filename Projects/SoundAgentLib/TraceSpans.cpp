@@ -0,0 +1,291 @@
+#include "os-dependencies.h"
+
+#include "TraceSpans.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+
+// A ring written by one thread at a time, the one that adopted it last. The writer claims an index, then fills
+// the event, then publishes it; a reader copies the published events and drops those whose slot got claimed again meanwhile.
+class ed::TraceRecorder::ThreadBuffer final {
+public:
+    struct Span
+    {
+        const char* name;
+        std::chrono::steady_clock::rep start;
+        std::chrono::steady_clock::rep duration;
+        DWORD threadId;
+    };
+
+    // The thread writing from firstIndex on
+    struct Owner
+    {
+        uint64_t firstIndex;
+        DWORD threadId;
+    };
+
+    // What a reader may read: the events before published, written by these owners
+    struct Extent
+    {
+        uint64_t published;
+        std::vector<Owner> owners;
+    };
+
+public:
+    ThreadBuffer()
+        : events_(std::make_unique<Event[]>(EVENTS_PER_THREAD))
+    {
+    }
+
+    DISALLOW_COPY_MOVE(ThreadBuffer);
+    ~ThreadBuffer() = default;
+
+public:
+    void Write(const char* name, std::chrono::steady_clock::rep start, std::chrono::steady_clock::rep duration)
+    {
+        const auto index = published_.load(std::memory_order_relaxed);
+        claimed_.store(index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        auto& event = events_[index % EVENTS_PER_THREAD];
+        event.name.store(name, std::memory_order_relaxed);
+        event.start.store(start, std::memory_order_relaxed);
+        event.duration.store(duration, std::memory_order_relaxed);
+        published_.store(index + 1, std::memory_order_release);
+    }
+
+    // With the pool locked, before the thread writes
+    void Adopt(DWORD threadId)
+    {
+        const auto published = published_.load(std::memory_order_relaxed);
+        owners_.push_back({published, threadId});
+        // Owners whose events are all overwritten
+        while (owners_.size() > 1 && owners_[1].firstIndex + EVENTS_PER_THREAD <= published)
+        {
+            owners_.erase(owners_.begin());
+        }
+    }
+
+    // With the pool locked
+    [[nodiscard]] Extent GetExtent() const
+    {
+        return {published_.load(std::memory_order_acquire), owners_};
+    }
+
+    [[nodiscard]] std::vector<Span> Read(const Extent& extent) const
+    {
+        const auto published = extent.published;
+        const auto& owners = extent.owners;
+        auto first = published > EVENTS_PER_THREAD ? published - EVENTS_PER_THREAD : 0;
+        std::vector<Span> spans;
+        spans.reserve(published - first);
+        auto owner = owners.begin();
+        for (auto index = first; index < published; ++index)
+        {
+            while (std::next(owner) != owners.end() && std::next(owner)->firstIndex <= index)
+            {
+                ++owner;
+            }
+            const auto& event = events_[index % EVENTS_PER_THREAD];
+            spans.push_back({
+                event.name.load(std::memory_order_relaxed),
+                event.start.load(std::memory_order_relaxed),
+                event.duration.load(std::memory_order_relaxed),
+                owner->threadId
+            });
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Claimed indices may have overwritten the slots of the indices EVENTS_PER_THREAD before them
+        if (const auto claimed = claimed_.load(std::memory_order_relaxed); claimed > first + EVENTS_PER_THREAD)
+        {
+            const auto overwritten = std::min<uint64_t>(claimed - EVENTS_PER_THREAD - first, spans.size());
+            spans.erase(spans.begin(), spans.begin() + static_cast<ptrdiff_t>(overwritten));
+        }
+        return spans;
+    }
+
+private:
+    struct Event
+    {
+        std::atomic<const char*> name = nullptr;
+        std::atomic<std::chrono::steady_clock::rep> start = 0;
+        std::atomic<std::chrono::steady_clock::rep> duration = 0;
+    };
+
+    const std::unique_ptr<Event[]> events_;
+    std::atomic<uint64_t> claimed_ = 0;
+    std::atomic<uint64_t> published_ = 0;
+    std::vector<Owner> owners_; // guarded by the pool mutex
+};
+
+class ed::TraceRecorder::ThreadBuffers final {
+public:
+    ThreadBuffers() = default;
+    DISALLOW_COPY_MOVE(ThreadBuffers);
+
+    // The thread finished: its buffers go back to the pools of the recorders still alive
+    ~ThreadBuffers()
+    {
+        for (const auto& entry : entries_)
+        {
+            if (const auto pool = entry.pool.lock())
+            {
+                std::lock_guard lock(pool->mutex);
+                pool->freeBuffers.push_back(entry.buffer);
+            }
+        }
+    }
+
+public:
+    [[nodiscard]] ThreadBuffer* Find(uint64_t recorderId) const
+    {
+        for (const auto& entry : entries_)
+        {
+            if (entry.recorderId == recorderId)
+            {
+                return entry.buffer;
+            }
+        }
+        return nullptr;
+    }
+
+    void Add(uint64_t recorderId, ThreadBuffer* buffer, const std::shared_ptr<BufferPool>& pool)
+    {
+        entries_.push_back({recorderId, buffer, pool});
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t recorderId;
+        ThreadBuffer* buffer;
+        std::weak_ptr<BufferPool> pool;
+    };
+
+    std::vector<Entry> entries_;
+};
+
+namespace
+{
+    std::atomic<uint64_t> lastRecorderId = 0;
+}
+
+thread_local ed::TraceRecorder::ThreadBuffers ed::TraceRecorder::threadBuffers_;
+
+ed::TraceRecorder::TraceRecorder()
+    : id_(++lastRecorderId)
+    , pool_(std::make_shared<BufferPool>())
+{
+}
+
+ed::TraceRecorder::~TraceRecorder() = default;
+
+ed::TraceRecorder& ed::TraceRecorder::GetInstance()
+{
+    static TraceRecorder instance;
+    return instance;
+}
+
+void ed::TraceRecorder::SetEnabled(bool enabled)
+{
+    isEnabled_.store(enabled, std::memory_order_relaxed);
+}
+
+bool ed::TraceRecorder::IsEnabled() const
+{
+    return isEnabled_.load(std::memory_order_relaxed);
+}
+
+void ed::TraceRecorder::Record(const char* name, std::chrono::steady_clock::time_point start,
+                               std::chrono::steady_clock::time_point end)
+{
+    GetThreadBuffer().Write(name, start.time_since_epoch().count(), (end - start).count());
+}
+
+ed::TraceRecorder::ThreadBuffer& ed::TraceRecorder::GetThreadBuffer()
+{
+    if (auto* buffer = threadBuffers_.Find(id_); buffer != nullptr)
+    {
+        return *buffer;
+    }
+    // First span of this thread: the buffer of a finished thread if any, a new one otherwise
+    ThreadBuffer* buffer;
+    {
+        std::lock_guard lock(pool_->mutex);
+        if (pool_->freeBuffers.empty())
+        {
+            buffer = pool_->buffers.emplace_back(std::make_unique<ThreadBuffer>()).get();
+        }
+        else
+        {
+            buffer = pool_->freeBuffers.back();
+            pool_->freeBuffers.pop_back();
+        }
+        buffer->Adopt(GetCurrentThreadId());
+    }
+    threadBuffers_.Add(id_, buffer, pool_);
+    return *buffer;
+}
+
+size_t ed::TraceRecorder::GetThreadBufferCount() const
+{
+    std::lock_guard lock(pool_->mutex);
+    return pool_->buffers.size();
+}
+
+std::string ed::TraceRecorder::FormatChromeTrace() const
+{
+    // The buffers are never freed; their owners change with the pool locked
+    std::vector<std::pair<const ThreadBuffer*, ThreadBuffer::Extent>> buffers;
+    {
+        std::lock_guard lock(pool_->mutex);
+        for (const auto& buffer : pool_->buffers)
+        {
+            buffers.emplace_back(buffer.get(), buffer->GetExtent());
+        }
+    }
+
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    const auto processId = GetCurrentProcessId();
+    std::string trace = R"({"displayTimeUnit":"ms","traceEvents":[)";
+    bool isFirst = true;
+    for (const auto& [buffer, extent] : buffers)
+    {
+        for (const auto& span : buffer->Read(extent))
+        {
+            trace += std::format(R"({}{{"name":"{}","cat":"agent","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":{},"tid":{}}})",
+                                 isFirst ? "\n" : ",\n", span.name,
+                                 Microseconds(std::chrono::steady_clock::duration(span.start)).count(),
+                                 Microseconds(std::chrono::steady_clock::duration(span.duration)).count(),
+                                 processId, span.threadId);
+            isFirst = false;
+        }
+    }
+    trace += "\n]}\n";
+    return trace;
+}
+
+bool ed::TraceRecorder::WriteChromeTrace(const std::filesystem::path& file) const
+{
+    const auto trace = FormatChromeTrace();
+    std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+    stream.write(trace.data(), static_cast<std::streamsize>(trace.size()));
+    return stream.good();
+}
+
+ed::TraceSpan::TraceSpan(const char* name)
+    : name_(TraceRecorder::GetInstance().IsEnabled() ? name : nullptr)
+    , start_(name_ != nullptr ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+{
+}
+
+ed::TraceSpan::~TraceSpan()
+{
+    if (name_ != nullptr)
+    {
+        TraceRecorder::GetInstance().Record(name_, start_, std::chrono::steady_clock::now());
+    }
+}
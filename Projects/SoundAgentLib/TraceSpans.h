@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace ed {
+// Spans of the agent's internal processing, kept per thread in a ring of the latest EVENTS_PER_THREAD spans
+// and exported as Chrome trace event JSON, viewable in ui.perfetto.dev or chrome://tracing.
+// Recording is off until enabled; a thread writes its own ring without locking, the export reads all of them.
+// The ring of a finished thread is taken over by the next thread that starts recording: there are at most as many
+// rings as threads recording at once. Its spans are exported until the new thread overwrote them.
+class TraceRecorder final {
+public:
+    static constexpr size_t EVENTS_PER_THREAD = 8192;
+
+public:
+    TraceRecorder();
+    DISALLOW_COPY_MOVE(TraceRecorder);
+    ~TraceRecorder();
+
+    // The one TRACE_SPAN records into
+    [[nodiscard]] static TraceRecorder& GetInstance();
+
+public:
+    void SetEnabled(bool enabled);
+    [[nodiscard]] bool IsEnabled() const;
+
+    // The name must outlive the recorder, e.g. a string literal; it must not need JSON escaping
+    void Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+    // Of the running threads and free ones
+    [[nodiscard]] size_t GetThreadBufferCount() const;
+
+    [[nodiscard]] std::string FormatChromeTrace() const;
+    // Replaces the file; false if it can not be written
+    bool WriteChromeTrace(const std::filesystem::path& file) const;
+
+private:
+    class ThreadBuffer;
+    // Shared with the threads: a finished thread hands its buffer back, the recorder may be gone by then
+    struct BufferPool
+    {
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::vector<ThreadBuffer*> freeBuffers;
+    };
+    class ThreadBuffers;
+
+    ThreadBuffer& GetThreadBuffer();
+
+    // The buffers of the current thread by recorder id, in practice the one of the global recorder; returned on thread exit
+    static thread_local ThreadBuffers threadBuffers_;
+
+    const uint64_t id_;
+    std::atomic<bool> isEnabled_ = false;
+    const std::shared_ptr<BufferPool> pool_;
+};
+
+// Records the time from its construction to its destruction if the recorder is enabled on construction
+class TraceSpan final {
+public:
+    explicit TraceSpan(const char* name);
+    DISALLOW_COPY_MOVE(TraceSpan);
+    ~TraceSpan();
+
+private:
+    const char* const name_;
+    const std::chrono::steady_clock::time_point start_;
+};
+}
+
+// A span over the rest of the enclosing block; nothing at all if NO_TRACE_SPANS is defined
+#ifdef NO_TRACE_SPANS
+#define TRACE_SPAN(name) static_cast<void>(0)
+#else
+#define TRACE_SPAN_CONCATENATE(left, right) left##right
+#define TRACE_SPAN_VARIABLE(line) TRACE_SPAN_CONCATENATE(traceSpan, line)
+#define TRACE_SPAN(name) const ed::TraceSpan TRACE_SPAN_VARIABLE(__LINE__)(name)
+#endif
@@ -0,0 +1,176 @@
+#include "os-dependencies.h"
+
+#include "Utf16Transcoding.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define ED_UTF16_TRANSCODING_SSE2
+#endif
+
+
+namespace
+{
+    static_assert(sizeof(wchar_t) == sizeof(uint16_t), "Wide characters are UTF-16 code units");
+
+    // Code units per step: two 128 bit loads packed into 16 bytes
+    constexpr size_t BLOCK_SIZE = 16;
+
+#ifdef ED_UTF16_TRANSCODING_SSE2
+    // false, nothing written, if a code unit of the block is not ASCII
+    bool TryPackAsciiBlock(const wchar_t* input, char* output)
+    {
+        const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+        const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + BLOCK_SIZE / 2));
+        const auto nonAsciiBits = _mm_and_si128(_mm_or_si128(low, high), _mm_set1_epi16(static_cast<short>(0xFF80)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAsciiBits, _mm_setzero_si128())) != 0xFFFF)
+        {
+            return false;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_packus_epi16(low, high));
+        return true;
+    }
+
+    void PackLowBytesBlock(const wchar_t* input, char* output)
+    {
+        const auto lowByteMask = _mm_set1_epi16(0x00FF);
+        const auto low = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input)), lowByteMask);
+        const auto high = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + BLOCK_SIZE / 2)), lowByteMask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_packus_epi16(low, high));
+    }
+#else
+    bool TryPackAsciiBlock(const wchar_t* input, char* output)
+    {
+        uint16_t allBits = 0;
+        for (size_t unit = 0; unit < BLOCK_SIZE; ++unit)
+        {
+            allBits |= static_cast<uint16_t>(input[unit]);
+        }
+        if (allBits >= 0x80)
+        {
+            return false;
+        }
+        std::transform(input, input + BLOCK_SIZE, output, [](wchar_t unit) { return static_cast<char>(unit); });
+        return true;
+    }
+
+    void PackLowBytesBlock(const wchar_t* input, char* output)
+    {
+        std::transform(input, input + BLOCK_SIZE, output, [](wchar_t unit) { return static_cast<char>(unit); });
+    }
+#endif
+
+    // One code point: a code unit, or two of a surrogate pair
+    void EncodeCodePoint(const wchar_t*& input, const wchar_t* end, char*& output)
+    {
+        uint32_t codePoint = static_cast<uint16_t>(*input++);
+        if (codePoint < 0x80)
+        {
+            *output++ = static_cast<char>(codePoint);
+            return;
+        }
+        if (codePoint < 0x800)
+        {
+            *output++ = static_cast<char>(0xC0 | codePoint >> 6);
+            *output++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+            return;
+        }
+        if (codePoint >= 0xD800 && codePoint < 0xE000)
+        {
+            if (const uint32_t next = input != end ? static_cast<uint16_t>(*input) : 0
+                ; codePoint < 0xDC00 && next >= 0xDC00 && next < 0xE000)
+            {
+                ++input;
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (next - 0xDC00);
+                *output++ = static_cast<char>(0xF0 | codePoint >> 18);
+                *output++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                *output++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                *output++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+                return;
+            }
+            codePoint = 0xFFFD; // unpaired
+        }
+        *output++ = static_cast<char>(0xE0 | codePoint >> 12);
+        *output++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        *output++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+size_t ed::TranscodeUtf16ToUtf8(std::wstring_view text, char* output)
+{
+    const auto* input = text.data();
+    const auto* const end = input + text.size();
+    auto* position = output;
+    bool isPreviousBlockAscii = false;
+    while (input != end)
+    {
+        const auto remaining = static_cast<size_t>(end - input);
+        if (remaining >= BLOCK_SIZE)
+        {
+            isPreviousBlockAscii = TryPackAsciiBlock(input, position);
+            if (isPreviousBlockAscii)
+            {
+                input += BLOCK_SIZE;
+                position += BLOCK_SIZE;
+                continue;
+            }
+        }
+        else if (isPreviousBlockAscii)
+        {
+            // The tail as a block overlapping the previous one, which took a byte per code unit
+            const auto overlap = BLOCK_SIZE - remaining;
+            if (TryPackAsciiBlock(end - BLOCK_SIZE, position - overlap))
+            {
+                position += remaining;
+                break;
+            }
+            isPreviousBlockAscii = false;
+        }
+
+        // A block, or the tail, one code point at a time
+        const auto* const blockEnd = input + std::min(remaining, BLOCK_SIZE);
+        while (input < blockEnd)
+        {
+            EncodeCodePoint(input, end, position);
+        }
+    }
+    return static_cast<size_t>(position - output);
+}
+
+size_t ed::TruncateUtf16(std::wstring_view text, char* output)
+{
+    const auto size = text.size();
+    size_t unit = 0;
+    for (; unit + BLOCK_SIZE <= size; unit += BLOCK_SIZE)
+    {
+        PackLowBytesBlock(text.data() + unit, output + unit);
+    }
+    if (unit < size && size >= BLOCK_SIZE)
+    {
+        PackLowBytesBlock(text.data() + size - BLOCK_SIZE, output + size - BLOCK_SIZE);
+        return size;
+    }
+    for (; unit < size; ++unit)
+    {
+        output[unit] = static_cast<char>(text[unit]);
+    }
+    return size;
+}
+
+ed::Utf8Text::Utf8Text(std::wstring_view text)
+{
+    char* output = inline_.data();
+    if (const auto maxSize = MaxUtf8Size(text.size()); maxSize > INLINE_SIZE)
+    {
+        heap_ = std::make_unique_for_overwrite<char[]>(maxSize);
+        output = heap_.get();
+    }
+    view_ = {output, TranscodeUtf16ToUtf8(text, output)};
+}
+
+std::string_view ed::Utf8Text::View() const
+{
+    return view_;
+}
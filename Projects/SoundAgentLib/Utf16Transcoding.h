@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ApiClient/common/ClassDefHelper.h"
+
+#include <array>
+#include <memory>
+#include <string_view>
+
+
+namespace ed {
+// UTF-16 code units take at most 3 UTF-8 bytes each, a surrogate pair 4 for the two
+constexpr size_t MaxUtf8Size(size_t utf16Size)
+{
+    return 3 * utf16Size;
+}
+
+// The text of Utf16ToUtf8 written to output, which must have room for MaxUtf8Size(text.size()) bytes;
+// returns the bytes written. An unpaired surrogate becomes U+FFFD, as with WideCharToMultiByte.
+// Runs of ASCII, e.g. endpoint ids, are packed 16 code units at a time with SSE2.
+size_t TranscodeUtf16ToUtf8(std::wstring_view text, char* output);
+
+// The text of WString2StringTruncate, the low byte of every code unit, written to output, which must have
+// room for text.size() bytes; returns the bytes written.
+size_t TruncateUtf16(std::wstring_view text, char* output);
+
+// UTF-8 of a wide text without allocating for the usual lengths, e.g. for the arguments of log lines:
+// ED_LOG_INFO(R"(Device added: id "{}".)", Utf8Text(deviceId).View());
+class Utf8Text final {
+public:
+    // Endpoint ids are 55 code units, friendly names rarely longer
+    static constexpr size_t INLINE_SIZE = 256;
+
+public:
+    explicit Utf8Text(std::wstring_view text);
+    DISALLOW_COPY_MOVE(Utf8Text);
+    ~Utf8Text() = default;
+
+public:
+    // Valid as long as this object
+    [[nodiscard]] std::string_view View() const;
+
+private:
+    std::array<char, INLINE_SIZE> inline_;
+    std::unique_ptr<char[]> heap_; // when longer than INLINE_SIZE may need
+    std::string_view view_;
+};
+}
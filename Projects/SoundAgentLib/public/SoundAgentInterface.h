@@ -6,6 +6,7 @@
 #include <memory>
 #include <string>
 #include <optional>
+#include <vector>
 
 
 class SoundDeviceCollectionInterface;
@@ -48,6 +49,8 @@ public:
     virtual size_t GetSize() const = 0;
     virtual std::unique_ptr<SoundDeviceInterface> CreateItem(size_t deviceNumber) const = 0;
     virtual std::unique_ptr<SoundDeviceInterface> CreateItem(const std::string& devicePnpId) const = 0;
+    // All the devices at one point in time; unlike GetSize() and CreateItem(i), safe against concurrent changes
+    virtual std::vector<std::unique_ptr<SoundDeviceInterface>> CreateItems() const = 0;
 
     virtual std::optional<std::string> GetDefaultRenderDevicePnpId() const = 0;
     virtual std::optional<std::string> GetDefaultCaptureDevicePnpId() const = 0;
@@ -0,0 +1,774 @@
+#include "os-dependencies.h"
+
+#include "ApiClient/AudioDeviceApiClient.h"
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+#include "ApiClient/common/StringUtils.h"
+#include "ApiClient/common/TimeUtil.h"
+
+#include "AsyncDefaultLogger.h"
+#include "BinaryLog.h"
+#include "Clock.h"
+#include "FakeAudioEndpoints.h"
+#include "LogFloodGuard.h"
+#include "LogMacros.h"
+#include "LogRing.h"
+#include "LogShipper.h"
+#include "PayloadEncoding.h"
+#include "RelayAggregator.h"
+#include "SentDeviceStateCache.h"
+#include "SoundDevice.h"
+#include "SoundDeviceCollection.h"
+#include "TimestampFormatter.h"
+#include "TraceSpans.h"
+#include "Utf16Transcoding.h"
+#include "public/CoInitRaiiHelper.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/spdlog.h>
+
+
+// Microbenchmarks of the SoundAgentLib hot paths: device copies, merging of the render and capture
+// endpoints of one device, volume change detection, observer fan-out, id conversion, name splitting,
+// time formatting, payload construction, trace spans, the logging of an enumeration, a log flood, the log formats, the log ring, log shipping
+// and a fleet of agents behind one relay.
+// The results are written as JSON (SoundAgentLibBenchmarks.json unless --benchmark_out is given),
+// to be compared across commits with compare.py of Google Benchmark.
+namespace ed::audio
+{
+    namespace
+    {
+        constexpr auto DEVICE_ID = "{0.0.0.00000000}.{6a3b1f29-4c8e-4d2a-9e71-0f5b2c8d4a11}";
+        constexpr auto PNP_ID = "0.0.0.00000000.6A3B1F29-4C8E-4D2A-9E71-0F5B2C8D4A11";
+        constexpr auto RENDER_NAME = "Headset Earphone (Jabra Evolve2 65)";
+        constexpr auto CAPTURE_NAME = "Headset Microphone (Jabra Evolve2 65)";
+
+        class DiscardingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                benchmark::DoNotOptimize(payload.data());
+                byteCount += payload.size();
+            }
+
+            size_t byteCount = 0;
+        };
+
+        class CountingObserver final : public SoundDeviceObserverInterface
+        {
+        public:
+            void OnCollectionChanged(SoundDeviceEventType, const std::string& devicePnpId) override
+            {
+                benchmark::DoNotOptimize(devicePnpId.data());
+                ++eventCount;
+            }
+
+            uint64_t eventCount = 0;
+        };
+
+        std::string HostName()
+        {
+            return "DESKTOP-4F7T2QK";
+        }
+
+        std::string OperationSystemName()
+        {
+            return "Windows 11 Enterprise 23H2 Build 22631.4317";
+        }
+
+        SoundDevice CreateMergedDevice()
+        {
+            return {PNP_ID, std::format("{}/{}", RENDER_NAME, CAPTURE_NAME), SoundDeviceFlowType::RenderAndCapture, 600, 800, true, true};
+        }
+
+        // A virtual agent: stamps its requests the way RelayClientHttpRequestDispatcher does, without the socket
+        class RelayLineAgent final : public HttpRequestDispatcherInterface
+        {
+        public:
+            RelayLineAgent(std::string hostName, uint64_t epoch, std::vector<std::string>& lines)
+                : hostName_(std::move(hostName))
+                , epoch_(epoch)
+                , lines_(lines)
+            {
+            }
+
+            void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                const std::string& urlSuffix, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>& header, const std::string& hint
+            ) override
+            {
+                RelayMessage relayMessage{
+                    .hostName = hostName_, .epoch = epoch_, .sequence = nextSequence_++,
+                    .message = {postOrPut, time, urlSuffix, payload, header, hint}
+                };
+                if (const auto json = nlohmann::json::parse(payload, nullptr, false);
+                    json.is_object() && json.contains("pnpId"))
+                {
+                    relayMessage.deviceId = json["pnpId"].get<std::string>();
+                }
+                lines_.push_back(relayMessage.ToNdjsonLine());
+            }
+
+            [[nodiscard]] const std::string& GetHostName() const
+            {
+                return hostName_;
+            }
+
+        private:
+            const std::string hostName_;
+            const uint64_t epoch_;
+            uint64_t nextSequence_ = 1;
+            std::vector<std::string>& lines_;
+        };
+
+        // The lines of the agents as they reach the relay: each agent sends its startup device records and
+        // a few volume changes over its own connection, the agents interleave; 3% of the lines are sent twice
+        // (as after a reconnect), a re-sent line follows its original
+        std::vector<std::string> CreateRelayWireLines(size_t agentCount, size_t devicesPerAgent, size_t volumeChangesPerAgent)
+        {
+            const auto messagesPerAgent = devicesPerAgent + volumeChangesPerAgent;
+            std::vector<std::vector<std::string>> agentLines(agentCount);
+            std::mt19937 randomGenerator(42); // NOLINT(cert-msc51-cpp): reproducible benchmark
+            for (size_t agent = 0; agent < agentCount; ++agent)
+            {
+                RelayLineAgent relayLineAgent(std::format("DESKTOP-{:06}", agent), randomGenerator(), agentLines[agent]);
+                const AudioDeviceApiClient apiClient(relayLineAgent,
+                    [&relayLineAgent] { return relayLineAgent.GetHostName(); }, OperationSystemName);
+                std::vector<SoundDevice> devices;
+                for (size_t device = 0; device < devicesPerAgent; ++device)
+                {
+                    devices.emplace_back(std::format("{{0.0.{}.00000000}}.{{F2B6C1D4-9A3E-4F7B-B0C8-5E1D2A3B{:04X}}}", device % 2, device),
+                                         std::format("Device {} (High Definition Audio)", device),
+                                         device % 2 == 0 ? SoundDeviceFlowType::Render : SoundDeviceFlowType::Capture,
+                                         static_cast<uint16_t>(400 + device), static_cast<uint16_t>(600 + device), device == 0, device == 1);
+                    apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &devices.back(), "");
+                }
+                for (size_t change = 0; change < volumeChangesPerAgent; ++change)
+                {
+                    apiClient.PutVolumeChangeToApi(devices[change % devicesPerAgent].GetPnpId(), true,
+                                                   static_cast<uint16_t>(randomGenerator() % 1000), "");
+                }
+            }
+
+            std::vector<std::string> wireLines;
+            wireLines.reserve(agentCount * messagesPerAgent * 104 / 100);
+            std::vector<size_t> agentOrder(agentCount);
+            std::iota(agentOrder.begin(), agentOrder.end(), size_t{0});
+            std::bernoulli_distribution resent(0.03);
+            for (size_t round = 0; round < messagesPerAgent; ++round)
+            {
+                std::ranges::shuffle(agentOrder, randomGenerator);
+                for (const auto agent : agentOrder)
+                {
+                    if (resent(randomGenerator))
+                    {
+                        wireLines.push_back(agentLines[agent][round]);
+                    }
+                    wireLines.push_back(std::move(agentLines[agent][round]));
+                }
+            }
+            return wireLines;
+        }
+
+        // Active render endpoints of as many devices
+        void AddSpeakers(FakeEndpoints& endpoints, int64_t count)
+        {
+            for (int64_t i = 0; i < count; ++i)
+            {
+                auto& endpoint = endpoints.Add(std::format(L"{{0.0.0.00000000}}.{{{:08x}-4c8e-4d2a-9e71-0f5b2c8d4a11}}", i),
+                                               std::format("0.0.0.00000000.{:08X}-4C8E-4D2A-9E71-0F5B2C8D4A11", i),
+                                               std::format("Speakers {}", i), SoundDeviceFlowType::Render);
+                endpoint.active = true;
+            }
+        }
+
+        // The collection logs its every step at info level: what is measured is the processing, not the logging
+        class QuietLogging final
+        {
+        public:
+            QuietLogging()
+                : previousLogger_(spdlog::default_logger())
+            {
+                spdlog::set_default_logger(std::make_shared<spdlog::logger>("benchmark", std::make_shared<spdlog::sinks::null_sink_mt>()));
+                spdlog::set_level(spdlog::level::warn);
+            }
+
+            DISALLOW_COPY_MOVE(QuietLogging);
+
+            ~QuietLogging()
+            {
+                spdlog::set_default_logger(previousLogger_);
+                spdlog::set_level(spdlog::level::info);
+            }
+
+        private:
+            const std::shared_ptr<spdlog::logger> previousLogger_;
+        };
+    }
+
+    void BM_SoundDeviceCopy(benchmark::State& state)
+    {
+        const auto device = CreateMergedDevice();
+        for (auto _ : state)
+        {
+            SoundDevice copy(device);
+            benchmark::DoNotOptimize(copy);
+        }
+    }
+    BENCHMARK(BM_SoundDeviceCopy);
+
+    void BM_SoundDeviceMove(benchmark::State& state)
+    {
+        auto device = CreateMergedDevice();
+        for (auto _ : state)
+        {
+            SoundDevice moved(std::move(device));
+            benchmark::DoNotOptimize(moved);
+            device = std::move(moved);
+        }
+    }
+    BENCHMARK(BM_SoundDeviceMove);
+
+    // The capture endpoint of a headset whose render endpoint is in the collection: merged into the device of
+    // their PnP id on the addition, unmerged on the removal
+    void BM_MergeAndUnmergeEndpoint(benchmark::State& state)
+    {
+        const QuietLogging quietLogging;
+        FakeEndpoints endpoints;
+        auto& renderEndpoint = endpoints.Add(L"{0.0.0.00000000}.{6a3b1f29-4c8e-4d2a-9e71-0f5b2c8d4a11}", PNP_ID, RENDER_NAME,
+                                             SoundDeviceFlowType::Render);
+        auto& captureEndpoint = endpoints.Add(L"{0.0.1.00000000}.{6a3b1f29-4c8e-4d2a-9e71-0f5b2c8d4a11}", PNP_ID, CAPTURE_NAME,
+                                              SoundDeviceFlowType::Capture);
+        SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(endpoints), nullptr);
+        renderEndpoint.active = true;
+        collection.OnDeviceAdded(renderEndpoint.id.c_str());
+        for (auto _ : state)
+        {
+            captureEndpoint.active = true;
+            collection.OnDeviceAdded(captureEndpoint.id.c_str());
+            captureEndpoint.active = false;
+            collection.OnDeviceRemoved(captureEndpoint.id.c_str());
+        }
+    }
+    BENCHMARK(BM_MergeAndUnmergeEndpoint);
+
+    // A volume notification: the volumes of all the endpoints read again and compared, every second device changed its volume
+    void BM_VolumeChangeDetection(benchmark::State& state)
+    {
+        const QuietLogging quietLogging;
+        FakeEndpoints endpoints;
+        AddSpeakers(endpoints, state.range(0));
+        SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(endpoints), nullptr);
+        collection.ResetContent();
+        const auto allEndpoints = endpoints.GetAll();
+        AUDIO_VOLUME_NOTIFICATION_DATA notification{};
+        uint16_t volume = 500;
+        for (auto _ : state)
+        {
+            volume = volume == 500 ? 510 : 500;
+            for (size_t i = 0; i < allEndpoints.size(); i += 2)
+            {
+                allEndpoints[i]->volume = volume;
+            }
+            collection.OnNotify(&notification);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_VolumeChangeDetection)->RangeMultiplier(4)->Range(4, 256);
+
+    // A volume change of one device notified to every observer
+    void BM_ObserverFanOut(benchmark::State& state)
+    {
+        const QuietLogging quietLogging;
+        FakeEndpoints endpoints;
+        AddSpeakers(endpoints, 1);
+        SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(endpoints), nullptr);
+        collection.ResetContent();
+        std::vector<CountingObserver> observers(static_cast<size_t>(state.range(0)));
+        for (auto& observer : observers)
+        {
+            collection.Subscribe(observer);
+        }
+        auto& endpoint = *endpoints.GetAll().front();
+        AUDIO_VOLUME_NOTIFICATION_DATA notification{};
+        for (auto _ : state)
+        {
+            endpoint.volume = endpoint.volume == 500 ? 510 : 500;
+            collection.OnNotify(&notification);
+        }
+        for (auto& observer : observers)
+        {
+            collection.Unsubscribe(observer);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_ObserverFanOut)->RangeMultiplier(2)->Range(1, 64);
+
+    // An endpoint id to UTF-8: 0 Utf16ToUtf8, 1 WString2StringTruncate, 2 TranscodeUtf16ToUtf8, 3 TruncateUtf16,
+    // the last two into a buffer of the caller, 4 Utf8Text
+    void BM_EndpointIdToUtf8(benchmark::State& state)
+    {
+        const std::wstring deviceId = L"{0.0.0.00000000}.{6a3b1f29-4c8e-4d2a-9e71-0f5b2c8d4a11}";
+        std::array<char, MaxUtf8Size(64)> buffer{};
+        for (auto _ : state)
+        {
+            switch (state.range(0))
+            {
+            case 0:
+                benchmark::DoNotOptimize(Utf16ToUtf8(deviceId));
+                break;
+            case 1:
+                benchmark::DoNotOptimize(WString2StringTruncate(deviceId));
+                break;
+            case 2:
+                benchmark::DoNotOptimize(TranscodeUtf16ToUtf8(deviceId, buffer.data()));
+                break;
+            case 3:
+                benchmark::DoNotOptimize(TruncateUtf16(deviceId, buffer.data()));
+                break;
+            default:
+                benchmark::DoNotOptimize(Utf8Text(deviceId).View());
+                break;
+            }
+            benchmark::ClobberMemory();
+        }
+    }
+    BENCHMARK(BM_EndpointIdToUtf8)->DenseRange(0, 4);
+
+    void BM_SplitName(benchmark::State& state)
+    {
+        const auto name = CreateMergedDevice().GetName();
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(Split(name, '/'));
+        }
+    }
+    BENCHMARK(BM_SplitName);
+
+    void BM_MergeName(benchmark::State& state)
+    {
+        const auto names = Split(CreateMergedDevice().GetName(), '/');
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(Merge(names, '/'));
+        }
+    }
+    BENCHMARK(BM_MergeName);
+
+    void BM_TimePointToStringAsUtc(benchmark::State& state)
+    {
+        const auto now = std::chrono::system_clock::now();
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(TimePointToStringAsUtc(now, true, true));
+        }
+    }
+    BENCHMARK(BM_TimePointToStringAsUtc);
+
+    void BM_TimePointToStringAsLocal(benchmark::State& state)
+    {
+        const auto now = std::chrono::system_clock::now();
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(TimePointToStringAsLocal(now, true, true));
+        }
+    }
+    BENCHMARK(BM_TimePointToStringAsLocal);
+
+    // The same text; the time advances by a microsecond per call, as for a log line stream
+    void BM_TimestampFormatter(benchmark::State& state)
+    {
+        TimestampFormatter formatter(static_cast<TimestampFormatter::Zone>(state.range(0)), true, true);
+        TimestampFormatter::Buffer buffer;
+        auto now = std::chrono::system_clock::now();
+        for (auto _ : state)
+        {
+            now += std::chrono::microseconds(1);
+            benchmark::DoNotOptimize(formatter.Format(now, buffer));
+        }
+    }
+    BENCHMARK(BM_TimestampFormatter)
+        ->Arg(static_cast<int>(TimestampFormatter::Zone::Utc))
+        ->Arg(static_cast<int>(TimestampFormatter::Zone::Local));
+
+    void BM_DevicePayload(benchmark::State& state)
+    {
+        DiscardingDispatcher dispatcher;
+        const AudioDeviceApiClient apiClient(dispatcher, HostName, OperationSystemName);
+        const auto device = CreateMergedDevice();
+        for (auto _ : state)
+        {
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &device, "");
+        }
+    }
+    BENCHMARK(BM_DevicePayload);
+
+    void BM_VolumePayload(benchmark::State& state)
+    {
+        DiscardingDispatcher dispatcher;
+        const AudioDeviceApiClient apiClient(dispatcher, HostName, OperationSystemName);
+        const std::string pnpId(PNP_ID);
+        for (auto _ : state)
+        {
+            apiClient.PutVolumeChangeToApi(pnpId, true, 650, "");
+        }
+    }
+    BENCHMARK(BM_VolumePayload);
+
+    void BM_DeltaPayload(benchmark::State& state)
+    {
+        const auto device = CreateMergedDevice();
+        const auto hostName = HostName();
+        const auto now = std::chrono::system_clock::now();
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(SentDeviceStateCache::CreateDeltaPayload(
+                device, SentDeviceStateCache::RenderVolumeField, SoundDeviceEventType::VolumeRenderChanged, hostName, now));
+        }
+    }
+    BENCHMARK(BM_DeltaPayload);
+
+    // Argument: PayloadEncoding
+    void BM_EncodePayload(benchmark::State& state)
+    {
+        const auto encoding = static_cast<PayloadEncoding>(state.range(0));
+        state.SetLabel(std::string(GetPayloadEncodingName(encoding)));
+        const auto jsonPayload = SentDeviceStateCache::CreateDeltaPayload(
+            CreateMergedDevice(), static_cast<uint8_t>(SentDeviceStateCache::NameField | SentDeviceStateCache::RenderVolumeField),
+            SoundDeviceEventType::Discovered, HostName(), std::chrono::system_clock::now());
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(EncodeJsonPayload(encoding, jsonPayload));
+        }
+    }
+    BENCHMARK(BM_EncodePayload)->DenseRange(static_cast<int>(PayloadEncoding::Json), static_cast<int>(PayloadEncoding::MessagePack));
+
+    // Arguments: logging (0: info, 1: info asynchronously, 2: warnings only), speaker count.
+    // The log lines go to a null sink: what is measured is the cost on the enumerating thread.
+    void BM_EnumerationLogging(benchmark::State& state)
+    {
+        const auto previousLogger = spdlog::default_logger();
+        spdlog::set_default_logger(std::make_shared<spdlog::logger>("benchmark", std::make_shared<spdlog::sinks::null_sink_mt>()));
+        spdlog::set_level(state.range(0) == 2 ? spdlog::level::warn : spdlog::level::info);
+        {
+            std::optional<AsyncDefaultLogger> asyncLogger;
+            if (state.range(0) == 1)
+            {
+                asyncLogger.emplace(8192);
+            }
+            FakeEndpoints endpoints;
+            AddSpeakers(endpoints, state.range(1));
+            endpoints.GetDefault(eRender) = endpoints.GetAll().front();
+            SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(endpoints), nullptr);
+            for (auto _ : state)
+            {
+                collection.ResetContent();
+            }
+            state.SetLabel(state.range(0) == 0 ? "info" : state.range(0) == 1 ? "info async" : "warn");
+        }
+        spdlog::set_default_logger(previousLogger);
+    }
+    BENCHMARK(BM_EnumerationLogging)->ArgsProduct({{0, 1, 2}, {8, 32}});
+
+    // A flapping device logging the same line over and over. Argument: 0 unlimited, 1 limited but every
+    // line passes (the cost of the limit on the normal path), 2 limited and flooding (the suppressed path)
+    void BM_LogFlood(benchmark::State& state)
+    {
+        const auto previousLogger = spdlog::default_logger();
+        spdlog::set_default_logger(std::make_shared<spdlog::logger>("benchmark", std::make_shared<spdlog::sinks::null_sink_mt>()));
+        spdlog::set_level(spdlog::level::info);
+        auto& guard = LogFloodGuard::GetInstance();
+        guard.SetLimit(state.range(0) == 0 ? 0.0 : state.range(0) == 1 ? 1e9 : 10.0, 200.0);
+
+        const std::string deviceId = "{0.0.0.00000000}.{a1b2c3d4-0000-1111-2222-333344445555}";
+        for (auto _ : state)
+        {
+            ED_LOG_INFO(R"(Device added: id "{}".)", deviceId);
+        }
+        state.SetLabel(state.range(0) == 0 ? "unlimited" : state.range(0) == 1 ? "limited, passing" : "limited, suppressed");
+
+        guard.SetLimit(0.0, 0.0);
+        guard.ReportSuppressed();
+        spdlog::set_default_logger(previousLogger);
+    }
+    BENCHMARK(BM_LogFlood)->Arg(0)->Arg(1)->Arg(2);
+
+    // Formats the lines as a file sink does, without writing them: the cost of a text line on the logging thread and its size
+    class FormattingSink final : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+    {
+    public:
+        [[nodiscard]] size_t GetByteCount() const
+        {
+            return byteCount_;
+        }
+
+    protected:
+        void sink_it_(const spdlog::details::log_msg& message) override
+        {
+            spdlog::memory_buf_t formatted;
+            formatter_->format(message, formatted);
+            byteCount_ += formatted.size();
+        }
+
+        void flush_() override
+        {
+        }
+
+    private:
+        size_t byteCount_ = 0;
+    };
+
+    // Argument: 0 text, 1 binary; time per burst of BURST_SIZE lines, the lines per second in items_per_second.
+    // Between the bursts, outside of the measurement, the writer thread drains the ring into a file. A burst fits
+    // into the ring of the thread: every record is copied and written as in the service; a dropped one would
+    // only cost the check of a full ring, so a run dropping any fails
+    void BM_LogFormat(benchmark::State& state)
+    {
+        constexpr uint64_t BURST_SIZE = 1000; // ~100 KB of binary records
+        std::vector<std::string> deviceIds;
+        for (int device = 0; device < 8; ++device)
+        {
+            deviceIds.push_back(std::format("{{0.0.0.00000000}}.{{a1b2c3d4-0000-1111-2222-33334444555{}}}", device));
+        }
+        const auto previousLogger = spdlog::default_logger();
+        const auto sink = std::make_shared<FormattingSink>();
+        spdlog::set_default_logger(std::make_shared<spdlog::logger>("benchmark", sink));
+        spdlog::set_level(spdlog::level::info);
+        const auto pathName = std::filesystem::temp_directory_path() / "BM_LogFormat.binlog";
+        std::filesystem::remove(pathName);
+
+        uint64_t lineCount = 0;
+        std::optional<BinaryLogWriter> writer;
+        if (state.range(0) == 1)
+        {
+            writer.emplace(pathName, BinaryLog::GetInstance(), std::chrono::milliseconds(1));
+        }
+        const auto waitUntilWritten = [&writer, &lineCount]
+            {
+                while (writer->GetWrittenCount() + writer->GetDroppedCount() < lineCount)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            };
+        for (auto _ : state)
+        {
+            for (uint64_t line = 0; line < BURST_SIZE; ++line)
+            {
+                ED_LOG_INFO(R"(The end point device "{}" has a volume "{}".)", deviceIds[lineCount % deviceIds.size()],
+                            static_cast<uint16_t>(lineCount % 1001));
+                ++lineCount;
+            }
+            if (writer.has_value())
+            {
+                state.PauseTiming();
+                waitUntilWritten();
+                state.ResumeTiming();
+            }
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(lineCount));
+        if (writer.has_value())
+        {
+            BinaryLog::GetInstance().SetEnabled(false);
+            waitUntilWritten();
+            const auto writtenCount = writer->GetWrittenCount();
+            state.counters["dropped"] = static_cast<double>(writer->GetDroppedCount());
+            if (writer->GetDroppedCount() > 0)
+            {
+                state.SkipWithError("The ring overflowed within a burst: the measurement covers dropped records");
+            }
+            writer.reset();
+            state.counters["bytes_per_line"] = static_cast<double>(std::filesystem::file_size(pathName)) / static_cast<double>(writtenCount);
+            std::filesystem::remove(pathName);
+        }
+        else
+        {
+            state.counters["bytes_per_line"] = static_cast<double>(sink->GetByteCount()) / static_cast<double>(lineCount);
+        }
+        state.SetLabel(state.range(0) == 0 ? "text" : "binary");
+        spdlog::set_default_logger(previousLogger);
+    }
+    BENCHMARK(BM_LogFormat)->Arg(0)->Arg(1);
+
+    // Threads writing formatted lines into one ring, faster than a reader drains it in chunks of 64;
+    // the lines overwritten or dropped before they were read are counted in "dropped"
+    void BM_LogRing(benchmark::State& state)
+    {
+        static std::unique_ptr<LogRing> ring;
+        static std::jthread reader;
+        if (state.thread_index() == 0)
+        {
+            ring = std::make_unique<LogRing>(4096);
+            reader = std::jthread([](std::stop_token stopToken)
+            {
+                while (!stopToken.stop_requested())
+                {
+                    const auto chunk = ring->AcquireChunk(64);
+                    for (const auto& record : chunk)
+                    {
+                        benchmark::DoNotOptimize(record.GetText().size());
+                    }
+                    ring->ReleaseChunk(chunk);
+                }
+            });
+        }
+
+        const std::string line = std::format(R"([2026-01-31 12:34:56.789012] [info] The end point device "{}" has a volume "{}".)",
+                                             "{0.0.0.00000000}.{a1b2c3d4-0000-1111-2222-333344445555}", 400);
+        for (auto _ : state)
+        {
+            ring->Write(line);
+        }
+
+        if (state.thread_index() == 0)
+        {
+            reader = {};
+            state.counters["dropped"] = static_cast<double>(ring->GetDroppedCount());
+            ring.reset();
+        }
+    }
+    BENCHMARK(BM_LogRing)->Threads(1)->Threads(2)->Threads(4);
+
+    // Ships 10k lines per iteration: drained from the ring, batched, compressed and handed over, on the
+    // benchmark thread as the manual clock keeps the shipper's worker waiting
+    void BM_LogShipping(benchmark::State& state)
+    {
+        constexpr int lineCount = 10000;
+        LogRing ring(16384);
+        DiscardingDispatcher dispatcher;
+        const ManualClock clock;
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            for (int line = 0; line < lineCount; ++line)
+            {
+                ring.Write(std::format(R"([2026-01-31 12:34:{:02}.{:06}] [info] The end point device "{}" has a volume "{}".)",
+                                       line / 1000 % 60, line * 997 % 1000000, DEVICE_ID, line % 1001));
+            }
+            state.ResumeTiming();
+            const LogShipper shipper(ring, dispatcher, {.bytesPerSecond = 0.0}, "host", {}, clock);
+        }
+        state.counters["bytes_per_10k_lines"] = static_cast<double>(dispatcher.byteCount) / static_cast<double>(state.iterations());
+    }
+    BENCHMARK(BM_LogShipping)->Unit(benchmark::kMillisecond);
+
+    // Argument: recording enabled; the budget of an enabled span is 50 ns
+    void BM_TraceSpan(benchmark::State& state)
+    {
+        auto& recorder = TraceRecorder::GetInstance();
+        recorder.SetEnabled(state.range(0) != 0);
+        for (auto _ : state)
+        {
+            TRACE_SPAN("BM_TraceSpan");
+            benchmark::ClobberMemory();
+        }
+        recorder.SetEnabled(false);
+    }
+    BENCHMARK(BM_TraceSpan)->Arg(0)->Arg(1);
+
+    // Argument: agents behind one relay, 10 messages each. Parsing, deduplication, batching and compression
+    // of all their lines, arriving at ~100k messages per second of the relay clock
+    void BM_RelayFleet(benchmark::State& state)
+    {
+        constexpr size_t devicesPerAgent = 4;
+        constexpr size_t volumeChangesPerAgent = 6;
+        const auto agentCount = static_cast<size_t>(state.range(0));
+        const auto wireLines = CreateRelayWireLines(agentCount, devicesPerAgent, volumeChangesPerAgent);
+        size_t bytesIn = 0;
+        for (const auto& line : wireLines)
+        {
+            bytesIn += line.size();
+        }
+
+        uint64_t duplicateCount = 0;
+        size_t batchCount = 0;
+        size_t bytesOut = 0;
+        for (auto _ : state)
+        {
+            RelayAggregator aggregator({});
+            batchCount = 0;
+            bytesOut = 0;
+            auto now = RelayAggregator::Clock::time_point{};
+            const auto forward = [&](const std::vector<RelayAggregator::Batch>& batches)
+                {
+                    for (const auto& batch : batches)
+                    {
+                        bytesOut += RelayAggregator::CreateBatchPayload(batch, "RELAY-1").size();
+                        ++batchCount;
+                    }
+                };
+            for (size_t i = 0; i < wireLines.size(); ++i)
+            {
+                if (auto message = RelayMessage::FromNdjsonLine(wireLines[i]))
+                {
+                    aggregator.Accept(std::move(*message), now);
+                }
+                if (i % 100 == 0)
+                {
+                    now += std::chrono::milliseconds(1);
+                    forward(aggregator.TakeBatches(now));
+                }
+            }
+            forward(aggregator.TakeBatches(now, true));
+
+            if (aggregator.GetAcceptedCount() != agentCount * (devicesPerAgent + volumeChangesPerAgent))
+            {
+                state.SkipWithError("Messages lost or duplicates accepted");
+                break;
+            }
+            duplicateCount = aggregator.GetDuplicateCount();
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(wireLines.size()));
+        state.counters["duplicates"] = static_cast<double>(duplicateCount);
+        state.counters["batches"] = static_cast<double>(batchCount);
+        state.counters["compression"] = static_cast<double>(bytesIn) / static_cast<double>(std::max<size_t>(bytesOut, 1));
+    }
+    BENCHMARK(BM_RelayFleet)->Arg(10000)->Unit(benchmark::kMillisecond);
+}
+
+
+int main(int argc, char* argv[])
+{
+    // SoundDeviceCollection creates its device enumerator on construction
+    const ed::CoInitRaiiHelper coInitHelper;
+
+    std::vector<char*> arguments(argv, argv + argc);
+    std::string defaultOutput = "--benchmark_out=SoundAgentLibBenchmarks.json";
+    std::string defaultOutputFormat = "--benchmark_out_format=json";
+    if (std::ranges::none_of(arguments, [](const char* argument) { return std::string_view(argument).starts_with("--benchmark_out="); }))
+    {
+        arguments.push_back(defaultOutput.data());
+        arguments.push_back(defaultOutputFormat.data());
+    }
+    auto argumentCount = static_cast<int>(arguments.size());
+
+    benchmark::Initialize(&argumentCount, arguments.data());
+    if (benchmark::ReportUnrecognizedArguments(argumentCount, arguments.data()))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
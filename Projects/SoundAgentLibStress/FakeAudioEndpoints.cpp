@@ -0,0 +1,119 @@
+#include "os-dependencies.h"
+
+#include "FakeAudioEndpoints.h"
+
+#include <format>
+
+
+ed::audio::FakeEndpoint::FakeEndpoint(std::wstring endpointId, std::string devicePnpId, std::string deviceName,
+                                      SoundDeviceFlowType endpointFlow)
+    : id(std::move(endpointId))
+    , pnpId(std::move(devicePnpId))
+    , name(std::move(deviceName))
+    , flow(endpointFlow)
+{
+}
+
+ed::audio::FakeEndpoints::FakeEndpoints(size_t deviceCount)
+{
+    for (size_t i = 0; i < deviceCount; ++i)
+    {
+        const auto pnpId = std::format("6A3B1F29-4C8E-4D2A-9E71-{:012X}", i);
+        const auto endpointId = [i](const wchar_t* flow)
+            {
+                return std::format(L"{{0.0.{}.00000000}}.{{{}-{:04}}}", flow[0] == L'r' ? 0 : 1, flow, i);
+            };
+        switch (i % 3)
+        {
+        case 0:
+            Add(endpointId(L"render"), pnpId, std::format("Speakers {}", i), SoundDeviceFlowType::Render);
+            break;
+        case 1:
+            Add(endpointId(L"capture"), pnpId, std::format("Microphone {}", i), SoundDeviceFlowType::Capture);
+            break;
+        default:
+            Add(endpointId(L"render"), pnpId, std::format("Headset Earphone {}", i), SoundDeviceFlowType::Render);
+            Add(endpointId(L"capture"), pnpId, std::format("Headset Microphone {}", i), SoundDeviceFlowType::Capture);
+            break;
+        }
+    }
+}
+
+ed::audio::FakeEndpoint& ed::audio::FakeEndpoints::Add(std::wstring endpointId, std::string pnpId, std::string name,
+                                                       SoundDeviceFlowType flow)
+{
+    std::lock_guard lock(mutex_);
+    endpoints_.push_back(std::make_unique<FakeEndpoint>(std::move(endpointId), std::move(pnpId), std::move(name), flow));
+    auto& endpoint = *endpoints_.back();
+    endpointsById_[endpoint.id] = &endpoint;
+    return endpoint;
+}
+
+std::vector<ed::audio::FakeEndpoint*> ed::audio::FakeEndpoints::GetAll() const
+{
+    std::lock_guard lock(mutex_);
+    std::vector<FakeEndpoint*> endpoints;
+    endpoints.reserve(endpoints_.size());
+    for (const auto& endpoint : endpoints_)
+    {
+        endpoints.push_back(endpoint.get());
+    }
+    return endpoints;
+}
+
+ed::audio::FakeEndpoint* ed::audio::FakeEndpoints::Find(const std::wstring& endpointId) const
+{
+    std::lock_guard lock(mutex_);
+    const auto foundPair = endpointsById_.find(endpointId);
+    return foundPair != endpointsById_.end() ? foundPair->second : nullptr;
+}
+
+std::atomic<ed::audio::FakeEndpoint*>& ed::audio::FakeEndpoints::GetDefault(EDataFlow flow)
+{
+    return flow == eRender ? defaultRender_ : defaultCapture_;
+}
+
+const std::atomic<ed::audio::FakeEndpoint*>& ed::audio::FakeEndpoints::GetDefault(EDataFlow flow) const
+{
+    return flow == eRender ? defaultRender_ : defaultCapture_;
+}
+
+ed::audio::FakeEndpointProvider::FakeEndpointProvider(const FakeEndpoints& endpoints)
+    : endpoints_(endpoints)
+{
+}
+
+bool ed::audio::FakeEndpointProvider::TryCreateDevice(const std::wstring& deviceId, SoundDevice& device,
+                                                      EndPointVolumeSmartPtr& outVolumeEndpoint) const
+{
+    auto* endpoint = endpoints_.Find(deviceId);
+    if (endpoint == nullptr)
+    {
+        return false;
+    }
+    const auto volume = endpoint->volume.load();
+    device = SoundDevice(endpoint->pnpId, endpoint->name, endpoint->flow,
+                         endpoint->flow == SoundDeviceFlowType::Render ? volume : uint16_t{0},
+                         endpoint->flow == SoundDeviceFlowType::Capture ? volume : uint16_t{0}, false, false);
+    outVolumeEndpoint = &endpoint->volumeEndpoint;
+    return true;
+}
+
+std::vector<std::wstring> ed::audio::FakeEndpointProvider::GetActiveDeviceIds() const
+{
+    std::vector<std::wstring> deviceIds;
+    for (const auto* endpoint : endpoints_.GetAll())
+    {
+        if (endpoint->active.load())
+        {
+            deviceIds.push_back(endpoint->id);
+        }
+    }
+    return deviceIds;
+}
+
+std::optional<std::wstring> ed::audio::FakeEndpointProvider::GetDefaultDeviceId(EDataFlow flow) const
+{
+    const auto* endpoint = endpoints_.GetDefault(flow).load();
+    return endpoint != nullptr ? std::optional(endpoint->id) : std::nullopt;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "SoundDeviceCollection.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace ed::audio {
+// Volume control of a fake endpoint; counts the callbacks registered and the references held by the collection
+class FakeEndpointVolume final : public IAudioEndpointVolume {
+public:
+    explicit FakeEndpointVolume(std::atomic<uint16_t>& volume)
+        : volume_(volume)
+    {
+    }
+
+    DISALLOW_COPY_MOVE(FakeEndpointVolume);
+    ~FakeEndpointVolume() = default;
+
+    // Owned by its endpoint: the references are counted, not released
+    ULONG STDMETHODCALLTYPE AddRef() override
+    {
+        return ++referenceCount_;
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        return --referenceCount_;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID refIId, void** ppvInterface) override
+    {
+        if (IID_IUnknown == refIId || __uuidof(IAudioEndpointVolume) == refIId)
+        {
+            AddRef();
+            *ppvInterface = static_cast<IAudioEndpointVolume*>(this);
+            return S_OK;
+        }
+        *ppvInterface = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    HRESULT STDMETHODCALLTYPE RegisterControlChangeNotify(IAudioEndpointVolumeCallback*) override
+    {
+        ++registrationCount_;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE UnregisterControlChangeNotify(IAudioEndpointVolumeCallback*) override
+    {
+        --registrationCount_;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetMasterVolumeLevelScalar(float* pfLevel) override
+    {
+        *pfLevel = static_cast<float>(volume_.load()) / 1000.0f;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetMute(BOOL* pbMute) override
+    {
+        *pbMute = FALSE;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetChannelCount(UINT*) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE SetMasterVolumeLevel(float, LPCGUID) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE SetMasterVolumeLevelScalar(float, LPCGUID) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE GetMasterVolumeLevel(float*) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE SetChannelVolumeLevel(UINT, float, LPCGUID) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE SetChannelVolumeLevelScalar(UINT, float, LPCGUID) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE GetChannelVolumeLevel(UINT, float*) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE GetChannelVolumeLevelScalar(UINT, float*) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE SetMute(BOOL, LPCGUID) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE GetVolumeStepInfo(UINT*, UINT*) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE VolumeStepUp(LPCGUID) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE VolumeStepDown(LPCGUID) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE QueryHardwareSupport(DWORD*) override { return E_NOTIMPL; }
+    HRESULT STDMETHODCALLTYPE GetVolumeRange(float*, float*, float*) override { return E_NOTIMPL; }
+
+    [[nodiscard]] long GetRegistrationCount() const
+    {
+        return registrationCount_.load();
+    }
+
+    [[nodiscard]] ULONG GetReferenceCount() const
+    {
+        return referenceCount_.load();
+    }
+
+private:
+    std::atomic<uint16_t>& volume_;
+    std::atomic<long> registrationCount_ = 0;
+    std::atomic<ULONG> referenceCount_ = 0;
+};
+
+struct FakeEndpoint
+{
+    FakeEndpoint(std::wstring endpointId, std::string devicePnpId, std::string deviceName, SoundDeviceFlowType endpointFlow);
+
+    const std::wstring id;
+    const std::string pnpId;
+    const std::string name;
+    const SoundDeviceFlowType flow;
+    std::atomic<bool> active = false;
+    std::atomic<uint16_t> volume = 500;
+    FakeEndpointVolume volumeEndpoint{volume};
+};
+
+// What the audio service would report: the endpoints, their state and volume, the default ones.
+// Endpoints are only added, never removed: the references to them stay valid. Thread safe.
+class FakeEndpoints final {
+public:
+    FakeEndpoints() = default;
+    // Speakers, microphones and headsets in turn; a headset has a render and a capture endpoint of one PnP id
+    explicit FakeEndpoints(size_t deviceCount);
+
+    DISALLOW_COPY_MOVE(FakeEndpoints);
+    ~FakeEndpoints() = default;
+
+public:
+    FakeEndpoint& Add(std::wstring endpointId, std::string pnpId, std::string name, SoundDeviceFlowType flow);
+
+    // In the order of addition
+    [[nodiscard]] std::vector<FakeEndpoint*> GetAll() const;
+    [[nodiscard]] FakeEndpoint* Find(const std::wstring& endpointId) const;
+
+    [[nodiscard]] std::atomic<FakeEndpoint*>& GetDefault(EDataFlow flow);
+    [[nodiscard]] const std::atomic<FakeEndpoint*>& GetDefault(EDataFlow flow) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<FakeEndpoint>> endpoints_;
+    std::map<std::wstring, FakeEndpoint*> endpointsById_;
+
+    std::atomic<FakeEndpoint*> defaultRender_ = nullptr;
+    std::atomic<FakeEndpoint*> defaultCapture_ = nullptr;
+};
+
+// Resolves the endpoint ids to the fake endpoints. Removed endpoints resolve too, as the MMDevice API
+// keeps them as not present; unknown ones do not.
+class FakeEndpointProvider final : public AudioEndpointProviderInterface {
+public:
+    explicit FakeEndpointProvider(const FakeEndpoints& endpoints);
+
+    DISALLOW_COPY_MOVE(FakeEndpointProvider);
+    ~FakeEndpointProvider() override = default;
+
+public:
+    [[nodiscard]] bool TryCreateDevice(const std::wstring& deviceId, SoundDevice& device,
+                                       EndPointVolumeSmartPtr& outVolumeEndpoint) const override;
+    [[nodiscard]] std::vector<std::wstring> GetActiveDeviceIds() const override;
+    [[nodiscard]] std::optional<std::wstring> GetDefaultDeviceId(EDataFlow flow) const override;
+
+private:
+    const FakeEndpoints& endpoints_;
+};
+}
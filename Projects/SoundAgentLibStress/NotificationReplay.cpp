@@ -0,0 +1,263 @@
+#include "os-dependencies.h"
+
+#include "NotificationReplay.h"
+
+#include <format>
+#include <map>
+#include <ranges>
+#include <stdexcept>
+#include <thread>
+
+
+namespace
+{
+    // Endpoint ids are ASCII, e.g. {0.0.0.00000000}.{6A3B1F29-4C8E-4D2A-9E71-0F5B2C8D4A11}
+    std::wstring ToEndpointId(const std::string& recordedEndpointId)
+    {
+        return {recordedEndpointId.begin(), recordedEndpointId.end()};
+    }
+
+    uint16_t GetEndpointVolume(const ed::audio::SoundDevice& device)
+    {
+        return device.GetFlow() == SoundDeviceFlowType::Capture ? device.GetCurrentCaptureVolume() : device.GetCurrentRenderVolume();
+    }
+}
+
+ed::audio::NotificationReplay::NotificationReplay(std::vector<RecordedNotification> notifications)
+    : notifications_(std::move(notifications))
+    , processedWithPrevious_(notifications_.size())
+{
+    if (notifications_.empty() || notifications_.front().type != NotificationType::Snapshot || !notifications_.front().listRecreated)
+    {
+        throw std::invalid_argument("Notification recording does not start with a snapshot of the device list");
+    }
+    for (size_t i = 1; i < notifications_.size(); ++i)
+    {
+        const auto& previous = notifications_[i - 1];
+        const auto& notification = notifications_[i];
+        if (previous.type != NotificationType::DeviceStateChanged || previous.endpointId != notification.endpointId)
+        {
+            continue;
+        }
+        switch (previous.state)
+        {
+        case DEVICE_STATE_ACTIVE:
+            processedWithPrevious_[i] = notification.type == NotificationType::DeviceAdded;
+            break;
+        case DEVICE_STATE_DISABLED:
+        case DEVICE_STATE_NOTPRESENT:
+        case DEVICE_STATE_UNPLUGGED:
+            processedWithPrevious_[i] = notification.type == NotificationType::DeviceRemoved;
+            break;
+        default: ;
+        }
+    }
+}
+
+void ed::audio::NotificationReplay::AddEndpoints(FakeEndpoints& endpoints) const
+{
+    for (const auto& notification : notifications_)
+    {
+        for (const auto& [endpointId, device] : notification.endpoints)
+        {
+            if (auto id = ToEndpointId(endpointId); endpoints.Find(id) == nullptr)
+            {
+                endpoints.Add(std::move(id), device.GetPnpId(), device.GetName(), device.GetFlow());
+            }
+        }
+    }
+}
+
+void ed::audio::NotificationReplay::LoadInitialState(FakeEndpoints& endpoints, SoundDeviceCollection& collection) const
+{
+    SetEndpoints(endpoints, notifications_.front());
+    collection.ResetContent();
+}
+
+size_t ed::audio::NotificationReplay::GetSize() const
+{
+    return notifications_.size() - 1;
+}
+
+std::chrono::microseconds ed::audio::NotificationReplay::GetTime(size_t index) const
+{
+    return notifications_.at(index + 1).time - notifications_.front().time;
+}
+
+bool ed::audio::NotificationReplay::IsSnapshot(size_t index) const
+{
+    return notifications_.at(index + 1).type == NotificationType::Snapshot;
+}
+
+std::vector<std::string> ed::audio::NotificationReplay::Apply(FakeEndpoints& endpoints, SoundDeviceCollection& collection,
+                                                              size_t index) const
+{
+    const auto& notification = notifications_.at(index + 1);
+    if (processedWithPrevious_[index + 1])
+    {
+        return {};
+    }
+    const auto endpointId = ToEndpointId(notification.endpointId);
+    switch (notification.type)
+    {
+    case NotificationType::Snapshot:
+        if (notification.listRecreated)
+        {
+            SetEndpoints(endpoints, notification);
+            collection.ResetContent();
+        }
+        return Compare(collection, notification);
+    case NotificationType::DeviceAdded:
+        SetEndpoint(endpoints, notification, true);
+        collection.OnDeviceAdded(endpointId.c_str());
+        break;
+    case NotificationType::DeviceRemoved:
+        SetEndpoint(endpoints, notification, false);
+        collection.OnDeviceRemoved(endpointId.c_str());
+        break;
+    case NotificationType::DeviceStateChanged:
+        // The endpoint as reported comes with the record the state change was processed as
+        SetEndpoint(endpoints, index + 2 < notifications_.size() && processedWithPrevious_[index + 2] ? notifications_[index + 2] : notification,
+                    notification.state == DEVICE_STATE_ACTIVE);
+        collection.OnDeviceStateChanged(endpointId.c_str(), notification.state);
+        break;
+    case NotificationType::DefaultDeviceChanged:
+        SetEndpoint(endpoints, notification, std::nullopt);
+        if (notification.role == ROLE_CONSOLE)
+        {
+            endpoints.GetDefault(static_cast<EDataFlow>(notification.flow)) = endpoints.Find(endpointId);
+        }
+        collection.OnDefaultDeviceChanged(static_cast<EDataFlow>(notification.flow), static_cast<ERole>(notification.role),
+                                          notification.endpointId.empty() ? nullptr : endpointId.c_str());
+        break;
+    case NotificationType::VolumeChanged:
+        {
+            for (auto* endpoint : endpoints.GetAll())
+            {
+                for (const auto& change : notification.volumeChanges)
+                {
+                    if (endpoint->pnpId == change.pnpId && (endpoint->flow == SoundDeviceFlowType::Render) == change.renderOrCapture)
+                    {
+                        endpoint->volume = change.volume;
+                    }
+                }
+            }
+            AUDIO_VOLUME_NOTIFICATION_DATA volumeData{};
+            volumeData.bMuted = notification.muted ? TRUE : FALSE;
+            volumeData.fMasterVolume = static_cast<float>(notification.masterVolume) / 1000.0f;
+            volumeData.nChannels = 1;
+            volumeData.afChannelVolumes[0] = volumeData.fMasterVolume;
+            collection.OnNotify(&volumeData);
+        }
+        break;
+    }
+    return {};
+}
+
+ed::audio::NotificationReplay::Result ed::audio::NotificationReplay::Run(FakeEndpoints& endpoints, SoundDeviceCollection& collection,
+                                                                         double speed) const
+{
+    Result result;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < GetSize(); ++index)
+    {
+        if (speed > 0.0)
+        {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(GetTime(index) / speed));
+        }
+        auto differences = Apply(endpoints, collection, index);
+        if (IsSnapshot(index))
+        {
+            ++result.checkedSnapshotCount;
+            result.differences.insert(result.differences.end(), std::make_move_iterator(differences.begin()),
+                                      std::make_move_iterator(differences.end()));
+        }
+        else if (!processedWithPrevious_[index + 1])
+        {
+            ++result.notificationCount;
+        }
+    }
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    return result;
+}
+
+std::vector<std::string> ed::audio::NotificationReplay::Compare(const SoundDeviceCollectionInterface& collection,
+                                                                const RecordedNotification& snapshot)
+{
+    std::map<std::string, const SoundDevice*> recordedDevices;
+    for (const auto& device : snapshot.devices)
+    {
+        recordedDevices[device.GetPnpId()] = &device;
+    }
+
+    std::vector<std::string> differences;
+    const auto at = std::format("at {} us", snapshot.time.count());
+    for (size_t i = 0; i < collection.GetSize(); ++i)
+    {
+        const auto device = collection.CreateItem(i);
+        const auto found = recordedDevices.find(device->GetPnpId());
+        if (found == recordedDevices.end())
+        {
+            differences.push_back(std::format(R"(Device "{}" not recorded {}.)", device->GetPnpId(), at));
+            continue;
+        }
+        const auto& recorded = *found->second;
+        if (device->GetName() != recorded.GetName() || device->GetFlow() != recorded.GetFlow()
+            || device->GetCurrentRenderVolume() != recorded.GetCurrentRenderVolume()
+            || device->GetCurrentCaptureVolume() != recorded.GetCurrentCaptureVolume()
+            || device->IsRenderCurrentlyDefault() != recorded.IsRenderCurrentlyDefault()
+            || device->IsCaptureCurrentlyDefault() != recorded.IsCaptureCurrentlyDefault())
+        {
+            differences.push_back(std::format(
+                R"(Device "{}" {}: "{}", flow {}, volume {} / {}, default {} / {}; recorded "{}", flow {}, volume {} / {}, default {} / {}.)",
+                device->GetPnpId(), at,
+                device->GetName(), static_cast<int>(device->GetFlow()), device->GetCurrentRenderVolume(),
+                device->GetCurrentCaptureVolume(), device->IsRenderCurrentlyDefault(), device->IsCaptureCurrentlyDefault(),
+                recorded.GetName(), static_cast<int>(recorded.GetFlow()), recorded.GetCurrentRenderVolume(),
+                recorded.GetCurrentCaptureVolume(), recorded.IsRenderCurrentlyDefault(), recorded.IsCaptureCurrentlyDefault()));
+        }
+        recordedDevices.erase(found);
+    }
+    for (const auto& pnpId : recordedDevices | std::views::keys)
+    {
+        differences.push_back(std::format(R"(Recorded device "{}" missing {}.)", pnpId, at));
+    }
+    return differences;
+}
+
+void ed::audio::NotificationReplay::SetEndpoints(FakeEndpoints& endpoints, const RecordedNotification& snapshot)
+{
+    for (auto* endpoint : endpoints.GetAll())
+    {
+        endpoint->active = false;
+    }
+    for (const auto& [endpointId, device] : snapshot.endpoints)
+    {
+        if (auto* endpoint = endpoints.Find(ToEndpointId(endpointId)); endpoint != nullptr)
+        {
+            endpoint->active = true;
+            endpoint->volume = GetEndpointVolume(device);
+        }
+    }
+    endpoints.GetDefault(eRender) = endpoints.Find(ToEndpointId(snapshot.defaultRenderEndpointId));
+    endpoints.GetDefault(eCapture) = endpoints.Find(ToEndpointId(snapshot.defaultCaptureEndpointId));
+}
+
+void ed::audio::NotificationReplay::SetEndpoint(FakeEndpoints& endpoints, const RecordedNotification& notification,
+                                                std::optional<bool> active)
+{
+    auto* endpoint = endpoints.Find(ToEndpointId(notification.endpointId));
+    if (endpoint == nullptr)
+    {
+        // Never resolved while recording: does not resolve in the replay either
+        return;
+    }
+    if (active.has_value())
+    {
+        endpoint->active = *active;
+    }
+    if (!notification.endpoints.empty())
+    {
+        endpoint->volume = GetEndpointVolume(notification.endpoints.front().device);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "FakeAudioEndpoints.h"
+#include "NotificationRecording.h"
+#include "SoundDeviceCollection.h"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ed::audio {
+// Replays a notification recording into a SoundDeviceCollection on fake endpoints and with it into the observers
+// subscribed to it, e.g. the service observer and the dispatcher pipeline behind it. The fake endpoints stand in
+// for the audio service of the recording machine: before every raw callback they are set to what the audio service
+// reported then, and the collection resolves the callback itself. Snapshots are compared with the collection.
+// Thread safe once created: one recording replays into many collections, each one driven by one thread.
+class NotificationReplay final
+{
+public:
+    // Throws std::invalid_argument if the recording does not start with a snapshot of the device list
+    explicit NotificationReplay(std::vector<RecordedNotification> notifications);
+
+    DISALLOW_COPY_MOVE(NotificationReplay);
+    ~NotificationReplay() = default;
+
+public:
+    struct Result
+    {
+        size_t notificationCount = 0; // callbacks replayed
+        size_t checkedSnapshotCount = 0;
+        std::vector<std::string> differences; // of the snapshots and the replayed collection; empty: state verified
+        std::chrono::duration<double> elapsed{};
+    };
+
+    // Every endpoint of the recording, not active yet. The collection replayed into resolves its endpoints here.
+    void AddEndpoints(FakeEndpoints& endpoints) const;
+    // Sets the endpoints to the initial snapshot and recreates the device list, before the observers are subscribed
+    void LoadInitialState(FakeEndpoints& endpoints, SoundDeviceCollection& collection) const;
+
+    // Records after the initial snapshot
+    [[nodiscard]] size_t GetSize() const;
+    // Recorded time of a record, relative to the initial snapshot
+    [[nodiscard]] std::chrono::microseconds GetTime(size_t index) const;
+    [[nodiscard]] bool IsSnapshot(size_t index) const;
+    // Replays a record and waits until the collection processed it; for a snapshot, returns its differences to the collection.
+    // A record a state change was processed as is replayed with the state change.
+    std::vector<std::string> Apply(FakeEndpoints& endpoints, SoundDeviceCollection& collection, size_t index) const;
+
+    // Applies all the records; speed 0: as fast as possible, otherwise at the recorded pace, speed times faster
+    Result Run(FakeEndpoints& endpoints, SoundDeviceCollection& collection, double speed) const;
+
+    [[nodiscard]] static std::vector<std::string> Compare(const SoundDeviceCollectionInterface& collection,
+                                                          const RecordedNotification& snapshot);
+
+private:
+    static constexpr uint8_t ROLE_CONSOLE = 0; // eConsole, the only role the default endpoints are kept for
+
+    static void SetEndpoints(FakeEndpoints& endpoints, const RecordedNotification& snapshot);
+    static void SetEndpoint(FakeEndpoints& endpoints, const RecordedNotification& notification, std::optional<bool> active);
+
+    const std::vector<RecordedNotification> notifications_;
+    // Per record: a DeviceAdded or DeviceRemoved the preceding state change was processed as
+    std::vector<bool> processedWithPrevious_;
+};
+}
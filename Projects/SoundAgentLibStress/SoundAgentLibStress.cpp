@@ -0,0 +1,412 @@
+#include "os-dependencies.h"
+
+#include "ApiClient/common/StringUtils.h"
+
+#include "FakeAudioEndpoints.h"
+#include "SoundDevice.h"
+#include "SoundDeviceCollection.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+
+// Concurrent churn stress of SoundDeviceCollection: several threads deliver randomized endpoint additions,
+// removals, state changes, default switches and volume changes into the notification handlers of one collection,
+// as the audio service does from its own threads. The endpoints are fakes, so the run is independent of the
+// hardware; the render and capture endpoints of a headset share a PnP id and get merged and unmerged.
+// After every step the invariants are checked, the other threads held between two steps: every volume registration
+// belongs to a device of the collection and is registered exactly once, the flow of every device is the one of its
+// registered endpoints, and the default PnP ids agree with the default flags of the devices. Reports the sustained steps per second and the violations.
+namespace ed::audio
+{
+    namespace
+    {
+        using SteadyClock = std::chrono::steady_clock;
+
+        struct StressSettings
+        {
+            size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+            std::chrono::seconds duration{10};
+            size_t deviceCount = 12;
+            size_t checkEvery = 1; // steps of a thread between the invariant checks
+            uint32_t seed = 42;
+        };
+
+        // Reads the collection back on every event, as the service observer does
+        class ReadingObserver final : public SoundDeviceObserverInterface
+        {
+        public:
+            explicit ReadingObserver(const SoundDeviceCollectionInterface& collection)
+                : collection_(collection)
+            {
+            }
+
+            DISALLOW_COPY_MOVE(ReadingObserver);
+            ~ReadingObserver() override = default;
+
+            void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId) override
+            {
+                ++eventCount;
+                if (!devicePnpId.empty() && collection_.CreateItem(devicePnpId) == nullptr && event != SoundDeviceEventType::Detached)
+                {
+                    ++missingDeviceCount;
+                }
+            }
+
+            std::atomic<uint64_t> eventCount = 0;
+            std::atomic<uint64_t> missingDeviceCount = 0;
+
+        private:
+            const SoundDeviceCollectionInterface& collection_;
+        };
+
+        enum class StepType : uint8_t
+        {
+            Add,
+            Remove,
+            StateChange,
+            DefaultChange,
+            VolumeChange,
+            Reset
+        };
+
+        constexpr std::array<const char*, 6> STEP_NAMES{"add", "remove", "state change", "default change", "volume change", "reset"};
+        // A volume drag is a burst of notifications; a reset is what the service does on a reconnect only
+        constexpr std::array<double, 6> STEP_WEIGHTS{10.0, 10.0, 10.0, 8.0, 30.0, 0.1};
+
+        // A broken invariant stays broken for many checks: only the first violations are kept
+        constexpr size_t MAX_KEPT_VIOLATIONS = 10;
+
+        struct StressStatistics
+        {
+            std::array<std::atomic<uint64_t>, 6> stepCounts{};
+            std::atomic<uint64_t> checkCount = 0;
+
+            std::mutex mutex;
+            uint64_t violationCount = 0;
+            std::vector<std::string> violations;
+
+            void AddViolations(std::vector<std::string> found)
+            {
+                if (found.empty())
+                {
+                    return;
+                }
+                std::lock_guard lock(mutex);
+                violationCount += found.size();
+                for (auto& violation : found | std::views::take(MAX_KEPT_VIOLATIONS - std::min(MAX_KEPT_VIOLATIONS, violations.size())))
+                {
+                    violations.push_back(std::move(violation));
+                }
+            }
+
+        };
+    }
+
+    namespace
+    {
+        void CheckDefault(const SoundDeviceInterface& device, bool isDefault, const std::optional<std::string>& defaultPnpId,
+                          bool hasFlow, const char* flowName, std::vector<std::string>& violations)
+        {
+            if (isDefault != (defaultPnpId == device.GetPnpId()))
+            {
+                violations.push_back(std::format("Device {} {} default flag {}, default PnP id \"{}\".",
+                                                 device.GetPnpId(), flowName, isDefault, defaultPnpId.value_or("")));
+            }
+            if (isDefault && !hasFlow)
+            {
+                violations.push_back(std::format("Device {} {} default without a {} endpoint.", device.GetPnpId(), flowName, flowName));
+            }
+        }
+
+        // Through the public interface of the collection and the registrations seen by the fake endpoints;
+        // consistent only while no notification is processed
+        std::vector<std::string> CheckInvariants(const SoundDeviceCollection& collection, const FakeEndpoints& endpoints)
+        {
+            std::vector<std::string> violations;
+            std::map<std::string, std::unique_ptr<SoundDeviceInterface>> devices;
+            for (auto& device : collection.CreateItems())
+            {
+                auto pnpId = device->GetPnpId();
+                devices.emplace(std::move(pnpId), std::move(device));
+            }
+
+            std::map<std::string, std::pair<bool, bool>> registeredFlows; // render, capture per PnP id
+            for (const auto* endpoint : endpoints.GetAll())
+            {
+                const auto registrationCount = endpoint->volumeEndpoint.GetRegistrationCount();
+                if (registrationCount == 0)
+                {
+                    continue;
+                }
+                if (registrationCount != 1)
+                {
+                    violations.push_back(std::format("Endpoint {} registered {} times.", WString2StringTruncate(endpoint->id),
+                                                     registrationCount));
+                }
+                if (!devices.contains(endpoint->pnpId))
+                {
+                    violations.push_back(std::format("Orphaned volume registration of endpoint {}: no device {}.",
+                                                     WString2StringTruncate(endpoint->id), endpoint->pnpId));
+                }
+                auto& [render, capture] = registeredFlows[endpoint->pnpId];
+                (endpoint->flow == SoundDeviceFlowType::Render ? render : capture) = true;
+            }
+
+            const auto defaultRenderPnpId = collection.GetDefaultRenderDevicePnpId();
+            const auto defaultCapturePnpId = collection.GetDefaultCaptureDevicePnpId();
+            for (const auto& [pnpId, device] : devices)
+            {
+                const auto [render, capture] = registeredFlows.contains(pnpId) ? registeredFlows.at(pnpId) : std::pair(false, false);
+                if (const auto expectedFlow = render && capture ? SoundDeviceFlowType::RenderAndCapture
+                        : render ? SoundDeviceFlowType::Render
+                        : capture ? SoundDeviceFlowType::Capture : SoundDeviceFlowType::None;
+                    device->GetFlow() != expectedFlow)
+                {
+                    violations.push_back(std::format("Device {} has flow {}, its registered endpoints {}.",
+                                                     pnpId, static_cast<int>(device->GetFlow()), static_cast<int>(expectedFlow)));
+                }
+                CheckDefault(*device, device->IsRenderCurrentlyDefault(), defaultRenderPnpId, render, "render", violations);
+                CheckDefault(*device, device->IsCaptureCurrentlyDefault(), defaultCapturePnpId, capture, "capture", violations);
+            }
+            for (const auto& [defaultPnpId, flowName] : {std::pair(defaultRenderPnpId, "render"), std::pair(defaultCapturePnpId, "capture")})
+            {
+                if (defaultPnpId.has_value() && !devices.contains(*defaultPnpId))
+                {
+                    violations.push_back(std::format("Default {} PnP id {} of no device.", flowName, *defaultPnpId));
+                }
+            }
+            return violations;
+        }
+
+        class ChurnDriver final
+        {
+        public:
+            ChurnDriver(SoundDeviceCollection& collection, FakeEndpoints& endpoints, uint32_t seed)
+                : collection_(collection)
+                , endpoints_(endpoints)
+                , allEndpoints_(endpoints.GetAll())
+                , randomGenerator_(seed)
+            {
+            }
+
+            DISALLOW_COPY_MOVE(ChurnDriver);
+            ~ChurnDriver() = default;
+
+            StepType Step()
+            {
+                const auto stepType = static_cast<StepType>(stepDistribution_(randomGenerator_));
+                auto& endpoint = *allEndpoints_[endpointDistribution_(randomGenerator_)];
+                switch (stepType)
+                {
+                case StepType::Add:
+                    endpoint.active = true;
+                    collection_.OnDeviceAdded(endpoint.id.c_str());
+                    break;
+                case StepType::Remove:
+                    endpoint.active = false;
+                    collection_.OnDeviceRemoved(endpoint.id.c_str());
+                    break;
+                case StepType::StateChange:
+                {
+                    constexpr std::array<DWORD, 4> states{
+                        DEVICE_STATE_ACTIVE, DEVICE_STATE_DISABLED, DEVICE_STATE_NOTPRESENT, DEVICE_STATE_UNPLUGGED};
+                    const auto state = states[std::uniform_int_distribution<size_t>(0, states.size() - 1)(randomGenerator_)];
+                    endpoint.active = state == DEVICE_STATE_ACTIVE;
+                    collection_.OnDeviceStateChanged(endpoint.id.c_str(), state);
+                    break;
+                }
+                case StepType::DefaultChange:
+                {
+                    const auto flow = endpoint.flow == SoundDeviceFlowType::Render ? eRender : eCapture;
+                    // now and then no endpoint is left for the role
+                    auto* newDefault = std::uniform_int_distribution(0, 9)(randomGenerator_) == 0 ? nullptr : &endpoint;
+                    endpoints_.GetDefault(flow) = newDefault;
+                    collection_.OnDefaultDeviceChanged(flow, eConsole, newDefault != nullptr ? newDefault->id.c_str() : nullptr);
+                    collection_.OnDefaultDeviceChanged(flow, eMultimedia, newDefault != nullptr ? newDefault->id.c_str() : nullptr);
+                    break;
+                }
+                case StepType::VolumeChange:
+                {
+                    endpoint.volume = static_cast<uint16_t>(std::uniform_int_distribution(0, 1000)(randomGenerator_));
+                    AUDIO_VOLUME_NOTIFICATION_DATA notification{};
+                    notification.fMasterVolume = static_cast<float>(endpoint.volume.load()) / 1000.0f;
+                    notification.nChannels = 1;
+                    notification.afChannelVolumes[0] = notification.fMasterVolume;
+                    collection_.OnNotify(&notification);
+                    break;
+                }
+                case StepType::Reset:
+                    collection_.ResetContent();
+                    break;
+                }
+                return stepType;
+            }
+
+        private:
+            SoundDeviceCollection& collection_;
+            FakeEndpoints& endpoints_;
+            const std::vector<FakeEndpoint*> allEndpoints_; // a fixed set during the run
+            std::mt19937 randomGenerator_;
+            std::discrete_distribution<int> stepDistribution_{STEP_WEIGHTS.begin(), STEP_WEIGHTS.end()};
+            std::uniform_int_distribution<size_t> endpointDistribution_{0, allEndpoints_.size() - 1};
+        };
+
+        StressSettings ParseArguments(int argc, char* argv[])
+        {
+            StressSettings settings;
+            for (int i = 1; i < argc; ++i)
+            {
+                const std::string argument(argv[i]);
+                const auto separator = argument.find('=');
+                if (!argument.starts_with("--") || separator == std::string::npos)
+                {
+                    throw std::invalid_argument(std::format(R"(Invalid argument "{}")", argument));
+                }
+                const auto key = argument.substr(2, separator - 2);
+                const auto value = argument.substr(separator + 1);
+                if (key == "threads")
+                {
+                    settings.threadCount = std::max<size_t>(1, std::stoul(value));
+                }
+                else if (key == "duration-s")
+                {
+                    settings.duration = std::chrono::seconds(std::stoul(value));
+                }
+                else if (key == "devices")
+                {
+                    settings.deviceCount = std::max<size_t>(1, std::stoul(value));
+                }
+                else if (key == "check-every")
+                {
+                    settings.checkEvery = std::stoul(value);
+                }
+                else if (key == "seed")
+                {
+                    settings.seed = static_cast<uint32_t>(std::stoul(value));
+                }
+                else
+                {
+                    throw std::invalid_argument(std::format(R"(Unknown option "{}")", key));
+                }
+            }
+            return settings;
+        }
+
+        constexpr auto USAGE =
+            "Usage: SoundAgentLibStress [--threads=<cores>] [--duration-s=10] [--devices=12] [--check-every=1|<steps>|0]\n"
+            "                           [--seed=42]\n";
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    using namespace ed::audio;
+
+    StressSettings settings;
+    try
+    {
+        settings = ParseArguments(argc, argv);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << ".\n" << USAGE;
+        return 1;
+    }
+    // every step is logged; only problems are of interest here
+    spdlog::set_level(spdlog::level::err);
+
+    FakeEndpoints endpoints(settings.deviceCount);
+    StressStatistics statistics;
+    std::chrono::duration<double> elapsed{};
+    uint64_t observerEventCount = 0;
+    {
+        SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(endpoints), nullptr);
+        ReadingObserver observer(collection);
+        collection.Subscribe(observer);
+
+        std::cout << std::format("{} endpoints of {} devices, {} thread(s) for {} s, invariants checked every {} step(s).\n",
+                                 endpoints.GetAll().size(), settings.deviceCount, settings.threadCount,
+                                 settings.duration.count(), settings.checkEvery);
+
+        const auto start = SteadyClock::now();
+        {
+            // The steps run concurrently; a check waits for the steps in progress and holds the next ones
+            std::shared_mutex stepMutex;
+            std::vector<std::jthread> drivers;
+            for (size_t threadIndex = 0; threadIndex < settings.threadCount; ++threadIndex)
+            {
+                drivers.emplace_back([&, threadIndex]
+                {
+                    ChurnDriver driver(collection, endpoints, settings.seed + static_cast<uint32_t>(threadIndex));
+                    for (size_t step = 1; SteadyClock::now() < start + settings.duration; ++step)
+                    {
+                        {
+                            std::shared_lock stepLock(stepMutex);
+                            ++statistics.stepCounts[static_cast<size_t>(driver.Step())];
+                        }
+                        if (settings.checkEvery > 0 && step % settings.checkEvery == 0)
+                        {
+                            std::unique_lock checkLock(stepMutex);
+                            ++statistics.checkCount;
+                            statistics.AddViolations(CheckInvariants(collection, endpoints));
+                        }
+                    }
+                });
+            }
+        }
+        elapsed = SteadyClock::now() - start;
+        statistics.AddViolations(CheckInvariants(collection, endpoints));
+        collection.Unsubscribe(observer);
+        observerEventCount = observer.eventCount.load();
+        if (observer.missingDeviceCount.load() > 0)
+        {
+            statistics.AddViolations({std::format("{} events of a device not in the collection.", observer.missingDeviceCount.load())});
+        }
+    }
+    // the collection is gone: every registration undone, every reference released
+    for (const auto& endpoint : endpoints.GetAll())
+    {
+        if (endpoint->volumeEndpoint.GetRegistrationCount() != 0 || endpoint->volumeEndpoint.GetReferenceCount() != 0)
+        {
+            statistics.AddViolations({std::format("Endpoint {} left with {} registrations, {} references.",
+                                                  WString2StringTruncate(endpoint->id), endpoint->volumeEndpoint.GetRegistrationCount(),
+                                                  endpoint->volumeEndpoint.GetReferenceCount())});
+        }
+    }
+
+    uint64_t stepCount = 0;
+    const auto seconds = elapsed.count();
+    for (size_t i = 0; i < STEP_NAMES.size(); ++i)
+    {
+        const auto count = statistics.stepCounts[i].load();
+        stepCount += count;
+        std::cout << std::format("{:<16}{:>12} steps, {:>10.0f} steps/s\n", STEP_NAMES[i], count, static_cast<double>(count) / seconds);
+    }
+    std::cout << std::format("{} steps in {:.1f} s ({:.0f} steps/s), {} observer events, {} invariant checks, {} violations.\n",
+                             stepCount, seconds, static_cast<double>(stepCount) / seconds, observerEventCount,
+                             statistics.checkCount.load(), statistics.violationCount);
+    for (const auto& violation : statistics.violations)
+    {
+        std::cout << violation << "\n";
+    }
+    return statistics.violationCount == 0 ? 0 : 2;
+}
@@ -0,0 +1,8 @@
+#pragma once
+// ReSharper disable CppClangTidyClangDiagnosticReservedMacroIdentifier
+// ReSharper disable CppInconsistentNaming
+
+#include <sdkddkver.h>
+
+#undef _WIN32_WINNT
+#define _WIN32_WINNT                   _WIN32_WINNT_WIN10 
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "BinaryLog.h"
+#include "LogMacros.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <spdlog/sinks/ostream_sink.h>
+#include <spdlog/spdlog.h>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        std::filesystem::path GetTestPathName(const std::string& name)
+        {
+            auto pathName = std::filesystem::temp_directory_path() / std::format("BinaryLogTests.{}.binlog", name);
+            std::filesystem::remove(pathName);
+            return pathName;
+        }
+
+        size_t CountLines(const std::string& text)
+        {
+            return static_cast<size_t>(std::ranges::count(text, '\n'));
+        }
+    }
+
+    TEST_CLASS(BinaryLogTests)
+    {
+        TEST_METHOD(RoundTripTest)
+        {
+            const auto pathName = GetTestPathName("RoundTrip");
+            BinaryLog log;
+            const LogSite volumeSite("C:/Sources/SoundDeviceCollection.cpp", 10);
+            const LogSite addedSite("C:/Sources/SoundDeviceCollection.cpp", 20);
+            const std::string endpointId = "{0.0.0.00000000}.{a1b2c3d4-0000-1111-2222-333344445555}";
+            {
+                const BinaryLogWriter writer(pathName, log, 1h);
+                log.Write(spdlog::level::info, volumeSite, R"(Device "{}" volume {} of {:.1f}, muted {}, change {}, flow {}.)",
+                          endpointId, uint16_t{400}, 1000.0, false, -25, 'R');
+                log.Write(spdlog::level::warn, addedSite, R"(Device added: id "{}".)", std::string_view(endpointId));
+                log.Write(spdlog::level::info, addedSite, R"(Device added: id "{}".)", "Other");
+                log.Write(spdlog::level::info, volumeSite, "Numeric format of a text {:x}.", "Text");
+            }
+            {
+                const BinaryLogWriter writer(pathName, log, 1h);
+                log.Write(spdlog::level::info, addedSite, R"(Device added: id "{}".)", endpointId);
+                Assert::IsTrue(log.IsEnabled());
+            }
+            Assert::IsFalse(log.IsEnabled(), L"Disabled by the writer destruction");
+
+            const auto text = DecodeBinaryLogFile(pathName);
+            Logger::WriteMessage(text.c_str());
+            Assert::AreEqual(size_t{5}, CountLines(text));
+            Assert::IsTrue(text.find(R"(] [info] [)") != std::string::npos);
+            Assert::IsTrue(text.find(std::format(R"(] Device "{}" volume 400 of 1000.0, muted false, change -25, flow R.)" "\n", endpointId))
+                           != std::string::npos);
+            Assert::IsTrue(text.find(std::format(R"(] [warning] [{}] Device added: id "{}".)" "\n", GetCurrentThreadId(), endpointId))
+                           != std::string::npos);
+            Assert::IsTrue(text.find(R"(] Device added: id "Other".)" "\n") != std::string::npos);
+            Assert::IsTrue(text.find("] Numeric format of a text {:x}. | Text\n") != std::string::npos, L"Format kept on error");
+            Assert::IsTrue(text.rfind(std::format(R"(] Device added: id "{}".)" "\n", endpointId)) > text.find("Numeric"),
+                           L"Second session appended");
+        }
+
+        TEST_METHOD(FullRingDropsAndCountsTest)
+        {
+            BinaryLog log;
+            const LogSite site(__FILE__, __LINE__);
+            const std::string longText(BinaryLog::MAX_STRING_SIZE + 100, 'x');
+            constexpr uint64_t recordCount = 2 * BinaryLog::BYTES_PER_THREAD / BinaryLog::MAX_STRING_SIZE;
+            for (uint64_t record = 0; record < recordCount; ++record)
+            {
+                log.Write(spdlog::level::info, site, "Record {}: {}", record, longText);
+            }
+
+            auto records = log.TakeRecords();
+            Assert::AreEqual(size_t{1}, records.size());
+            Assert::AreEqual(static_cast<uint32_t>(GetCurrentThreadId()), records[0].threadId);
+            // all records have the same size: the numbers are raw
+            const auto recordSize = BinaryLog::BYTES_PER_THREAD / (recordCount - records[0].droppedCount);
+            Assert::IsTrue(records[0].droppedCount > 0);
+            Assert::AreEqual(records[0].data.size(), (recordCount - records[0].droppedCount) * recordSize);
+            Assert::IsTrue(records[0].data.size() + recordSize > BinaryLog::BYTES_PER_THREAD, L"Dropped only when full");
+
+            log.Write(spdlog::level::info, site, "Record {}: {}", recordCount, longText);
+            records = log.TakeRecords();
+            Assert::AreEqual(size_t{1}, records.size());
+            Assert::AreEqual(uint64_t{0}, records[0].droppedCount, L"Room again after taking");
+            Assert::AreEqual(recordSize, records[0].data.size());
+
+            const auto pathName = GetTestPathName("FullRing");
+            for (uint64_t record = 0; record < recordCount; ++record)
+            {
+                log.Write(spdlog::level::info, site, "Record {}: {}", record, longText);
+            }
+            {
+                const BinaryLogWriter writer(pathName, log, 1h);
+            }
+            const auto text = DecodeBinaryLogFile(pathName);
+            Assert::IsTrue(text.find(std::format("] {} log messages dropped: the buffer of the thread was full.\n",
+                                                 recordCount - BinaryLog::BYTES_PER_THREAD / recordSize)) != std::string::npos);
+            Assert::IsTrue(text.find("] Record 0: " + std::string(BinaryLog::MAX_STRING_SIZE, 'x') + "\n") != std::string::npos,
+                           L"Strings cut");
+        }
+
+        TEST_METHOD(LogMacroWritesToEnabledBinaryLogTest)
+        {
+            const auto pathName = GetTestPathName("LogMacro");
+            std::ostringstream stream;
+            const auto previousLogger = spdlog::default_logger();
+            spdlog::set_default_logger(std::make_shared<spdlog::logger>("test", std::make_shared<spdlog::sinks::ostream_sink_mt>(stream)));
+            {
+                const BinaryLogWriter writer(pathName);
+                ED_LOG_INFO("Binary {} and {}.", 42, "text"s);
+            }
+            ED_LOG_INFO("Text {}.", 43);
+            spdlog::set_default_logger(previousLogger);
+
+            Assert::IsTrue(DecodeBinaryLogFile(pathName).find("] Binary 42 and text.\n") != std::string::npos);
+            Assert::IsTrue(stream.str().find("Binary") == std::string::npos);
+            Assert::IsTrue(stream.str().find("Text 43.") != std::string::npos, L"Text log once the binary one is off");
+        }
+    };
+}
@@ -0,0 +1,238 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "Clock.h"
+#include "DeliveryReport.h"
+#include "RateLimitingHttpRequestDispatcher.h"
+#include "RetryingHttpRequestDispatcher.h"
+
+#include <atomic>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        // Throws while the manual time is before recoveryTime
+        class RecoveringDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            RecoveringDispatcher(const ClockInterface& clock, std::chrono::steady_clock::time_point recoveryTime)
+                : clock_(clock)
+                , recoveryTime_(recoveryTime)
+            {
+            }
+
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                ++attemptCount;
+                if (clock_.SteadyNow() < recoveryTime_)
+                {
+                    throw std::runtime_error("Sink unavailable");
+                }
+                ++deliveredCount;
+            }
+
+            std::atomic<size_t> attemptCount = 0;
+            std::atomic<size_t> deliveredCount = 0;
+
+        private:
+            const ClockInterface& clock_;
+            const std::chrono::steady_clock::time_point recoveryTime_;
+        };
+
+        // Takes the delivery report over, like a sink writing from an own thread; the test reports the outcome
+        class ReportingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                auto onDelivered = DeliveryReport::Take();
+                std::lock_guard lock(mutex_);
+                handlers_.push_back(std::move(onDelivered));
+            }
+
+            [[nodiscard]] size_t GetAttemptCount() const
+            {
+                std::lock_guard lock(mutex_);
+                return handlers_.size();
+            }
+
+            void Report(size_t attempt, bool delivered) const
+            {
+                DeliveryReport::Handler onDelivered;
+                {
+                    std::lock_guard lock(mutex_);
+                    onDelivered = handlers_.at(attempt);
+                }
+                onDelivered(delivered, delivered ? "" : "Disk full");
+            }
+
+        private:
+            mutable std::mutex mutex_;
+            std::vector<DeliveryReport::Handler> handlers_;
+        };
+
+        // In real time: the worker threads need a moment to catch up with the manual clock
+        bool WaitUntil(const std::function<bool()>& condition, std::chrono::milliseconds timeout = 5s)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (!condition())
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(1ms);
+            }
+            return true;
+        }
+    }
+
+    TEST_CLASS(ClockTests)
+    {
+        TEST_METHOD(ManualClockStandsStillUntilAdvancedTest)
+        {
+            const auto systemStart = std::chrono::sys_days{2025y / 1 / 1};
+            ManualClock clock(systemStart);
+            const auto steadyStart = clock.SteadyNow();
+
+            std::this_thread::sleep_for(20ms);
+            Assert::IsTrue(clock.SystemNow() == systemStart);
+            Assert::IsTrue(clock.SteadyNow() == steadyStart);
+
+            clock.Advance(90min);
+            clock.Advance(-1h); // ignored: the clocks are monotonic
+            Assert::IsTrue(clock.SystemNow() == systemStart + 90min);
+            Assert::IsTrue(clock.SteadyNow() == steadyStart + 90min);
+            Assert::IsTrue(clock.GetElapsed() == 90min);
+        }
+
+        TEST_METHOD(ManualClockWaitEndsWhenAdvancedPastDeadlineTest)
+        {
+            ManualClock clock;
+            std::mutex mutex;
+            std::condition_variable_any condition;
+            std::atomic<bool> isWaitOver = false;
+
+            const auto deadline = clock.SteadyNow() + 1h;
+            std::jthread waiter([&](const std::stop_token& stopToken)
+            {
+                std::unique_lock lock(mutex);
+                clock.WaitUntil(condition, lock, stopToken, deadline, [] { return false; });
+                isWaitOver = true;
+            });
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+
+            clock.Advance(59min);
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s), L"Deadline not reached in the manual time");
+            Assert::IsFalse(isWaitOver.load());
+
+            clock.Advance(1min);
+            Assert::IsTrue(WaitUntil([&] { return isWaitOver.load(); }));
+            Assert::IsFalse(clock.WaitForWaiters(1, 10ms));
+        }
+
+        TEST_METHOD(RateLimitingHourOfStartupDelayTest)
+        {
+            ManualClock clock;
+            RecoveringDispatcher target(clock, clock.SteadyNow());
+            RateLimitingHttpRequestDispatcher dispatcher(target, {.messagesPerSecond = 1.0, .burst = 1.0, .lifecycleSharePercent = 100},
+                                                         1h, clock);
+            for (int i = 0; i < 10; ++i)
+            {
+                dispatcher.EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, std::format("Request {}", i));
+            }
+
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            clock.Advance(59min + 59s);
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            Assert::AreEqual(size_t{0}, target.deliveredCount.load(), L"Held back during the startup delay");
+
+            // One token per second: each step releases one request, then the worker waits for the next token
+            for (size_t second = 1; second < 10; ++second)
+            {
+                clock.Advance(1s);
+                Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+                Assert::AreEqual(second, target.deliveredCount.load());
+            }
+            clock.Advance(1s);
+            Assert::IsTrue(WaitUntil([&] { return target.deliveredCount == 10; }));
+        }
+
+        TEST_METHOD(RetryingHourOfSinkOutageTest)
+        {
+            ManualClock clock;
+            RecoveringDispatcher target(clock, clock.SteadyNow() + 30min);
+            RetryingHttpRequestDispatcher dispatcher(target, "Test",
+                {.backoff = {.initialDelay = 1s, .maxDelay = 5min, .maxAttempts = 1000},
+                 .circuitBreaker = {.failureThreshold = 3, .openDuration = 1min}},
+                clock);
+
+            const auto realStart = std::chrono::steady_clock::now();
+            dispatcher.EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, "Device");
+            for (int second = 0; second < 3600; ++second)
+            {
+                Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+                clock.Advance(1s);
+            }
+            Assert::IsTrue(WaitUntil([&] { return target.deliveredCount == 1; }));
+
+            Logger::WriteMessage(std::format("One hour of retries took {} ms, {} attempt(s).",
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - realStart).count(),
+                target.attemptCount.load()).c_str());
+            Assert::IsTrue(target.attemptCount > 1, L"First attempt fails during the outage");
+        }
+
+        TEST_METHOD(RetryingReportedFailureTest)
+        {
+            ManualClock clock;
+            ReportingDispatcher target;
+            RetryingHttpRequestDispatcher dispatcher(target, "Test",
+                {.backoff = {.initialDelay = 1s, .maxDelay = 1s, .maxAttempts = 3},
+                 .circuitBreaker = {.failureThreshold = 0}},
+                clock);
+
+            dispatcher.EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, "Device");
+            Assert::AreEqual(size_t{1}, target.GetAttemptCount());
+            target.Report(0, false);
+
+            // The report is taken up on the next tick, the retry within the backoff after it
+            for (int tick = 0; tick < 20 && target.GetAttemptCount() < 2; ++tick)
+            {
+                Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+                clock.Advance(RetryScheduler::TICK_DURATION);
+            }
+            Assert::IsTrue(WaitUntil([&] { return target.GetAttemptCount() == 2; }));
+            Assert::AreEqual(uint64_t{1}, dispatcher.GetFailedCount());
+
+            target.Report(1, true);
+            for (int tick = 0; tick < 20; ++tick)
+            {
+                Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+                clock.Advance(RetryScheduler::TICK_DURATION);
+            }
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            Assert::AreEqual(size_t{2}, target.GetAttemptCount(), L"Not retried once delivered");
+            Assert::AreEqual(uint64_t{1}, dispatcher.GetFailedCount());
+        }
+    };
+}
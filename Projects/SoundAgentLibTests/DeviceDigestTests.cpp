@@ -0,0 +1,223 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/AudioDeviceApiClient.h"
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "DeviceDigest.h"
+#include "SoundDevice.h"
+
+#include <format>
+
+#include <nlohmann/json.hpp>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        // Backend stand-in: keeps its own device table from the bucket messages and
+        // answers a digest with the buckets that differ
+        class SimulatedBackend final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string& urlSuffix, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>& header, const std::string&
+            ) override
+            {
+                bytes += urlSuffix.size() + payload.size();
+                for (const auto& [key, value] : header)
+                {
+                    bytes += key.size() + value.size();
+                }
+
+                const auto json = nlohmann::json::parse(payload);
+                if (urlSuffix == DIGEST_URL_SUFFIX)
+                {
+                    DeviceDigest::BucketHashes agentBucketHashes{};
+                    for (size_t bucket = 0; bucket < DeviceDigest::BUCKET_COUNT; ++bucket)
+                    {
+                        agentBucketHashes[bucket] = std::stoull(json.at("bucketHashes").at(bucket).get<std::string>(), nullptr, 16);
+                    }
+                    mismatchedBuckets = DeviceDigest::FindMismatchedBuckets(agentBucketHashes, table.GetBucketHashes());
+                }
+                else if (urlSuffix == DIGEST_BUCKET_URL_SUFFIX)
+                {
+                    std::vector<DeviceRecord> records;
+                    for (const auto& device : json.at("devices"))
+                    {
+                        records.push_back(DeviceRecord::FromJson(device));
+                    }
+                    table.ReplaceBucket(json.at("bucket").get<size_t>(), records);
+                }
+            }
+
+            static constexpr auto DIGEST_URL_SUFFIX = "/digest";
+            static constexpr auto DIGEST_BUCKET_URL_SUFFIX = "/digest/bucket";
+
+            DeviceDigest table;
+            std::vector<size_t> mismatchedBuckets;
+            size_t bytes = 0;
+        };
+
+        class ByteCountingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string& urlSuffix, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>& header, const std::string&
+            ) override
+            {
+                bytes += urlSuffix.size() + payload.size();
+                for (const auto& [key, value] : header)
+                {
+                    bytes += key.size() + value.size();
+                }
+            }
+
+            size_t bytes = 0;
+        };
+
+        std::string TestHostName()
+        {
+            return "DESKTOP-4F7T2QK";
+        }
+
+        std::string TestOperationSystemName()
+        {
+            return "Windows 11 Enterprise 23H2 Build 22631.4317";
+        }
+
+        std::vector<std::unique_ptr<SoundDevice>> CreateDevices(size_t count)
+        {
+            std::vector<std::unique_ptr<SoundDevice>> devices;
+            for (size_t i = 0; i < count; ++i)
+            {
+                devices.push_back(std::make_unique<SoundDevice>(
+                    std::format("{{0.0.{}.00000000}}.{{F2B6C1D4-9A3E-4F7B-B0C8-5E1D2A3B{:04X}}}", i % 2, i),
+                    std::format("Device {} (High Definition Audio)", i),
+                    i % 2 == 0 ? SoundDeviceFlowType::Render : SoundDeviceFlowType::Capture,
+                    static_cast<uint16_t>(i % 2 == 0 ? 400 + i : 0), static_cast<uint16_t>(i % 2 == 0 ? 0 : 600 + i),
+                    i == 0, i == 1));
+            }
+            return devices;
+        }
+
+        std::unique_ptr<DeviceDigest> CreateDigest(const std::vector<std::unique_ptr<SoundDevice>>& devices)
+        {
+            auto digest = std::make_unique<DeviceDigest>();
+            for (const auto& device : devices)
+            {
+                digest->Put(DeviceRecord::FromDevice(*device));
+            }
+            return digest;
+        }
+
+        // The agent side of one sync round, as the service observer does it
+        void Sync(const DeviceDigest& agentDigest, SimulatedBackend& backend, std::chrono::system_clock::time_point now)
+        {
+            backend.EnqueueRequest(true, now, SimulatedBackend::DIGEST_URL_SUFFIX, agentDigest.CreateDigestPayload(TestHostName(), now),
+                                   {{"Content-Type", "application/json"}}, "Device digest");
+            for (const auto bucket : std::vector(backend.mismatchedBuckets))
+            {
+                backend.EnqueueRequest(true, now, SimulatedBackend::DIGEST_BUCKET_URL_SUFFIX,
+                                       agentDigest.CreateBucketPayload(bucket, TestHostName(), now),
+                                       {{"Content-Type", "application/json"}}, "Device digest bucket");
+            }
+        }
+    }
+
+    TEST_CLASS(DeviceDigestTests)
+    {
+        TEST_METHOD(MismatchIsLocalizedToBucketTest)
+        {
+            const auto devices = CreateDevices(12);
+            const auto agentDigest = CreateDigest(devices);
+            const auto backendDigest = CreateDigest(devices);
+            Assert::AreEqual(agentDigest->GetRootHash(), backendDigest->GetRootHash());
+
+            auto changed = DeviceRecord::FromDevice(*devices[5]);
+            changed.renderVolume = 999;
+            backendDigest->Put(changed);
+            Assert::AreNotEqual(agentDigest->GetRootHash(), backendDigest->GetRootHash());
+            const auto mismatched = DeviceDigest::FindMismatchedBuckets(agentDigest->GetBucketHashes(), backendDigest->GetBucketHashes());
+            Assert::IsTrue(std::vector{DeviceDigest::GetBucket(devices[5]->GetPnpId())} == mismatched);
+
+            // a stale device on the backend side is removed by replacing its bucket
+            auto stale = DeviceRecord::FromDevice(*devices[0]);
+            stale.pnpId = "{0.0.0.00000000}.{STALE}";
+            backendDigest->Put(stale);
+            for (const auto bucket : DeviceDigest::FindMismatchedBuckets(agentDigest->GetBucketHashes(), backendDigest->GetBucketHashes()))
+            {
+                backendDigest->ReplaceBucket(bucket, agentDigest->GetBucketRecords(bucket));
+            }
+            Assert::AreEqual(agentDigest->GetRootHash(), backendDigest->GetRootHash());
+            Assert::AreEqual(devices.size(), backendDigest->GetSize());
+        }
+
+        // Pinned to a little endian serialization: an agent and a backend of another byte order agree
+        TEST_METHOD(HashesAreByteOrderIndependentTest)
+        {
+            const DeviceRecord record{
+                .pnpId = "{0.0.0.00000000}.{6A3B1F29-4C8E-4D2A-9E71-0F5B2C8D4A11}", .name = "Speakers (Realtek)",
+                .flow = SoundDeviceFlowType::Render, .renderVolume = 550, .captureVolume = 0,
+                .renderIsDefault = true, .captureIsDefault = false
+            };
+            Assert::AreEqual(uint64_t{0x51e7ed5d6107e231}, DeviceDigest::HashRecord(record));
+            Assert::AreEqual(size_t{6}, DeviceDigest::GetBucket(record.pnpId));
+            Assert::AreEqual(uint64_t{0xc4485a69ea81a02d}, DeviceDigest::HashBuckets({1, 2, 3, 4, 5, 6, 7, 8}));
+        }
+
+        // One day of hourly syncs with a few lost messages against hourly re-confirmation of every device
+        TEST_METHOD(BytesPerDayAgainstFullReconfirmationTest)
+        {
+            constexpr size_t deviceCount = 12;
+            auto devices = CreateDevices(deviceCount);
+            const auto start = std::chrono::system_clock::time_point{} + 24h * 20000;
+
+            SimulatedBackend backend;
+            ByteCountingDispatcher fullReconfirmation;
+            const AudioDeviceApiClient apiClient(fullReconfirmation, TestHostName, TestOperationSystemName);
+            size_t repairedBuckets = 0;
+
+            for (int hour = 0; hour < 24; ++hour)
+            {
+                const auto now = start + std::chrono::hours(hour);
+                // state changes whose messages got lost on the way to the backend
+                if (hour == 5 || hour == 11 || hour == 17)
+                {
+                    auto& device = devices[static_cast<size_t>(hour) % deviceCount];
+                    device = std::make_unique<SoundDevice>(device->GetPnpId(), device->GetName(), device->GetFlow(),
+                                                           static_cast<uint16_t>(device->GetCurrentRenderVolume() + 10),
+                                                           device->GetCurrentCaptureVolume(),
+                                                           device->IsRenderCurrentlyDefault(), device->IsCaptureCurrentlyDefault());
+                }
+                if (hour == 20)
+                {
+                    devices.pop_back(); // detached, not reported
+                }
+
+                const auto agentDigest = CreateDigest(devices);
+                Sync(*agentDigest, backend, now);
+                repairedBuckets += backend.mismatchedBuckets.size();
+                Assert::AreEqual(agentDigest->GetRootHash(), backend.table.GetRootHash(), L"Backend converged");
+
+                for (const auto& device : devices)
+                {
+                    apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, device.get(), "");
+                }
+            }
+
+            Logger::WriteMessage(std::format(
+                "{} devices, hourly for a day: full re-confirmation {} bytes, digest sync {} bytes ({} bucket repairs, first one filling the empty backend), {:.1f}x less.",
+                deviceCount, fullReconfirmation.bytes, backend.bytes, repairedBuckets,
+                static_cast<double>(fullReconfirmation.bytes) / static_cast<double>(backend.bytes)).c_str());
+            Assert::IsTrue(backend.bytes * 2 < fullReconfirmation.bytes);
+        }
+    };
+}
@@ -0,0 +1,126 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "LatencyHistogram.h"
+#include "LatencyMarkingHttpRequestDispatcher.h"
+#include "PipelineLatency.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        class SleepingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                std::this_thread::sleep_for(2ms);
+            }
+        };
+    }
+
+    TEST_CLASS(LatencyHistogramTests)
+    {
+        TEST_METHOD(PercentilesWithinBucketPrecisionTest)
+        {
+            LatencyHistogram histogram;
+            for (int64_t valueUs = 1; valueUs <= 100000; ++valueUs)
+            {
+                histogram.Record(std::chrono::microseconds(valueUs));
+            }
+
+            const auto snapshot = histogram.GetSnapshot();
+            Assert::AreEqual(uint64_t{100000}, snapshot.GetCount());
+            Assert::IsTrue(snapshot.GetMax() == 100000us);
+            Assert::IsTrue(snapshot.GetMean() == 50000us);
+            for (const auto percentile : {1.0, 50.0, 90.0, 99.0, 99.9})
+            {
+                const auto expected = percentile * 1000.0;
+                const auto actual = static_cast<double>(snapshot.GetPercentile(percentile).count());
+                Assert::IsTrue(std::abs(actual - expected) <= expected * 0.035, L"Within the bucket precision");
+            }
+            Assert::IsTrue(snapshot.GetPercentile(100.0) == 100000us);
+        }
+
+        TEST_METHOD(SmallValuesExactLargeValuesCappedTest)
+        {
+            LatencyHistogram histogram;
+            Assert::IsTrue(histogram.GetSnapshot().GetPercentile(50.0) == 0us, L"Empty");
+
+            histogram.Record(37us);
+            Assert::IsTrue(histogram.GetSnapshot().GetPercentile(50.0) == 37us);
+
+            histogram.Record(-5ms);
+            histogram.Record(1000h);
+            const auto snapshot = histogram.GetSnapshot();
+            Assert::IsTrue(snapshot.GetPercentile(0.0) == 0us, L"Negative counted as zero");
+            Assert::IsTrue(snapshot.GetMax() == LatencyHistogram::MAX_VALUE);
+        }
+
+        TEST_METHOD(ConcurrentRecordingLosesNothingTest)
+        {
+            LatencyHistogram histogram;
+            constexpr size_t threadCount = 8;
+            constexpr int64_t recordsPerThread = 100000;
+            {
+                std::vector<std::jthread> threads;
+                for (size_t thread = 0; thread < threadCount; ++thread)
+                {
+                    threads.emplace_back([&histogram, thread]
+                    {
+                        for (int64_t i = 0; i < recordsPerThread; ++i)
+                        {
+                            histogram.Record(std::chrono::microseconds(i % 5000 + static_cast<int64_t>(thread)));
+                        }
+                    });
+                }
+            }
+            const auto snapshot = histogram.GetSnapshot();
+            Assert::AreEqual(uint64_t{threadCount * recordsPerThread}, snapshot.GetCount());
+            Assert::IsTrue(snapshot.GetMax() == std::chrono::microseconds(4999 + threadCount - 1));
+        }
+
+        TEST_METHOD(TraceMarksStagesWithinScopeOnlyTest)
+        {
+            LatencyTrace::SetEnabled(true);
+            auto& latency = PipelineLatency::GetInstance();
+            const auto countOf = [&latency](LatencyStage stage) { return latency.GetSnapshot(stage).GetCount(); };
+            const auto stateUpdatedBefore = countOf(LatencyStage::StateUpdated);
+            const auto payloadBuiltBefore = countOf(LatencyStage::PayloadBuilt);
+            const auto enqueuedBefore = countOf(LatencyStage::Enqueued);
+
+            SleepingDispatcher target;
+            LatencyMarkingHttpRequestDispatcher dispatcher(target);
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {}, "Outside");
+            Assert::AreEqual(payloadBuiltBefore, countOf(LatencyStage::PayloadBuilt), L"No notification being processed");
+
+            {
+                const LatencyTrace::Scope scope;
+                LatencyTrace::Mark(LatencyStage::StateUpdated);
+                dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {}, "Inside");
+            }
+            Assert::AreEqual(stateUpdatedBefore + 1, countOf(LatencyStage::StateUpdated));
+            Assert::AreEqual(payloadBuiltBefore + 1, countOf(LatencyStage::PayloadBuilt));
+            Assert::AreEqual(enqueuedBefore + 1, countOf(LatencyStage::Enqueued));
+            Assert::IsTrue(latency.GetSnapshot(LatencyStage::Enqueued).GetMax() >= 2ms, L"Measured around the target");
+
+            LatencyTrace::Mark(LatencyStage::StateUpdated);
+            Assert::AreEqual(stateUpdatedBefore + 1, countOf(LatencyStage::StateUpdated), L"Scope closed");
+            Assert::IsTrue(latency.FormatSummary().find("enqueued: n=") != std::string::npos);
+        }
+    };
+}
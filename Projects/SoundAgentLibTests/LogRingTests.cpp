@@ -0,0 +1,179 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "LogRing.h"
+
+#include <atomic>
+#include <format>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        std::vector<std::string> Drain(LogRing& ring, size_t maxRecords = SIZE_MAX)
+        {
+            std::vector<std::string> lines;
+            for (auto chunk = ring.AcquireChunk(maxRecords); !chunk.empty(); chunk = ring.AcquireChunk(maxRecords))
+            {
+                for (const auto& record : chunk)
+                {
+                    lines.emplace_back(record.GetText());
+                }
+                ring.ReleaseChunk(chunk);
+            }
+            return lines;
+        }
+    }
+
+    TEST_CLASS(LogRingTests)
+    {
+        TEST_METHOD(ChunksInOrderTest)
+        {
+            LogRing ring(6);
+            Assert::AreEqual(size_t{8}, ring.GetCapacity());
+            Assert::IsTrue(ring.AcquireChunk().empty());
+
+            for (int line = 0; line < 5; ++line)
+            {
+                Assert::IsTrue(ring.Write(std::format("Line {}", line)));
+            }
+            auto chunk = ring.AcquireChunk(3);
+            Assert::AreEqual(size_t{3}, chunk.size());
+            Assert::AreEqual(std::string("Line 0"), std::string(chunk[0].GetText()));
+            Assert::AreEqual(std::string("Line 2"), std::string(chunk[2].GetText()));
+            ring.ReleaseChunk(chunk);
+
+            for (int line = 5; line < 10; ++line)
+            {
+                ring.Write(std::format("Line {}", line));
+            }
+            // the chunk ends with the array; the lines wrapped around come next
+            chunk = ring.AcquireChunk();
+            Assert::AreEqual(size_t{5}, chunk.size());
+            Assert::AreEqual(std::string("Line 3"), std::string(chunk[0].GetText()));
+            ring.ReleaseChunk(chunk);
+            const auto lines = Drain(ring);
+            Assert::AreEqual(size_t{2}, lines.size());
+            Assert::AreEqual(std::string("Line 9"), lines[1]);
+            Assert::AreEqual(uint64_t{0}, ring.GetDroppedCount());
+        }
+
+        TEST_METHOD(FullRingOverwritesOldestTest)
+        {
+            LogRing ring(8);
+            for (int line = 0; line < 12; ++line)
+            {
+                Assert::IsTrue(ring.Write(std::format("Line {}", line)));
+            }
+            const auto lines = Drain(ring);
+            Assert::AreEqual(size_t{8}, lines.size());
+            Assert::AreEqual(std::string("Line 4"), lines.front());
+            Assert::AreEqual(std::string("Line 11"), lines.back());
+            Assert::AreEqual(uint64_t{4}, ring.GetDroppedCount());
+        }
+
+        TEST_METHOD(AcquiredRecordsKeptTest)
+        {
+            LogRing ring(4);
+            for (int line = 0; line < 4; ++line)
+            {
+                ring.Write(std::format("Line {}", line));
+            }
+            const auto chunk = ring.AcquireChunk(2);
+            Assert::IsFalse(ring.Write("Line 4"), L"Would overwrite a record being read");
+            Assert::IsFalse(ring.Write("Line 5"));
+            Assert::IsTrue(ring.Write("Line 6"));
+            Assert::AreEqual(std::string("Line 0"), std::string(chunk[0].GetText()));
+            Assert::AreEqual(std::string("Line 1"), std::string(chunk[1].GetText()));
+            ring.ReleaseChunk(chunk);
+
+            const auto lines = Drain(ring);
+            Assert::AreEqual(size_t{2}, lines.size());
+            Assert::AreEqual(std::string("Line 3"), lines[0]);
+            Assert::AreEqual(std::string("Line 6"), lines[1]);
+            Assert::AreEqual(uint64_t{3}, ring.GetDroppedCount(), L"Two dropped, one overwritten");
+        }
+
+        TEST_METHOD(LongLineCutAtCharacterTest)
+        {
+            LogRing ring(2);
+            const std::string text = std::string(LogRing::MAX_TEXT_SIZE - 1, 'x') + "\xC3\xA9";
+            ring.Write(text);
+            const auto lines = Drain(ring);
+            Assert::AreEqual(text.substr(0, LogRing::MAX_TEXT_SIZE - 1), lines.at(0));
+        }
+
+        TEST_METHOD(ConcurrentWritersAndReaderTest)
+        {
+            constexpr int threadCount = 4;
+            constexpr int linesPerThread = 20000;
+            LogRing ring(256);
+            std::atomic<bool> isWriting = true;
+            std::vector<std::string> lines;
+            std::thread reader([&]
+            {
+                while (isWriting.load())
+                {
+                    auto drained = Drain(ring, 32);
+                    lines.insert(lines.end(), drained.begin(), drained.end());
+                }
+                auto drained = Drain(ring);
+                lines.insert(lines.end(), drained.begin(), drained.end());
+            });
+            {
+                std::vector<std::jthread> writers;
+                for (int thread = 0; thread < threadCount; ++thread)
+                {
+                    writers.emplace_back([&ring, thread]
+                    {
+                        for (int line = 0; line < linesPerThread; ++line)
+                        {
+                            ring.Write(std::format("Thread {} line {} {}", thread, line, std::string(line % 64, '.')));
+                        }
+                    });
+                }
+            }
+            isWriting = false;
+            reader.join();
+
+            std::vector<int> lastLines(threadCount, -1);
+            for (const auto& line : lines)
+            {
+                std::istringstream stream(line);
+                std::string threadWord;
+                std::string lineWord;
+                int thread = -1;
+                int number = -1;
+                stream >> threadWord >> thread >> lineWord >> number;
+                Assert::IsTrue(threadWord == "Thread" && lineWord == "line" && thread >= 0 && number >= 0, std::wstring(line.begin(), line.end()).c_str());
+                Assert::IsTrue(line.ends_with(" " + std::string(number % 64, '.')), L"Intact");
+                Assert::IsTrue(number > lastLines.at(thread), L"In order per thread");
+                lastLines[thread] = number;
+            }
+            Assert::AreEqual(uint64_t{threadCount * linesPerThread}, lines.size() + ring.GetDroppedCount());
+        }
+
+        TEST_METHOD(SinkTest)
+        {
+            LogRing ring(4);
+            spdlog::logger logger("ring", std::make_shared<LogRingSink>(ring));
+            logger.info("Device {} added.", 42);
+            logger.debug("Not logged");
+            const auto lines = Drain(ring);
+            Assert::AreEqual(size_t{1}, lines.size());
+            Assert::IsTrue(lines[0].starts_with("[20"));
+            Assert::IsTrue(lines[0].ends_with("] [info] Device 42 added."), std::wstring(lines[0].begin(), lines[0].end()).c_str());
+        }
+    };
+}
@@ -0,0 +1,212 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "Clock.h"
+#include "LogRing.h"
+#include "LogShipper.h"
+
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Poco/InflatingStream.h>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        struct ShippedRequest
+        {
+            bool postOrPut;
+            std::string urlSuffix;
+            std::string text; // decompressed
+            std::unordered_map<std::string, std::string> header;
+        };
+
+        class CapturingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            CapturingDispatcher() = default;
+            DISALLOW_COPY_MOVE(CapturingDispatcher);
+            ~CapturingDispatcher() override = default;
+
+            void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point&,
+                                const std::string& urlSuffix, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>& header, const std::string&) override
+            {
+                if (isFailing)
+                {
+                    throw std::runtime_error("Broker unreachable");
+                }
+                payloadBytes += payload.size();
+                std::istringstream compressed(payload);
+                Poco::InflatingInputStream inflater(compressed, Poco::InflatingStreamBuf::STREAM_GZIP);
+                std::ostringstream text;
+                text << inflater.rdbuf();
+
+                std::lock_guard lock(mutex_);
+                requests_.push_back({postOrPut, urlSuffix, text.str(), header});
+            }
+
+            [[nodiscard]] std::vector<ShippedRequest> GetRequests() const
+            {
+                std::lock_guard lock(mutex_);
+                return requests_;
+            }
+
+            [[nodiscard]] std::string GetText() const
+            {
+                std::string text;
+                for (const auto& request : GetRequests())
+                {
+                    text += request.text;
+                }
+                return text;
+            }
+
+            std::atomic<bool> isFailing = false;
+            std::atomic<uint64_t> payloadBytes = 0;
+
+        private:
+            mutable std::mutex mutex_;
+            std::vector<ShippedRequest> requests_;
+        };
+
+        // Returns the text as the batches carry it
+        std::string WriteLines(LogRing& ring, int first, int count)
+        {
+            std::string text;
+            for (int line = first; line < first + count; ++line)
+            {
+                const auto lineText = std::format("[2026-01-31 12:34:56.{:06}] [info] Device {{0.0.0.00000000}}.{{{:08x}}} volume {}.",
+                                                  line, line * 2654435761U, line % 1001);
+                ring.Write(lineText);
+                text += lineText + "\n";
+            }
+            return text;
+        }
+
+        std::filesystem::path GetSpoolDirectory(const std::string& name)
+        {
+            auto directory = std::filesystem::temp_directory_path() / std::format("LogShipperTests.{}", name);
+            std::filesystem::remove_all(directory);
+            return directory;
+        }
+
+        size_t CountFiles(const std::filesystem::path& directory)
+        {
+            return static_cast<size_t>(std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()));
+        }
+    }
+
+    TEST_CLASS(LogShipperTests)
+    {
+        TEST_METHOD(BatchesBySizeInOrderTest)
+        {
+            LogRing ring(1024);
+            CapturingDispatcher dispatcher;
+            const ManualClock clock;
+            const auto text = WriteLines(ring, 0, 200);
+            {
+                const LogShipper shipper(ring, dispatcher, {.maxBatchBytes = 4096, .bytesPerSecond = 0.0}, "host-1", {}, clock);
+            }
+
+            const auto requests = dispatcher.GetRequests();
+            Assert::IsTrue(requests.size() >= text.size() / (4096 + 16 * LogRing::MAX_TEXT_SIZE));
+            for (const auto& request : requests)
+            {
+                Assert::IsFalse(request.postOrPut, L"PUT: low priority");
+                Assert::AreEqual(std::string(LogShipper::LOG_BATCH_URL_SUFFIX), request.urlSuffix);
+                Assert::AreEqual(std::string("gzip"), request.header.at("Content-Encoding"));
+                Assert::AreEqual(std::string("host-1"), request.header.at(LogShipper::HOST_NAME_HEADER_KEY));
+            }
+            Assert::IsTrue(text == dispatcher.GetText(), L"All lines, in order");
+        }
+
+        TEST_METHOD(AgeClosesBatchTest)
+        {
+            LogRing ring(64);
+            CapturingDispatcher dispatcher;
+            ManualClock clock;
+            const LogShipper shipper(ring, dispatcher, {.maxBatchDelay = 1s, .bytesPerSecond = 0.0}, "host-1", {}, clock);
+            const auto text = WriteLines(ring, 0, 3);
+
+            Assert::IsTrue(clock.WaitForWaiters(1, 5000ms));
+            clock.Advance(100ms); // drained: the batch starts
+            Assert::IsTrue(clock.WaitForWaiters(1, 5000ms));
+            Assert::IsTrue(dispatcher.GetRequests().empty());
+            clock.Advance(1s);
+            for (int attempt = 0; attempt < 500 && dispatcher.GetRequests().empty(); ++attempt)
+            {
+                std::this_thread::sleep_for(10ms);
+            }
+            Assert::AreEqual(size_t{1}, dispatcher.GetRequests().size());
+            Assert::IsTrue(text == dispatcher.GetText());
+        }
+
+        TEST_METHOD(SpoolWhileTransportUnavailableTest)
+        {
+            const auto spoolDirectory = GetSpoolDirectory("Spool");
+            const LogShippingSettings settings{.maxBatchBytes = 2048, .bytesPerSecond = 0.0, .spoolDirectory = spoolDirectory};
+            LogRing ring(256);
+            CapturingDispatcher dispatcher;
+            const ManualClock clock;
+
+            dispatcher.isFailing = true;
+            auto text = WriteLines(ring, 0, 150);
+            {
+                const LogShipper shipper(ring, dispatcher, settings, "host-1", {}, clock);
+            }
+            const auto spooledCount = CountFiles(spoolDirectory);
+            Assert::IsTrue(spooledCount >= 2, L"Spooled when the target throws");
+
+            dispatcher.isFailing = false;
+            bool isAvailable = false;
+            text += WriteLines(ring, 150, 150);
+            {
+                const LogShipper shipper(ring, dispatcher, settings, "host-1", [&isAvailable] { return isAvailable; }, clock);
+            }
+            Assert::IsTrue(dispatcher.GetRequests().empty(), L"Nothing sent while unavailable");
+            Assert::IsTrue(CountFiles(spoolDirectory) > spooledCount);
+
+            isAvailable = true;
+            {
+                const LogShipper shipper(ring, dispatcher, settings, "host-1", [&isAvailable] { return isAvailable; }, clock);
+            }
+            Assert::AreEqual(size_t{0}, CountFiles(spoolDirectory), L"Spool emptied");
+            Assert::IsTrue(text == dispatcher.GetText(), L"Spooled batches in order, none lost");
+            std::filesystem::remove_all(spoolDirectory);
+        }
+
+        TEST_METHOD(BandwidthCapTest)
+        {
+            const auto spoolDirectory = GetSpoolDirectory("Bandwidth");
+            constexpr size_t maxBatchBytes = 2048;
+            LogRing ring(1024);
+            CapturingDispatcher dispatcher;
+            const ManualClock clock; // the budget is not refilled
+            WriteLines(ring, 0, 1000);
+            {
+                const LogShipper shipper(ring, dispatcher,
+                                         {.maxBatchBytes = maxBatchBytes, .bytesPerSecond = 1.0, .spoolDirectory = spoolDirectory},
+                                         "host-1", {}, clock);
+            }
+            Assert::IsTrue(dispatcher.payloadBytes > 0 && dispatcher.payloadBytes <= maxBatchBytes, L"No more than the budget");
+            Assert::IsTrue(CountFiles(spoolDirectory) > 0, L"The rest spooled");
+            std::filesystem::remove_all(spoolDirectory);
+        }
+    };
+}
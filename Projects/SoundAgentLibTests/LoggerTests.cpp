@@ -2,12 +2,25 @@
 
 #include "ApiClient/common/SpdLogger.h"
 
+#include "AsyncDefaultLogger.h"
+#include "LogFloodGuard.h"
+#include "LogMacros.h"
+
 #include <CppUnitTest.h>
 
+#include <atomic>
 #include <format>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/sinks/ostream_sink.h>
+#include <spdlog/spdlog.h>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
-using namespace std::literals::string_literals;
+using namespace std::literals;
 
 
 namespace ed::tests
@@ -37,5 +50,101 @@ namespace ed::tests
             , widenedErrMessage.c_str()
             );
         }
+
+        TEST_METHOD(LevelGatedArgumentsTest)
+        {
+            const auto previousLevel = spdlog::get_level();
+            int evaluationCount = 0;
+            const auto countEvaluation = [&evaluationCount] { return ++evaluationCount; };
+
+            spdlog::set_level(spdlog::level::warn);
+            ED_LOG_INFO("Not logged: {}.", countEvaluation());
+            Assert::AreEqual(0, evaluationCount, L"Below the level the arguments are not evaluated");
+            ED_LOG_WARN("Logged: {}.", countEvaluation());
+            Assert::AreEqual(1, evaluationCount);
+
+            spdlog::set_level(previousLevel);
+        }
+
+        TEST_METHOD(AsyncDefaultLoggerWritesToPreviousSinksTest)
+        {
+            std::ostringstream stream;
+            const auto previousLogger = spdlog::default_logger();
+            spdlog::set_default_logger(std::make_shared<spdlog::logger>("test", std::make_shared<spdlog::sinks::ostream_sink_mt>(stream)));
+            const auto testLogger = spdlog::default_logger();
+            {
+                const AsyncDefaultLogger asyncLogger(64);
+                Assert::IsTrue(spdlog::default_logger() != testLogger);
+                for (int i = 0; i < 100; ++i)
+                {
+                    spdlog::info("Message {}", i);
+                }
+            }
+            Assert::IsTrue(spdlog::default_logger() == testLogger, L"Previous logger restored");
+            spdlog::set_default_logger(previousLogger);
+
+            const auto text = stream.str();
+            Assert::IsTrue(text.find("Message 99") != std::string::npos, L"Queued messages written on destruction");
+        }
+
+        TEST_METHOD(LogSiteBurstThenRateTest)
+        {
+            LogFloodGuard guard;
+            LogSite site("Sources/Flooding.cpp", 42);
+            const auto start = LogSite::Clock::now();
+            Assert::IsTrue(site.TryAcquire(guard, start), L"Unlimited by default");
+
+            guard.SetLimit(2.0, 5.0);
+            for (int i = 0; i < 5; ++i)
+            {
+                Assert::IsTrue(site.TryAcquire(guard, start + 1s), L"Burst");
+            }
+            Assert::IsFalse(site.TryAcquire(guard, start + 1s));
+            Assert::IsFalse(site.TryAcquire(guard, start + 1s + 400ms));
+            Assert::IsTrue(site.TryAcquire(guard, start + 1s + 500ms), L"Refilled at 2/s");
+            Assert::IsFalse(site.TryAcquire(guard, start + 1s + 500ms));
+            Assert::AreEqual(uint64_t{3}, site.GetSuppressedCount());
+            Assert::IsTrue(site.TryAcquire(guard, start + 10s), L"Calm again");
+
+            std::ostringstream stream;
+            const auto previousLogger = spdlog::default_logger();
+            spdlog::set_default_logger(std::make_shared<spdlog::logger>("test", std::make_shared<spdlog::sinks::ostream_sink_mt>(stream)));
+            Assert::AreEqual(uint64_t{3}, guard.ReportSuppressed());
+            Assert::AreEqual(uint64_t{0}, guard.ReportSuppressed(), L"Reported once");
+            spdlog::set_default_logger(previousLogger);
+
+            Assert::IsTrue(stream.str().find("Suppressed 3 similar messages of Flooding.cpp:42.") != std::string::npos);
+            Assert::AreEqual(uint64_t{0}, site.GetSuppressedCount());
+        }
+
+        // Threads flooding one site at the same instant: exactly the burst passes
+        TEST_METHOD(LogSiteConcurrentFloodTest)
+        {
+            constexpr size_t threadCount = 4;
+            constexpr uint64_t messageCount = 10000;
+            LogFloodGuard guard;
+            guard.SetLimit(1.0, 100.0);
+            LogSite site(__FILE__, __LINE__);
+            const auto now = LogSite::Clock::now();
+            std::atomic<uint64_t> passedCount = 0;
+            {
+                std::vector<std::jthread> threads;
+                for (size_t thread = 0; thread < threadCount; ++thread)
+                {
+                    threads.emplace_back([&guard, &site, &passedCount, now]
+                    {
+                        for (uint64_t message = 0; message < messageCount; ++message)
+                        {
+                            if (site.TryAcquire(guard, now))
+                            {
+                                ++passedCount;
+                            }
+                        }
+                    });
+                }
+            }
+            Assert::AreEqual(uint64_t{100}, passedCount.load());
+            Assert::AreEqual(uint64_t{threadCount * messageCount - 100}, site.GetSuppressedCount());
+        }
     };
 }
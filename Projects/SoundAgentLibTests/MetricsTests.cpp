@@ -0,0 +1,181 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "AgentMetrics.h"
+#include "FakeAudioEndpoints.h"
+#include "FanOutHttpRequestDispatcher.h"
+#include "MetricsRegistry.h"
+#include "SoundDeviceCollection.h"
+
+#include <atomic>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/HTTPRequest.h>
+#include <Poco/Net/HTTPResponse.h>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        class FailingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                throw std::runtime_error("Broker unreachable");
+            }
+        };
+
+        // Empty if the status is not 200
+        std::string Scrape(uint16_t port, const std::string& path = MetricsHttpServer::METRICS_PATH)
+        {
+            Poco::Net::HTTPClientSession session("127.0.0.1", port);
+            Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, path, Poco::Net::HTTPMessage::HTTP_1_1);
+            session.sendRequest(request);
+            Poco::Net::HTTPResponse response;
+            auto& body = session.receiveResponse(response);
+            std::string text{std::istreambuf_iterator(body), std::istreambuf_iterator<char>()};
+            return response.getStatus() == Poco::Net::HTTPResponse::HTTP_OK ? text : std::string();
+        }
+
+        // The value of the series, e.g. R"(soundagent_events_total{type="Discovered"})"; -1 if missing
+        double GetValue(const std::string& text, const std::string& series)
+        {
+            const auto line = "\n" + series + " ";
+            const auto position = ("\n" + text).find(line);
+            return position == std::string::npos ? -1.0 : std::stod(text.substr(position + line.size() - 1));
+        }
+    }
+
+    TEST_CLASS(MetricsTests)
+    {
+        TEST_METHOD(RenderTextExpositionFormatTest)
+        {
+            MetricsRegistry registry;
+            registry.AddCounter("requests_total", "Requests.", {{"sink", "a\"b"}}, [] { return 3.0; });
+            registry.AddCounter("requests_total", "Ignored help.", {{"sink", "c"}}, [] { return 4.0; });
+            registry.AddGauge("queue_size", "Queue.", {}, [] { return 1.5; });
+            registry.AddSummary("latency_seconds", "Latency.", {{"stage", "x"}}, []
+            {
+                LatencyHistogram histogram;
+                histogram.Record(10us); // below 64 us the buckets are exact
+                histogram.Record(40us);
+                return histogram.GetSnapshot();
+            });
+            Assert::ExpectException<std::invalid_argument>([&registry] { registry.AddGauge("requests_total", "", {}, [] { return 0.0; }); });
+
+            const auto expected =
+                "# HELP requests_total Requests.\n"
+                "# TYPE requests_total counter\n"
+                "requests_total{sink=\"a\\\"b\"} 3\n"
+                "requests_total{sink=\"c\"} 4\n"
+                "# HELP queue_size Queue.\n"
+                "# TYPE queue_size gauge\n"
+                "queue_size 1.5\n"
+                "# HELP latency_seconds Latency.\n"
+                "# TYPE latency_seconds summary\n"
+                "latency_seconds{stage=\"x\",quantile=\"0.5\"} 0.000010\n"
+                "latency_seconds{stage=\"x\",quantile=\"0.9\"} 0.000040\n"
+                "latency_seconds{stage=\"x\",quantile=\"0.99\"} 0.000040\n"
+                "latency_seconds{stage=\"x\",quantile=\"0.999\"} 0.000040\n"
+                "latency_seconds_sum{stage=\"x\"} 0.000050\n"
+                "latency_seconds_count{stage=\"x\"} 2\n"s;
+            Assert::AreEqual(expected, registry.Render());
+        }
+
+        // An event storm on one thread, scrapes on another: the counters only grow while the storm lasts
+        // and match the storm exactly afterwards.
+        TEST_METHOD(ScrapeUnderEventStormTest)
+        {
+            constexpr size_t deviceCount = 50;
+            constexpr size_t volumeChangeCount = 20000;
+
+            audio::FakeEndpoints endpoints;
+            audio::SoundDeviceCollection collection(std::make_unique<audio::FakeEndpointProvider>(endpoints), nullptr);
+            FanOutHttpRequestDispatcher fanOutDispatcher;
+            fanOutDispatcher.AddSink("Broken", std::make_unique<FailingDispatcher>(), PayloadEncoding::Json, 100);
+            AgentMetrics metrics(collection, &fanOutDispatcher, 0);
+            const auto port = metrics.GetPort();
+
+            Assert::IsTrue(Scrape(port, "/other").empty(), L"Only the metrics path is served");
+
+            std::atomic<bool> isStormOver = false;
+            std::jthread storm([&endpoints, &collection, &isStormOver]
+            {
+                std::vector<audio::FakeEndpoint*> devices;
+                for (size_t device = 0; device < deviceCount; ++device)
+                {
+                    auto& endpoint = endpoints.Add(std::format(L"{{0.0.0.00000000}}.{{Device{}}}", device), std::format("Device{}", device),
+                                                   "Device", SoundDeviceFlowType::Render);
+                    endpoint.volume = 400;
+                    endpoint.active = true;
+                    collection.OnDeviceAdded(endpoint.id.c_str());
+                    devices.push_back(&endpoint);
+                }
+                for (size_t change = 0; change < volumeChangeCount; ++change)
+                {
+                    // every device alternates between two volumes: each change is a real one
+                    const auto volume = static_cast<uint16_t>(1 + change / deviceCount % 2);
+                    devices[change % deviceCount]->volume = volume;
+                    AUDIO_VOLUME_NOTIFICATION_DATA volumeData{};
+                    volumeData.fMasterVolume = static_cast<float>(volume) / 1000.0f;
+                    collection.OnNotify(&volumeData);
+                }
+                isStormOver = true;
+            });
+
+            const auto volumeSeries = R"(soundagent_events_total{type="VolumeRenderChanged"})"s;
+            double previousVolumeEvents = 0.0;
+            size_t scrapeCount = 0;
+            do
+            {
+                const auto text = Scrape(port);
+                const auto volumeEvents = GetValue(text, volumeSeries);
+                Assert::IsTrue(volumeEvents >= previousVolumeEvents, L"Counter never decreases");
+                previousVolumeEvents = volumeEvents;
+                ++scrapeCount;
+            } while (!isStormOver);
+            storm.join();
+
+            for (int i = 0; i < 5; ++i)
+            {
+                fanOutDispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {}, "Device");
+            }
+            std::string text;
+            for (const auto deadline = std::chrono::steady_clock::now() + 5s; std::chrono::steady_clock::now() < deadline; )
+            {
+                text = Scrape(port);
+                if (GetValue(text, R"(soundagent_sink_failures_total{sink="Broken"})") == 5.0)
+                {
+                    break;
+                }
+                std::this_thread::sleep_for(10ms);
+            }
+            Logger::WriteMessage(std::format("{} scrapes during the storm.", scrapeCount).c_str());
+
+            Assert::AreEqual(static_cast<double>(deviceCount), GetValue(text, R"(soundagent_events_total{type="Discovered"})"));
+            Assert::AreEqual(static_cast<double>(volumeChangeCount), GetValue(text, volumeSeries));
+            Assert::AreEqual(static_cast<double>(deviceCount), GetValue(text, "soundagent_devices"));
+            Assert::AreEqual(5.0, GetValue(text, R"(soundagent_sink_failures_total{sink="Broken"})"));
+            Assert::AreEqual(0.0, GetValue(text, R"(soundagent_sink_queue_size{sink="Broken"})"));
+            Assert::IsTrue(GetValue(text, "process_resident_memory_bytes") > 0.0);
+            Assert::IsTrue(GetValue(text, "process_open_handles") > 0.0);
+        }
+    };
+}
@@ -0,0 +1,239 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "FakeAudioEndpoints.h"
+#include "NotificationRecording.h"
+#include "NotificationReplay.h"
+#include "SoundDeviceCollection.h"
+
+#include <chrono>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class CountingObserver final : public SoundDeviceObserverInterface
+        {
+        public:
+            void OnCollectionChanged(SoundDeviceEventType, const std::string&) override
+            {
+                ++eventCount;
+            }
+
+            size_t eventCount = 0;
+        };
+
+        constexpr auto SPEAKERS_ENDPOINT = "{0.0.0.00000000}.{1}";
+        constexpr auto HEADSET_EARPHONE_ENDPOINT = "{0.0.0.00000000}.{2}";
+        constexpr auto HEADSET_MICROPHONE_ENDPOINT = "{0.0.1.00000000}.{2}";
+
+        RecordedNotification CreateSnapshot(std::chrono::microseconds time, std::vector<SoundDevice> devices)
+        {
+            return {.type = NotificationType::Snapshot, .time = time, .devices = std::move(devices)};
+        }
+
+        // After (re)creating the device list: with the active endpoints and the default render one
+        RecordedNotification CreateSnapshot(std::chrono::microseconds time, std::vector<SoundDevice> devices,
+                                            std::vector<RecordedEndpoint> endpoints, std::string defaultRenderEndpointId)
+        {
+            return {.type = NotificationType::Snapshot, .time = time, .endpoints = std::move(endpoints), .listRecreated = true,
+                    .defaultRenderEndpointId = std::move(defaultRenderEndpointId), .devices = std::move(devices)};
+        }
+
+        // What a SoundDeviceCollection records for a headset plugged in, made default, turned down, its earphone unplugged
+        std::vector<RecordedNotification> CreateRecording()
+        {
+            const SoundDevice speakersEndpoint{"SPEAKERS", "Speakers", SoundDeviceFlowType::Render, 500, 0, false, false};
+            const SoundDevice earphoneEndpoint{"HEADSET", "Headset Earphone", SoundDeviceFlowType::Render, 300, 0, false, false};
+            const SoundDevice earphoneEndpointTurnedDown{"HEADSET", "Headset Earphone", SoundDeviceFlowType::Render, 250, 0, false, false};
+            const SoundDevice microphoneEndpoint{"HEADSET", "Headset Microphone", SoundDeviceFlowType::Capture, 0, 700, false, false};
+
+            const SoundDevice speakers{"SPEAKERS", "Speakers", SoundDeviceFlowType::Render, 500, 0, true, false};
+            const SoundDevice speakersNotDefault{"SPEAKERS", "Speakers", SoundDeviceFlowType::Render, 500, 0, false, false};
+            const SoundDevice headset{"HEADSET", "Headset Earphone/Headset Microphone", SoundDeviceFlowType::RenderAndCapture, 300, 700, false, false};
+            const SoundDevice headsetAsDefault{"HEADSET", "Headset Earphone/Headset Microphone", SoundDeviceFlowType::RenderAndCapture, 250, 700, true, false};
+
+            return {
+                CreateSnapshot(std::chrono::microseconds(0), {speakers}, {{SPEAKERS_ENDPOINT, speakersEndpoint}}, SPEAKERS_ENDPOINT),
+                {.type = NotificationType::DeviceStateChanged, .time = std::chrono::microseconds(1000), .endpointId = HEADSET_EARPHONE_ENDPOINT, .state = 1},
+                {.type = NotificationType::DeviceAdded, .time = std::chrono::microseconds(1010), .endpointId = HEADSET_EARPHONE_ENDPOINT,
+                 .endpoints = {{HEADSET_EARPHONE_ENDPOINT, earphoneEndpoint}}, .devices = {earphoneEndpoint}},
+                {.type = NotificationType::DeviceStateChanged, .time = std::chrono::microseconds(1020), .endpointId = HEADSET_MICROPHONE_ENDPOINT, .state = 1},
+                {.type = NotificationType::DeviceAdded, .time = std::chrono::microseconds(1030), .endpointId = HEADSET_MICROPHONE_ENDPOINT,
+                 .endpoints = {{HEADSET_MICROPHONE_ENDPOINT, microphoneEndpoint}}, .devices = {headset}},
+                {.type = NotificationType::DefaultDeviceChanged, .time = std::chrono::microseconds(2000), .endpointId = HEADSET_EARPHONE_ENDPOINT,
+                 .flow = 0, .role = 1, .endpoints = {{HEADSET_EARPHONE_ENDPOINT, earphoneEndpoint}}, .pnpId = "SPEAKERS"},
+                {.type = NotificationType::DefaultDeviceChanged, .time = std::chrono::microseconds(2001), .endpointId = HEADSET_EARPHONE_ENDPOINT,
+                 .flow = 0, .role = 0, .endpoints = {{HEADSET_EARPHONE_ENDPOINT, earphoneEndpoint}}, .pnpId = "HEADSET"},
+                {.type = NotificationType::VolumeChanged, .time = std::chrono::microseconds(3000), .masterVolume = 250, .volumeChanges = {{"HEADSET", true, 250}}},
+                CreateSnapshot(std::chrono::microseconds(3500), {speakersNotDefault, headsetAsDefault},
+                               {{SPEAKERS_ENDPOINT, speakersEndpoint}, {HEADSET_EARPHONE_ENDPOINT, earphoneEndpointTurnedDown},
+                                {HEADSET_MICROPHONE_ENDPOINT, microphoneEndpoint}}, HEADSET_EARPHONE_ENDPOINT),
+                {.type = NotificationType::DeviceRemoved, .time = std::chrono::microseconds(4000), .endpointId = HEADSET_EARPHONE_ENDPOINT,
+                 .endpoints = {{HEADSET_EARPHONE_ENDPOINT, earphoneEndpointTurnedDown}}, .pnpId = "HEADSET", .devices = {microphoneEndpoint}},
+                {.type = NotificationType::DefaultDeviceChanged, .time = std::chrono::microseconds(4001), .flow = 0, .role = 0, .pnpId = ""},
+                CreateSnapshot(std::chrono::microseconds(5000), {speakersNotDefault, microphoneEndpoint})
+            };
+        }
+
+        // A SoundDeviceCollection on the endpoints of a replay, the audio service of the recording machine
+        class ReplayedDesk final
+        {
+        public:
+            explicit ReplayedDesk(const NotificationReplay& replay)
+            {
+                replay.AddEndpoints(endpoints);
+            }
+
+            FakeEndpoints endpoints;
+            SoundDeviceCollection collection{std::make_unique<FakeEndpointProvider>(endpoints), nullptr};
+        };
+
+        std::string Encode(const std::vector<RecordedNotification>& notifications)
+        {
+            std::string data;
+            AppendNotificationRecordingHeader(data);
+            std::chrono::microseconds previousTime{};
+            for (const auto& notification : notifications)
+            {
+                AppendNotificationRecord(data, notification, previousTime);
+                previousTime = notification.time;
+            }
+            return data;
+        }
+    }
+
+    TEST_CLASS(NotificationRecordingTests)
+    {
+        TEST_METHOD(EncodeAndParseRoundTripTest)
+        {
+            const auto recording = CreateRecording();
+            const auto parsed = ParseNotificationRecording(Encode(recording));
+
+            Assert::AreEqual(recording.size(), parsed.size());
+            for (size_t i = 0; i < recording.size(); ++i)
+            {
+                const auto& expected = recording[i];
+                const auto& actual = parsed[i];
+                Assert::IsTrue(expected.type == actual.type);
+                Assert::AreEqual(expected.time.count(), actual.time.count());
+                Assert::AreEqual(expected.endpointId, actual.endpointId);
+                Assert::AreEqual(expected.flow, actual.flow);
+                Assert::AreEqual(expected.role, actual.role);
+                Assert::AreEqual(expected.state, actual.state);
+                Assert::AreEqual(expected.masterVolume, actual.masterVolume);
+                Assert::AreEqual(expected.pnpId, actual.pnpId);
+                Assert::AreEqual(expected.devices.size(), actual.devices.size());
+                Assert::AreEqual(expected.volumeChanges.size(), actual.volumeChanges.size());
+                Assert::AreEqual(expected.endpoints.size(), actual.endpoints.size());
+                Assert::AreEqual(expected.listRecreated, actual.listRecreated);
+                Assert::AreEqual(expected.defaultRenderEndpointId, actual.defaultRenderEndpointId);
+            }
+            const FakeEndpoints noEndpoints;
+            const SoundDeviceCollection emptyCollection(std::make_unique<FakeEndpointProvider>(noEndpoints), nullptr);
+            Assert::IsTrue(NotificationReplay::Compare(emptyCollection, parsed.front()).size() == 1, L"Recorded device missing");
+            const auto& [endpointId, endpoint] = parsed[2].endpoints.front();
+            Assert::AreEqual(std::string(HEADSET_EARPHONE_ENDPOINT), endpointId);
+            Assert::AreEqual(uint16_t{300}, endpoint.GetCurrentRenderVolume());
+            const auto& lastDevice = parsed.back().devices.back();
+            Assert::AreEqual(std::string("Headset Microphone"), lastDevice.GetName());
+            Assert::IsTrue(SoundDeviceFlowType::Capture == lastDevice.GetFlow());
+            Assert::AreEqual(uint16_t{700}, lastDevice.GetCurrentCaptureVolume());
+        }
+
+        TEST_METHOD(TruncatedAndInvalidRecordingTest)
+        {
+            const auto recording = CreateRecording();
+            const auto data = Encode(recording);
+
+            const auto parsed = ParseNotificationRecording(std::string_view(data).substr(0, data.size() - 3));
+            Assert::AreEqual(recording.size() - 1, parsed.size(), L"Record cut off while writing is dropped");
+
+            Assert::ExpectException<std::runtime_error>([] { (void)ParseNotificationRecording("SANX\x01"); });
+            Assert::ExpectException<std::runtime_error>([] { (void)ParseNotificationRecording("SANR\x01"); }, L"Without the endpoints");
+            Assert::ExpectException<std::runtime_error>([] { (void)ParseNotificationRecording("SANR\x02\x09"); });
+            Assert::ExpectException<std::invalid_argument>([&recording]
+            {
+                NotificationReplay replay({recording.begin() + 1, recording.end()});
+            });
+        }
+
+        TEST_METHOD(ReplayReproducesRecordedStateTest)
+        {
+            const NotificationReplay replay(CreateRecording());
+            ReplayedDesk desk(replay);
+            replay.LoadInitialState(desk.endpoints, desk.collection);
+            CountingObserver observer;
+            desk.collection.Subscribe(observer);
+
+            const auto result = replay.Run(desk.endpoints, desk.collection, 0.0);
+            desk.collection.Unsubscribe(observer);
+            for (const auto& difference : result.differences)
+            {
+                Logger::WriteMessage(difference.c_str());
+            }
+            Assert::IsTrue(result.differences.empty());
+            Assert::AreEqual(size_t{2}, result.checkedSnapshotCount);
+            // The state changes, not the additions they were processed as
+            Assert::AreEqual(size_t{7}, result.notificationCount);
+            // Discovered twice; render default; volume; none for the reset; detached, render default reset
+            Assert::AreEqual(size_t{6}, observer.eventCount);
+        }
+
+        TEST_METHOD(ReplayDetectsDivergingCollectionTest)
+        {
+            auto recording = CreateRecording();
+            // Recorded by a collection that resolved the microphone volume differently
+            recording.back().devices.back() = {"HEADSET", "Headset Microphone", SoundDeviceFlowType::Capture, 0, 650, false, false};
+            const NotificationReplay replay(std::move(recording));
+            ReplayedDesk desk(replay);
+            replay.LoadInitialState(desk.endpoints, desk.collection);
+
+            const auto result = replay.Run(desk.endpoints, desk.collection, 0.0);
+            Assert::AreEqual(size_t{1}, result.differences.size());
+            Assert::IsTrue(result.differences.front().find("volume 0 / 700") != std::string::npos);
+        }
+
+        TEST_METHOD(ReplayThroughputTest)
+        {
+            constexpr size_t cycles = 20'000;
+            std::vector<RecordedNotification> recording{CreateRecording().front()};
+            const auto cycle = CreateRecording();
+            for (size_t i = 0; i < cycles; ++i)
+            {
+                for (auto notification = cycle.begin() + 1; notification != cycle.end(); ++notification)
+                {
+                    if (notification->type != NotificationType::Snapshot)
+                    {
+                        recording.push_back(*notification);
+                    }
+                }
+            }
+            recording.push_back(cycle.back());
+
+            const auto parsed = ParseNotificationRecording(Encode(recording));
+            const NotificationReplay replay(parsed);
+            ReplayedDesk desk(replay);
+            replay.LoadInitialState(desk.endpoints, desk.collection);
+            CountingObserver observer;
+            desk.collection.Subscribe(observer);
+
+            const auto result = replay.Run(desk.endpoints, desk.collection, 0.0);
+            desk.collection.Unsubscribe(observer);
+            Assert::IsTrue(result.differences.empty());
+            Logger::WriteMessage(std::format("Replayed {} notifications in {:.3f} s: {:.0f} notifications/s, {} observer events",
+                                             result.notificationCount, result.elapsed.count(),
+                                             static_cast<double>(result.notificationCount) / result.elapsed.count(),
+                                             observer.eventCount).c_str());
+        }
+    };
+}
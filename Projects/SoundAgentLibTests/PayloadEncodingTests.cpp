@@ -0,0 +1,177 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/AudioDeviceApiClient.h"
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "EncodingHttpRequestDispatcher.h"
+#include "PayloadEncoding.h"
+#include "SoundDevice.h"
+
+#include <chrono>
+#include <format>
+
+#include <nlohmann/json.hpp>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class CapturingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>& header, const std::string&
+            ) override
+            {
+                lastPayload = payload;
+                lastHeader = header;
+            }
+
+            std::string lastPayload;
+            std::unordered_map<std::string, std::string> lastHeader;
+        };
+
+        std::string TestHostName()
+        {
+            return "DESKTOP-4F7T2QK";
+        }
+
+        std::string TestOperationSystemName()
+        {
+            return "Windows 11 Enterprise 23H2 Build 22631.4317";
+        }
+
+        constexpr PayloadEncoding ALL_ENCODINGS[] = {PayloadEncoding::Json, PayloadEncoding::Cbor, PayloadEncoding::MessagePack};
+    }
+
+    TEST_CLASS(PayloadEncodingTests)
+    {
+        // JSON payloads as produced by AudioDeviceApiClient for the message types of interest
+        static std::vector<std::pair<std::string, std::string>> CreateSamplePayloads()
+        {
+            CapturingDispatcher dispatcher;
+            const AudioDeviceApiClient apiClient(dispatcher, TestHostName, TestOperationSystemName);
+            const SoundDevice device("F2B6C1D4-9A3E-4F7B-B0C8-5E1D2A3B4C63",
+                                     "Headset Earphone (Jabra Evolve2 65)/Headset Microphone (Jabra Evolve2 65)",
+                                     SoundDeviceFlowType::RenderAndCapture, 600, 800, true, false);
+
+            std::vector<std::pair<std::string, std::string>> samples;
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Discovered, &device, "");
+            samples.emplace_back("Discovered", dispatcher.lastPayload);
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &device, "");
+            samples.emplace_back("Confirmed", dispatcher.lastPayload);
+            apiClient.PutVolumeChangeToApi(device.GetPnpId(), true, 650, "");
+            samples.emplace_back("VolumeRenderChanged", dispatcher.lastPayload);
+            return samples;
+        }
+
+        TEST_METHOD(ParseEncodingNameTest)
+        {
+            Assert::IsTrue(ParsePayloadEncoding("cbor") == PayloadEncoding::Cbor);
+            Assert::IsTrue(ParsePayloadEncoding("MESSAGEPACK") == PayloadEncoding::MessagePack);
+            Assert::IsTrue(ParsePayloadEncoding("Json") == PayloadEncoding::Json);
+            Assert::IsFalse(ParsePayloadEncoding("xml").has_value());
+        }
+
+        TEST_METHOD(RoundTripTest)
+        {
+            for (const auto& [messageType, jsonPayload] : CreateSamplePayloads())
+            {
+                for (const auto encoding : ALL_ENCODINGS)
+                {
+                    const auto encoded = EncodeJsonPayload(encoding, jsonPayload);
+                    Assert::IsTrue(nlohmann::json::parse(jsonPayload) == nlohmann::json::parse(DecodeToJsonPayload(encoding, encoded)));
+                }
+            }
+        }
+
+        TEST_METHOD(DispatcherSetsContentTypeAndSchemaTest)
+        {
+            CapturingDispatcher target;
+            EncodingHttpRequestDispatcher dispatcher(target, PayloadEncoding::Cbor);
+
+            const std::unordered_map<std::string, std::string> jsonHeader{{CONTENT_TYPE_HEADER_KEY, "application/json"}};
+
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", R"({"deviceMessageType":1,"pnpId":"X"})", jsonHeader, "");
+            Assert::AreEqual(std::string("application/cbor"), target.lastHeader.at(CONTENT_TYPE_HEADER_KEY));
+            Assert::AreEqual(std::string(PAYLOAD_SCHEMA_ID), target.lastHeader.at(SCHEMA_ID_HEADER_KEY));
+            Assert::AreEqual(std::string(R"({"deviceMessageType":1,"pnpId":"X"})"), DecodeToJsonPayload(PayloadEncoding::Cbor, target.lastPayload));
+
+            // JSON, but no device payload (digest, session hello): encoded without the device schema id
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", R"({"rootHash":"0"})", jsonHeader, "");
+            Assert::AreEqual(std::string("application/cbor"), target.lastHeader.at(CONTENT_TYPE_HEADER_KEY));
+            Assert::IsFalse(target.lastHeader.contains(SCHEMA_ID_HEADER_KEY));
+
+            // not a JSON document: forwarded as is
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "plain text", jsonHeader, "");
+            Assert::AreEqual(std::string("plain text"), target.lastPayload);
+            Assert::AreEqual(std::string("application/json"), target.lastHeader.at(CONTENT_TYPE_HEADER_KEY));
+        }
+
+        TEST_METHOD(DispatcherForwardsOtherContentUntouchedTest)
+        {
+            CapturingDispatcher target;
+            EncodingHttpRequestDispatcher dispatcher(target, PayloadEncoding::MessagePack);
+
+            // gzip compressed log batch
+            const std::unordered_map<std::string, std::string> gzipHeader{
+                {CONTENT_TYPE_HEADER_KEY, "text/plain; charset=utf-8"}, {CONTENT_ENCODING_HEADER_KEY, "gzip"}};
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "\x1f\x8b binary", gzipHeader, "");
+            Assert::AreEqual(std::string("\x1f\x8b binary"), target.lastPayload);
+            Assert::IsTrue(gzipHeader == target.lastHeader);
+
+            const std::unordered_map<std::string, std::string> gzipJsonHeader{
+                {CONTENT_TYPE_HEADER_KEY, "application/json"}, {CONTENT_ENCODING_HEADER_KEY, "gzip"}};
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "\x1f\x8b binary", gzipJsonHeader, "");
+            Assert::IsTrue(gzipJsonHeader == target.lastHeader);
+
+            // no content type at all
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", R"({"deviceMessageType":1})", {}, "");
+            Assert::AreEqual(std::string(R"({"deviceMessageType":1})"), target.lastPayload);
+            Assert::IsTrue(target.lastHeader.empty());
+
+            // media type parameters do not matter
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", R"({"deviceMessageType":1})",
+                                      {{CONTENT_TYPE_HEADER_KEY, "Application/JSON; charset=utf-8"}}, "");
+            Assert::AreEqual(std::string("application/msgpack"), target.lastHeader.at(CONTENT_TYPE_HEADER_KEY));
+        }
+
+        TEST_METHOD(SizeAndSpeedComparison)
+        {
+            constexpr int iterations = 20000;
+            for (const auto& [messageType, jsonPayload] : CreateSamplePayloads())
+            {
+                for (const auto encoding : ALL_ENCODINGS)
+                {
+                    std::string encoded;
+                    auto start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < iterations; ++i)
+                    {
+                        encoded = EncodeJsonPayload(encoding, jsonPayload);
+                    }
+                    const auto encodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+                    std::string decoded;
+                    start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < iterations; ++i)
+                    {
+                        decoded = DecodeToJsonPayload(encoding, encoded);
+                    }
+                    const auto decodeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+                    Logger::WriteMessage(std::format("{:<20} {:<12} {:>4} bytes ({:>3}% of JSON), encode {:>6} ns, decode {:>6} ns",
+                                                     messageType, GetPayloadEncodingName(encoding), encoded.size(),
+                                                     encoded.size() * 100 / jsonPayload.size(), encodeNs, decodeNs).c_str());
+                    Assert::IsTrue(encoded.size() <= jsonPayload.size());
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,74 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "Clock.h"
+#include "PeriodicTask.h"
+
+#include <atomic>
+#include <stdexcept>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    TEST_CLASS(PeriodicTaskTests)
+    {
+        TEST_METHOD(RunsOnceEveryIntervalTest)
+        {
+            ManualClock clock;
+            std::atomic<size_t> runCount = 0;
+            PeriodicTask task("Test", 1min, [&runCount] { ++runCount; }, PeriodicTask::OnStop::Skip, clock);
+
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            clock.Advance(59s);
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            Assert::AreEqual(size_t{0}, runCount.load(), L"Not before the first interval elapsed");
+
+            for (size_t run = 1; run <= 3; ++run)
+            {
+                clock.Advance(run == 1 ? 1s : 1min);
+                // Waits for the next interval again after the run
+                Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+                Assert::AreEqual(run, runCount.load());
+            }
+        }
+
+        TEST_METHOD(RunsOnStopOnlyIfRequestedTest)
+        {
+            ManualClock clock;
+            std::atomic<size_t> skippingRunCount = 0;
+            std::atomic<size_t> runningRunCount = 0;
+            {
+                PeriodicTask skipping("Skipping", 1h, [&skippingRunCount] { ++skippingRunCount; }, PeriodicTask::OnStop::Skip, clock);
+                PeriodicTask running("Running", 1h, [&runningRunCount] { ++runningRunCount; }, PeriodicTask::OnStop::Run, clock);
+                Assert::IsTrue(clock.WaitForWaiters(2, 5s));
+            }
+            Assert::AreEqual(size_t{0}, skippingRunCount.load());
+            Assert::AreEqual(size_t{1}, runningRunCount.load());
+        }
+
+        TEST_METHOD(FailedRunDoesNotStopTheTaskTest)
+        {
+            ManualClock clock;
+            std::atomic<size_t> runCount = 0;
+            PeriodicTask task("Failing", 1min, [&runCount]
+                {
+                    if (++runCount == 1)
+                    {
+                        throw std::runtime_error("First run fails");
+                    }
+                }, PeriodicTask::OnStop::Skip, clock);
+
+            for (size_t run = 1; run <= 2; ++run)
+            {
+                Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+                clock.Advance(1min);
+            }
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            Assert::AreEqual(size_t{2}, runCount.load());
+        }
+    };
+}
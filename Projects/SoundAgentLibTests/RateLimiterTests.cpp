@@ -0,0 +1,345 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "Clock.h"
+#include "RateLimiter.h"
+#include "RateLimitingHttpRequestDispatcher.h"
+
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        class HintRecordingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string& hint
+            ) override
+            {
+                std::lock_guard lock(mutex_);
+                hints_.push_back(hint);
+            }
+
+            [[nodiscard]] std::vector<std::string> GetHints() const
+            {
+                std::lock_guard lock(mutex_);
+                return hints_;
+            }
+
+        private:
+            mutable std::mutex mutex_;
+            std::vector<std::string> hints_;
+        };
+
+        // In real time: the worker thread needs a moment to catch up with the manual clock
+        bool WaitUntil(const std::function<bool()>& condition, std::chrono::milliseconds timeout = 5s)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (!condition())
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(1ms);
+            }
+            return true;
+        }
+    }
+
+    TEST_CLASS(RateLimiterTests)
+    {
+        using Clock = TokenBucket::Clock;
+
+        TEST_METHOD(TokenBucketBurstAndRefillTest)
+        {
+            const Clock::time_point start{};
+            TokenBucket bucket(2.0, 3.0, start);
+
+            // full burst available at once
+            Assert::IsTrue(bucket.TryConsume(start));
+            Assert::IsTrue(bucket.TryConsume(start));
+            Assert::IsTrue(bucket.TryConsume(start));
+            Assert::IsFalse(bucket.TryConsume(start));
+
+            // 2 tokens per second: the next one after 500ms
+            Assert::IsTrue(bucket.TimeUntilAvailable(start) == 500ms);
+            Assert::IsFalse(bucket.TryConsume(start + 499ms));
+            Assert::IsTrue(bucket.TryConsume(start + 500ms));
+
+            // refill is capped by the capacity
+            Assert::IsTrue(bucket.GetAvailable(start + 1h) == 3.0);
+        }
+
+        TEST_METHOD(TokenBucketZeroRateNeverRefillsTest)
+        {
+            const Clock::time_point start{};
+            TokenBucket bucket(0.0, 1.0, start);
+
+            Assert::IsTrue(bucket.TryConsume(start));
+            Assert::IsFalse(bucket.TryConsume(start + 24h));
+            Assert::IsTrue(bucket.TimeUntilAvailable(start + 24h) == Clock::duration::max());
+        }
+
+        TEST_METHOD(LifecycleShareIsReservedTest)
+        {
+            const Clock::time_point start{};
+            PriorityRateLimiter limiter({.messagesPerSecond = 10.0, .burst = 10.0, .lifecycleSharePercent = 50}, start);
+
+            // low priority events exhaust the shared bucket only
+            size_t lowAcquired = 0;
+            while (limiter.TryAcquire(RatePriority::Low, start))
+            {
+                ++lowAcquired;
+            }
+            Assert::AreEqual(size_t{5}, lowAcquired);
+
+            // the reserved part is still there for lifecycle events
+            size_t lifecycleAcquired = 0;
+            while (limiter.TryAcquire(RatePriority::Lifecycle, start))
+            {
+                ++lifecycleAcquired;
+            }
+            Assert::AreEqual(size_t{5}, lifecycleAcquired);
+        }
+
+        TEST_METHOD(FullLifecycleShareLeavesRateForOthersTest)
+        {
+            const Clock::time_point start{};
+            PriorityRateLimiter limiter({.messagesPerSecond = 10.0, .burst = 10.0, .lifecycleSharePercent = 100}, start);
+
+            while (limiter.TryAcquire(RatePriority::Low, start))
+            {
+            }
+
+            // clamped to 90%: about 1 message/s left for the others
+            const auto wait = limiter.TimeUntilAvailable(RatePriority::Low, start);
+            Assert::IsTrue(wait < 2s);
+            Assert::IsTrue(limiter.TryAcquire(RatePriority::Low, start + wait));
+        }
+
+        TEST_METHOD(UnlimitedWhenNoRateConfiguredTest)
+        {
+            const Clock::time_point start{};
+            PriorityRateLimiter limiter({}, start);
+
+            Assert::IsTrue(limiter.IsUnlimited());
+            for (int i = 0; i < 10000; ++i)
+            {
+                Assert::IsTrue(limiter.TryAcquire(RatePriority::Low, start));
+            }
+        }
+
+        // Simulates a patch-day reboot of a fleet: all agents come up within a few seconds
+        // and send a Confirmed message per device. Compares the backend peak load (messages per second)
+        // with and without startup jitter and agent-side rate limiting.
+        TEST_METHOD(FleetStartupPeakLoadSimulation)
+        {
+            constexpr size_t agentCount = 5000;
+            constexpr size_t devicesPerAgent = 6;
+            constexpr auto bootSpread = 5s;
+
+            const auto peakWithoutJitter = SimulatePeakMessagesPerSecond(agentCount, devicesPerAgent, bootSpread, 0s, {});
+            const auto peakWithJitter = SimulatePeakMessagesPerSecond(agentCount, devicesPerAgent, bootSpread, 60s,
+                {.messagesPerSecond = 2.0, .burst = 2.0, .lifecycleSharePercent = 50});
+
+            Logger::WriteMessage(std::format(
+                "{} agents x {} devices, boot spread {}: backend peak {} msg/s without jitter, {} msg/s with 60s jitter and 2 msg/s per agent.",
+                agentCount, devicesPerAgent, bootSpread, peakWithoutJitter, peakWithJitter).c_str());
+
+            Assert::IsTrue(peakWithJitter * 5 < peakWithoutJitter);
+        }
+
+        // The same reboot with startup jitter only, driven through the dispatchers the agents use:
+        // each agent holds its messages back until its startup delay elapsed and then sends them at once.
+        TEST_METHOD(FleetStartupJitterThroughDispatcherSimulation)
+        {
+            constexpr size_t agentCount = 500;
+            constexpr size_t devicesPerAgent = 6;
+            constexpr auto bootSpread = 5s;
+
+            const auto peakWithoutJitter = SimulateDispatcherPeakMessagesPerSecond(agentCount, devicesPerAgent, bootSpread, 0s);
+            const auto peakWithJitter = SimulateDispatcherPeakMessagesPerSecond(agentCount, devicesPerAgent, bootSpread, 60s);
+
+            Logger::WriteMessage(std::format(
+                "{} agents x {} devices, boot spread {}: backend peak {} msg/s without jitter, {} msg/s with 60s jitter only.",
+                agentCount, devicesPerAgent, bootSpread, peakWithoutJitter, peakWithJitter).c_str());
+
+            Assert::IsTrue(peakWithJitter * 4 < peakWithoutJitter);
+        }
+
+        TEST_METHOD(LifecycleRequestsOvertakeVolumeUpdatesTest)
+        {
+            ManualClock clock;
+            HintRecordingDispatcher target;
+            RateLimitingHttpRequestDispatcher dispatcher(target, {}, 1s, clock);
+            dispatcher.EnqueueRequest(false, clock.SystemNow(), "", "{}", {}, "PUT 0");
+            dispatcher.EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, "POST 0");
+            dispatcher.EnqueueRequest(false, clock.SystemNow(), "", "{}", {}, "PUT 1");
+            dispatcher.EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, "POST 1");
+            dispatcher.EnqueueRequest(false, clock.SystemNow(), "", "{}", {}, "PUT 2");
+
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            Assert::IsTrue(target.GetHints().empty(), L"Held back during the startup delay");
+            clock.Advance(1s);
+
+            // All the waiting lifecycle requests first, each queue in its order
+            Assert::IsTrue(WaitUntil([&target] { return target.GetHints().size() == 5; }));
+            Assert::IsTrue(std::vector<std::string>{"POST 0", "POST 1", "PUT 0", "PUT 1", "PUT 2"} == target.GetHints());
+        }
+
+        TEST_METHOD(FullLowPriorityQueueDropsOldestTest)
+        {
+            constexpr size_t overflowCount = 5;
+            constexpr auto queueSize = RateLimitingHttpRequestDispatcher::MAX_LOW_PRIORITY_QUEUE_SIZE;
+
+            ManualClock clock;
+            HintRecordingDispatcher target;
+            RateLimitingHttpRequestDispatcher dispatcher(target, {}, 1s, clock);
+            dispatcher.EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, "POST");
+            for (size_t i = 0; i < queueSize + overflowCount; ++i)
+            {
+                dispatcher.EnqueueRequest(false, clock.SystemNow(), "", "{}", {}, std::format("PUT {}", i));
+            }
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            clock.Advance(1s);
+
+            // The lifecycle request is never dropped; of the PUT requests the newest ones are kept
+            Assert::IsTrue(WaitUntil([&target, queueSize] { return target.GetHints().size() == queueSize + 1; }));
+            std::vector<std::string> expected{"POST"};
+            for (size_t i = overflowCount; i < queueSize + overflowCount; ++i)
+            {
+                expected.push_back(std::format("PUT {}", i));
+            }
+            Assert::IsTrue(expected == target.GetHints());
+        }
+
+        TEST_METHOD(BackgroundRequestsComeLastAndAreRefusedWhenFullTest)
+        {
+            constexpr auto queueSize = RateLimitingHttpRequestDispatcher::MAX_BACKGROUND_QUEUE_SIZE;
+
+            ManualClock clock;
+            HintRecordingDispatcher target;
+            RateLimitingHttpRequestDispatcher dispatcher(target, {}, 1s, clock);
+            auto& background = dispatcher.GetBackgroundDispatcher();
+            for (size_t i = 0; i < queueSize; ++i)
+            {
+                background.EnqueueRequest(false, clock.SystemNow(), "/logs/batch", "", {}, std::format("Log {}", i));
+            }
+            bool refused = false;
+            try
+            {
+                background.EnqueueRequest(false, clock.SystemNow(), "/logs/batch", "", {}, "Log refused");
+            }
+            catch (const std::runtime_error&)
+            {
+                refused = true;
+            }
+            Assert::IsTrue(refused, L"Kept by the caller instead of dropped");
+            dispatcher.EnqueueRequest(false, clock.SystemNow(), "", "{}", {}, "PUT");
+            dispatcher.EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, "POST");
+            Assert::IsTrue(clock.WaitForWaiters(1, 5s));
+            clock.Advance(1s);
+
+            Assert::IsTrue(WaitUntil([&target, queueSize] { return target.GetHints().size() == queueSize + 2; }));
+            std::vector<std::string> expected{"POST", "PUT"};
+            for (size_t i = 0; i < queueSize; ++i)
+            {
+                expected.push_back(std::format("Log {}", i));
+            }
+            Assert::IsTrue(expected == target.GetHints());
+        }
+
+    private:
+        static size_t SimulatePeakMessagesPerSecond(size_t agentCount, size_t devicesPerAgent,
+                                                    Clock::duration bootSpread, Clock::duration jitterMax,
+                                                    const RateLimitSettings& settings)
+        {
+            std::mt19937 randomGenerator(42); // NOLINT(cert-msc51-cpp): reproducible simulation
+            std::uniform_int_distribution<Clock::rep> bootDistribution(0, bootSpread.count());
+            std::uniform_int_distribution<Clock::rep> jitterDistribution(0, jitterMax.count());
+
+            std::vector<size_t> messagesPerSecond;
+            for (size_t agent = 0; agent < agentCount; ++agent)
+            {
+                auto now = Clock::time_point{} + Clock::duration(bootDistribution(randomGenerator))
+                    + Clock::duration(jitterDistribution(randomGenerator));
+                PriorityRateLimiter limiter(settings, now);
+                for (size_t device = 0; device < devicesPerAgent; ++device)
+                {
+                    while (!limiter.TryAcquire(RatePriority::Lifecycle, now))
+                    {
+                        now += limiter.TimeUntilAvailable(RatePriority::Lifecycle, now);
+                    }
+                    const auto second = static_cast<size_t>(std::chrono::floor<std::chrono::seconds>(now.time_since_epoch()).count());
+                    if (second >= messagesPerSecond.size())
+                    {
+                        messagesPerSecond.resize(second + 1);
+                    }
+                    ++messagesPerSecond[second];
+                }
+            }
+            return std::ranges::max(messagesPerSecond);
+        }
+
+        // The boot time is modeled as a part of the startup delay: all agents share one manual clock
+        static size_t SimulateDispatcherPeakMessagesPerSecond(size_t agentCount, size_t devicesPerAgent,
+                                                              std::chrono::milliseconds bootSpread,
+                                                              std::chrono::milliseconds jitterMax)
+        {
+            std::mt19937 randomGenerator(42); // NOLINT(cert-msc51-cpp): reproducible simulation
+            std::uniform_int_distribution<std::chrono::milliseconds::rep> bootDistribution(0, bootSpread.count());
+            std::uniform_int_distribution<std::chrono::milliseconds::rep> jitterDistribution(0, jitterMax.count());
+
+            ManualClock clock;
+            HintRecordingDispatcher backend;
+            std::vector<std::chrono::milliseconds> startupDelays;
+            std::vector<std::unique_ptr<RateLimitingHttpRequestDispatcher>> agents;
+            for (size_t agent = 0; agent < agentCount; ++agent)
+            {
+                const auto startupDelay = std::chrono::milliseconds(bootDistribution(randomGenerator))
+                    + std::chrono::milliseconds(jitterDistribution(randomGenerator));
+                startupDelays.push_back(startupDelay);
+                agents.push_back(std::make_unique<RateLimitingHttpRequestDispatcher>(backend, RateLimitSettings{}, startupDelay, clock));
+                for (size_t device = 0; device < devicesPerAgent; ++device)
+                {
+                    agents.back()->EnqueueRequest(true, clock.SystemNow(), "", "{}", {}, std::format("Confirmed {}/{}", agent, device));
+                }
+            }
+
+            std::vector<size_t> messagesPerSecond;
+            size_t sentCount = 0;
+            while (sentCount < agentCount * devicesPerAgent)
+            {
+                clock.Advance(1s);
+                const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(clock.GetElapsed());
+                const auto releasedCount = devicesPerAgent * static_cast<size_t>(std::ranges::count_if(startupDelays,
+                    [now](const auto& startupDelay) { return startupDelay <= now; }));
+                Assert::IsTrue(WaitUntil([&backend, releasedCount] { return backend.GetHints().size() == releasedCount; }),
+                               L"Each agent sends once its startup delay elapsed");
+                messagesPerSecond.push_back(releasedCount - sentCount);
+                sentCount = releasedCount;
+            }
+            return std::ranges::max(messagesPerSecond);
+        }
+    };
+}
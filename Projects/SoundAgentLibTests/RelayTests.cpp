@@ -0,0 +1,302 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "DeliveryReport.h"
+#include "RelayAggregator.h"
+#include "RelayClientHttpRequestDispatcher.h"
+#include "RelayServer.h"
+
+#include <format>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Net/StreamSocket.h>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        RelayMessage CreateMessage(const std::string& hostName, const std::string& deviceId, uint64_t sequence)
+        {
+            return {
+                .hostName = hostName,
+                .deviceId = deviceId,
+                .sequence = sequence,
+                .message = {
+                    .postOrPut = true, .time = std::chrono::system_clock::time_point{} + 1h, .urlSuffix = "",
+                    .payload = std::format(R"({{"pnpId":"{}","volume":{}}})", deviceId, sequence),
+                    .header = {{"Content-Type", "application/json"}}, .hint = "Post"
+                }
+            };
+        }
+
+        // Collects the batches forwarded by a relay
+        class BatchCollector final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                std::lock_guard lock(mutex_);
+                for (auto& message : RelayAggregator::ParseBatchPayload(payload))
+                {
+                    messages_.push_back(std::move(message));
+                }
+            }
+
+            [[nodiscard]] std::vector<RelayMessage> GetMessages() const
+            {
+                std::lock_guard lock(mutex_);
+                return messages_;
+            }
+
+        private:
+            mutable std::mutex mutex_;
+            std::vector<RelayMessage> messages_;
+        };
+
+        // The outcome of one request sent to the client
+        std::pair<bool, std::string> SendAndWait(RelayClientHttpRequestDispatcher& client, const RelayMessage& message)
+        {
+            auto outcome = std::make_shared<std::promise<std::pair<bool, std::string>>>();
+            auto future = outcome->get_future();
+            {
+                const DeliveryReport::Scope deliveryReport([outcome](bool delivered, const std::string& error)
+                    {
+                        outcome->set_value({delivered, error});
+                    });
+                client.EnqueueRequest(message.message.postOrPut, message.message.time, message.message.urlSuffix,
+                                      message.message.payload, message.message.header, message.message.hint);
+                Assert::IsTrue(deliveryReport.IsTaken(), L"Delivered by the client worker");
+            }
+            Assert::IsTrue(future.wait_for(20s) == std::future_status::ready, L"Outcome reported");
+            return future.get();
+        }
+
+        // An agent that never answers the challenge
+        Poco::Net::StreamSocket ConnectSilently(uint16_t port)
+        {
+            const Poco::Timespan timeout(std::chrono::duration_cast<std::chrono::microseconds>(5s).count());
+            Poco::Net::StreamSocket socket;
+            socket.connect(Poco::Net::SocketAddress("127.0.0.1", port), timeout);
+            socket.setReceiveTimeout(timeout);
+            return socket;
+        }
+
+        // Everything received until the relay closes the connection; throws Poco::TimeoutException if it does not
+        std::string ReceiveUntilClosed(Poco::Net::StreamSocket& socket)
+        {
+            std::string received;
+            char chunk[256];
+            for (auto count = socket.receiveBytes(chunk, sizeof(chunk)); count > 0; count = socket.receiveBytes(chunk, sizeof(chunk)))
+            {
+                received.append(chunk, static_cast<size_t>(count));
+            }
+            return received;
+        }
+    }
+
+    TEST_CLASS(RelayTests)
+    {
+        using Clock = RelayAggregator::Clock;
+
+        TEST_METHOD(NdjsonLineRoundTripTest)
+        {
+            auto message = CreateMessage("HOST-1", "{0.0.0.00000000}.{A}", 42);
+            message.message.payload = "line\nbreak and \"quotes\"";
+            const auto line = message.ToNdjsonLine();
+            Assert::AreEqual(size_t{1}, static_cast<size_t>(std::ranges::count(line, '\n')), L"One line per message");
+
+            const auto parsed = RelayMessage::FromNdjsonLine(line);
+            Assert::IsTrue(parsed.has_value());
+            Assert::AreEqual(message.hostName, parsed->hostName);
+            Assert::AreEqual(message.deviceId, parsed->deviceId);
+            Assert::AreEqual(message.sequence, parsed->sequence);
+            Assert::AreEqual(message.message.payload, parsed->message.payload);
+            Assert::IsTrue(message.message.time == parsed->message.time);
+            Assert::IsTrue(message.message.header == parsed->message.header);
+
+            Assert::IsFalse(RelayMessage::FromNdjsonLine("not json").has_value());
+            Assert::IsFalse(RelayMessage::FromNdjsonLine(R"({"hostName":"HOST-1"})").has_value());
+        }
+
+        TEST_METHOD(BinaryPayloadRoundTripTest)
+        {
+            // e.g. a gzip compressed log batch: not UTF-8
+            auto message = CreateMessage("HOST-1", "", 7);
+            message.message.urlSuffix = "/logs/batch";
+            message.message.payload = std::string("\x1F\x8B\x08\x00\xFF\xFE\x00\x80\xC3", 9);
+
+            const auto parsed = RelayMessage::FromNdjsonLine(message.ToNdjsonLine());
+            Assert::IsTrue(parsed.has_value());
+            Assert::IsTrue(message.message.payload == parsed->message.payload, L"Bytes kept in the line");
+
+            const auto batch = RelayAggregator::ParseBatchPayload(
+                RelayAggregator::CreateBatchPayload({CreateMessage("HOST-1", "A", 1), message}, "RELAY-1"));
+            Assert::AreEqual(size_t{2}, batch.size());
+            Assert::AreEqual(CreateMessage("HOST-1", "A", 1).message.payload, batch[0].message.payload);
+            Assert::IsTrue(message.message.payload == batch[1].message.payload, L"Bytes kept in the batch");
+        }
+
+        TEST_METHOD(DuplicatesAreDroppedPerHostAndDeviceTest)
+        {
+            const Clock::time_point start{};
+            RelayAggregator aggregator({.maxBatchCount = 100, .dedupWindow = 10min});
+
+            Assert::IsTrue(aggregator.Accept(CreateMessage("HOST-1", "A", 1), start));
+            Assert::IsTrue(aggregator.Accept(CreateMessage("HOST-1", "A", 2), start));
+            Assert::IsFalse(aggregator.Accept(CreateMessage("HOST-1", "A", 2), start), L"Re-sent after a reconnect");
+            Assert::IsFalse(aggregator.Accept(CreateMessage("HOST-1", "A", 1), start));
+            Assert::IsTrue(aggregator.Accept(CreateMessage("HOST-1", "B", 2), start), L"Other device");
+            Assert::IsTrue(aggregator.Accept(CreateMessage("HOST-2", "A", 2), start), L"Other host");
+            Assert::AreEqual(uint64_t{4}, aggregator.GetAcceptedCount());
+            Assert::AreEqual(uint64_t{2}, aggregator.GetDuplicateCount());
+            Assert::AreEqual(size_t{3}, aggregator.GetDedupKeyCount());
+
+            // forgotten after the window
+            std::ignore = aggregator.TakeBatches(start + 10min, true);
+            Assert::AreEqual(size_t{0}, aggregator.GetDedupKeyCount());
+        }
+
+        TEST_METHOD(BatchesCloseByCountSizeAndAgeTest)
+        {
+            const Clock::time_point start{};
+            RelayAggregator aggregator({.maxBatchCount = 3, .maxBatchBytes = 1000, .maxBatchDelay = 200ms});
+
+            for (uint64_t sequence = 1; sequence <= 7; ++sequence)
+            {
+                aggregator.Accept(CreateMessage("HOST-1", "A", sequence), start);
+            }
+            auto batches = aggregator.TakeBatches(start + 100ms);
+            Assert::AreEqual(size_t{2}, batches.size(), L"Closed by count");
+            Assert::AreEqual(size_t{1}, aggregator.GetPendingCount());
+
+            batches = aggregator.TakeBatches(start + 200ms);
+            Assert::AreEqual(size_t{1}, batches.size(), L"Closed by age");
+            Assert::AreEqual(size_t{0}, aggregator.GetPendingCount());
+
+            auto big = CreateMessage("HOST-1", "A", 8);
+            big.message.payload.assign(2000, 'x');
+            aggregator.Accept(std::move(big), start + 300ms);
+            Assert::AreEqual(size_t{1}, aggregator.TakeBatches(start + 300ms).size(), L"Closed by size");
+        }
+
+        TEST_METHOD(BatchPayloadRoundTripTest)
+        {
+            RelayAggregator::Batch batch;
+            for (uint64_t sequence = 1; sequence <= 50; ++sequence)
+            {
+                batch.push_back(CreateMessage(std::format("HOST-{}", sequence % 5), "A", sequence));
+            }
+            const auto payload = RelayAggregator::CreateBatchPayload(batch, "RELAY-1");
+            const auto parsed = RelayAggregator::ParseBatchPayload(payload);
+
+            Assert::AreEqual(batch.size(), parsed.size());
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                Assert::AreEqual(batch[i].hostName, parsed[i].hostName);
+                Assert::AreEqual(batch[i].sequence, parsed[i].sequence);
+                Assert::AreEqual(batch[i].message.payload, parsed[i].message.payload);
+            }
+        }
+
+        TEST_METHOD(RestartedAgentIsNotDroppedTest)
+        {
+            const Clock::time_point start{};
+            RelayAggregator aggregator({.maxBatchCount = 100, .dedupWindow = 10min});
+
+            auto beforeRestart = CreateMessage("HOST-1", "A", 5);
+            beforeRestart.epoch = 1;
+            Assert::IsTrue(aggregator.Accept(beforeRestart, start));
+
+            // the sequence starts over, whatever the clock of the agent did meanwhile
+            auto afterRestart = CreateMessage("HOST-1", "A", 1);
+            afterRestart.epoch = 2;
+            Assert::IsTrue(aggregator.Accept(afterRestart, start), L"New epoch");
+            Assert::IsFalse(aggregator.Accept(afterRestart, start), L"Re-sent within the epoch");
+
+            const auto parsed = RelayMessage::FromNdjsonLine(afterRestart.ToNdjsonLine());
+            Assert::IsTrue(parsed.has_value());
+            Assert::AreEqual(afterRestart.epoch, parsed->epoch);
+        }
+
+        TEST_METHOD(HandshakeTest)
+        {
+            const auto challenge = RelayHandshake::CreateChallenge();
+            Assert::AreNotEqual(challenge, RelayHandshake::CreateChallenge(), L"Random");
+            Assert::IsTrue(challenge.size() < RelayHandshake::MAX_LINE_SIZE);
+
+            const auto response = RelayHandshake::CreateResponse("secret", challenge);
+            Assert::IsTrue(response.find("secret") == std::string::npos, L"The secret is not sent");
+            Assert::IsTrue(response.size() < RelayHandshake::MAX_LINE_SIZE);
+            Assert::IsTrue(RelayHandshake::IsResponseValid("secret", challenge, response));
+            Assert::IsFalse(RelayHandshake::IsResponseValid("other secret", challenge, response));
+            Assert::IsFalse(RelayHandshake::IsResponseValid("secret", RelayHandshake::CreateChallenge(), response), L"Not replayable");
+            Assert::IsFalse(RelayHandshake::IsResponseValid("secret", challenge, ""));
+        }
+
+        TEST_METHOD(RelayServerAuthenticatesAgentsTest)
+        {
+            BatchCollector collector;
+            const RelayServer relayServer(collector, Poco::Net::SocketAddress("127.0.0.1", 0), "secret",
+                                          {.maxBatchDelay = 10ms}, "RELAY-1");
+
+            RelayClientHttpRequestDispatcher intruder("127.0.0.1", relayServer.GetPort(), "wrong secret", "HOST-0");
+            Assert::IsFalse(SendAndWait(intruder, CreateMessage("HOST-0", "A", 1)).first, L"Rejected");
+
+            RelayClientHttpRequestDispatcher agent("127.0.0.1", relayServer.GetPort(), "secret", "HOST-1");
+            const auto [delivered, error] = SendAndWait(agent, CreateMessage("HOST-1", "A", 1));
+            Assert::IsTrue(delivered, std::wstring(error.begin(), error.end()).c_str());
+
+            for (int i = 0; i < 500 && collector.GetMessages().empty(); ++i)
+            {
+                std::this_thread::sleep_for(10ms);
+            }
+            const auto messages = collector.GetMessages();
+            Assert::AreEqual(size_t{1}, messages.size(), L"Only the authenticated agent's message forwarded");
+            Assert::AreEqual(std::string("HOST-1"), messages.front().hostName);
+            Assert::AreEqual(std::string("A"), messages.front().deviceId);
+            Assert::AreEqual(uint64_t{1}, messages.front().sequence, L"Sequence starts at 1 per epoch");
+
+            Assert::ExpectException<std::invalid_argument>([&collector]
+                {
+                    const RelayServer withoutSecret(collector, Poco::Net::SocketAddress("127.0.0.1", 0), "", {}, "RELAY-1");
+                });
+        }
+
+        TEST_METHOD(RelayServerClosesPendingHandshakesTest)
+        {
+            BatchCollector collector;
+            const RelayServer relayServer(collector, Poco::Net::SocketAddress("127.0.0.1", 0), "secret",
+                                          {.maxBatchDelay = 10ms, .handshakeTimeout = 200ms, .maxPendingHandshakes = 1}, "RELAY-1");
+
+            auto silentAgent = ConnectSilently(relayServer.GetPort());
+            char challenge[RelayHandshake::MAX_LINE_SIZE];
+            Assert::IsTrue(silentAgent.receiveBytes(challenge, sizeof(challenge)) > 0, L"Challenged");
+
+            auto refusedAgent = ConnectSilently(relayServer.GetPort());
+            Assert::IsTrue(ReceiveUntilClosed(refusedAgent).empty(), L"Refused beyond the pending handshakes");
+
+            const auto start = std::chrono::steady_clock::now();
+            ReceiveUntilClosed(silentAgent);
+            Assert::IsTrue(std::chrono::steady_clock::now() - start < 3s, L"Closed after the handshake timeout");
+
+            RelayClientHttpRequestDispatcher agent("127.0.0.1", relayServer.GetPort(), "secret", "HOST-1");
+            const auto [delivered, error] = SendAndWait(agent, CreateMessage("HOST-1", "A", 1));
+            Assert::IsTrue(delivered, std::wstring(error.begin(), error.end()).c_str());
+        }
+    };
+}
@@ -0,0 +1,179 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "RetryScheduler.h"
+#include "TimerWheel.h"
+
+#include <format>
+#include <optional>
+#include <vector>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    TEST_CLASS(RetrySchedulerTests)
+    {
+        using Clock = TimerWheel::Clock;
+
+        TEST_METHOD(TimerWheelScheduleCancelAdvanceTest)
+        {
+            const Clock::time_point start{};
+            TimerWheel wheel(10ms, 8, start);
+
+            const auto soon = wheel.Schedule(start + 25ms);
+            const auto cancelled = wheel.Schedule(start + 40ms);
+            const auto afterTwoRounds = wheel.Schedule(start + 200ms); // same slot as soon, two revolutions later
+            Assert::AreEqual(size_t{3}, wheel.GetSize());
+            Assert::IsTrue(wheel.Cancel(cancelled));
+            Assert::IsFalse(wheel.Cancel(cancelled));
+
+            Assert::IsTrue(wheel.Advance(start + 29ms).empty(), L"Fires on the first tick at or after due");
+            Assert::IsTrue(std::vector{soon} == wheel.Advance(start + 30ms));
+            Assert::IsTrue(wheel.Advance(start + 199ms).empty());
+            Assert::IsTrue(std::vector{afterTwoRounds} == wheel.Advance(start + 1h));
+            Assert::AreEqual(size_t{0}, wheel.GetSize());
+
+            // a due time in the past fires on the next tick
+            const auto overdue = wheel.Schedule(start);
+            Assert::IsTrue(std::vector{overdue} == wheel.Advance(start + 1h + 10ms));
+        }
+
+        TEST_METHOD(BackoffIsCappedWithFullJitterTest)
+        {
+            const BackoffSettings settings{.initialDelay = 1s, .maxDelay = 60s, .maxAttempts = 100};
+            std::mt19937 randomGenerator(42); // NOLINT(cert-msc51-cpp): reproducible test
+
+            for (unsigned retry = 1; retry < 40; ++retry)
+            {
+                const auto ceiling = std::min<std::chrono::milliseconds>(settings.maxDelay, settings.initialDelay * (1LL << std::min(retry - 1, 20u)));
+                std::chrono::milliseconds longest{0};
+                for (int sample = 0; sample < 200; ++sample)
+                {
+                    const auto delay = GetBackoffDelay(settings, retry, randomGenerator);
+                    Assert::IsTrue(delay >= 0ms && delay <= ceiling);
+                    longest = std::max(longest, delay);
+                }
+                Assert::IsTrue(longest * 10 > ceiling * 9, L"Full jitter spreads over the whole range");
+            }
+        }
+
+        TEST_METHOD(CircuitBreakerStatesTest)
+        {
+            const Clock::time_point start{};
+            CircuitBreaker breaker({.failureThreshold = 3, .openDuration = 1min});
+
+            breaker.OnFailure(start);
+            breaker.OnFailure(start);
+            Assert::IsTrue(breaker.AllowRequest(start));
+            breaker.OnFailure(start);
+            Assert::IsTrue(breaker.GetState() == CircuitBreaker::State::Open);
+            Assert::IsFalse(breaker.AllowRequest(start + 59s));
+
+            Assert::IsTrue(breaker.AllowRequest(start + 1min), L"Trial request after the open duration");
+            Assert::IsTrue(breaker.GetState() == CircuitBreaker::State::HalfOpen);
+            Assert::IsFalse(breaker.AllowRequest(start + 1min), L"One trial request only");
+            breaker.OnFailure(start + 1min);
+            Assert::IsTrue(breaker.GetState() == CircuitBreaker::State::Open, L"Failed trial opens again");
+
+            Assert::IsTrue(breaker.AllowRequest(start + 2min));
+            breaker.OnSuccess();
+            Assert::IsTrue(breaker.GetState() == CircuitBreaker::State::Closed);
+        }
+
+        // A sink is down for two hours; the clock is virtual, so the whole outage runs in milliseconds.
+        TEST_METHOD(OutageRecoveryOnVirtualClockTest)
+        {
+            constexpr size_t messageCount = 100;
+            const Clock::time_point start{};
+            const auto outageEnd = start + 2h;
+            auto now = start;
+
+            uint64_t attemptsDuringOutage = 0;
+            RetryScheduler scheduler("test",
+                [&now, &outageEnd, &attemptsDuringOutage](const OutgoingMessage&, RetryScheduler::DeliveryId)
+                {
+                    if (now < outageEnd)
+                    {
+                        ++attemptsDuringOutage;
+                        throw std::runtime_error("broker unreachable");
+                    }
+                    return true;
+                },
+                {.backoff = {.initialDelay = 1s, .maxDelay = 5min, .maxAttempts = 50},
+                 .circuitBreaker = {.failureThreshold = 5, .openDuration = 1min}},
+                start, 42);
+
+            for (size_t i = 0; i < messageCount; ++i)
+            {
+                scheduler.Submit({.hint = std::to_string(i)}, now);
+                now += 1s;
+            }
+
+            std::optional<Clock::time_point> allDelivered;
+            const auto realStart = std::chrono::steady_clock::now();
+            for (; now < start + 3h && !allDelivered; now += RetryScheduler::TICK_DURATION)
+            {
+                scheduler.Advance(now);
+                if (scheduler.GetDeliveredCount() == messageCount)
+                {
+                    allDelivered = now;
+                }
+            }
+            const auto realElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - realStart);
+
+            Assert::IsTrue(allDelivered.has_value());
+            Logger::WriteMessage(std::format(
+                "{} messages, 2h outage: {} attempts during the outage, all delivered {} after recovery, simulated in {}.",
+                messageCount, attemptsDuringOutage,
+                std::chrono::duration_cast<std::chrono::seconds>(*allDelivered - outageEnd), realElapsed).c_str());
+
+            Assert::AreEqual(uint64_t{0}, scheduler.GetDroppedCount());
+            Assert::AreEqual(size_t{0}, scheduler.GetPendingCount());
+            // the circuit breaker lets a single trial through per open period instead of every message retrying
+            Assert::IsTrue(attemptsDuringOutage < 2 * messageCount);
+            Assert::IsTrue(*allDelivered - outageEnd <= 1min + RetryScheduler::TICK_DURATION);
+        }
+
+        // A sink writing from an own thread reports the outcome after the send returned
+        TEST_METHOD(ReportedFailureIsRetriedTest)
+        {
+            const Clock::time_point start{};
+            std::vector<RetryScheduler::DeliveryId> sent;
+            RetryScheduler scheduler("test",
+                [&sent](const OutgoingMessage&, RetryScheduler::DeliveryId deliveryId)
+                {
+                    sent.push_back(deliveryId);
+                    return false;
+                },
+                {.backoff = {.initialDelay = 1s, .maxDelay = 1s, .maxAttempts = 2},
+                 .circuitBreaker = {.failureThreshold = 0}},
+                start, 42);
+
+            scheduler.Submit({.hint = "first"}, start);
+            scheduler.Submit({.hint = "second"}, start);
+            Assert::AreEqual(size_t{2}, sent.size());
+            Assert::AreEqual(size_t{2}, scheduler.GetInFlightCount());
+            Assert::AreEqual(uint64_t{0}, scheduler.GetDeliveredCount(), L"Not delivered before reported");
+
+            scheduler.OnDeliveryResult(sent[0], true, "", start);
+            scheduler.OnDeliveryResult(sent[1], false, "disk full", start);
+            scheduler.OnDeliveryResult(sent[1], true, "", start); // reported twice: ignored
+            Assert::AreEqual(uint64_t{1}, scheduler.GetDeliveredCount());
+            Assert::AreEqual(uint64_t{1}, scheduler.GetFailedCount());
+            Assert::AreEqual(size_t{1}, scheduler.GetPendingCount());
+            Assert::AreEqual(size_t{0}, scheduler.GetInFlightCount());
+
+            scheduler.Advance(start + 1s + RetryScheduler::TICK_DURATION);
+            Assert::AreEqual(size_t{3}, sent.size(), L"The failed one is sent again");
+            Assert::AreEqual(uint64_t{1}, scheduler.GetRetryCount());
+
+            scheduler.OnDeliveryResult(sent[2], false, "disk full", start + 2s);
+            Assert::AreEqual(uint64_t{1}, scheduler.GetDroppedCount(), L"Dropped after the last attempt");
+            Assert::AreEqual(size_t{0}, scheduler.GetPendingCount());
+        }
+    };
+}
@@ -0,0 +1,210 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/AudioDeviceApiClient.h"
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "SentDeviceStateCache.h"
+#include "SoundDevice.h"
+
+#include <filesystem>
+#include <format>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class ByteCountingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string& urlSuffix, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>& header, const std::string&
+            ) override
+            {
+                bytes += urlSuffix.size() + payload.size();
+                for (const auto& [key, value] : header)
+                {
+                    bytes += key.size() + value.size();
+                }
+                ++messages;
+            }
+
+            size_t bytes = 0;
+            size_t messages = 0;
+        };
+
+        std::string TestHostName()
+        {
+            return "DESKTOP-4F7T2QK";
+        }
+
+        std::string TestOperationSystemName()
+        {
+            return "Windows 11 Enterprise 23H2 Build 22631.4317";
+        }
+    }
+
+    TEST_CLASS(SentDeviceStateCacheTests)
+    {
+        static std::filesystem::path TestStatePathName()
+        {
+            return std::filesystem::temp_directory_path() / "SentDeviceStateCacheTests.sent-state.json";
+        }
+
+        TEST_METHOD(ClassifyTest)
+        {
+            const auto start = std::chrono::system_clock::now();
+            SentDeviceStateCache cache(TestStatePathName(), 24h);
+
+            SoundDevice device("PNP-01", "Speakers", SoundDeviceFlowType::Render, 500, 0, true, false);
+            auto decision = cache.Classify(device, start);
+            Assert::IsTrue(decision.kind == SentDeviceStateCache::SendKind::Full, L"Never sent device must be sent full");
+
+            cache.MarkSent(device, true, start);
+            decision = cache.Classify(device, start + 1h);
+            Assert::IsTrue(decision.kind == SentDeviceStateCache::SendKind::Nothing, L"Unchanged device must not be sent");
+
+            device.SetCurrentRenderVolume(650);
+            device.SetRenderCurrentlyDefault(false);
+            decision = cache.Classify(device, start + 1h);
+            Assert::IsTrue(decision.kind == SentDeviceStateCache::SendKind::Delta);
+            Assert::AreEqual(static_cast<int>(SentDeviceStateCache::RenderVolumeField | SentDeviceStateCache::RenderDefaultField),
+                             static_cast<int>(decision.changedFields));
+
+            // a volume sent by a volume change message is not part of the next delta
+            cache.MarkVolumeSent("PNP-01", true, 650);
+            decision = cache.Classify(device, start + 1h);
+            Assert::AreEqual(static_cast<int>(SentDeviceStateCache::RenderDefaultField), static_cast<int>(decision.changedFields));
+
+            cache.MarkSent(device, false, start + 1h);
+            decision = cache.Classify(device, start + 24h);
+            Assert::IsTrue(decision.kind == SentDeviceStateCache::SendKind::Full, L"Checkpoint interval elapsed: full record expected");
+        }
+
+        TEST_METHOD(PersistenceTest)
+        {
+            const auto start = std::chrono::system_clock::now();
+            const SoundDevice device("PNP-02", "Headset/Headset Microphone", SoundDeviceFlowType::RenderAndCapture, 300, 800, false, true);
+            {
+                SentDeviceStateCache cache(TestStatePathName(), 24h);
+                cache.MarkSent(device, true, start);
+                Assert::IsTrue(cache.SaveIfModified());
+            }
+
+            SentDeviceStateCache restartedCache(TestStatePathName(), 24h);
+            Assert::IsTrue(restartedCache.Load());
+            Assert::IsTrue(restartedCache.Classify(device, start + 1min).kind == SentDeviceStateCache::SendKind::Nothing,
+                           L"Device sent before the restart must not be re-sent");
+
+            std::filesystem::remove(TestStatePathName());
+        }
+
+        TEST_METHOD(DeltaPayloadContainsChangedFieldsOnlyTest)
+        {
+            const SoundDevice device("PNP-03", "Speakers", SoundDeviceFlowType::Render, 420, 0, true, false);
+            const auto payload = SentDeviceStateCache::CreateDeltaPayload(device, SentDeviceStateCache::RenderVolumeField,
+                                                                          SoundDeviceEventType::Discovered, TestHostName(),
+                                                                          std::chrono::system_clock::now());
+
+            Assert::IsTrue(payload.find("\"renderVolume\":420") != std::string::npos);
+            Assert::IsTrue(payload.find("Speakers") == std::string::npos);
+            Assert::IsTrue(payload.find("captureVolume") == std::string::npos);
+        }
+
+        // Replays one day of a docked laptop: 3 service starts, re-plugging USB and Bluetooth headsets,
+        // volume drags and default device switches. Reports bytes per hour with full records only
+        // against last-sent-state deltas.
+        TEST_METHOD(BytesPerHourOnReplayedDayTest)
+        {
+            ByteCountingDispatcher fullDispatcher;
+            ByteCountingDispatcher deltaDispatcher;
+            const AudioDeviceApiClient fullApiClient(fullDispatcher, TestHostName, TestOperationSystemName);
+            const AudioDeviceApiClient deltaApiClient(deltaDispatcher, TestHostName, TestOperationSystemName);
+            SentDeviceStateCache cache(TestStatePathName(), 24h);
+
+            std::vector<SoundDevice> devices{
+                {"8D3E7B8C-3C0F-4E1A-9E51-6B0E3F4A2C11", "Speakers (Realtek(R) Audio)", SoundDeviceFlowType::Render, 400, 0, true, false},
+                {"1C5A9F20-77B4-4B4C-8A0E-2D6F1E9B3A52", "Microphone Array (Realtek(R) Audio)", SoundDeviceFlowType::Capture, 0, 700, false, true},
+                {"F2B6C1D4-9A3E-4F7B-B0C8-5E1D2A3B4C63", "Headset Earphone (Jabra Evolve2 65)/Headset Microphone (Jabra Evolve2 65)", SoundDeviceFlowType::RenderAndCapture, 600, 800, false, false},
+                {"0A1B2C3D-4E5F-6A7B-8C9D-0E1F2A3B4C74", "DELL U2723QE (NVIDIA High Definition Audio)", SoundDeviceFlowType::Render, 1000, 0, false, false},
+                {"9E8D7C6B-5A4F-3E2D-1C0B-A9F8E7D6C585", "Headphones (WH-1000XM4)", SoundDeviceFlowType::Render, 350, 0, false, false}
+            };
+
+            const auto postDevice = [&](SoundDeviceEventType type, const SoundDevice& device, std::chrono::system_clock::time_point now)
+            {
+                fullApiClient.PostDeviceToApi(type, &device, "");
+                switch (const auto [kind, changedFields] = cache.Classify(device, now); kind)
+                {
+                case SentDeviceStateCache::SendKind::Nothing:
+                    break;
+                case SentDeviceStateCache::SendKind::Delta:
+                    deltaDispatcher.EnqueueRequest(true, now, "/delta",
+                        SentDeviceStateCache::CreateDeltaPayload(device, changedFields, type, TestHostName(), now),
+                        {{"Content-Type", "application/json"}}, "");
+                    cache.MarkSent(device, false, now);
+                    break;
+                case SentDeviceStateCache::SendKind::Full:
+                    deltaApiClient.PostDeviceToApi(type, &device, "");
+                    cache.MarkSent(device, true, now);
+                    break;
+                }
+            };
+            const auto putVolume = [&](SoundDevice& device, uint16_t volume, std::chrono::system_clock::time_point now)
+            {
+                device.SetCurrentRenderVolume(volume);
+                fullApiClient.PutVolumeChangeToApi(device.GetPnpId(), true, volume, "");
+                deltaApiClient.PutVolumeChangeToApi(device.GetPnpId(), true, volume, "");
+                cache.MarkVolumeSent(device.GetPnpId(), true, volume);
+            };
+
+            constexpr auto replayedPeriod = 24h;
+            const auto start = std::chrono::system_clock::now();
+            for (auto offset = 0min; offset < replayedPeriod; offset += 5min)
+            {
+                const auto now = start + offset;
+                if (offset % 8h == 0min) // service (re)start
+                {
+                    for (const auto& device : devices)
+                    {
+                        postDevice(SoundDeviceEventType::Confirmed, device, now);
+                    }
+                }
+                if (offset % 45min == 0min) // USB headset re-plugged at the dock
+                {
+                    postDevice(SoundDeviceEventType::Discovered, devices[2], now);
+                }
+                if (offset % 30min == 15min) // Bluetooth headphones reconnect
+                {
+                    postDevice(SoundDeviceEventType::Discovered, devices[4], now);
+                }
+                if (offset % 2h == 1h) // default switches between speakers and headset
+                {
+                    devices[0].SetRenderCurrentlyDefault(!devices[0].IsRenderCurrentlyDefault());
+                    devices[2].SetRenderCurrentlyDefault(!devices[2].IsRenderCurrentlyDefault());
+                }
+                if (offset % 20min == 10min) // volume drag on speakers: a handful of notifications
+                {
+                    for (uint16_t step = 0; step < 4; ++step)
+                    {
+                        putVolume(devices[0], static_cast<uint16_t>(300 + (offset / 20min % 5) * 100 + step * 10), now);
+                    }
+                }
+            }
+
+            const auto hours = std::chrono::duration_cast<std::chrono::hours>(replayedPeriod).count();
+            Logger::WriteMessage(std::format(
+                "Full records: {} messages, {} bytes/h. Last-sent-state deltas: {} messages, {} bytes/h.",
+                fullDispatcher.messages, fullDispatcher.bytes / hours,
+                deltaDispatcher.messages, deltaDispatcher.bytes / hours).c_str());
+
+            Assert::IsTrue(deltaDispatcher.bytes < fullDispatcher.bytes);
+            std::filesystem::remove(TestStatePathName());
+        }
+    };
+}
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/AudioDeviceApiClient.h"
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "SessionEnvelopeHttpRequestDispatcher.h"
+#include "SoundDevice.h"
+
+#include <format>
+
+#include <nlohmann/json.hpp>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::audio
+{
+    namespace
+    {
+        class RecordingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            struct Request
+            {
+                std::string urlSuffix;
+                std::string payload;
+            };
+
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string& urlSuffix, const std::string& payload,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                requests.push_back({urlSuffix, payload});
+                bytes += urlSuffix.size() + payload.size();
+            }
+
+            std::vector<Request> requests;
+            size_t bytes = 0;
+        };
+
+        std::string operationSystemName = "Windows 11 Enterprise 23H2 Build 22631.4317";
+
+        std::string TestHostName()
+        {
+            return "DESKTOP-4F7T2QK";
+        }
+
+        std::string TestOperationSystemName()
+        {
+            return operationSystemName;
+        }
+
+        const SoundDevice& TestDevice()
+        {
+            static const SoundDevice device("F2B6C1D4-9A3E-4F7B-B0C8-5E1D2A3B4C63", "Speakers (Realtek(R) Audio)",
+                                            SoundDeviceFlowType::Render, 400, 0, true, false);
+            return device;
+        }
+    }
+
+    TEST_CLASS(SessionEnvelopeTests)
+    {
+        TEST_METHOD(HelloPrecedesSessionMessagesTest)
+        {
+            RecordingDispatcher target;
+            SessionEnvelopeHttpRequestDispatcher dispatcher(target, 1h);
+            const AudioDeviceApiClient apiClient(dispatcher, TestHostName, TestOperationSystemName);
+
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Discovered, &TestDevice(), "");
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &TestDevice(), "");
+
+            Assert::AreEqual(size_t{3}, target.requests.size());
+            Assert::AreEqual(std::string(SessionEnvelopeHttpRequestDispatcher::SESSION_HELLO_URL_SUFFIX), target.requests[0].urlSuffix);
+            const auto hello = nlohmann::json::parse(target.requests[0].payload);
+            Assert::AreEqual(TestHostName(), hello.at("hostName").get<std::string>());
+            Assert::AreEqual(dispatcher.GetSessionId(), hello.at("sessionId").get<std::string>());
+
+            for (size_t i = 1; i < target.requests.size(); ++i)
+            {
+                const auto message = nlohmann::json::parse(target.requests[i].payload);
+                Assert::AreEqual(dispatcher.GetSessionId(), message.at("sessionId").get<std::string>());
+                Assert::IsFalse(message.contains("hostName"));
+                Assert::IsFalse(message.contains("operationSystemName"));
+                Assert::AreEqual(TestDevice().GetPnpId(), message.at("pnpId").get<std::string>());
+            }
+        }
+
+        TEST_METHOD(NewSessionOnChangeAndRenewTest)
+        {
+            RecordingDispatcher target;
+            SessionEnvelopeHttpRequestDispatcher dispatcher(target, 1h);
+            const AudioDeviceApiClient apiClient(dispatcher, TestHostName, TestOperationSystemName);
+
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &TestDevice(), "");
+            const auto firstSessionId = dispatcher.GetSessionId();
+
+            const auto savedOperationSystemName = operationSystemName;
+            operationSystemName = "Windows 11 Enterprise 24H2 Build 26100.2033"; // updated in place
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &TestDevice(), "");
+            const auto secondSessionId = dispatcher.GetSessionId();
+            Assert::IsTrue(firstSessionId != secondSessionId);
+            Assert::AreEqual(size_t{4}, target.requests.size(), L"A hello per session");
+
+            dispatcher.RenewSession(); // e.g. reconnected
+            apiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &TestDevice(), "");
+            Assert::IsTrue(secondSessionId != dispatcher.GetSessionId());
+            operationSystemName = savedOperationSystemName;
+            Assert::AreEqual(size_t{6}, target.requests.size());
+        }
+
+        TEST_METHOD(PayloadWithoutHostMetadataIsUntouchedTest)
+        {
+            RecordingDispatcher target;
+            SessionEnvelopeHttpRequestDispatcher dispatcher(target, 1h);
+
+            dispatcher.EnqueueRequest(false, std::chrono::system_clock::now(), "/x", R"({"volume":5})", {}, "");
+            dispatcher.EnqueueRequest(false, std::chrono::system_clock::now(), "/x", "not json", {}, "");
+
+            Assert::AreEqual(size_t{2}, target.requests.size());
+            Assert::AreEqual(std::string(R"({"volume":5})"), target.requests[0].payload);
+            Assert::AreEqual(std::string("not json"), target.requests[1].payload);
+        }
+
+        // Bytes of 200 device messages with the host metadata in every message against one hello per session
+        TEST_METHOD(PerMessageByteSavingsTest)
+        {
+            constexpr size_t messageCount = 200;
+            RecordingDispatcher plainTarget;
+            RecordingDispatcher sessionTarget;
+            SessionEnvelopeHttpRequestDispatcher dispatcher(sessionTarget, 1h);
+            const AudioDeviceApiClient plainApiClient(plainTarget, TestHostName, TestOperationSystemName);
+            const AudioDeviceApiClient sessionApiClient(dispatcher, TestHostName, TestOperationSystemName);
+
+            for (size_t i = 0; i < messageCount; ++i)
+            {
+                plainApiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &TestDevice(), "");
+                sessionApiClient.PostDeviceToApi(SoundDeviceEventType::Confirmed, &TestDevice(), "");
+            }
+
+            const auto plainPerMessage = static_cast<double>(plainTarget.bytes) / messageCount;
+            const auto sessionPerMessage = static_cast<double>(sessionTarget.bytes) / messageCount;
+            Logger::WriteMessage(std::format(
+                "{} device messages: {:.1f} bytes/message with host metadata, {:.1f} bytes/message with session id (hello included), {:.1f}% saved.",
+                messageCount, plainPerMessage, sessionPerMessage, 100.0 * (plainPerMessage - sessionPerMessage) / plainPerMessage).c_str());
+            Assert::IsTrue(sessionPerMessage < plainPerMessage);
+        }
+    };
+}
@@ -0,0 +1,286 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "DeliveryReport.h"
+#include "FanOutHttpRequestDispatcher.h"
+#include "NdjsonHttpRequestDispatchers.h"
+#include "QueuedHttpRequestDispatcher.h"
+
+#include <atomic>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        class CountingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            explicit CountingDispatcher(std::chrono::milliseconds delay = 0ms)
+                : delay_(delay)
+            {
+            }
+
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string& hint
+            ) override
+            {
+                std::this_thread::sleep_for(delay_);
+                std::lock_guard lock(mutex);
+                hints.push_back(hint);
+                count = hints.size();
+            }
+
+            std::atomic<size_t> count = 0;
+            std::mutex mutex;
+            std::vector<std::string> hints;
+
+        private:
+            const std::chrono::milliseconds delay_;
+        };
+
+        // Takes the delivery report over and reports every request failed, like a sink with a broken disk
+        class ReportingFailureDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                if (const auto onDelivered = DeliveryReport::Take())
+                {
+                    onDelivered(false, "Disk full");
+                }
+            }
+        };
+
+        // Throws while isDown is set, like a sink that lost its connection
+        class FlakyDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>&, const std::string&
+            ) override
+            {
+                ++attemptCount;
+                if (isDown)
+                {
+                    throw std::runtime_error("Connection lost");
+                }
+            }
+
+            std::atomic<bool> isDown = false;
+            std::atomic<size_t> attemptCount = 0;
+        };
+
+        bool WaitUntil(const std::function<bool()>& condition, std::chrono::milliseconds timeout)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (!condition())
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(1ms);
+            }
+            return true;
+        }
+    }
+
+    TEST_CLASS(SinkPipelineTests)
+    {
+        TEST_METHOD(SlowSinkDoesNotStallOthersTest)
+        {
+            constexpr size_t requestCount = 50;
+            auto slowSink = std::make_unique<CountingDispatcher>(10ms);
+            auto fastSink = std::make_unique<CountingDispatcher>();
+            const auto& slow = *slowSink;
+            const auto& fast = *fastSink;
+
+            FanOutHttpRequestDispatcher dispatcher;
+            dispatcher.AddSink("slow", std::move(slowSink), PayloadEncoding::Json, requestCount);
+            dispatcher.AddSink("fast", std::move(fastSink), PayloadEncoding::Json, requestCount);
+            Assert::AreEqual(size_t{2}, dispatcher.GetSinkCount());
+
+            for (size_t i = 0; i < requestCount; ++i)
+            {
+                dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {}, std::to_string(i));
+            }
+
+            Assert::IsTrue(WaitUntil([&fast] { return fast.count == requestCount; }, 200ms), L"Fast sink must not wait for the slow one");
+            Assert::IsTrue(slow.count < requestCount);
+        }
+
+        TEST_METHOD(FullQueueDropsOldestTest)
+        {
+            std::mutex gate;
+            std::unique_lock gateLock(gate);
+
+            class BlockedDispatcher final : public HttpRequestDispatcherInterface
+            {
+            public:
+                BlockedDispatcher(std::mutex& gate, CountingDispatcher& target) : gate_(gate), target_(target) {}
+
+                void EnqueueRequest(bool postOrPut, const std::chrono::system_clock::time_point& time,
+                                    const std::string& urlSuffix, const std::string& payload,
+                                    const std::unordered_map<std::string, std::string>& header, const std::string& hint
+                ) override
+                {
+                    std::lock_guard lock(gate_);
+                    target_.EnqueueRequest(postOrPut, time, urlSuffix, payload, header, hint);
+                }
+
+            private:
+                std::mutex& gate_;
+                CountingDispatcher& target_;
+            };
+
+            CountingDispatcher received;
+            BlockedDispatcher blocked(gate, received);
+            {
+                QueuedHttpRequestDispatcher dispatcher(blocked, "blocked", 3);
+                for (int i = 0; i < 10; ++i)
+                {
+                    dispatcher.EnqueueRequest(false, std::chrono::system_clock::now(), "", "{}", {}, std::to_string(i));
+                }
+                Assert::IsTrue(dispatcher.GetDroppedCount() >= 6);
+                gateLock.unlock();
+            }
+
+            // at most one request was taken over before the queue filled up, the newest three are always there
+            Assert::IsTrue(received.hints.size() <= 4);
+            Assert::IsTrue(std::vector<std::string>{"7", "8", "9"}
+                == std::vector<std::string>(received.hints.end() - 3, received.hints.end()));
+        }
+
+        TEST_METHOD(FileSinkWritesNdjsonLinesTest)
+        {
+            const auto pathName = std::filesystem::temp_directory_path() / "SinkPipelineTests.ndjson";
+            std::filesystem::remove(pathName);
+
+            constexpr int requestCount = 500;
+            {
+                NdjsonFileHttpRequestDispatcher dispatcher(pathName, 50ms, 4096);
+                for (int i = 0; i < requestCount; ++i)
+                {
+                    dispatcher.EnqueueRequest(i % 2 == 0, std::chrono::system_clock::now(), "/volume",
+                                              std::format(R"({{"pnpId":"PNP-{}","volume":{}}})", i, i * 2),
+                                              {{"Content-Type", "application/json"}}, std::to_string(i));
+                }
+            }
+
+            std::ifstream stream(pathName);
+            int lineCount = 0;
+            for (std::string line; std::getline(stream, line); ++lineCount)
+            {
+                const auto json = nlohmann::json::parse(line);
+                Assert::AreEqual(std::format("PNP-{}", lineCount), json.at("payload").at("pnpId").get<std::string>());
+                Assert::AreEqual(std::string(lineCount % 2 == 0 ? "POST" : "PUT"), json.at("method").get<std::string>());
+            }
+            Assert::AreEqual(requestCount, lineCount);
+
+            stream.close();
+            std::filesystem::remove(pathName);
+        }
+
+        TEST_METHOD(FileSinkReportsDeliveryTest)
+        {
+            const auto pathName = std::filesystem::temp_directory_path() / "SinkPipelineTestsReport.ndjson";
+            std::filesystem::remove(pathName);
+
+            constexpr size_t requestCount = 10;
+            std::atomic<size_t> deliveredCount = 0;
+            {
+                NdjsonFileHttpRequestDispatcher dispatcher(pathName, 50ms, 4096);
+                for (size_t i = 0; i < requestCount; ++i)
+                {
+                    const DeliveryReport::Scope deliveryReport([&deliveredCount](bool delivered, const std::string&)
+                        {
+                            deliveredCount += delivered ? 1 : 0;
+                        });
+                    dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "/volume", "{}", {}, std::to_string(i));
+                    Assert::IsTrue(deliveryReport.IsTaken());
+                }
+                Assert::IsTrue(WaitUntil([&deliveredCount] { return deliveredCount == requestCount; }, 5s),
+                               L"Reported once the chunk is written");
+            }
+            std::filesystem::remove(pathName);
+        }
+
+        TEST_METHOD(ReportedFailuresAreCountedTest)
+        {
+            ReportingFailureDispatcher target;
+            QueuedHttpRequestDispatcher queue(target, "broken", 10);
+            for (int i = 0; i < 3; ++i)
+            {
+                queue.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {}, std::to_string(i));
+            }
+            Assert::IsTrue(WaitUntil([&queue] { return queue.GetFailedCount() == 3; }, 5s));
+        }
+
+        TEST_METHOD(SinkRecoveryIsReportedTest)
+        {
+            auto flakySink = std::make_unique<FlakyDispatcher>();
+            auto& flaky = *flakySink;
+            FanOutHttpRequestDispatcher dispatcher;
+            dispatcher.AddSink("flaky", std::move(flakySink), PayloadEncoding::Json, 10);
+
+            std::mutex mutex;
+            std::vector<std::string> recoveredSinks;
+            dispatcher.SetSinkRecoveredHandler([&mutex, &recoveredSinks](const std::string& sinkName)
+            {
+                std::lock_guard lock(mutex);
+                recoveredSinks.push_back(sinkName);
+            });
+
+            const auto send = [&dispatcher, &flaky](size_t attemptCount)
+            {
+                dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {}, "");
+                Assert::IsTrue(WaitUntil([&flaky, attemptCount] { return flaky.attemptCount == attemptCount; }, 5s));
+            };
+            send(1);
+            flaky.isDown = true;
+            send(2);
+            send(3);
+            flaky.isDown = false;
+            send(4);
+            send(5);
+
+            dispatcher.SetSinkRecoveredHandler(nullptr);
+            std::lock_guard lock(mutex);
+            Assert::IsTrue(std::vector<std::string>{"flaky"} == recoveredSinks, L"Once, on the first delivery after the failures");
+        }
+
+        TEST_METHOD(NonJsonPayloadIsWrittenAsBinaryTest)
+        {
+            std::ostringstream stream;
+            NdjsonStreamHttpRequestDispatcher dispatcher(stream);
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "\xA1\x61\x61\x01", {}, "");
+
+            const auto line = stream.str();
+            Assert::IsTrue(line.ends_with('\n'));
+            Assert::AreEqual(size_t{4}, nlohmann::json::parse(line).at("payload").at("bytes").size());
+        }
+    };
+}
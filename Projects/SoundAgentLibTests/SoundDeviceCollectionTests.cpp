@@ -2,12 +2,15 @@
 
 #include <cstdlib>
 
+#include <atomic>
 #include <queue>
+#include <thread>
 
 #include <CppUnitTest.h>
 
 #include "ApiClient/common/SpdLogger.h"
 
+#include "FakeAudioEndpoints.h"
 #include "SoundDeviceCollection.h"
 
 
@@ -16,7 +19,167 @@ using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 
 namespace ed::audio {
+    namespace
+    {
+        // A speaker and a headset, the render and capture endpoints of the headset share the PnP id
+        struct Desk
+        {
+            FakeEndpoints endpoints;
+            FakeEndpoint& speakers = endpoints.Add(L"{0.0.0.00000000}.{speakers}", "SPEAKERS-PNP", "Speakers", SoundDeviceFlowType::Render);
+            FakeEndpoint& headsetRender = endpoints.Add(L"{0.0.0.00000000}.{headset}", "HEADSET-PNP", "Headset Earphone", SoundDeviceFlowType::Render);
+            FakeEndpoint& headsetCapture = endpoints.Add(L"{0.0.1.00000000}.{headset}", "HEADSET-PNP", "Headset Microphone", SoundDeviceFlowType::Capture);
+        };
+
+        void Plug(SoundDeviceCollection& collection, FakeEndpoint& endpoint)
+        {
+            endpoint.active = true;
+            collection.OnDeviceAdded(endpoint.id.c_str());
+        }
+
+        void Unplug(SoundDeviceCollection& collection, FakeEndpoint& endpoint)
+        {
+            endpoint.active = false;
+            collection.OnDeviceRemoved(endpoint.id.c_str());
+        }
+
+        void Reactivate(SoundDeviceCollection& collection, const FakeEndpoint& endpoint)
+        {
+            collection.OnDeviceStateChanged(endpoint.id.c_str(), DEVICE_STATE_ACTIVE);
+        }
+
+        // nullptr: no endpoint left for the role
+        void SetDefault(SoundDeviceCollection& collection, FakeEndpoints& endpoints, EDataFlow flow, FakeEndpoint* endpoint)
+        {
+            endpoints.GetDefault(flow) = endpoint;
+            collection.OnDefaultDeviceChanged(flow, eConsole, endpoint != nullptr ? endpoint->id.c_str() : nullptr);
+        }
+    }
+
     TEST_CLASS(SoundDeviceCollectionTests) {
+        TEST_METHOD(RemovalReleasesEndpointVolumeTest)
+        {
+            Desk desk;
+            {
+                SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(desk.endpoints), nullptr);
+                Plug(collection, desk.speakers);
+                // added again on the state change that follows
+                Reactivate(collection, desk.speakers);
+                Assert::AreEqual(1L, desk.speakers.volumeEndpoint.GetRegistrationCount(), L"Registered once");
+
+                Unplug(collection, desk.speakers);
+                Assert::AreEqual(size_t{0}, collection.GetSize());
+                Assert::AreEqual(0L, desk.speakers.volumeEndpoint.GetRegistrationCount());
+                Assert::AreEqual(ULONG{0}, desk.speakers.volumeEndpoint.GetReferenceCount(), L"No reference left on removal");
+
+                Plug(collection, desk.headsetRender);
+            }
+            Assert::AreEqual(0L, desk.headsetRender.volumeEndpoint.GetRegistrationCount());
+            Assert::AreEqual(ULONG{0}, desk.headsetRender.volumeEndpoint.GetReferenceCount(), L"No reference left on destruction");
+        }
+
+        TEST_METHOD(EndpointAddedAgainKeepsDefaultTest)
+        {
+            Desk desk;
+            SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(desk.endpoints), nullptr);
+            Plug(collection, desk.headsetRender);
+            Plug(collection, desk.headsetCapture);
+            SetDefault(collection, desk.endpoints, eRender, &desk.headsetRender);
+            SetDefault(collection, desk.endpoints, eCapture, &desk.headsetCapture);
+
+            Reactivate(collection, desk.headsetRender);
+
+            const auto headset = collection.CreateItem(desk.headsetRender.pnpId);
+            Assert::IsTrue(headset->GetFlow() == SoundDeviceFlowType::RenderAndCapture);
+            Assert::IsTrue(headset->IsRenderCurrentlyDefault());
+            Assert::IsTrue(headset->IsCaptureCurrentlyDefault());
+            Assert::AreEqual(desk.headsetRender.pnpId, collection.GetDefaultRenderDevicePnpId().value_or(""));
+        }
+
+        TEST_METHOD(RemovedDefaultEndpointLeavesRoleUnassignedTest)
+        {
+            Desk desk;
+            SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(desk.endpoints), nullptr);
+            Plug(collection, desk.headsetRender);
+            Plug(collection, desk.headsetCapture);
+            SetDefault(collection, desk.endpoints, eRender, &desk.headsetRender);
+            SetDefault(collection, desk.endpoints, eCapture, &desk.headsetCapture);
+
+            Unplug(collection, desk.headsetCapture);
+            Assert::IsFalse(collection.GetDefaultCaptureDevicePnpId().has_value());
+            Assert::AreEqual(desk.headsetRender.pnpId, collection.GetDefaultRenderDevicePnpId().value_or(""), L"The render role stays");
+            Assert::IsFalse(collection.CreateItem(desk.headsetRender.pnpId)->IsCaptureCurrentlyDefault());
+
+            Unplug(collection, desk.headsetRender);
+            Assert::IsFalse(collection.GetDefaultRenderDevicePnpId().has_value());
+        }
+
+        TEST_METHOD(DefaultChangeToEndpointNotInCollectionTest)
+        {
+            Desk desk;
+            SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(desk.endpoints), nullptr);
+            Plug(collection, desk.headsetRender);
+            SetDefault(collection, desk.endpoints, eCapture, &desk.headsetCapture);
+
+            // The device of the PnP id has no capture endpoint in the collection
+            Assert::IsFalse(collection.GetDefaultCaptureDevicePnpId().has_value());
+            const auto headset = collection.CreateItem(desk.headsetRender.pnpId);
+            Assert::IsTrue(headset->GetFlow() == SoundDeviceFlowType::Render);
+            Assert::IsFalse(headset->IsCaptureCurrentlyDefault());
+        }
+
+        TEST_METHOD(CreateItemsUnderConcurrentRemovalTest)
+        {
+            Desk desk;
+            SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(desk.endpoints), nullptr);
+            Plug(collection, desk.speakers);
+            Plug(collection, desk.headsetRender);
+            Plug(collection, desk.headsetCapture);
+
+            const auto devices = collection.CreateItems();
+            Assert::AreEqual(size_t{2}, devices.size());
+            Assert::AreEqual(desk.headsetRender.pnpId, devices[0]->GetPnpId());
+            Assert::IsTrue(devices[0]->GetFlow() == SoundDeviceFlowType::RenderAndCapture);
+            Assert::AreEqual(desk.speakers.pnpId, devices[1]->GetPnpId());
+
+            // The speakers come and go while the devices are read, as the digest timer does
+            std::atomic<bool> stop = false;
+            std::thread churn([&]
+            {
+                while (!stop)
+                {
+                    Unplug(collection, desk.speakers);
+                    Plug(collection, desk.speakers);
+                }
+            });
+            size_t unexpectedSizes = 0;
+            for (int i = 0; i < 1000; ++i)
+            {
+                if (const auto size = collection.CreateItems().size(); size != 1 && size != 2)
+                {
+                    ++unexpectedSizes;
+                }
+            }
+            stop = true;
+            churn.join();
+            Assert::AreEqual(size_t{0}, unexpectedSizes);
+        }
+
+        TEST_METHOD(ResetForgetsPreviousDefaultsTest)
+        {
+            Desk desk;
+            SoundDeviceCollection collection(std::make_unique<FakeEndpointProvider>(desk.endpoints), nullptr);
+            Plug(collection, desk.speakers);
+            SetDefault(collection, desk.endpoints, eRender, &desk.speakers);
+            Assert::AreEqual(desk.speakers.pnpId, collection.GetDefaultRenderDevicePnpId().value_or(""));
+
+            desk.speakers.active = false;
+            desk.endpoints.GetDefault(eRender) = nullptr;
+            collection.ResetContent();
+
+            Assert::AreEqual(size_t{0}, collection.GetSize());
+            Assert::IsFalse(collection.GetDefaultRenderDevicePnpId().has_value());
+        }
+
 #if 0
 //#ifdef _DEBUG
 private:
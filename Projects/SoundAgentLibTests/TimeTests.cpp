@@ -8,6 +8,8 @@
 
 #include "ApiClient/common/TimeUtil.h"
 
+#include "TimestampFormatter.h"
+
 using namespace std::literals;
 using namespace std::chrono;
 using namespace std::literals::string_literals;
@@ -155,4 +157,42 @@ namespace ed::audio
         }
 
     };
+
+    TEST_CLASS(TimestampFormatterTests)
+    {
+        TEST_METHOD(SameTextAsTimeUtilTest)
+        {
+            // a year in steps of a bit more than a week: both daylight saving time switches, and every weekday
+            std::vector<system_clock::time_point> timePoints{ system_clock::time_point{ 54s }, floor<microseconds>(system_clock::now()) };
+            for (auto timePoint = sys_days{ 2025y / 1 / 1 } + 223709us; timePoint < sys_days{ 2026y / 1 / 1 }; timePoint += 193h + 17min + 1s + 4321us)
+            {
+                timePoints.push_back(timePoint);
+                timePoints.push_back(timePoint + 999999us); // the same second, the cached date and time
+            }
+
+            for (const auto insertT : { false, true })
+            {
+                for (const auto addTimeZone : { false, true })
+                {
+                    TimestampFormatter utcFormatter(TimestampFormatter::Zone::Utc, insertT, addTimeZone);
+                    TimestampFormatter localFormatter(TimestampFormatter::Zone::Local, insertT, addTimeZone);
+                    TimestampFormatter::Buffer buffer{};
+                    for (const auto& timePoint : timePoints)
+                    {
+                        Assert::AreEqual(TimePointToStringAsUtc(timePoint, insertT, addTimeZone), std::string(utcFormatter.Format(timePoint, buffer)));
+                        Assert::AreEqual(TimePointToStringAsLocal(timePoint, insertT, addTimeZone), std::string(localFormatter.Format(timePoint, buffer)));
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(SubMicrosecondsCutTest)
+        {
+            TimestampFormatter formatter(TimestampFormatter::Zone::Utc, false, true);
+            TimestampFormatter::Buffer buffer{};
+            const auto timePoint = sys_days{ 2025y / 5 / 29 } + 10h + 34min + 56s + 223709us;
+            Assert::AreEqual(std::string_view("2025-05-29 10:34:56.223709Z"), formatter.Format(timePoint + duration_cast<system_clock::duration>(999ns), buffer));
+            Assert::AreEqual(std::string_view("2025-05-29 10:34:57.000000Z"), formatter.Format(timePoint + 776291us, buffer));
+        }
+    };
 }
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/HttpRequestDispatcherInterface.h"
+
+#include "PipelineLatency.h"
+#include "TraceContextHttpRequestDispatcher.h"
+
+#include <chrono>
+#include <regex>
+#include <string>
+#include <unordered_map>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        class HeaderCapturingDispatcher final : public HttpRequestDispatcherInterface
+        {
+        public:
+            void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                                const std::string&, const std::string&,
+                                const std::unordered_map<std::string, std::string>& header, const std::string&
+            ) override
+            {
+                lastHeader = header;
+            }
+
+            std::unordered_map<std::string, std::string> lastHeader;
+        };
+
+        std::string GetHeader(const std::unordered_map<std::string, std::string>& header, const std::string& key)
+        {
+            const auto found = header.find(key);
+            return found != header.end() ? found->second : std::string();
+        }
+    }
+
+    TEST_CLASS(TraceContextTests)
+    {
+        TEST_METHOD(HeadersOnlyWithinScopeTest)
+        {
+            LatencyTrace::SetEnabled(true);
+            HeaderCapturingDispatcher target;
+            TraceContextHttpRequestDispatcher dispatcher(target);
+
+            dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {{"Content-Type", "application/json"}}, "");
+            Assert::AreEqual(size_t{1}, target.lastHeader.size(), L"No notification being processed");
+
+            const auto before = std::chrono::system_clock::now();
+            {
+                const LatencyTrace::Scope scope;
+                dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {{"Content-Type", "application/json"}}, "");
+            }
+            const auto after = std::chrono::system_clock::now();
+
+            Assert::AreEqual("application/json"s, GetHeader(target.lastHeader, "Content-Type"));
+            Assert::IsTrue(std::regex_match(GetHeader(target.lastHeader, TraceContextHttpRequestDispatcher::TRACE_PARENT_HEADER_KEY),
+                                            std::regex("00-[0-9a-f]{32}-[0-9a-f]{16}-01")));
+            const auto captureTime = std::chrono::system_clock::time_point(std::chrono::microseconds(
+                std::stoll(GetHeader(target.lastHeader, TraceContextHttpRequestDispatcher::CAPTURE_TIME_HEADER_KEY))));
+            Assert::IsTrue(captureTime >= std::chrono::floor<std::chrono::microseconds>(before) && captureTime <= after);
+            Assert::IsTrue(std::stoll(GetHeader(target.lastHeader, TraceContextHttpRequestDispatcher::CAPTURE_MONOTONIC_TIME_HEADER_KEY)) > 0);
+        }
+
+        TEST_METHOD(EachNotificationOwnTraceTest)
+        {
+            LatencyTrace::SetEnabled(true);
+            Assert::IsNull(LatencyTrace::GetContext());
+
+            std::string firstTraceParent;
+            {
+                const LatencyTrace::Scope scope;
+                firstTraceParent = LatencyTrace::GetContext()->traceParent;
+                {
+                    const LatencyTrace::Scope nestedScope;
+                    Assert::AreNotEqual(firstTraceParent, LatencyTrace::GetContext()->traceParent);
+                }
+                Assert::AreEqual(firstTraceParent, LatencyTrace::GetContext()->traceParent, L"Outer context restored");
+            }
+            Assert::IsNull(LatencyTrace::GetContext());
+
+            const LatencyTrace::Scope scope;
+            Assert::AreNotEqual(firstTraceParent, LatencyTrace::GetContext()->traceParent);
+        }
+
+        TEST_METHOD(NoContextWhenDisabledTest)
+        {
+            HeaderCapturingDispatcher target;
+            TraceContextHttpRequestDispatcher dispatcher(target);
+            const auto stateUpdatedBefore = PipelineLatency::GetInstance().GetSnapshot(LatencyStage::StateUpdated).GetCount();
+
+            LatencyTrace::SetEnabled(false);
+            {
+                const LatencyTrace::Scope scope;
+                Assert::IsNull(LatencyTrace::GetContext());
+                LatencyTrace::Mark(LatencyStage::StateUpdated);
+                dispatcher.EnqueueRequest(true, std::chrono::system_clock::now(), "", "{}", {}, "");
+            }
+            LatencyTrace::SetEnabled(true);
+
+            Assert::IsTrue(target.lastHeader.empty(), L"No trace headers");
+            Assert::AreEqual(stateUpdatedBefore, PipelineLatency::GetInstance().GetSnapshot(LatencyStage::StateUpdated).GetCount());
+        }
+    };
+}
@@ -0,0 +1,141 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "TraceSpans.h"
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        std::vector<nlohmann::json> GetEvents(const TraceRecorder& recorder, const std::string& name)
+        {
+            const auto trace = nlohmann::json::parse(recorder.FormatChromeTrace());
+            std::vector<nlohmann::json> events;
+            for (const auto& event : trace["traceEvents"])
+            {
+                if (event["name"] == name)
+                {
+                    events.push_back(event);
+                }
+            }
+            return events;
+        }
+
+        // start == duration, so that an event mixed from two writes shows up
+        void RecordNumbered(TraceRecorder& recorder, const char* name, int64_t number)
+        {
+            const std::chrono::steady_clock::time_point start{std::chrono::microseconds(number)};
+            recorder.Record(name, start, start + std::chrono::microseconds(number));
+        }
+    }
+
+    TEST_CLASS(TraceSpansTests)
+    {
+        TEST_METHOD(NestedSpansOnlyWhileEnabledTest)
+        {
+            auto& recorder = TraceRecorder::GetInstance();
+            {
+                TRACE_SPAN("TraceSpansTests.Disabled");
+            }
+            recorder.SetEnabled(true);
+            {
+                TRACE_SPAN("TraceSpansTests.Outer");
+                std::this_thread::sleep_for(1ms);
+                {
+                    TRACE_SPAN("TraceSpansTests.Inner");
+                    std::this_thread::sleep_for(1ms);
+                }
+            }
+            recorder.SetEnabled(false);
+
+            Assert::IsTrue(GetEvents(recorder, "TraceSpansTests.Disabled").empty());
+            const auto outer = GetEvents(recorder, "TraceSpansTests.Outer");
+            const auto inner = GetEvents(recorder, "TraceSpansTests.Inner");
+            Assert::AreEqual(size_t{1}, outer.size());
+            Assert::AreEqual(size_t{1}, inner.size());
+            Assert::AreEqual(std::string("X"), outer[0]["ph"].get<std::string>());
+            Assert::IsTrue(outer[0]["tid"] == inner[0]["tid"]);
+            Assert::IsTrue(outer[0]["dur"].get<double>() >= 2000.0);
+            Assert::IsTrue(outer[0]["ts"].get<double>() <= inner[0]["ts"].get<double>());
+            Assert::IsTrue(outer[0]["ts"].get<double>() + outer[0]["dur"].get<double>()
+                           >= inner[0]["ts"].get<double>() + inner[0]["dur"].get<double>(), L"Inner within outer");
+        }
+
+        TEST_METHOD(RingKeepsLatestSpansTest)
+        {
+            TraceRecorder recorder;
+            constexpr auto recordCount = static_cast<int64_t>(TraceRecorder::EVENTS_PER_THREAD) + 100;
+            for (int64_t number = 1; number <= recordCount; ++number)
+            {
+                RecordNumbered(recorder, "Span", number);
+            }
+
+            const auto events = GetEvents(recorder, "Span");
+            Assert::AreEqual(TraceRecorder::EVENTS_PER_THREAD, events.size());
+            Assert::AreEqual(101.0, events.front()["ts"].get<double>());
+            Assert::AreEqual(static_cast<double>(recordCount), events.back()["ts"].get<double>());
+        }
+
+        // Writers go round their rings many times while the export reads them: no event is mixed or repeated
+        TEST_METHOD(ExportWhileWritingTest)
+        {
+            TraceRecorder recorder;
+            constexpr size_t writerCount = 4;
+            {
+                std::vector<std::jthread> writers;
+                for (size_t writer = 0; writer < writerCount; ++writer)
+                {
+                    writers.emplace_back([&recorder](const std::stop_token& stopToken)
+                    {
+                        constexpr auto minimumCount = static_cast<int64_t>(2 * TraceRecorder::EVENTS_PER_THREAD);
+                        for (int64_t number = 1; number <= minimumCount || !stopToken.stop_requested(); ++number)
+                        {
+                            RecordNumbered(recorder, "Span", number);
+                        }
+                    });
+                }
+                for (int exports = 0; exports < 50; ++exports)
+                {
+                    std::set<std::pair<uint64_t, double>> seen;
+                    for (const auto& event : GetEvents(recorder, "Span"))
+                    {
+                        Assert::AreEqual(event["ts"].get<double>(), event["dur"].get<double>(), L"Not mixed");
+                        Assert::IsTrue(seen.emplace(event["tid"].get<uint64_t>(), event["ts"].get<double>()).second, L"Not repeated");
+                    }
+                }
+            }
+            Assert::AreEqual(writerCount * TraceRecorder::EVENTS_PER_THREAD, GetEvents(recorder, "Span").size());
+        }
+
+        // A thread pool replacing its threads: the next thread records into the ring of the finished one
+        TEST_METHOD(FinishedThreadBufferReusedTest)
+        {
+            TraceRecorder recorder;
+            for (int64_t thread = 1; thread <= 3; ++thread)
+            {
+                std::jthread([&recorder, thread] { RecordNumbered(recorder, "Span", thread); }).join();
+                Assert::AreEqual(static_cast<size_t>(thread), GetEvents(recorder, "Span").size(), L"Spans of the finished threads kept");
+            }
+            Assert::AreEqual(size_t{1}, recorder.GetThreadBufferCount());
+
+            {
+                std::jthread first([&recorder] { RecordNumbered(recorder, "Span", 4); });
+                std::jthread second([&recorder] { RecordNumbered(recorder, "Span", 5); });
+            }
+            Assert::IsTrue(recorder.GetThreadBufferCount() <= 2, L"One per thread recording at once");
+            Assert::AreEqual(size_t{5}, GetEvents(recorder, "Span").size());
+        }
+    };
+}
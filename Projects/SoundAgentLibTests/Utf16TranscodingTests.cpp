@@ -0,0 +1,108 @@
+#include "stdafx.h"
+
+#include <CppUnitTest.h>
+
+#include "ApiClient/common/StringUtils.h"
+
+#include "Utf16Transcoding.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace ed::tests
+{
+    namespace
+    {
+        std::string Transcode(std::wstring_view text)
+        {
+            std::string output(MaxUtf8Size(text.size()), '\0');
+            output.resize(TranscodeUtf16ToUtf8(text, output.data()));
+            return output;
+        }
+
+        std::string Truncate(std::wstring_view text)
+        {
+            std::string output(text.size(), '\0');
+            output.resize(TruncateUtf16(text, output.data()));
+            return output;
+        }
+
+        // Mostly ASCII, as the ids and names are, with runs of 2 and 3 byte characters and surrogate pairs
+        std::wstring CreateRandomText(std::mt19937& random, size_t size)
+        {
+            std::wstring text;
+            while (text.size() < size)
+            {
+                switch (const auto kind = random() % 100; kind < 80 ? 0 : kind < 88 ? 1 : kind < 95 ? 2 : 3)
+                {
+                case 0:
+                    text.push_back(static_cast<wchar_t>(0x20 + random() % 0x5F));
+                    break;
+                case 1:
+                    text.push_back(static_cast<wchar_t>(0x80 + random() % 0x780));
+                    break;
+                case 2:
+                    text.push_back(static_cast<wchar_t>(0xE000 + random() % 0x2000));
+                    break;
+                default:
+                    text.push_back(static_cast<wchar_t>(0xD800 + random() % 0x400));
+                    text.push_back(static_cast<wchar_t>(0xDC00 + random() % 0x400));
+                    break;
+                }
+            }
+            return text;
+        }
+    }
+
+    TEST_CLASS(Utf16TranscodingTests)
+    {
+        TEST_METHOD(EndpointIdTest)
+        {
+            constexpr auto deviceId = L"{0.0.1.00000000}.{6a3b1f29-4c8e-4d2a-9e71-0f5b2c8d4a11}";
+            const std::string expected = "{0.0.1.00000000}.{6a3b1f29-4c8e-4d2a-9e71-0f5b2c8d4a11}";
+            Assert::AreEqual(expected, Transcode(deviceId));
+            Assert::AreEqual(expected, Truncate(deviceId));
+            Assert::AreEqual(expected, std::string(Utf8Text(deviceId).View()));
+        }
+
+        TEST_METHOD(SameTextAsStringUtilsFuzzTest)
+        {
+            std::mt19937 random(20261019); // NOLINT(cert-msc51-cpp): reproducible
+            for (int iteration = 0; iteration < 20000; ++iteration)
+            {
+                const auto text = CreateRandomText(random, random() % 130);
+                // Every alignment of the blocks
+                const auto offset = random() % 4;
+                const auto view = std::wstring_view(text).substr(std::min<size_t>(offset, text.size()));
+                const std::wstring wide(view);
+
+                Assert::AreEqual(Utf16ToUtf8(wide), Transcode(view));
+                Assert::AreEqual(Utf16ToUtf8(wide), std::string(Utf8Text(view).View()));
+                Assert::AreEqual(WString2StringTruncate(wide), Truncate(view));
+            }
+        }
+
+        TEST_METHOD(UnpairedSurrogateTest)
+        {
+            const auto replacement = "\xEF\xBF\xBD"s;
+            Assert::AreEqual("a" + replacement + "b", Transcode(L"a\xD800" L"b"));
+            Assert::AreEqual("a" + replacement + "b", Transcode(L"a\xDC00" L"b"));
+            Assert::AreEqual("a" + replacement, Transcode(L"a\xDBFF"));
+            Assert::AreEqual(replacement + "\xF0\x9F\x8E\xA7", Transcode(L"\xDC00\xD83C\xDFA7"));
+        }
+
+        TEST_METHOD(LongTextOnHeapTest)
+        {
+            std::wstring text(Utf8Text::INLINE_SIZE, L'x');
+            text[Utf8Text::INLINE_SIZE / 2] = L'\x00E9';
+            const Utf8Text utf8(text);
+            Assert::AreEqual(Utf8Text::INLINE_SIZE + 1, utf8.View().size());
+            Assert::AreEqual(Utf16ToUtf8(text), std::string(utf8.View()));
+        }
+    };
+}
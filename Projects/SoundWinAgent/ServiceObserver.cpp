@@ -2,6 +2,10 @@
 
 #include "ServiceObserver.h"
 
+#include "DeviceDigest.h"
+#include "LogMacros.h"
+#include "PipelineLatency.h"
+#include "TraceSpans.h"
 #include "ApiClient/AudioDeviceApiClient.h"
 #include "ApiClient/common/StringUtils.h"
 
@@ -11,52 +15,167 @@
 #include <winternl.h>
 
 ServiceObserver::ServiceObserver(SoundDeviceCollectionInterface& collection,
-                                 HttpRequestDispatcherInterface& requestProcessor
+                                 HttpRequestDispatcherInterface& requestProcessor,
+                                 std::unique_ptr<ed::audio::SentDeviceStateCache> sentStateCache,
+                                 std::function<std::string()> hostNameProvider,
+                                 std::function<std::string()> operationSystemNameProvider,
+                                 const ed::ClockInterface& clock
                                  )
     : collection_(collection)
     , requestProcessorInterface_(requestProcessor)
+    , sentStateCache_(std::move(sentStateCache))
+    , hostNameProvider_(std::move(hostNameProvider))
+    , operationSystemNameProvider_(std::move(operationSystemNameProvider))
+    , clock_(clock)
 {
 }
 
 void ServiceObserver::PostDeviceToApi(const SoundDeviceEventType messageType, const SoundDeviceInterface* devicePtr, const std::string & hintPrefix) const
 {
-    const AudioDeviceApiClient apiClient(requestProcessorInterface_, GetHostName, GetOperationSystemName);
-    apiClient.PostDeviceToApi(messageType, devicePtr, hintPrefix);
+    using SendKind = ed::audio::SentDeviceStateCache::SendKind;
+
+    const AudioDeviceApiClient apiClient(requestProcessorInterface_, hostNameProvider_, operationSystemNameProvider_);
+    if (sentStateCache_ == nullptr)
+    {
+        apiClient.PostDeviceToApi(messageType, devicePtr, hintPrefix);
+        return;
+    }
+
+    const auto now = clock_.SystemNow();
+    switch (const auto [sendKind, changedFields] = sentStateCache_->Classify(*devicePtr, now); sendKind)
+    {
+    case SendKind::Nothing:
+        ED_LOG_INFO(R"({}Device "{}" is unchanged since sent last time; nothing to send.)", hintPrefix, devicePtr->GetPnpId());
+        break;
+    case SendKind::Delta:
+        requestProcessorInterface_.EnqueueRequest(true, now, DEVICE_DELTA_URL_SUFFIX,
+            ed::audio::SentDeviceStateCache::CreateDeltaPayload(*devicePtr, changedFields, messageType, hostNameProvider_(), now),
+            {{"Content-Type", "application/json"}}, hintPrefix + "Device delta " + devicePtr->GetPnpId());
+        sentStateCache_->MarkSent(*devicePtr, false, now);
+        break;
+    case SendKind::Full:
+        apiClient.PostDeviceToApi(messageType, devicePtr, hintPrefix);
+        sentStateCache_->MarkSent(*devicePtr, true, now);
+        break;
+    }
 }
 
 void ServiceObserver::PutVolumeChangeToApi(const std::string & pnpId, bool renderOrCapture, uint16_t volume, const std::string & hintPrefix) const
 {
-	const AudioDeviceApiClient apiClient(requestProcessorInterface_, GetHostName, GetOperationSystemName);
+	const AudioDeviceApiClient apiClient(requestProcessorInterface_, hostNameProvider_, operationSystemNameProvider_);
 	apiClient.PutVolumeChangeToApi(pnpId, renderOrCapture, volume, hintPrefix);
+    if (sentStateCache_ != nullptr)
+    {
+        sentStateCache_->MarkVolumeSent(pnpId, renderOrCapture, volume);
+    }
 }
 
 void ServiceObserver::PostAndPrintCollection() const
 {
     spdlog::info("Processing device collection...");
 
-    for (size_t i = 0; i < collection_.GetSize(); ++i)
+    std::vector<std::unique_ptr<SoundDeviceInterface>> devices;
+    const auto lock = LockWithCurrentDevices(devices);
+    for (const auto& deviceSmartPtr : devices)
     {
-        const auto deviceSmartPtr(collection_.CreateItem(i));
-
         spdlog::info(R"({}, "{}", {}, Volume {} / {})", deviceSmartPtr->GetPnpId(), deviceSmartPtr->GetName(),
                      magic_enum::enum_name(deviceSmartPtr->GetFlow()), deviceSmartPtr->GetCurrentRenderVolume(),
                      deviceSmartPtr->GetCurrentCaptureVolume());
         PostDeviceToApi(SoundDeviceEventType::Confirmed, deviceSmartPtr.get(), "(by iteration on device collection) ");
     }
+    SaveSentState();
     spdlog::info("...Processing device collection finished.");
 }
 
+void ServiceObserver::SendDueFullRecords() const
+{
+    if (sentStateCache_ == nullptr)
+    {
+        return;
+    }
+
+    std::vector<std::unique_ptr<SoundDeviceInterface>> devices;
+    const auto lock = LockWithCurrentDevices(devices);
+    const auto now = clock_.SystemNow();
+    for (const auto& deviceSmartPtr : devices)
+    {
+        if (sentStateCache_->Classify(*deviceSmartPtr, now).kind == ed::audio::SentDeviceStateCache::SendKind::Full)
+        {
+            PostDeviceToApi(SoundDeviceEventType::Confirmed, deviceSmartPtr.get(), "(by full state checkpoint) ");
+        }
+    }
+    sentStateCache_->SaveIfModified();
+}
+
+std::unique_lock<std::mutex> ServiceObserver::LockWithCurrentDevices(std::vector<std::unique_ptr<SoundDeviceInterface>>& devices) const
+{
+    std::unique_lock lock(sendMutex_);
+    // Under an event storm the last snapshot is taken as is: the next events send their devices again
+    for (int attempt = 0; attempt < MAX_DEVICE_SNAPSHOT_ATTEMPTS; ++attempt)
+    {
+        const auto seenEventCount = sentEventCount_;
+        lock.unlock();
+        devices = collection_.CreateItems();
+        lock.lock();
+        if (sentEventCount_ == seenEventCount)
+        {
+            break;
+        }
+    }
+    return lock;
+}
+
+void ServiceObserver::SaveSentState() const
+{
+    if (sentStateCache_ != nullptr)
+    {
+        sentStateCache_->SaveIfModified();
+    }
+}
+
+void ServiceObserver::PublishDeviceDigest() const
+{
+    const auto now = clock_.SystemNow();
+    const auto digest = ed::audio::DeviceDigest::FromCollection(collection_);
+    spdlog::info("Publishing digest of {} device(s), root hash {:016x}.", digest->GetSize(), digest->GetRootHash());
+    requestProcessorInterface_.EnqueueRequest(true, now, DEVICE_DIGEST_URL_SUFFIX, digest->CreateDigestPayload(hostNameProvider_(), now),
+                                              {{"Content-Type", "application/json"}}, "Device digest");
+}
+
+void ServiceObserver::SendDeviceDigestBuckets(const std::vector<size_t>& buckets) const
+{
+    const auto now = clock_.SystemNow();
+    const auto digest = ed::audio::DeviceDigest::FromCollection(collection_);
+    for (const auto bucket : buckets)
+    {
+        if (bucket >= ed::audio::DeviceDigest::BUCKET_COUNT)
+        {
+            spdlog::warn("Invalid device digest bucket {} requested.", bucket);
+            continue;
+        }
+        spdlog::info("Sending device digest bucket {} on mismatch.", bucket);
+        requestProcessorInterface_.EnqueueRequest(true, now, DEVICE_DIGEST_BUCKET_URL_SUFFIX,
+                                                  digest->CreateBucketPayload(bucket, hostNameProvider_(), now),
+                                                  {{"Content-Type", "application/json"}}, "Device digest bucket " + std::to_string(bucket));
+    }
+}
+
 void ServiceObserver::OnCollectionChanged(SoundDeviceEventType event, const std::string & devicePnpId)
 {
-    spdlog::info("Event caught: {}, device PnP id: {}.", magic_enum::enum_name(event), devicePnpId);
+    ed::LatencyTrace::Mark(ed::LatencyStage::ObserverInvoked);
+    // Builds the payload; the EnqueueRequest span nested in it is the handing over
+    TRACE_SPAN("OnCollectionChanged");
+    ED_LOG_INFO("Event caught: {}, device PnP id: {}.", magic_enum::enum_name(event), devicePnpId);
 
     const auto soundDeviceInterface = collection_.CreateItem(devicePnpId);
     if (!soundDeviceInterface)
     {
-        spdlog::warn("Sound device with PnP id cannot be initialized.", devicePnpId);
+        ED_LOG_WARN("Sound device with PnP id {} cannot be initialized.", devicePnpId);
         return;
     }
 
+    std::lock_guard lock(sendMutex_);
+    ++sentEventCount_;
 	//There is no SoundDeviceEventType::Confirmed processing. "Confirmed" is sent by collection initialization only
     if (event == SoundDeviceEventType::Discovered)
     {
@@ -75,7 +194,6 @@ void ServiceObserver::OnCollectionChanged(SoundDeviceEventType event, const std:
 	{
         spdlog::warn("Unexpected event type: {}", static_cast<int>(event));
 	}
-
 }
 
 std::string ServiceObserver::GetHostName()
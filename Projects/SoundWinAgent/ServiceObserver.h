@@ -1,6 +1,14 @@
 ﻿#pragma once
 
 #include "public/SoundAgentInterface.h"
+#include "Clock.h"
+#include "SentDeviceStateCache.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 class HttpRequestDispatcherInterface;
 class DirectHttpRequestDispatcher;
@@ -8,7 +16,13 @@ class DirectHttpRequestDispatcher;
 class ServiceObserver final : public SoundDeviceObserverInterface {
 public:
     ServiceObserver(SoundDeviceCollectionInterface& collection,
-        HttpRequestDispatcherInterface& requestProcessor
+        HttpRequestDispatcherInterface& requestProcessor,
+        std::unique_ptr<ed::audio::SentDeviceStateCache> sentStateCache = nullptr,
+        // The fleet simulator runs many observers in one process, each one as a virtual host
+        std::function<std::string()> hostNameProvider = GetHostName,
+        std::function<std::string()> operationSystemNameProvider = GetOperationSystemName,
+        // Time stamps of the messages
+        const ed::ClockInterface& clock = ed::SystemClock::GetInstance()
     );
 
     void PostDeviceToApi(SoundDeviceEventType messageType, const SoundDeviceInterface* devicePtr, const std::string & hintPrefix= "") const;
@@ -19,14 +33,42 @@ public:
 
 public:
     void PostAndPrintCollection() const;
+    // Sends a full record of every device whose checkpoint is due, independent of its events; saves the sent state
+    void SendDueFullRecords() const;
+    // The event path only updates the sent state in memory: it is saved by SendDueFullRecords and on stop
+    void SaveSentState() const;
+    // Anti-entropy: publishes the digest of the device table, for a backend to detect a drift
+    void PublishDeviceDigest() const;
+    // Sends the given digest buckets as a whole. For a backend answer naming its mismatched buckets;
+    // the transports are one way so far, nothing delivers such an answer yet.
+    void SendDeviceDigestBuckets(const std::vector<size_t>& buckets) const;
 
     void OnCollectionChanged(SoundDeviceEventType event, const std::string& devicePnpId) override;
 
 private:
+    // Locks sendMutex_ with a snapshot of the devices taken outside of it, see sentEventCount_
+    [[nodiscard]] std::unique_lock<std::mutex> LockWithCurrentDevices(std::vector<std::unique_ptr<SoundDeviceInterface>>& devices) const;
+
     static std::string GetHostName();
     static std::string GetOperationSystemName();
 
 private:
     SoundDeviceCollectionInterface& collection_;
     HttpRequestDispatcherInterface& requestProcessorInterface_;
+    // nullptr: every device message is sent as a full record
+    std::unique_ptr<ed::audio::SentDeviceStateCache> sentStateCache_;
+    const std::function<std::string()> hostNameProvider_;
+    const std::function<std::string()> operationSystemNameProvider_;
+    const ed::ClockInterface& clock_;
+    // Serializes the classify-send-mark sequences of the event path and of the checkpoint timer,
+    // so that a device is not sent twice
+    mutable std::mutex sendMutex_;
+    // Events sent under sendMutex_. An event arrives under the collection lock and then takes sendMutex_, so the
+    // device snapshot of the timer is taken outside of sendMutex_ and retaken if an event was sent meanwhile
+    mutable uint64_t sentEventCount_ = 0;
+    static constexpr int MAX_DEVICE_SNAPSHOT_ATTEMPTS = 10;
+
+    static constexpr auto DEVICE_DELTA_URL_SUFFIX = "/delta";
+    static constexpr auto DEVICE_DIGEST_URL_SUFFIX = "/digest";
+    static constexpr auto DEVICE_DIGEST_BUCKET_URL_SUFFIX = "/digest/bucket";
 };
@@ -4,16 +4,40 @@
 
 #include "ApiClient/SodiumCrypt.h"
 #include "ApiClient/RabbitMqHttpRequestDispatcher.h"
+#include "AgentMetrics.h"
+#include "AsyncDefaultLogger.h"
+#include "BinaryLog.h"
+#include "FanOutHttpRequestDispatcher.h"
+#include "LatencyMarkingHttpRequestDispatcher.h"
+#include "LogFloodGuard.h"
+#include "LogRing.h"
+#include "LogShipper.h"
+#include "NotificationRecording.h"
+#include "NdjsonHttpRequestDispatchers.h"
+#include "PeriodicTask.h"
+#include "PipelineLatency.h"
+#include "RateLimitingHttpRequestDispatcher.h"
+#include "RelayClientHttpRequestDispatcher.h"
+#include "RelayServer.h"
+#include "SessionEnvelopeHttpRequestDispatcher.h"
 #include "ServiceObserver.h"
+#include "SoundDeviceCollection.h"
+#include "TraceContextHttpRequestDispatcher.h"
+#include "TraceSpans.h"
 #include "public/CoInitRaiiHelper.h"
 #include "public/SoundAgentInterface.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <random>
 #include <tchar.h>
 #include <vector>
 
+#include <Poco/Environment.h>
+#include <Poco/Net/SocketAddress.h>
 #include <Poco/Util/ServerApplication.h>
 #include <Poco/UnicodeConverter.h>
 #include <Poco/Util/HelpFormatter.h>
@@ -22,6 +46,21 @@
 #include <spdlog/spdlog.h>
 
 
+namespace
+{
+    class EmptyDispatcher final : public HttpRequestDispatcherInterface
+    {
+    public:
+        void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
+                            const std::string&, const std::string&,
+                            const std::unordered_map<std::string, std::string>&, const std::string&
+        ) override
+        {
+            spdlog::info("Enqueueing ignored, because the transport method is \"None\"");
+        }
+    };
+}
+
 class AudioDeviceService final : public Poco::Util::ServerApplication {
 protected:
     int main(const std::vector<std::string>& args) override {
@@ -33,39 +72,194 @@ protected:
         try {
             spdlog::info("Starting Sound Agent...");
 
-            const auto coll(SoundAgent::CreateDeviceCollection());
-
-            std::unique_ptr<HttpRequestDispatcherInterface> requestDispatcherSmartPtr;
-            if (Poco::icompare(transportMethod_, API_TRANSPORT_METHOD_VALUE00_NONE) == 0)
+            FanOutHttpRequestDispatcher fanOutDispatcher;
+            for (const auto& sinkSettings : sinks_)
             {
-                class EmptyDispatcher : public HttpRequestDispatcherInterface
+                try
                 {
-                public:
-                    void EnqueueRequest(bool, const std::chrono::system_clock::time_point&,
-                                        const std::string&, const std::string&,
-                                        const std::unordered_map<std::string, std::string>&, const std::string&
-                    ) override
+                    // The RabbitMQ sink hands the messages over to its own sender and reports no delivery result:
+                    // a retry would never be triggered, broker failures are not retried
+                    auto retrySettings = retrySettings_;
+                    if (retrySettings.has_value() && Poco::icompare(sinkSettings.type, SINK_TYPE_RABBITMQ) == 0)
                     {
-                        spdlog::info("Enqueueing ignored, because the transport method is \"{}\"",
-                                     API_TRANSPORT_METHOD_VALUE00_NONE);
+                        spdlog::info(R"(Sink "{}" reports no delivery result; its failures are not retried.)", sinkSettings.type);
+                        retrySettings.reset();
                     }
-                };
-                requestDispatcherSmartPtr.reset(new EmptyDispatcher());
+                    fanOutDispatcher.AddSink(sinkSettings.type, CreateSinkDispatcher(sinkSettings),
+                                             sinkSettings.encoding, sinkSettings.queueCapacity, retrySettings);
+                }
+                catch (const std::exception& ex)
+                {
+                    spdlog::error(R"(Sink "{}" can not be created: {}.)", sinkSettings.type, ex.what());
+                }
+            }
+
+            if (relayListenPort_ > 0)
+            {
+                // Relay mode: no local devices; the messages of the agents are forwarded in batches to the sinks
+                const auto logShipper = CreateLogShipper(fanOutDispatcher, fanOutDispatcher);
+                RelayServer relayServer(fanOutDispatcher,
+                                        Poco::Net::SocketAddress(relayListenAddress_, static_cast<uint16_t>(relayListenPort_)),
+                                        relaySecret_, relaySettings_, Poco::Environment::nodeName());
+                waitForTerminationRequest();
+                spdlog::info("Stopping...");
+                return EXIT_OK;
+            }
+
+            // Only what reads the notification latency or its trace context pays for it
+            ed::LatencyTrace::SetEnabled(latencyLogIntervalMinutes_ > 0 || metricsPort_ > 0 || traceContextHeaders_ != 0);
+            const auto coll(CreateDeviceCollection());
+
+            // Shared: a sink may report its recovery from its own thread while this one is being destroyed
+            std::shared_ptr<SessionEnvelopeHttpRequestDispatcher> sessionEnvelopeDispatcherSmartPtr;
+            if (sessionHelloIntervalMinutes_ > 0)
+            {
+                spdlog::info("Host metadata sent once per session, hello repeated every {} minutes.", sessionHelloIntervalMinutes_);
+                sessionEnvelopeDispatcherSmartPtr = std::make_shared<SessionEnvelopeHttpRequestDispatcher>(
+                    fanOutDispatcher, std::chrono::minutes(sessionHelloIntervalMinutes_));
+                // A sink delivering again after an outage, e.g. a reconnected broker, may have lost the hello
+                fanOutDispatcher.SetSinkRecoveredHandler(
+                    [weakSessionDispatcher = std::weak_ptr(sessionEnvelopeDispatcherSmartPtr)](const std::string& sinkName)
+                    {
+                        if (const auto sessionDispatcher = weakSessionDispatcher.lock())
+                        {
+                            spdlog::info(R"(Sink "{}" delivers again; a new session starts.)", sinkName);
+                            sessionDispatcher->RenewSession();
+                        }
+                    });
+            }
+            auto& sessionDispatcher = sessionEnvelopeDispatcherSmartPtr ? *sessionEnvelopeDispatcherSmartPtr : fanOutDispatcher;
+
+            // Declared after the target dispatcher: destroyed (and flushed) before it
+            std::unique_ptr<RateLimitingHttpRequestDispatcher> rateLimitingDispatcherSmartPtr;
+            if (startupJitterMaxMs_ > 0 || rateLimitSettings_.messagesPerSecond > 0.0)
+            {
+                std::mt19937 randomGenerator(std::random_device{}());
+                const std::chrono::milliseconds startupDelay(
+                    std::uniform_int_distribution<unsigned>(0, startupJitterMaxMs_)(randomGenerator));
+                spdlog::info("Sending delayed by {} ms (startup jitter), rate limited to {} messages/s, burst {}, {}% reserved for lifecycle events.",
+                             startupDelay.count(), rateLimitSettings_.messagesPerSecond, rateLimitSettings_.burst,
+                             rateLimitSettings_.lifecycleSharePercent);
+                rateLimitingDispatcherSmartPtr = std::make_unique<RateLimitingHttpRequestDispatcher>(
+                    sessionDispatcher, rateLimitSettings_, startupDelay);
+            }
+            auto& rateLimitedDispatcher = rateLimitingDispatcherSmartPtr ? *rateLimitingDispatcherSmartPtr : sessionDispatcher;
+            // Behind the volume updates, in a queue of their own; the batches it refuses are spooled
+            const auto logShipper = CreateLogShipper(
+                rateLimitingDispatcherSmartPtr ? rateLimitingDispatcherSmartPtr->GetBackgroundDispatcher() : sessionDispatcher,
+                fanOutDispatcher);
+            // Before the rate limiter may defer a request to another thread
+            std::unique_ptr<TraceContextHttpRequestDispatcher> traceContextDispatcherSmartPtr;
+            if (traceContextHeaders_ != 0)
+            {
+                spdlog::info("Messages of endpoint notifications carry their trace context as headers.");
+                traceContextDispatcherSmartPtr = std::make_unique<TraceContextHttpRequestDispatcher>(rateLimitedDispatcher);
+            }
+            LatencyMarkingHttpRequestDispatcher requestDispatcher(
+                traceContextDispatcherSmartPtr ? *traceContextDispatcherSmartPtr : rateLimitedDispatcher);
+
+            std::unique_ptr<ed::audio::SentDeviceStateCache> sentStateCache;
+            if (fullStateCheckpointHours_ > 0)
+            {
+                if (std::filesystem::path stateFile;
+                    ed::utility::AppPath::GetAndValidateLogFilePathName(stateFile, RESOURCE_FILENAME_ATTRIBUTE))
+                {
+                    stateFile.replace_extension(".sent-state.json");
+                    sentStateCache = std::make_unique<ed::audio::SentDeviceStateCache>(
+                        stateFile, std::chrono::hours(fullStateCheckpointHours_));
+                    sentStateCache->Load();
+                }
+                else
+                {
+                    spdlog::warn("Sent device state can not be stored; all device messages are sent as full records.");
+                }
             }
-            else if (Poco::icompare(transportMethod_, API_TRANSPORT_METHOD_VALUE02_RABBITMQ) == 0)
+
+            std::unique_ptr<ed::AgentMetrics> agentMetrics;
+            if (metricsPort_ > 0)
             {
-                requestDispatcherSmartPtr.reset(new RabbitMqHttpRequestDispatcher());
+                try
+                {
+                    agentMetrics = std::make_unique<ed::AgentMetrics>(*coll, &fanOutDispatcher, static_cast<uint16_t>(metricsPort_));
+                }
+                catch (const Poco::Exception& ex)
+                {
+                    spdlog::error("Metrics endpoint can not be started: {}.", ex.displayText());
+                }
             }
 
-            ServiceObserver serviceObserver(*coll, *requestDispatcherSmartPtr);
+            const bool isSentStateCached = sentStateCache != nullptr;
+            ServiceObserver serviceObserver(*coll, requestDispatcher, std::move(sentStateCache));
             coll->Subscribe(serviceObserver);
 
             coll->ResetContent();
             serviceObserver.PostAndPrintCollection();
 
+            // A device without events gets its full record when due, too
+            std::unique_ptr<ed::PeriodicTask> fullStateCheckpoint;
+            if (isSentStateCached)
+            {
+                fullStateCheckpoint = std::make_unique<ed::PeriodicTask>("Full state checkpoint", FULL_STATE_CHECKPOINT_CHECK_INTERVAL,
+                    [&serviceObserver] { serviceObserver.SendDueFullRecords(); });
+            }
+
+            std::unique_ptr<ed::PeriodicTask> digestPublisher;
+            if (digestSyncIntervalMinutes_ > 0)
+            {
+                spdlog::info("Device digest published every {} minutes.", digestSyncIntervalMinutes_);
+                digestPublisher = std::make_unique<ed::PeriodicTask>("Device digest", std::chrono::minutes(digestSyncIntervalMinutes_),
+                    [&serviceObserver] { serviceObserver.PublishDeviceDigest(); });
+            }
+
+            std::unique_ptr<ed::PeriodicTask> latencyLogger;
+            if (latencyLogIntervalMinutes_ > 0)
+            {
+                latencyLogger = std::make_unique<ed::PeriodicTask>("Latency log", std::chrono::minutes(latencyLogIntervalMinutes_),
+                    [] { spdlog::info("Latency since start: {}.", ed::PipelineLatency::GetInstance().FormatSummary()); });
+            }
+
+            std::unique_ptr<ed::PeriodicTask> traceSpanWriter;
+            if (traceSpansDumpIntervalMinutes_ > 0)
+            {
+                if (std::filesystem::path traceFile;
+                    ed::utility::AppPath::GetAndValidateLogFilePathName(traceFile, RESOURCE_FILENAME_ATTRIBUTE))
+                {
+                    traceFile.replace_extension(".trace.json");
+                    spdlog::info(R"(Trace spans written to "{}" every {} minutes and on stop.)", traceFile.string(), traceSpansDumpIntervalMinutes_);
+                    ed::TraceRecorder::GetInstance().SetEnabled(true);
+                    traceSpanWriter = std::make_unique<ed::PeriodicTask>("Trace spans", std::chrono::minutes(traceSpansDumpIntervalMinutes_),
+                        [traceFile]
+                        {
+                            if (!ed::TraceRecorder::GetInstance().WriteChromeTrace(traceFile))
+                            {
+                                spdlog::warn(R"(Trace spans can not be written to "{}".)", traceFile.string());
+                            }
+                        },
+                        ed::PeriodicTask::OnStop::Run);
+                }
+                else
+                {
+                    spdlog::warn("Trace spans can not be written: no log directory.");
+                }
+            }
+
+            std::unique_ptr<ed::PeriodicTask> logFloodReporter;
+            if (ed::LogFloodGuard::GetInstance().IsLimited())
+            {
+                logFloodReporter = std::make_unique<ed::PeriodicTask>("Log flood report", LOG_FLOOD_REPORT_INTERVAL,
+                    [] { ed::LogFloodGuard::GetInstance().ReportSuppressed(); }, ed::PeriodicTask::OnStop::Run);
+            }
+
             waitForTerminationRequest();
 
+            logFloodReporter.reset();
+            traceSpanWriter.reset();
+            latencyLogger.reset();
+            digestPublisher.reset();
+            fullStateCheckpoint.reset();
+            agentMetrics.reset();
             coll->Unsubscribe(serviceObserver);
+            serviceObserver.SaveSentState();
 
             spdlog::info("Stopping...");
 
@@ -77,6 +271,138 @@ protected:
         }
     }
 
+    struct SinkSettings
+    {
+        std::string type;
+        ed::PayloadEncoding encoding = ed::PayloadEncoding::Json;
+        unsigned queueCapacity = DEFAULT_SINK_QUEUE_CAPACITY;
+        std::string path;
+        unsigned syncIntervalMs = DEFAULT_FILE_SINK_SYNC_INTERVAL_MS;
+        std::string host;
+        unsigned port = DEFAULT_RELAY_PORT;
+    };
+
+    [[nodiscard]] std::unique_ptr<HttpRequestDispatcherInterface> CreateSinkDispatcher(const SinkSettings& sinkSettings) const
+    {
+        if (Poco::icompare(sinkSettings.type, SINK_TYPE_RABBITMQ) == 0)
+        {
+            return std::make_unique<RabbitMqHttpRequestDispatcher>();
+        }
+        if (Poco::icompare(sinkSettings.type, SINK_TYPE_FILE) == 0)
+        {
+            std::filesystem::path pathName(sinkSettings.path);
+            if (pathName.empty())
+            {
+                if (!ed::utility::AppPath::GetAndValidateLogFilePathName(pathName, RESOURCE_FILENAME_ATTRIBUTE))
+                {
+                    throw std::runtime_error("No path configured and the log directory can not be used");
+                }
+                pathName.replace_extension(".events.ndjson");
+            }
+            spdlog::info(R"(Requests are written to "{}".)", pathName.string());
+            return std::make_unique<NdjsonFileHttpRequestDispatcher>(pathName, std::chrono::milliseconds(sinkSettings.syncIntervalMs));
+        }
+        if (Poco::icompare(sinkSettings.type, SINK_TYPE_STDOUT) == 0)
+        {
+            return std::make_unique<NdjsonStreamHttpRequestDispatcher>(std::cout);
+        }
+        if (Poco::icompare(sinkSettings.type, SINK_TYPE_RELAY) == 0)
+        {
+            if (sinkSettings.host.empty() || sinkSettings.port == 0 || sinkSettings.port > UINT16_MAX)
+            {
+                throw std::runtime_error("No valid relay host / port configured");
+            }
+            if (relaySecret_.empty())
+            {
+                throw std::runtime_error("No relay secret configured");
+            }
+            spdlog::info(R"(Requests are relayed via "{}:{}".)", sinkSettings.host, sinkSettings.port);
+            return std::make_unique<RelayClientHttpRequestDispatcher>(sinkSettings.host, static_cast<uint16_t>(sinkSettings.port),
+                                                                      relaySecret_, Poco::Environment::nodeName());
+        }
+        return std::make_unique<EmptyDispatcher>();
+    }
+
+    // <sinks><sink type="RabbitMQ|File|Stdout|Relay|None" encoding="..." queueCapacity="..." path="..." syncIntervalMs="..." host="..." port="..."/>...</sinks>
+    [[nodiscard]] std::vector<SinkSettings> ReadSinkSettings() const
+    {
+        std::vector<SinkSettings> sinks;
+        for (size_t index = 0; ; ++index)
+        {
+            const auto prefix = std::string(SINKS_PROPERTY_KEY) + "[" + std::to_string(index) + "]";
+            if (!config().hasProperty(prefix + "[@type]"))
+            {
+                break;
+            }
+
+            SinkSettings sinkSettings;
+            sinkSettings.type = config().getString(prefix + "[@type]");
+            if (Poco::icompare(sinkSettings.type, SINK_TYPE_RABBITMQ) != 0  // NOLINT(bugprone-branch-clone)
+                && Poco::icompare(sinkSettings.type, SINK_TYPE_FILE) != 0
+                && Poco::icompare(sinkSettings.type, SINK_TYPE_STDOUT) != 0
+                && Poco::icompare(sinkSettings.type, SINK_TYPE_RELAY) != 0
+                && Poco::icompare(sinkSettings.type, API_TRANSPORT_METHOD_VALUE00_NONE) != 0
+            )
+            {
+                spdlog::info(R"(Invalid sink type "{}" ignored.)", sinkSettings.type);
+                continue;
+            }
+
+            sinkSettings.encoding = payloadEncoding_;
+            if (const auto encodingName = config().getString(prefix + "[@encoding]", "");
+                !encodingName.empty())
+            {
+                if (const auto encoding = ed::ParsePayloadEncoding(encodingName))
+                {
+                    sinkSettings.encoding = *encoding;
+                }
+                else
+                {
+                    spdlog::info(R"(Invalid payload encoding "{}" of sink "{}". Using "{}".)", encodingName, sinkSettings.type,
+                                 ed::GetPayloadEncodingName(sinkSettings.encoding));
+                }
+            }
+            sinkSettings.queueCapacity = ReadOptionalUnsignedConfigProperty(prefix + "[@queueCapacity]", sinkSettings.queueCapacity);
+            sinkSettings.path = config().getString(prefix + "[@path]", "");
+            sinkSettings.syncIntervalMs = ReadOptionalUnsignedConfigProperty(prefix + "[@syncIntervalMs]", sinkSettings.syncIntervalMs);
+            sinkSettings.host = config().getString(prefix + "[@host]", "");
+            sinkSettings.port = ReadOptionalUnsignedConfigProperty(prefix + "[@port]", sinkSettings.port);
+            if (Poco::icompare(sinkSettings.type, SINK_TYPE_RELAY) == 0 && sinkSettings.encoding != ed::PayloadEncoding::Json)
+            {
+                // the relay lines carry the payloads as text; the relay's own sinks encode
+                spdlog::info(R"(Relay sink payloads are sent as "{}".)", ed::GetPayloadEncodingName(ed::PayloadEncoding::Json));
+                sinkSettings.encoding = ed::PayloadEncoding::Json;
+            }
+            sinks.push_back(std::move(sinkSettings));
+        }
+        return sinks;
+    }
+
+    [[nodiscard]] std::unique_ptr<SoundDeviceCollectionInterface> CreateDeviceCollection() const
+    {
+        if (recordNotifications_ == 0)
+        {
+            return SoundAgent::CreateDeviceCollection();
+        }
+        try
+        {
+            if (std::filesystem::path recordingFile;
+                ed::utility::AppPath::GetAndValidateLogFilePathName(recordingFile, RESOURCE_FILENAME_ATTRIBUTE))
+            {
+                recordingFile.replace_extension(".notifications.bin");
+                auto recorder = std::make_unique<ed::audio::NotificationRecorder>(recordingFile);
+                spdlog::info(R"(Endpoint notifications recorded to "{}".)", recordingFile.string());
+                return std::make_unique<ed::audio::SoundDeviceCollection>(std::move(recorder));
+            }
+            spdlog::warn("Endpoint notifications can not be recorded: no log directory.");
+        }
+        catch (const std::exception& ex)
+        {
+            spdlog::warn("Endpoint notifications can not be recorded: {}.", ex.what());
+        }
+        return SoundAgent::CreateDeviceCollection();
+    }
+
     [[nodiscard]] std::string ReadOptionalSimpleConfigProperty(const std::string& propertyName,
                                                                const std::string& defaultValue = "") const
     {
@@ -96,6 +422,21 @@ protected:
         return returnValue;
     }
 
+    [[nodiscard]] unsigned ReadOptionalUnsignedConfigProperty(const std::string& propertyName,
+                                                              unsigned defaultValue) const
+    {
+        const auto valueAsString = ReadOptionalSimpleConfigProperty(propertyName, std::to_string(defaultValue));
+        try
+        {
+            return static_cast<unsigned>(std::stoul(valueAsString));
+        }
+        catch (const std::exception&)
+        {
+            spdlog::info(R"(Property "{}" value "{}" is not a non-negative number. Using default value: "{}".)", propertyName, valueAsString, defaultValue);
+            return defaultValue;
+        }
+    }
+
 
     [[nodiscard]] std::string ReadMandatoryPossiblyEncryptedConfigProperty(const std::string & propertyName) const
     {
@@ -124,11 +465,61 @@ protected:
         return returnValue;
     }
 
+    std::unique_ptr<LogShipper> CreateLogShipper(HttpRequestDispatcherInterface& targetDispatcher,
+                                                 const FanOutHttpRequestDispatcher& fanOutDispatcher) const
+    {
+        if (!logRing_)
+        {
+            return nullptr;
+        }
+        ed::LogShippingSettings settings{.bytesPerSecond = static_cast<double>(logShippingBytesPerSecond_)};
+        if (std::filesystem::path spoolDirectory;
+            ed::utility::AppPath::GetAndValidateLogFilePathName(spoolDirectory, RESOURCE_FILENAME_ATTRIBUTE))
+        {
+            settings.spoolDirectory = spoolDirectory.replace_extension(".log-spool");
+        }
+        else
+        {
+            spdlog::warn("Log batches can not be spooled: no log directory.");
+        }
+        spdlog::info(R"(Log lines shipped in batches of up to {} bytes, {} bytes/s; spooled to "{}" while no sink is available.)",
+                     settings.maxBatchBytes, logShippingBytesPerSecond_, settings.spoolDirectory.string());
+        return std::make_unique<LogShipper>(*logRing_, targetDispatcher, settings, Poco::Environment::nodeName(),
+                                            [&fanOutDispatcher] { return fanOutDispatcher.IsAnySinkAvailable(); });
+    }
+
     static void FreeLog()
     {
         ed::model::Logger::Inst().Free();
     }
 
+    void SetUpBinaryLog()
+    {
+        if (std::filesystem::path binaryLogFile;
+            ed::utility::AppPath::GetAndValidateLogFilePathName(binaryLogFile, RESOURCE_FILENAME_ATTRIBUTE))
+        {
+            binaryLogFile.replace_extension(".binlog");
+            try
+            {
+                binaryLogWriter_ = std::make_unique<ed::BinaryLogWriter>(binaryLogFile);
+                spdlog::info(R"(Device log messages written in binary to "{}" only, not to this log; "SoundWinAgent /decodeLog=<file>" makes text of them.)",
+                             binaryLogFile.string());
+                if (logRing_)
+                {
+                    spdlog::warn("Device log messages are not shipped in the binary log format.");
+                }
+            }
+            catch (const std::runtime_error& ex)
+            {
+                spdlog::warn("Binary log can not be written: {}.", ex.what());
+            }
+        }
+        else
+        {
+            spdlog::warn("Binary log can not be written: no log directory.");
+        }
+    }
+
     static void SetUpLog()
     {
         ed::model::Logger::Inst().SetOutputToConsole(true);
@@ -163,7 +554,33 @@ protected:
         }
 
         SetUpLog();
+        // Before the asynchronous logger takes over the sinks
+        logShippingBytesPerSecond_ = ReadOptionalUnsignedConfigProperty(LOG_SHIPPING_BYTES_PER_SECOND_PROPERTY_KEY, 0);
+        if (logShippingBytesPerSecond_ > 0)
+        {
+            logRing_ = std::make_unique<ed::LogRing>(LOG_RING_CAPACITY);
+            logRingSink_ = std::make_shared<ed::LogRingSink>(*logRing_);
+            spdlog::default_logger()->sinks().push_back(logRingSink_);
+        }
+        if (const auto asyncLogQueueSize = ReadOptionalUnsignedConfigProperty(ASYNC_LOG_QUEUE_SIZE_PROPERTY_KEY, DEFAULT_ASYNC_LOG_QUEUE_SIZE);
+            asyncLogQueueSize > 0)
+        {
+            asyncLogger_ = std::make_unique<ed::AsyncDefaultLogger>(asyncLogQueueSize);
+        }
+        if (const auto logFloodMessagesPerSecond = ReadOptionalUnsignedConfigProperty(LOG_FLOOD_MESSAGES_PER_SECOND_PROPERTY_KEY,
+                                                                                      DEFAULT_LOG_FLOOD_MESSAGES_PER_SECOND);
+            logFloodMessagesPerSecond > 0)
+        {
+            const auto logFloodBurst = ReadOptionalUnsignedConfigProperty(LOG_FLOOD_BURST_PROPERTY_KEY, DEFAULT_LOG_FLOOD_BURST);
+            ed::LogFloodGuard::GetInstance().SetLimit(logFloodMessagesPerSecond, logFloodBurst);
+            spdlog::info("Log messages limited to {}/s per call site, burst {}.", logFloodMessagesPerSecond, logFloodBurst);
+        }
+        if (Poco::icompare(ReadOptionalSimpleConfigProperty(LOG_FORMAT_PROPERTY_KEY, LOG_FORMAT_TEXT), LOG_FORMAT_BINARY) == 0)
+        {
+            SetUpBinaryLog();
+        }
 
+        const bool transportMethodFromCommandLine = !transportMethod_.empty();
         if (transportMethod_.empty())
         {   // If no transport method is provided via command line, read it from the configuration
             spdlog::info("Transport method not provided via command line. Reading from configuration...");
@@ -182,11 +599,93 @@ protected:
             spdlog::info(R"(Transport method value "{}" validated.)", transportMethod_);
         }
 
+        startupJitterMaxMs_ = ReadOptionalUnsignedConfigProperty(STARTUP_JITTER_MAX_MS_PROPERTY_KEY, 0);
+        rateLimitSettings_.messagesPerSecond = ReadOptionalUnsignedConfigProperty(RATE_LIMIT_MESSAGES_PER_SECOND_PROPERTY_KEY, 0);
+        rateLimitSettings_.burst = ReadOptionalUnsignedConfigProperty(RATE_LIMIT_BURST_PROPERTY_KEY,
+                                                                      static_cast<unsigned>(rateLimitSettings_.messagesPerSecond));
+        rateLimitSettings_.lifecycleSharePercent = std::min(
+            ReadOptionalUnsignedConfigProperty(RATE_LIMIT_LIFECYCLE_SHARE_PERCENT_PROPERTY_KEY, rateLimitSettings_.lifecycleSharePercent),
+            ed::RateLimitSettings::MAX_LIFECYCLE_SHARE_PERCENT);
+        fullStateCheckpointHours_ = ReadOptionalUnsignedConfigProperty(FULL_STATE_CHECKPOINT_HOURS_PROPERTY_KEY, 0);
+        sessionHelloIntervalMinutes_ = ReadOptionalUnsignedConfigProperty(SESSION_HELLO_INTERVAL_MINUTES_PROPERTY_KEY, 0);
+        digestSyncIntervalMinutes_ = ReadOptionalUnsignedConfigProperty(DIGEST_SYNC_INTERVAL_MINUTES_PROPERTY_KEY, 0);
+        latencyLogIntervalMinutes_ = ReadOptionalUnsignedConfigProperty(LATENCY_LOG_INTERVAL_MINUTES_PROPERTY_KEY, 0);
+        traceContextHeaders_ = ReadOptionalUnsignedConfigProperty(TRACE_CONTEXT_HEADERS_PROPERTY_KEY, 0);
+        traceSpansDumpIntervalMinutes_ = ReadOptionalUnsignedConfigProperty(TRACE_SPANS_DUMP_INTERVAL_MINUTES_PROPERTY_KEY, 0);
+        relayListenPort_ = ReadOptionalUnsignedConfigProperty(RELAY_LISTEN_PORT_PROPERTY_KEY, 0);
+        if (relayListenPort_ > UINT16_MAX)
+        {
+            spdlog::info("Invalid relay listen port {}. Relay mode off.", relayListenPort_);
+            relayListenPort_ = 0;
+        }
+        relayListenAddress_ = ReadOptionalSimpleConfigProperty(RELAY_LISTEN_ADDRESS_PROPERTY_KEY, DEFAULT_RELAY_LISTEN_ADDRESS);
+        // shared by the relay and its agents; never logged
+        relaySecret_ = config().getString(RELAY_SECRET_PROPERTY_KEY, "");
+        if (relayListenPort_ > 0 && relaySecret_.empty())
+        {
+            spdlog::error(R"(No relay secret "{}" configured. Relay mode off.)", RELAY_SECRET_PROPERTY_KEY);
+            relayListenPort_ = 0;
+        }
+        metricsPort_ = ReadOptionalUnsignedConfigProperty(METRICS_PORT_PROPERTY_KEY, 0);
+        if (metricsPort_ > UINT16_MAX)
+        {
+            spdlog::info("Invalid metrics port {}. Metrics endpoint off.", metricsPort_);
+            metricsPort_ = 0;
+        }
+        relaySettings_.maxBatchCount = ReadOptionalUnsignedConfigProperty(RELAY_MAX_BATCH_COUNT_PROPERTY_KEY,
+                                                                          static_cast<unsigned>(relaySettings_.maxBatchCount));
+        relaySettings_.maxBatchDelay = std::chrono::milliseconds(ReadOptionalUnsignedConfigProperty(
+            RELAY_MAX_BATCH_DELAY_MS_PROPERTY_KEY, static_cast<unsigned>(relaySettings_.maxBatchDelay.count())));
+        recordNotifications_ = ReadOptionalUnsignedConfigProperty(RECORD_NOTIFICATIONS_PROPERTY_KEY, 0);
+
+        if (const auto payloadEncodingName = ReadOptionalSimpleConfigProperty(PAYLOAD_ENCODING_PROPERTY_KEY,
+                                                                              std::string(ed::GetPayloadEncodingName(payloadEncoding_)));
+            const auto payloadEncoding = ed::ParsePayloadEncoding(payloadEncodingName))
+        {
+            payloadEncoding_ = *payloadEncoding;
+        }
+        else
+        {
+            spdlog::info(R"(Invalid payload encoding "{}". Using default: "{}".)", payloadEncodingName, ed::GetPayloadEncodingName(payloadEncoding_));
+        }
+
+        if (const auto retryMaxAttempts = ReadOptionalUnsignedConfigProperty(RETRY_MAX_ATTEMPTS_PROPERTY_KEY, 1);
+            retryMaxAttempts > 1)
+        {
+            ed::RetrySettings retrySettings;
+            retrySettings.backoff.maxAttempts = retryMaxAttempts;
+            retrySettings.backoff.initialDelay = std::chrono::milliseconds(ReadOptionalUnsignedConfigProperty(
+                RETRY_INITIAL_DELAY_MS_PROPERTY_KEY, static_cast<unsigned>(retrySettings.backoff.initialDelay.count())));
+            retrySettings.backoff.maxDelay = std::chrono::milliseconds(ReadOptionalUnsignedConfigProperty(
+                RETRY_MAX_DELAY_MS_PROPERTY_KEY, static_cast<unsigned>(retrySettings.backoff.maxDelay.count())));
+            retrySettings.circuitBreaker.failureThreshold = ReadOptionalUnsignedConfigProperty(
+                CIRCUIT_BREAKER_FAILURE_THRESHOLD_PROPERTY_KEY, retrySettings.circuitBreaker.failureThreshold);
+            retrySettings.circuitBreaker.openDuration = std::chrono::milliseconds(ReadOptionalUnsignedConfigProperty(
+                CIRCUIT_BREAKER_OPEN_MS_PROPERTY_KEY, static_cast<unsigned>(retrySettings.circuitBreaker.openDuration.count())));
+            retrySettings_ = retrySettings;
+        }
+
+        // A transport given on the command line replaces the configured sinks
+        if (!transportMethodFromCommandLine)
+        {
+            sinks_ = ReadSinkSettings();
+        }
+        if (sinks_.empty())
+        {
+            sinks_.push_back({.type = transportMethod_, .encoding = payloadEncoding_});
+        }
+
         setUnixOptions(false);  // Force Windows service behavior
     }
 
     void uninitialize() override
 	{
+        binaryLogWriter_.reset();
+        asyncLogger_.reset();
+        if (logRingSink_)
+        {
+            std::erase(spdlog::default_logger()->sinks(), logRingSink_);
+        }
         FreeLog();
         ServerApplication::uninitialize();
     }
@@ -213,6 +712,13 @@ protected:
             .required(false)
             .repeatable(false)
             .callback(Poco::Util::OptionCallback<AudioDeviceService>(this, &AudioDeviceService::HandleVersion)));
+
+        options.addOption(
+            Poco::Util::Option("decodeLog", "", "Write a binary log file (logFormat Binary) as text to the console")
+            .required(false)
+            .repeatable(false)
+            .argument("<file>", true)
+            .callback(Poco::Util::OptionCallback<AudioDeviceService>(this, &AudioDeviceService::HandleDecodeLog)));
     }
 
     void HandleHelp(const std::string& name, const std::string& value)
@@ -234,6 +740,20 @@ protected:
         onlyConsoleOutputRequested_ = true;
     }
 
+    void HandleDecodeLog(const std::string& name, const std::string& value)
+    {
+        try
+        {
+            std::cout << ed::DecodeBinaryLogFile(value);
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << ex.what() << "\n";
+        }
+        stopOptionsProcessing();
+        onlyConsoleOutputRequested_ = true;
+    }
+
     void HandleTransport(const std::string& name, const std::string& value)
     {
         std::cout << fmt::format(R"(Got Transport Method "{}"
@@ -243,14 +763,84 @@ protected:
 
 private:
     std::string transportMethod_;
+    unsigned startupJitterMaxMs_ = 0;
+    ed::RateLimitSettings rateLimitSettings_;
+    unsigned fullStateCheckpointHours_ = 0;
+    unsigned sessionHelloIntervalMinutes_ = 0;
+    unsigned digestSyncIntervalMinutes_ = 0;
+    unsigned latencyLogIntervalMinutes_ = 0;
+    unsigned traceContextHeaders_ = 0;
+    unsigned metricsPort_ = 0;
+    unsigned traceSpansDumpIntervalMinutes_ = 0;
+    unsigned relayListenPort_ = 0;
+    std::string relayListenAddress_;
+    std::string relaySecret_;
+    ed::RelaySettings relaySettings_;
+    unsigned recordNotifications_ = 0;
+    ed::PayloadEncoding payloadEncoding_ = ed::PayloadEncoding::Json;
+    std::vector<SinkSettings> sinks_;
+    std::optional<ed::RetrySettings> retrySettings_;
 
     bool onlyConsoleOutputRequested_ = false;
+    std::unique_ptr<ed::AsyncDefaultLogger> asyncLogger_;
+    std::unique_ptr<ed::BinaryLogWriter> binaryLogWriter_;
+    unsigned logShippingBytesPerSecond_ = 0;
+    std::unique_ptr<ed::LogRing> logRing_;
+    std::shared_ptr<ed::LogRingSink> logRingSink_;
 
     // ReSharper disable once IdentifierTypo
     // ReSharper disable once StringLiteralTypo
     static constexpr auto API_TRANSPORT_METHOD_CONFIGURATED_PROPERTY_KEY = "custom.transportMethod";
     static constexpr auto API_TRANSPORT_METHOD_VALUE00_NONE = "None";
     static constexpr auto API_TRANSPORT_METHOD_VALUE02_RABBITMQ = "RabbitMQ";
+
+    static constexpr auto STARTUP_JITTER_MAX_MS_PROPERTY_KEY = "custom.startupJitterMaxMs";
+    static constexpr auto RATE_LIMIT_MESSAGES_PER_SECOND_PROPERTY_KEY = "custom.rateLimitMessagesPerSecond";
+    static constexpr auto RATE_LIMIT_BURST_PROPERTY_KEY = "custom.rateLimitBurst";
+    static constexpr auto RATE_LIMIT_LIFECYCLE_SHARE_PERCENT_PROPERTY_KEY = "custom.rateLimitLifecycleSharePercent";
+    static constexpr auto FULL_STATE_CHECKPOINT_HOURS_PROPERTY_KEY = "custom.fullStateCheckpointHours";
+    static constexpr auto FULL_STATE_CHECKPOINT_CHECK_INTERVAL = std::chrono::minutes(10);
+    static constexpr auto SESSION_HELLO_INTERVAL_MINUTES_PROPERTY_KEY = "custom.sessionHelloIntervalMinutes";
+    static constexpr auto DIGEST_SYNC_INTERVAL_MINUTES_PROPERTY_KEY = "custom.digestSyncIntervalMinutes";
+    static constexpr auto LATENCY_LOG_INTERVAL_MINUTES_PROPERTY_KEY = "custom.latencyLogIntervalMinutes";
+    static constexpr auto TRACE_CONTEXT_HEADERS_PROPERTY_KEY = "custom.traceContextHeaders";
+    static constexpr auto METRICS_PORT_PROPERTY_KEY = "custom.metricsPort";
+    static constexpr auto TRACE_SPANS_DUMP_INTERVAL_MINUTES_PROPERTY_KEY = "custom.traceSpansDumpIntervalMinutes";
+    static constexpr auto ASYNC_LOG_QUEUE_SIZE_PROPERTY_KEY = "custom.asyncLogQueueSize";
+    static constexpr unsigned DEFAULT_ASYNC_LOG_QUEUE_SIZE = 0;
+    static constexpr auto LOG_FLOOD_MESSAGES_PER_SECOND_PROPERTY_KEY = "custom.logFloodMessagesPerSecond";
+    static constexpr unsigned DEFAULT_LOG_FLOOD_MESSAGES_PER_SECOND = 0;
+    static constexpr auto LOG_FLOOD_BURST_PROPERTY_KEY = "custom.logFloodBurst";
+    static constexpr unsigned DEFAULT_LOG_FLOOD_BURST = 200;
+    static constexpr auto LOG_FLOOD_REPORT_INTERVAL = std::chrono::minutes(1);
+    static constexpr auto LOG_FORMAT_PROPERTY_KEY = "custom.logFormat";
+    static constexpr auto LOG_FORMAT_TEXT = "Text";
+    static constexpr auto LOG_FORMAT_BINARY = "Binary";
+    static constexpr auto LOG_SHIPPING_BYTES_PER_SECOND_PROPERTY_KEY = "custom.logShippingBytesPerSecond";
+    static constexpr size_t LOG_RING_CAPACITY = 8192;
+    static constexpr auto RELAY_LISTEN_PORT_PROPERTY_KEY = "custom.relayListenPort";
+    static constexpr auto RELAY_LISTEN_ADDRESS_PROPERTY_KEY = "custom.relayListenAddress";
+    static constexpr auto RELAY_SECRET_PROPERTY_KEY = "custom.relaySecret";
+    static constexpr auto RELAY_MAX_BATCH_COUNT_PROPERTY_KEY = "custom.relayMaxBatchCount";
+    static constexpr auto RELAY_MAX_BATCH_DELAY_MS_PROPERTY_KEY = "custom.relayMaxBatchDelayMs";
+    static constexpr auto RECORD_NOTIFICATIONS_PROPERTY_KEY = "custom.recordNotifications";
+    static constexpr auto PAYLOAD_ENCODING_PROPERTY_KEY = "custom.payloadEncoding";
+
+    static constexpr auto SINKS_PROPERTY_KEY = "custom.sinks.sink";
+    static constexpr auto SINK_TYPE_RABBITMQ = API_TRANSPORT_METHOD_VALUE02_RABBITMQ;
+    static constexpr auto SINK_TYPE_FILE = "File";
+    static constexpr auto SINK_TYPE_STDOUT = "Stdout";
+    static constexpr auto SINK_TYPE_RELAY = "Relay";
+    static constexpr unsigned DEFAULT_RELAY_PORT = 5680;
+    static constexpr auto DEFAULT_RELAY_LISTEN_ADDRESS = "127.0.0.1";
+    static constexpr unsigned DEFAULT_SINK_QUEUE_CAPACITY = 1000;
+    static constexpr unsigned DEFAULT_FILE_SINK_SYNC_INTERVAL_MS = 1000;
+
+    static constexpr auto RETRY_MAX_ATTEMPTS_PROPERTY_KEY = "custom.retryMaxAttempts";
+    static constexpr auto RETRY_INITIAL_DELAY_MS_PROPERTY_KEY = "custom.retryInitialDelayMs";
+    static constexpr auto RETRY_MAX_DELAY_MS_PROPERTY_KEY = "custom.retryMaxDelayMs";
+    static constexpr auto CIRCUIT_BREAKER_FAILURE_THRESHOLD_PROPERTY_KEY = "custom.circuitBreakerFailureThreshold";
+    static constexpr auto CIRCUIT_BREAKER_OPEN_MS_PROPERTY_KEY = "custom.circuitBreakerOpenMs";
 };
 
 int _tmain(int argc, _TCHAR * argv[])